@@ -0,0 +1,781 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/*
+  Distributed algorithm benchmarks.
+
+  Runs the example algorithms (asynch_bfs, asynch_bellman_ford, asynch_spanning_tree, asynch_lcr, and peterson_leader) on generated ring, grid, and random topologies under each scheduler.
+  The ring leader election algorithms are unidirectional and only run on rings.
+
+  Every run happens in a forked child so the peak resident set size belongs to that run alone.
+  The child reports one JSON object and the results are written to standard output as a JSON array.
+
+  generate_ns     Time to generate the topology (before the scheduler starts).
+  setup_ns        Time from the start of the scheduler until every channel is bound at both ends.
+  convergence_ns  Time from the start of the scheduler until the last message is delivered or the last result is reported.
+  run_ns          Time spent in ioa::run including the destruction of the automata.
+  actions         Actions executed on the channels, i.e., one per message sent and one per message delivered.
+                  The internal actions of the nodes are not counted.
+  cpu_ns          CPU time of every thread of the run.
+  utilization     CPU time of each thread divided by run_ns, busiest first, sampled from /proc every 10ms.
+
+  Algorithms that print their progress do so to a disabled std::cout so formatting and I/O are not measured.
+*/
+
+#include "asynch_bfs_automaton.hpp"
+#include "asynch_bellman_ford_automaton.hpp"
+#include "asynch_spanning_tree_automaton.hpp"
+#include "asynch_lcr_automaton.hpp"
+#include "peterson_leader_automaton.hpp"
+#include "UID.hpp"
+
+#include <ioa/ioa.hpp>
+#include <ioa/global_fifo_scheduler.hpp>
+#include <ioa/simple_scheduler.hpp>
+#include <ioa/sharded_scheduler.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <queue>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+  Topologies
+
+  Nodes are numbered 0 to N - 1 and every link is bidirectional.
+  A random topology is a random tree (so it is connected) plus random links until the average degree is reached.
+*/
+typedef std::vector<std::set<size_t> > graph;
+
+static void link (graph& g,
+		  const size_t i,
+		  const size_t j) {
+  g[i].insert (j);
+  g[j].insert (i);
+}
+
+static void make_ring (graph& g) {
+  const size_t N = g.size ();
+  for (size_t i = 0; N > 1 && i < N; ++i) {
+    link (g, i, (i + 1) % N);
+  }
+}
+
+static void make_grid (graph& g) {
+  const size_t N = g.size ();
+  size_t cols = 1;
+  while (cols * cols < N) {
+    ++cols;
+  }
+  for (size_t i = 0; i < N; ++i) {
+    if ((i + 1) % cols != 0 && i + 1 < N) {
+      link (g, i, i + 1);
+    }
+    if (i + cols < N) {
+      link (g, i, i + cols);
+    }
+  }
+}
+
+static double degree = 4;
+
+static void make_random (graph& g) {
+  const size_t N = g.size ();
+  for (size_t i = 1; i < N; ++i) {
+    link (g, i, lrand48 () % i);
+  }
+
+  size_t links = N - (N != 0);
+  const size_t target = static_cast<size_t> (degree * N / 2);
+  // Give up on duplicates eventually so dense requests on small graphs terminate.
+  for (size_t attempts = 0; links < target && attempts < 4 * target; ++attempts) {
+    const size_t i = lrand48 () % N;
+    const size_t j = lrand48 () % N;
+    if (i != j && g[i].count (j) == 0) {
+      link (g, i, j);
+      ++links;
+    }
+  }
+}
+
+static size_t link_count (const graph& g) {
+  size_t count = 0;
+  for (size_t i = 0; i < g.size (); ++i) {
+    count += g[i].size ();
+  }
+  return count / 2;
+}
+
+/*
+  Measurements
+
+  The counters are updated from the scheduler threads.
+  Each channel keeps its own tallies and adds them to the totals when it is destroyed.
+*/
+static int64_t run_start;
+static size_t channels_expected;
+static volatile size_t channels_bound;
+static volatile int64_t setup_end;
+static volatile int64_t last_event;
+static volatile uint64_t total_actions;
+static volatile uint64_t total_messages;
+
+static int64_t now_nsec () {
+  return ioa::time::now ().nsec ();
+}
+
+static void fold_max (volatile int64_t& v,
+		      const int64_t t) {
+  int64_t old = v;
+  while (t > old) {
+    const int64_t prev = __sync_val_compare_and_swap (&v, old, t);
+    if (prev == old) {
+      break;
+    }
+    old = prev;
+  }
+}
+
+// channel_automaton that counts its actions and reports when both of its ends are bound.
+template <class T>
+class bench_channel :
+  public ioa::automaton,
+  private ioa::observer
+{
+private:
+  std::queue<T> m_queue;
+  uint64_t m_actions;
+  uint64_t m_messages;
+  int64_t m_last;
+
+  void observe (ioa::observable* o) {
+    const bool bound = (o == &send) ? send.recent_op == ioa::BOUND : receive.recent_op == ioa::BOUND;
+    if (bound && __sync_add_and_fetch (&channels_bound, 1) == 2 * channels_expected) {
+      setup_end = now_nsec ();
+    }
+  }
+
+  void send_effect (const T& t) {
+    ++m_actions;
+    m_queue.push (t);
+  }
+
+  void send_schedule () const {
+    receive_schedule ();
+  }
+
+public:
+  V_UP_INPUT (bench_channel, send, T);
+
+private:
+  bool receive_precondition () const {
+    return !m_queue.empty () && ioa::binding_count (&bench_channel::receive) != 0;
+  }
+
+  T receive_effect () {
+    ++m_actions;
+    ++m_messages;
+    m_last = now_nsec ();
+    T retval = m_queue.front ();
+    m_queue.pop ();
+    return retval;
+  }
+
+  void receive_schedule () const {
+    if (receive_precondition ()) {
+      ioa::schedule (&bench_channel::receive);
+    }
+  }
+
+public:
+  V_UP_OUTPUT (bench_channel, receive, T);
+
+  bench_channel () :
+    m_actions (0),
+    m_messages (0),
+    m_last (0)
+  {
+    add_observable (&send);
+    add_observable (&receive);
+  }
+
+  ~bench_channel () {
+    __sync_add_and_fetch (&total_actions, m_actions);
+    __sync_add_and_fetch (&total_messages, m_messages);
+    fold_max (last_event, m_last);
+  }
+};
+
+/*
+  Algorithms
+
+  Each algorithm describes how to allocate its node i with root i0.
+*/
+struct bfs_algorithm
+{
+  typedef asynch_bfs_automaton node_type;
+  typedef size_t message_type;
+
+  static std::auto_ptr<ioa::typed_allocator_interface<node_type> > allocator (const graph& g,
+									     const size_t i,
+									     const size_t i0) {
+    return ioa::make_allocator<node_type> (i, i0, g[i]);
+  }
+};
+
+struct bellman_ford_algorithm
+{
+  typedef asynch_bellman_ford_automaton node_type;
+  typedef size_t message_type;
+
+  // Link weights depend only on the endpoints so both ends agree.
+  static size_t weight (size_t i,
+			size_t j) {
+    if (i > j) {
+      std::swap (i, j);
+    }
+    return 1 + (i * 2654435761u + j) % 16;
+  }
+
+  static std::auto_ptr<ioa::typed_allocator_interface<node_type> > allocator (const graph& g,
+									     const size_t i,
+									     const size_t i0) {
+    std::map<size_t, size_t> weights;
+    for (std::set<size_t>::const_iterator pos = g[i].begin (); pos != g[i].end (); ++pos) {
+      weights.insert (std::make_pair (*pos, weight (i, *pos)));
+    }
+    return ioa::make_allocator<node_type> (i, i0, g[i], weights);
+  }
+};
+
+struct spanning_tree_algorithm
+{
+  typedef asynch_spanning_tree_automaton node_type;
+  typedef search_t message_type;
+
+  static std::auto_ptr<ioa::typed_allocator_interface<node_type> > allocator (const graph& g,
+									     const size_t i,
+									     const size_t i0) {
+    return ioa::make_allocator<node_type> (i, i0, g[i]);
+  }
+};
+
+// Binds an output that reports a result to the network, if the node has one.
+template <class T, class N>
+static void bind_report (N*,
+			 ioa::automaton_manager<T>*,
+			 const size_t) { }
+
+template <class N>
+static void bind_report (N* network,
+			 ioa::automaton_manager<asynch_spanning_tree_automaton>* node,
+			 const size_t i) {
+  ioa::make_binding_manager (network, node, &asynch_spanning_tree_automaton::parent, &network->self, &N::report, i);
+}
+
+// A network of A nodes joined by a pair of channels for every link.
+template <class A>
+class bidirectional_bench_network :
+  public ioa::automaton
+{
+private:
+  typedef typename A::node_type T;
+  typedef bench_channel<typename A::message_type> C;
+
+  void report_effect (const size_t&, size_t) {
+    fold_max (last_event, now_nsec ());
+  }
+
+  void report_schedule (size_t) const { }
+
+public:
+  ioa::handle_manager<bidirectional_bench_network> self;
+
+  V_P_INPUT (bidirectional_bench_network, report, size_t, size_t);
+
+  bidirectional_bench_network (const graph* g,
+			       const size_t i0) :
+    self (ioa::get_aid ())
+  {
+    const size_t N = g->size ();
+    std::vector<ioa::automaton_manager<T>*> nodes;
+    nodes.reserve (N);
+    for (size_t i = 0; i < N; ++i) {
+      nodes.push_back (ioa::make_automaton_manager (this, A::allocator (*g, i, i0)));
+      bind_report (this, nodes[i], i);
+    }
+
+    for (size_t i = 0; i < N; ++i) {
+      for (std::set<size_t>::const_iterator pos = (*g)[i].begin (); pos != (*g)[i].end (); ++pos) {
+	// One channel from i to j.
+	const size_t j = *pos;
+	ioa::automaton_manager<C>* channel = ioa::make_automaton_manager (this, ioa::make_allocator<C> ());
+	ioa::make_binding_manager (this, nodes[i], &T::send, j, channel, &C::send);
+	ioa::make_binding_manager (this, channel, &C::receive, nodes[j], &T::receive, i);
+      }
+    }
+  }
+};
+
+// A unidirectional ring of T nodes that report when they are elected.
+template <class T>
+class ring_bench_network :
+  public ioa::automaton
+{
+private:
+  typedef bench_channel<UID_t> C;
+
+  ioa::handle_manager<ring_bench_network> m_self;
+
+  void leader_effect (const bool&, size_t) {
+    fold_max (last_event, now_nsec ());
+  }
+
+  void leader_schedule (size_t) const { }
+
+  V_P_INPUT (ring_bench_network, leader, bool, size_t);
+
+public:
+  ring_bench_network (const graph* g,
+		      const size_t) :
+    m_self (ioa::get_aid ())
+  {
+    const size_t N = g->size ();
+    std::vector<ioa::automaton_manager<T>*> nodes;
+    std::vector<ioa::automaton_manager<C>*> channels;
+    nodes.reserve (N);
+    channels.reserve (N);
+    for (size_t i = 0; i < N; ++i) {
+      nodes.push_back (ioa::make_automaton_manager (this, ioa::make_allocator<T> (UID_t (lrand48 (), i))));
+      channels.push_back (ioa::make_automaton_manager (this, ioa::make_allocator<C> ()));
+    }
+
+    for (size_t i = 0; i < N; ++i) {
+      ioa::make_binding_manager (this, nodes[i], &T::send, channels[i], &C::send);
+      ioa::make_binding_manager (this, channels[i], &C::receive, nodes[(i + 1) % N], &T::receive);
+      ioa::make_binding_manager (this, nodes[i], &T::leader, &m_self, &ring_bench_network::leader, i);
+    }
+  }
+};
+
+/*
+  Thread sampling
+
+  A sampling thread reads the CPU time of every thread of the process from /proc.
+  schedstat has nanosecond resolution; stat is the fallback when the kernel does not provide it.
+*/
+static volatile bool sampling;
+static pid_t sampler_tid;
+static std::map<pid_t, int64_t> thread_cpu;
+
+static bool read_thread_cpu (const pid_t tid,
+			     int64_t& nsec) {
+  char path[64];
+  snprintf (path, sizeof (path), "/proc/self/task/%d/schedstat", tid);
+  std::ifstream schedstat (path);
+  long long run;
+  if (schedstat >> run) {
+    nsec = run;
+    return true;
+  }
+
+  snprintf (path, sizeof (path), "/proc/self/task/%d/stat", tid);
+  std::ifstream stat (path);
+  std::string line;
+  if (!std::getline (stat, line) || line.rfind (')') == std::string::npos) {
+    return false;
+  }
+  // The fields after the command name start with the state (field 3); utime and stime are fields 14 and 15.
+  std::istringstream fields (line.substr (line.rfind (')') + 2));
+  std::string field;
+  for (int i = 3; i < 14; ++i) {
+    fields >> field;
+  }
+  long long utime;
+  long long stime;
+  if (!(fields >> utime >> stime)) {
+    return false;
+  }
+  nsec = (utime + stime) * (1000000000LL / sysconf (_SC_CLK_TCK));
+  return true;
+}
+
+static void sample_threads () {
+  DIR* dir = opendir ("/proc/self/task");
+  if (dir == 0) {
+    return;
+  }
+  struct dirent* entry;
+  while ((entry = readdir (dir)) != 0) {
+    const pid_t tid = atoi (entry->d_name);
+    int64_t nsec;
+    if (tid != 0 && tid != sampler_tid && read_thread_cpu (tid, nsec)) {
+      thread_cpu[tid] = nsec;
+    }
+  }
+  closedir (dir);
+}
+
+static void* sampler (void*) {
+  sampler_tid = syscall (SYS_gettid);
+  while (sampling) {
+    sample_threads ();
+    usleep (10000);
+  }
+  return 0;
+}
+
+/*
+  Runs
+*/
+struct algorithm
+{
+  const char* name;
+  bool ring_only;
+  void (*run) (ioa::scheduler_interface&, const graph*, size_t);
+};
+
+template <class A>
+static void run_bidirectional (ioa::scheduler_interface& sched,
+			       const graph* g,
+			       const size_t i0) {
+  ioa::run (sched, ioa::make_allocator<bidirectional_bench_network<A> > (g, i0));
+}
+
+template <class T>
+static void run_ring (ioa::scheduler_interface& sched,
+		      const graph* g,
+		      const size_t i0) {
+  ioa::run (sched, ioa::make_allocator<ring_bench_network<T> > (g, i0));
+}
+
+static const algorithm algorithms[] = {
+  { "asynch_bfs", false, run_bidirectional<bfs_algorithm> },
+  { "asynch_bellman_ford", false, run_bidirectional<bellman_ford_algorithm> },
+  { "asynch_spanning_tree", false, run_bidirectional<spanning_tree_algorithm> },
+  { "asynch_lcr", true, run_ring<asynch_lcr_automaton<UID_t> > },
+  { "peterson_leader", true, run_ring<peterson_leader_automaton<UID_t> > },
+};
+
+struct topology
+{
+  const char* name;
+  void (*make) (graph&);
+};
+
+static const topology topologies[] = {
+  { "ring", make_ring },
+  { "grid", make_grid },
+  { "random", make_random },
+};
+
+static const char* const scheduler_names[] = { "global_fifo", "simple", "sharded" };
+
+static long seed = 1;
+
+// Performs one run in the current process and writes its JSON object to fd.
+static void measure (const algorithm& alg,
+		     const topology& top,
+		     const size_t N,
+		     const std::string& scheduler,
+		     const int threads,
+		     const int fd) {
+  // The algorithms print their progress.
+  std::cout.setstate (std::ios::badbit);
+
+  srand48 (seed);
+  int64_t start = now_nsec ();
+  graph g (N);
+  top.make (g);
+  const size_t i0 = lrand48 () % N;
+  const int64_t generate_ns = now_nsec () - start;
+
+  channels_expected = alg.ring_only ? N : 2 * link_count (g);
+
+  std::auto_ptr<ioa::scheduler_interface> sched;
+  if (scheduler == "global_fifo") {
+    sched.reset (new ioa::global_fifo_scheduler ());
+  }
+  else if (scheduler == "simple") {
+    sched.reset (new ioa::simple_scheduler (threads));
+  }
+  else {
+    sched.reset (new ioa::sharded_scheduler (threads));
+  }
+
+  sampling = true;
+  pthread_t sampler_thread;
+  pthread_create (&sampler_thread, 0, sampler, 0);
+
+  run_start = now_nsec ();
+  alg.run (*sched, &g, i0);
+  const int64_t run_ns = now_nsec () - run_start;
+
+  sampling = false;
+  pthread_join (sampler_thread, 0);
+  sample_threads ();
+
+  struct rusage usage;
+  getrusage (RUSAGE_SELF, &usage);
+
+  const int64_t setup_ns = setup_end != 0 ? setup_end - run_start : -1;
+  const int64_t convergence_ns = std::max (last_event, setup_end) - run_start;
+
+  std::vector<int64_t> cpu;
+  int64_t cpu_ns = 0;
+  for (std::map<pid_t, int64_t>::const_iterator pos = thread_cpu.begin (); pos != thread_cpu.end (); ++pos) {
+    cpu.push_back (pos->second);
+    cpu_ns += pos->second;
+  }
+  std::sort (cpu.begin (), cpu.end (), std::greater<int64_t> ());
+
+  std::ostringstream out;
+  out << "  {\"algorithm\": \"" << alg.name << "\""
+      << ", \"topology\": \"" << top.name << "\""
+      << ", \"nodes\": " << N
+      << ", \"links\": " << link_count (g)
+      << ", \"scheduler\": \"" << scheduler << "\""
+      << ", \"threads\": " << threads
+      << ", \"seed\": " << seed
+      << ", \"generate_ns\": " << generate_ns
+      << ", \"setup_ns\": " << setup_ns
+      << ", \"convergence_ns\": " << convergence_ns
+      << ", \"run_ns\": " << run_ns
+      << ", \"messages\": " << total_messages
+      << ", \"actions\": " << total_actions
+      << ", \"actions_per_sec\": " << static_cast<int64_t> (convergence_ns > 0 ? total_actions * 1e9 / convergence_ns : 0)
+      << ", \"peak_rss_kb\": " << usage.ru_maxrss
+      << ", \"cpu_ns\": " << cpu_ns
+      << ", \"utilization\": [";
+  for (size_t i = 0; i < cpu.size (); ++i) {
+    out << (i == 0 ? "" : ", ") << static_cast<double> (cpu[i]) / run_ns;
+  }
+  out << "]}";
+
+  const std::string s = out.str ();
+  if (write (fd, s.data (), s.size ()) != static_cast<ssize_t> (s.size ())) {
+    exit (EXIT_FAILURE);
+  }
+}
+
+// Forks so the run has its own address space and its own peak resident set size.
+// Returns false if the child fails, leaving result untouched.
+static bool measure_in_child (const algorithm& alg,
+			      const topology& top,
+			      const size_t N,
+			      const std::string& scheduler,
+			      const int threads,
+			      std::string& result) {
+  int fd[2];
+  if (pipe (fd) == -1) {
+    perror ("pipe");
+    exit (EXIT_FAILURE);
+  }
+
+  const pid_t pid = fork ();
+  if (pid == -1) {
+    perror ("fork");
+    exit (EXIT_FAILURE);
+  }
+  if (pid == 0) {
+    close (fd[0]);
+    measure (alg, top, N, scheduler, threads, fd[1]);
+    _exit (EXIT_SUCCESS);
+  }
+
+  close (fd[1]);
+  std::string s;
+  char buf[4096];
+  ssize_t r;
+  while ((r = read (fd[0], buf, sizeof (buf))) != 0) {
+    if (r > 0) {
+      s.append (buf, r);
+    }
+    else if (errno != EINTR) {
+      break;
+    }
+  }
+  close (fd[0]);
+
+  int status;
+  if (waitpid (pid, &status, 0) == -1 ||
+      !WIFEXITED (status) ||
+      WEXITSTATUS (status) != EXIT_SUCCESS ||
+      s.empty ()) {
+    std::cerr << alg.name << " on " << top.name << " with " << N << " nodes under " << scheduler << " with " << threads << " threads failed" << std::endl;
+    return false;
+  }
+  result = s;
+  return true;
+}
+
+static std::vector<std::string> split (const char* list) {
+  std::vector<std::string> retval;
+  std::istringstream in (list);
+  std::string s;
+  while (std::getline (in, s, ',')) {
+    retval.push_back (s);
+  }
+  return retval;
+}
+
+static bool selected (const std::vector<std::string>& list,
+		      const char* name) {
+  return list.empty () || std::find (list.begin (), list.end (), name) != list.end ();
+}
+
+static void usage (const char* program) {
+  std::cerr << "Usage: " << program << " [-n NODES[,NODES...]] [-t THREADS[,THREADS...]] [-a ALGORITHM[,...]] [-g TOPOLOGY[,...]] [-S SCHEDULER[,...]] [-d DEGREE] [-s SEED]" << std::endl;
+  std::cerr << "Algorithms:";
+  for (size_t i = 0; i < sizeof (algorithms) / sizeof (algorithms[0]); ++i) {
+    std::cerr << " " << algorithms[i].name;
+  }
+  std::cerr << std::endl << "Topologies:";
+  for (size_t i = 0; i < sizeof (topologies) / sizeof (topologies[0]); ++i) {
+    std::cerr << " " << topologies[i].name;
+  }
+  std::cerr << std::endl << "Schedulers:";
+  for (size_t i = 0; i < sizeof (scheduler_names) / sizeof (scheduler_names[0]); ++i) {
+    std::cerr << " " << scheduler_names[i];
+  }
+  std::cerr << std::endl;
+  exit (EXIT_FAILURE);
+}
+
+int
+main (int argc, char* argv[]) {
+  std::vector<size_t> sizes;
+  std::vector<int> threads;
+  std::vector<std::string> only_algorithms;
+  std::vector<std::string> only_topologies;
+  std::vector<std::string> only_schedulers;
+
+  int c;
+  while ((c = getopt (argc, argv, "n:t:a:g:S:d:s:")) != -1) {
+    switch (c) {
+    case 'n':
+    case 't':
+      {
+	const std::vector<std::string> list = split (optarg);
+	for (size_t i = 0; i < list.size (); ++i) {
+	  const long v = atol (list[i].c_str ());
+	  if (v <= 0) {
+	    usage (argv[0]);
+	  }
+	  if (c == 'n') {
+	    sizes.push_back (v);
+	  }
+	  else {
+	    threads.push_back (v);
+	  }
+	}
+      }
+      break;
+    case 'a':
+      only_algorithms = split (optarg);
+      break;
+    case 'g':
+      only_topologies = split (optarg);
+      break;
+    case 'S':
+      only_schedulers = split (optarg);
+      break;
+    case 'd':
+      degree = strtod (optarg, 0);
+      break;
+    case 's':
+      seed = atol (optarg);
+      break;
+    default:
+      usage (argv[0]);
+    }
+  }
+
+  if (optind != argc || degree < 0) {
+    usage (argv[0]);
+  }
+
+  if (sizes.empty ()) {
+    sizes.push_back (1000);
+    sizes.push_back (10000);
+  }
+
+  if (threads.empty ()) {
+    threads.push_back (1);
+    threads.push_back (2);
+    threads.push_back (4);
+  }
+
+  bool first = true;
+  bool found = false;
+  bool ok = true;
+  for (size_t a = 0; a < sizeof (algorithms) / sizeof (algorithms[0]); ++a) {
+    if (!selected (only_algorithms, algorithms[a].name)) {
+      continue;
+    }
+    for (size_t t = 0; t < sizeof (topologies) / sizeof (topologies[0]); ++t) {
+      if (!selected (only_topologies, topologies[t].name) ||
+	  (algorithms[a].ring_only && strcmp (topologies[t].name, "ring") != 0)) {
+	continue;
+      }
+      for (size_t n = 0; n < sizes.size (); ++n) {
+	for (size_t s = 0; s < sizeof (scheduler_names) / sizeof (scheduler_names[0]); ++s) {
+	  if (!selected (only_schedulers, scheduler_names[s])) {
+	    continue;
+	  }
+	  // global_fifo_scheduler has exactly one thread.
+	  const bool single = strcmp (scheduler_names[s], "global_fifo") == 0;
+	  for (size_t k = 0; k < (single ? 1 : threads.size ()); ++k) {
+	    found = true;
+	    std::string result;
+	    if (measure_in_child (algorithms[a], topologies[t], sizes[n], scheduler_names[s], single ? 1 : threads[k], result)) {
+	      std::cout << (first ? "[\n" : ",\n") << result << std::flush;
+	      first = false;
+	    }
+	    else {
+	      ok = false;
+	    }
+	  }
+	}
+      }
+    }
+  }
+
+  if (!found) {
+    usage (argv[0]);
+  }
+
+  std::cout << (first ? "[" : "") << "\n]" << std::endl;
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,642 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/*
+  Microbenchmarks for the runtime primitives.
+
+  Each benchmark runs a root automaton that exercises one primitive ITERATIONS times and records the latency of every operation in nanoseconds.
+  The first tenth of each series is discarded as warm-up.
+  Every benchmark runs under global_fifo_scheduler and under simple_scheduler with each of the given thread counts.
+  The results are written to standard output as a JSON array with one object per series, scheduler, and thread count.
+*/
+
+#include <ioa/ioa.hpp>
+#include <ioa/global_fifo_scheduler.hpp>
+#include <ioa/simple_scheduler.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+static int iterations = 10000;
+
+// The samples of the running benchmark by series.
+static std::map<std::string, std::vector<int64_t> > samples;
+
+static int64_t now_nsec () {
+  return ioa::time::now ().nsec ();
+}
+
+static void record (const char* series,
+		    const int64_t nsec) {
+  samples[series].push_back (nsec);
+}
+
+/*
+  schedule and schedule_duplicate
+
+  An internal action schedules itself from its effect.
+  The duplicate variant schedules itself eight times, seven of which the scheduler must discard.
+  The sample is the cost of one call.
+*/
+class schedule_bench :
+  public ioa::automaton
+{
+private:
+  const int m_calls;
+  int m_count;
+
+  bool step_precondition () const {
+    return m_count < iterations;
+  }
+
+  void step_effect () {
+    ++m_count;
+    const int64_t start = now_nsec ();
+    for (int i = 0; i < m_calls; ++i) {
+      ioa::schedule (&schedule_bench::step);
+    }
+    record (m_calls == 1 ? "schedule" : "schedule_duplicate", (now_nsec () - start) / m_calls);
+  }
+
+  void step_schedule () const { }
+
+  UP_INTERNAL (schedule_bench, step);
+
+public:
+  schedule_bench (const int calls) :
+    m_calls (calls),
+    m_count (0)
+  {
+    ioa::schedule (&schedule_bench::step);
+  }
+};
+
+/*
+  internal_action
+
+  The sample is the interval between consecutive executions of a self-scheduling internal action.
+*/
+class internal_bench :
+  public ioa::automaton
+{
+private:
+  int m_count;
+  int64_t m_last;
+
+  void schedule () const {
+    if (step_precondition ()) {
+      ioa::schedule (&internal_bench::step);
+    }
+  }
+
+  bool step_precondition () const {
+    return m_count < iterations;
+  }
+
+  void step_effect () {
+    const int64_t now = now_nsec ();
+    if (m_count != 0) {
+      record ("internal_action", now - m_last);
+    }
+    m_last = now;
+    ++m_count;
+  }
+
+  void step_schedule () const {
+    schedule ();
+  }
+
+  UP_INTERNAL (internal_bench, step);
+
+public:
+  internal_bench () :
+    m_count (0),
+    m_last (0)
+  {
+    schedule ();
+  }
+};
+
+/*
+  delivery_fanout_N
+
+  An output is bound to N inputs.
+  The sample is the time from the effect of the output to the effect of the last input.
+*/
+static int64_t delivery_start;
+static int delivery_pending;
+static const char* delivery_series;
+
+class fanout_consumer :
+  public ioa::automaton
+{
+private:
+  void receive_effect () {
+    if (--delivery_pending == 0) {
+      record (delivery_series, now_nsec () - delivery_start);
+    }
+  }
+
+  void receive_schedule () const { }
+
+public:
+  UV_UP_INPUT (fanout_consumer, receive);
+};
+
+class fanout_producer :
+  public ioa::automaton,
+  private ioa::observer
+{
+private:
+  const size_t m_fanout;
+  int m_sent;
+
+  void schedule () const {
+    if (emit_precondition ()) {
+      ioa::schedule (&fanout_producer::emit);
+    }
+  }
+
+  void observe (ioa::observable*) {
+    schedule ();
+  }
+
+  bool emit_precondition () const {
+    return m_sent < iterations && ioa::binding_count (&fanout_producer::emit) == m_fanout;
+  }
+
+  void emit_effect () {
+    ++m_sent;
+    delivery_pending = m_fanout;
+    delivery_start = now_nsec ();
+  }
+
+  void emit_schedule () const {
+    schedule ();
+  }
+
+public:
+  UV_UP_OUTPUT (fanout_producer, emit);
+
+  fanout_producer (const size_t fanout) :
+    m_fanout (fanout),
+    m_sent (0)
+  {
+    add_observable (&emit);
+  }
+};
+
+template <size_t N>
+class fanout_bench :
+  public ioa::automaton
+{
+public:
+  fanout_bench () {
+    ioa::automaton_manager<fanout_producer>* producer = ioa::make_automaton_manager (this, ioa::make_allocator<fanout_producer> (N));
+    for (size_t i = 0; i < N; ++i) {
+      ioa::automaton_manager<fanout_consumer>* consumer = ioa::make_automaton_manager (this, ioa::make_allocator<fanout_consumer> ());
+      ioa::make_binding_manager (this, producer, &fanout_producer::emit, consumer, &fanout_consumer::receive);
+    }
+  }
+};
+
+/*
+  timer_arm and timer_fire
+
+  An internal action arms a timer for itself with a zero offset.
+  timer_arm is the cost of ioa::schedule_after and timer_fire is the time from arming to the execution of the action.
+*/
+class timer_bench :
+  public ioa::automaton
+{
+private:
+  int m_count;
+  int64_t m_armed;
+
+  void arm () {
+    m_armed = now_nsec ();
+    ioa::schedule_after (&timer_bench::fire, ioa::time ());
+    record ("timer_arm", now_nsec () - m_armed);
+  }
+
+  bool fire_precondition () const {
+    return m_count < iterations;
+  }
+
+  void fire_effect () {
+    record ("timer_fire", now_nsec () - m_armed);
+    ++m_count;
+    if (m_count < iterations) {
+      arm ();
+    }
+  }
+
+  void fire_schedule () const { }
+
+  UP_INTERNAL (timer_bench, fire);
+
+public:
+  timer_bench () :
+    m_count (0),
+    m_armed (0)
+  {
+    arm ();
+  }
+};
+
+/*
+  fd_round_trip
+
+  A byte is written to a pipe and the read end is registered with ioa::schedule_read_ready.
+  The sample is the time from the write to the execution of the action.
+*/
+class fd_bench :
+  public ioa::automaton
+{
+private:
+  int m_fd[2];
+  int m_count;
+  int64_t m_written;
+
+  void send () {
+    const char c = 0;
+    m_written = now_nsec ();
+    if (write (m_fd[1], &c, 1) != 1) {
+      perror ("write");
+      exit (EXIT_FAILURE);
+    }
+    ioa::schedule_read_ready (&fd_bench::read_ready, m_fd[0]);
+  }
+
+  bool read_ready_precondition () const {
+    return m_count < iterations;
+  }
+
+  void read_ready_effect () {
+    char c;
+    if (read (m_fd[0], &c, 1) != 1) {
+      // Spurious wake-up.
+      ioa::schedule_read_ready (&fd_bench::read_ready, m_fd[0]);
+      return;
+    }
+    record ("fd_round_trip", now_nsec () - m_written);
+    ++m_count;
+    if (m_count < iterations) {
+      send ();
+    }
+  }
+
+  void read_ready_schedule () const { }
+
+  UP_INTERNAL (fd_bench, read_ready);
+
+public:
+  fd_bench () :
+    m_count (0),
+    m_written (0)
+  {
+    if (pipe (m_fd) == -1 ||
+	fcntl (m_fd[0], F_SETFL, O_NONBLOCK) == -1) {
+      perror ("pipe");
+      exit (EXIT_FAILURE);
+    }
+    send ();
+  }
+
+  ~fd_bench () {
+    // The last registration has been consumed.
+    ::close (m_fd[0]);
+    ::close (m_fd[1]);
+  }
+};
+
+// An automaton that does nothing and offers an output and an input for binding.
+class endpoint :
+  public ioa::automaton
+{
+private:
+  bool out_precondition () const {
+    return false;
+  }
+
+  void out_effect () { }
+
+  void out_schedule () const { }
+
+  void in_effect () { }
+
+  void in_schedule () const { }
+
+public:
+  UV_UP_OUTPUT (endpoint, out);
+  UV_UP_INPUT (endpoint, in);
+};
+
+/*
+  create and destroy
+
+  The root creates a child and destroys it as soon as it exists.
+  The samples are the times from the request to the notification.
+*/
+class lifecycle_bench :
+  public ioa::automaton,
+  private ioa::observer
+{
+private:
+  int m_count;
+  int64_t m_start;
+  ioa::automaton_manager<endpoint>* m_child;
+
+  void create () {
+    m_start = now_nsec ();
+    m_child = ioa::make_automaton_manager (this, ioa::make_allocator<endpoint> ());
+    add_observable (m_child);
+  }
+
+  void observe (ioa::observable*) {
+    switch (m_child->get_state ()) {
+    case ioa::automaton_manager_interface::CREATED:
+      record ("create", now_nsec () - m_start);
+      m_start = now_nsec ();
+      m_child->destroy ();
+      break;
+    case ioa::automaton_manager_interface::DESTROYED:
+      // The manager deletes itself after this notification.
+      record ("destroy", now_nsec () - m_start);
+      ++m_count;
+      if (m_count < iterations) {
+	create ();
+      }
+      break;
+    default:
+      break;
+    }
+  }
+
+public:
+  lifecycle_bench () :
+    m_count (0),
+    m_start (0),
+    m_child (0)
+  {
+    create ();
+  }
+};
+
+/*
+  bind and unbind
+
+  The root binds an output to an input and unbinds them as soon as they are bound.
+  The samples are the times from the request to the notification.
+*/
+class binding_bench :
+  public ioa::automaton,
+  private ioa::observer
+{
+private:
+  int m_count;
+  int64_t m_start;
+  ioa::automaton_manager<endpoint>* m_output;
+  ioa::automaton_manager<endpoint>* m_input;
+  ioa::binding_manager_interface* m_binding;
+
+  void bind () {
+    m_start = now_nsec ();
+    m_binding = ioa::make_binding_manager (this, m_output, &endpoint::out, m_input, &endpoint::in);
+    add_observable (m_binding);
+  }
+
+  void observe (ioa::observable* o) {
+    if (o != m_binding) {
+      // One of the endpoints.
+      if (m_binding == 0 &&
+	  m_output->get_state () == ioa::automaton_manager_interface::CREATED &&
+	  m_input->get_state () == ioa::automaton_manager_interface::CREATED) {
+	bind ();
+      }
+      return;
+    }
+
+    switch (m_binding->get_state ()) {
+    case ioa::binding_manager_interface::BOUND:
+      record ("bind", now_nsec () - m_start);
+      m_start = now_nsec ();
+      m_binding->unbind ();
+      break;
+    case ioa::binding_manager_interface::UNBOUND:
+      // The manager deletes itself after this notification.
+      record ("unbind", now_nsec () - m_start);
+      ++m_count;
+      if (m_count < iterations) {
+	bind ();
+      }
+      break;
+    default:
+      break;
+    }
+  }
+
+public:
+  binding_bench () :
+    m_count (0),
+    m_start (0),
+    m_output (ioa::make_automaton_manager (this, ioa::make_allocator<endpoint> ())),
+    m_input (ioa::make_automaton_manager (this, ioa::make_allocator<endpoint> ())),
+    m_binding (0)
+  {
+    add_observable (m_output);
+    add_observable (m_input);
+  }
+};
+
+struct benchmark
+{
+  const char* name;
+  void (*run) (ioa::scheduler_interface&);
+};
+
+template <class T>
+static void run_bench (ioa::scheduler_interface& sched) {
+  ioa::run (sched, ioa::make_allocator<T> ());
+}
+
+static void run_schedule (ioa::scheduler_interface& sched) {
+  ioa::run (sched, ioa::make_allocator<schedule_bench> (1));
+}
+
+static void run_schedule_duplicate (ioa::scheduler_interface& sched) {
+  ioa::run (sched, ioa::make_allocator<schedule_bench> (8));
+}
+
+template <size_t N>
+static void run_fanout (ioa::scheduler_interface& sched) {
+  std::ostringstream name;
+  name << "delivery_fanout_" << N;
+  const std::string series = name.str ();
+  delivery_series = series.c_str ();
+  ioa::run (sched, ioa::make_allocator<fanout_bench<N> > ());
+}
+
+static const benchmark benchmarks[] = {
+  { "schedule", run_schedule },
+  { "schedule_duplicate", run_schedule_duplicate },
+  { "internal_action", run_bench<internal_bench> },
+  { "delivery_fanout_1", run_fanout<1> },
+  { "delivery_fanout_10", run_fanout<10> },
+  { "delivery_fanout_100", run_fanout<100> },
+  { "timer", run_bench<timer_bench> },
+  { "fd_round_trip", run_bench<fd_bench> },
+  { "lifecycle", run_bench<lifecycle_bench> },
+  { "binding", run_bench<binding_bench> },
+};
+
+// Nearest-rank percentile of sorted samples.
+static int64_t percentile (const std::vector<int64_t>& sorted,
+			   const double p) {
+  size_t rank = static_cast<size_t> (ceil (p * sorted.size ()));
+  if (rank == 0) {
+    rank = 1;
+  }
+  return sorted[rank - 1];
+}
+
+static void report (const std::string& scheduler,
+		    const int threads,
+		    bool& first) {
+  for (std::map<std::string, std::vector<int64_t> >::iterator pos = samples.begin ();
+       pos != samples.end ();
+       ++pos) {
+    // Drop the warm-up.
+    std::vector<int64_t> s (pos->second.begin () + pos->second.size () / 10, pos->second.end ());
+    if (s.empty ()) {
+      continue;
+    }
+    std::sort (s.begin (), s.end ());
+    double sum = 0;
+    for (size_t i = 0; i < s.size (); ++i) {
+      sum += s[i];
+    }
+
+    std::cout << (first ? "[\n" : ",\n");
+    first = false;
+    std::cout << "  {\"benchmark\": \"" << pos->first << "\""
+	      << ", \"scheduler\": \"" << scheduler << "\""
+	      << ", \"threads\": " << threads
+	      << ", \"iterations\": " << iterations
+	      << ", \"samples\": " << s.size ()
+	      << ", \"unit\": \"ns\""
+	      << ", \"mean\": " << static_cast<int64_t> (sum / s.size ())
+	      << ", \"min\": " << s.front ()
+	      << ", \"p50\": " << percentile (s, 0.50)
+	      << ", \"p90\": " << percentile (s, 0.90)
+	      << ", \"p99\": " << percentile (s, 0.99)
+	      << ", \"p999\": " << percentile (s, 0.999)
+	      << ", \"max\": " << s.back ()
+	      << "}";
+  }
+  samples.clear ();
+}
+
+static void usage (const char* program) {
+  std::cerr << "Usage: " << program << " [-n ITERATIONS] [-t THREADS[,THREADS...]] [-b BENCHMARK]" << std::endl;
+  std::cerr << "Benchmarks:";
+  for (size_t i = 0; i < sizeof (benchmarks) / sizeof (benchmarks[0]); ++i) {
+    std::cerr << " " << benchmarks[i].name;
+  }
+  std::cerr << std::endl;
+  exit (EXIT_FAILURE);
+}
+
+int
+main (int argc, char* argv[]) {
+  std::vector<int> threads;
+  const char* only = 0;
+
+  int c;
+  while ((c = getopt (argc, argv, "n:t:b:")) != -1) {
+    switch (c) {
+    case 'n':
+      iterations = atoi (optarg);
+      break;
+    case 't':
+      {
+	std::istringstream in (optarg);
+	std::string t;
+	while (std::getline (in, t, ',')) {
+	  threads.push_back (atoi (t.c_str ()));
+	  if (threads.back () <= 0) {
+	    usage (argv[0]);
+	  }
+	}
+      }
+      break;
+    case 'b':
+      only = optarg;
+      break;
+    default:
+      usage (argv[0]);
+    }
+  }
+
+  if (optind != argc || iterations <= 0) {
+    usage (argv[0]);
+  }
+
+  if (threads.empty ()) {
+    threads.push_back (1);
+    threads.push_back (2);
+    threads.push_back (4);
+  }
+
+  bool first = true;
+  bool found = false;
+  for (size_t i = 0; i < sizeof (benchmarks) / sizeof (benchmarks[0]); ++i) {
+    if (only != 0 && strcmp (only, benchmarks[i].name) != 0) {
+      continue;
+    }
+    found = true;
+
+    {
+      ioa::global_fifo_scheduler sched;
+      benchmarks[i].run (sched);
+      report ("global_fifo", 1, first);
+    }
+
+    for (size_t t = 0; t < threads.size (); ++t) {
+      ioa::simple_scheduler sched (threads[t]);
+      benchmarks[i].run (sched);
+      report ("simple", threads[t], first);
+    }
+  }
+
+  if (!found) {
+    usage (argv[0]);
+  }
+
+  std::cout << "\n]" << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,367 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/*
+  Measures the connection setup rate of tcp_acceptor_automaton.
+
+  Client processes connect to a loopback port, wait for the server to close the connection, and connect again.
+  Each client has one connection open at a time so the server never holds more fds than there are clients.
+  The server runs K acceptors on the port with SO_REUSEPORT under a sharded_scheduler with K shards.
+  With handles, each acceptor is fed by a pool of slots that hand it a tcp_connection_automaton and replace it once it is connected.
+  With transfers, the server creates a tcp_connection_automaton from each fd the acceptors output and destroys it once it exists.
+*/
+
+#include <ioa/ioa.hpp>
+#include <ioa/tcp_acceptor_automaton.hpp>
+#include <ioa/sharded_scheduler.hpp>
+
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <iostream>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static const int SLOTS = 32;
+static const int CLIENTS = 16;
+
+class accept_slot :
+  public ioa::automaton,
+  private ioa::observer
+{
+private:
+  ioa::handle_manager<accept_slot> m_self;
+  ioa::handle_manager<ioa::tcp_acceptor_automaton> m_acceptor;
+  ioa::automaton_manager<ioa::tcp_connection_automaton>* m_connection;
+  bool m_offered;
+  bool m_connected;
+
+  void schedule () const {
+    if (accept_precondition ()) {
+      ioa::schedule (&accept_slot::accept);
+    }
+    if (accepted_precondition ()) {
+      ioa::schedule (&accept_slot::accepted);
+    }
+  }
+
+  void observe (ioa::observable*) {
+    schedule ();
+  }
+
+  void create_connection () {
+    m_connection = new ioa::automaton_manager<ioa::tcp_connection_automaton> (this, ioa::make_allocator<ioa::tcp_connection_automaton> ());
+    add_observable (m_connection);
+    ioa::make_binding_manager (this, m_connection, &ioa::tcp_connection_automaton::connected, &m_self, &accept_slot::connected);
+    m_offered = false;
+  }
+
+public:
+  accept_slot (const ioa::automaton_handle<ioa::tcp_acceptor_automaton>& acceptor) :
+    m_self (ioa::get_aid ()),
+    m_acceptor (acceptor),
+    m_connected (false)
+  {
+    ioa::make_binding_manager (this, &m_self, &accept_slot::accept, &m_acceptor, &ioa::tcp_acceptor_automaton::accept);
+    create_connection ();
+  }
+
+private:
+  bool accept_precondition () const {
+    return !m_offered &&
+      m_connection->get_state () == ioa::automaton_manager_interface::CREATED &&
+      ioa::binding_count (&accept_slot::accept) != 0;
+  }
+
+  ioa::automaton_handle<ioa::tcp_connection_automaton> accept_effect () {
+    m_offered = true;
+    return m_connection->get_handle ();
+  }
+
+  void accept_schedule () const {
+    schedule ();
+  }
+
+  V_UP_OUTPUT (accept_slot, accept, ioa::automaton_handle<ioa::tcp_connection_automaton>);
+
+  void connected_effect () {
+    m_connected = true;
+  }
+
+  void connected_schedule () const {
+    schedule ();
+  }
+
+  UV_UP_INPUT (accept_slot, connected);
+
+  bool accepted_precondition () const {
+    return m_connected && ioa::binding_count (&accept_slot::accepted) != 0;
+  }
+
+  void accepted_effect () {
+    // Replace the connection.
+    m_connected = false;
+    m_connection->destroy ();
+    create_connection ();
+  }
+
+  void accepted_schedule () const {
+    schedule ();
+  }
+
+public:
+  UV_UP_OUTPUT (accept_slot, accepted);
+};
+
+class accept_server :
+  public ioa::automaton,
+  private ioa::observer
+{
+private:
+  ioa::handle_manager<accept_server> m_self;
+  const int m_acceptor_count;
+  const int m_count;
+  const bool m_transfer;
+  std::vector<ioa::automaton_manager<ioa::tcp_acceptor_automaton>*> m_acceptors;
+  std::vector<ioa::automaton_manager<accept_slot>*> m_slots;
+  std::set<ioa::automaton_manager<ioa::tcp_connection_automaton>*> m_connections;
+  bool m_slots_created;
+  int m_accepted;
+  ioa::time m_first;
+  bool m_stopped;
+
+  void schedule () const {
+    if (create_slots_precondition ()) {
+      ioa::schedule (&accept_server::create_slots);
+    }
+    if (stop_precondition ()) {
+      ioa::schedule (&accept_server::stop);
+    }
+  }
+
+  void observe (ioa::observable* o) {
+    // Close transferred connections once they exist.
+    std::set<ioa::automaton_manager<ioa::tcp_connection_automaton>*>::iterator pos = m_connections.find (static_cast<ioa::automaton_manager<ioa::tcp_connection_automaton>*> (o));
+    if (pos != m_connections.end () && (*pos)->get_state () == ioa::automaton_manager_interface::CREATED) {
+      (*pos)->destroy ();
+      m_connections.erase (pos);
+    }
+    schedule ();
+  }
+
+public:
+  accept_server (const ioa::inet_address& address,
+		 const int acceptors,
+		 const int count,
+		 const bool transfer) :
+    m_self (ioa::get_aid ()),
+    m_acceptor_count (acceptors),
+    m_count (count),
+    m_transfer (transfer),
+    m_slots_created (transfer),
+    m_accepted (0),
+    m_stopped (false)
+  {
+    for (int i = 0; i < m_acceptor_count; ++i) {
+      ioa::automaton_manager<ioa::tcp_acceptor_automaton>* acceptor = new ioa::automaton_manager<ioa::tcp_acceptor_automaton> (this, ioa::make_allocator<ioa::tcp_acceptor_automaton> (address, 1024, m_acceptor_count > 1));
+      add_observable (acceptor);
+      ioa::make_binding_manager (this, acceptor, &ioa::tcp_acceptor_automaton::error, &m_self, &accept_server::error);
+      if (m_transfer) {
+	ioa::make_binding_manager (this, acceptor, &ioa::tcp_acceptor_automaton::accepted, &m_self, &accept_server::transferred, i);
+      }
+      m_acceptors.push_back (acceptor);
+    }
+  }
+
+private:
+  bool create_slots_precondition () const {
+    if (m_slots_created) {
+      return false;
+    }
+    for (size_t i = 0; i < m_acceptors.size (); ++i) {
+      if (m_acceptors[i]->get_state () != ioa::automaton_manager_interface::CREATED) {
+	return false;
+      }
+    }
+    return true;
+  }
+
+  void create_slots_effect () {
+    m_slots_created = true;
+    for (size_t i = 0; i < m_acceptors.size (); ++i) {
+      for (int j = 0; j < SLOTS; ++j) {
+	ioa::automaton_manager<accept_slot>* slot = new ioa::automaton_manager<accept_slot> (this, ioa::make_allocator<accept_slot> (m_acceptors[i]->get_handle ()));
+	ioa::make_binding_manager (this, slot, &accept_slot::accepted, &m_self, &accept_server::accepted, slot);
+	m_slots.push_back (slot);
+      }
+    }
+  }
+
+  void create_slots_schedule () const {
+    schedule ();
+  }
+
+  UP_INTERNAL (accept_server, create_slots);
+
+  void accepted_effect (ioa::automaton_manager<accept_slot>*) {
+    if (m_accepted++ == 0) {
+      m_first = ioa::time::now ();
+    }
+  }
+
+  void accepted_schedule (ioa::automaton_manager<accept_slot>*) const {
+    schedule ();
+  }
+
+  UV_P_INPUT (accept_server, accepted, ioa::automaton_manager<accept_slot>*);
+
+  void transferred_effect (const ioa::fd_transfer& fd,
+			   int) {
+    if (m_stopped) {
+      return;
+    }
+    if (m_accepted++ == 0) {
+      m_first = ioa::time::now ();
+    }
+    ioa::automaton_manager<ioa::tcp_connection_automaton>* connection = new ioa::automaton_manager<ioa::tcp_connection_automaton> (this, ioa::make_allocator<ioa::tcp_connection_automaton> (fd));
+    add_observable (connection);
+    m_connections.insert (connection);
+  }
+
+  void transferred_schedule (int) const {
+    schedule ();
+  }
+
+  V_P_INPUT (accept_server, transferred, ioa::fd_transfer, int);
+
+  void error_effect (const int& err) {
+    std::cerr << "Acceptor error: " << strerror (err) << std::endl;
+    exit (EXIT_FAILURE);
+  }
+
+  void error_schedule () const {
+    schedule ();
+  }
+
+  V_UP_INPUT (accept_server, error, int);
+
+  bool stop_precondition () const {
+    return !m_stopped && m_accepted >= m_count;
+  }
+
+  void stop_effect () {
+    m_stopped = true;
+    const ioa::time elapsed = ioa::time::now () - m_first;
+    const double seconds = elapsed.sec () + elapsed.usec () / 1000000.0;
+    std::cout << (m_transfer ? "transfer" : "handle")
+	      << " acceptors=" << m_acceptor_count
+	      << " connections=" << m_accepted
+	      << " rate=" << (seconds > 0 ? m_accepted / seconds : 0) << "/s"
+	      << std::endl;
+
+    // Let the scheduler run out of work.
+    for (size_t i = 0; i < m_slots.size (); ++i) {
+      m_slots[i]->destroy ();
+    }
+    for (std::set<ioa::automaton_manager<ioa::tcp_connection_automaton>*>::const_iterator pos = m_connections.begin ();
+	 pos != m_connections.end ();
+	 ++pos) {
+      (*pos)->destroy ();
+    }
+    m_connections.clear ();
+    for (size_t i = 0; i < m_acceptors.size (); ++i) {
+      m_acceptors[i]->destroy ();
+    }
+  }
+
+  void stop_schedule () const {
+    schedule ();
+  }
+
+  UP_INTERNAL (accept_server, stop);
+};
+
+static void
+run_clients (const ioa::inet_address& address,
+	     const int count) {
+  // Give the server time to listen.
+  usleep (200000);
+  for (int c = 0; c < CLIENTS; ++c) {
+    if (fork () == 0) {
+      for (int i = c; i < count; i += CLIENTS) {
+	const int fd = socket (AF_INET, SOCK_STREAM, 0);
+	if (fd == -1 ||
+	    connect (fd, address.get_sockaddr (), address.get_socklen ()) == -1) {
+	  perror ("connect");
+	  exit (EXIT_FAILURE);
+	}
+	// Wait for the server to close.
+	char c;
+	while (read (fd, &c, 1) > 0) ;;
+	close (fd);
+      }
+      exit (EXIT_SUCCESS);
+    }
+  }
+  for (int c = 0; c < CLIENTS; ++c) {
+    wait (0);
+  }
+}
+
+static void
+run (const ioa::inet_address& address,
+     const int acceptors,
+     const int count,
+     const bool transfer) {
+  const pid_t pid = fork ();
+  if (pid == 0) {
+    run_clients (address, count);
+    exit (EXIT_SUCCESS);
+  }
+
+  ioa::sharded_scheduler sched (acceptors);
+  ioa::run (sched, ioa::make_allocator<accept_server> (address, acceptors, count, transfer));
+  waitpid (pid, 0, 0);
+}
+
+int
+main (int argc, char* argv[]) {
+  if (argc > 4) {
+    std::cerr << "Usage: " << argv[0] << " [COUNT] [ACCEPTORS] [PORT]" << std::endl;
+    exit (EXIT_FAILURE);
+  }
+
+  const int count = argc > 1 ? atoi (argv[1]) : 20000;
+  const int acceptors = argc > 2 ? atoi (argv[2]) : 4;
+  const unsigned short port = argc > 3 ? atoi (argv[3]) : 20000 + getpid () % 10000;
+  if (count <= 0 || acceptors <= 0) {
+    std::cerr << "COUNT and ACCEPTORS must be positive" << std::endl;
+    exit (EXIT_FAILURE);
+  }
+
+  run (ioa::inet_address ("127.0.0.1", port), 1, count, false);
+  run (ioa::inet_address ("127.0.0.1", port + 1), 1, count, true);
+  if (acceptors > 1) {
+    run (ioa::inet_address ("127.0.0.1", port + 2), acceptors, count, true);
+  }
+
+  return 0;
+}
@@ -0,0 +1,366 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/*
+  Compares the shared memory ring with TCP loopback for bindings between two processes.
+
+  The parent process produces COUNT values as fast as the transport accepts them and the child consumes them.
+  Each value carries the time it was produced so the child can report the one-way latency.
+  Both processes run a global_fifo_scheduler.
+*/
+
+#include <ioa/ioa.hpp>
+#include <ioa/shm_automaton.hpp>
+#include <ioa/remote_automaton.hpp>
+#include <ioa/global_fifo_scheduler.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Production time in microseconds and a payload.
+typedef std::pair<long long, std::string> message;
+
+static long long now_usec () {
+  const ioa::time t = ioa::time::now ();
+  return static_cast<long long> (t.sec ()) * 1000000 + t.usec ();
+}
+
+class bench_sender :
+  public ioa::automaton,
+  private ioa::observer
+{
+private:
+  ioa::handle_manager<bench_sender> m_self;
+  const int m_count;
+  const std::string m_payload;
+  int m_produced;
+  int m_fd;
+  ioa::automaton_manager<ioa::tcp_connection_automaton>* m_connection;
+  bool m_proxy_created;
+
+  void schedule () const {
+    if (create_proxy_precondition ()) {
+      ioa::schedule (&bench_sender::create_proxy);
+    }
+    if (produce_precondition ()) {
+      ioa::schedule (&bench_sender::produce);
+    }
+  }
+
+  void observe (ioa::observable*) {
+    schedule ();
+  }
+
+public:
+  // Shared memory.
+  bench_sender (const ioa::shm_ring_descriptor& descriptor,
+		const int count,
+		const size_t size) :
+    m_self (ioa::get_aid ()),
+    m_count (count),
+    m_payload (size, 'x'),
+    m_produced (0),
+    m_fd (-1),
+    m_connection (0),
+    m_proxy_created (true)
+  {
+    ioa::automaton_manager<ioa::shm_sender_automaton<message> >* sender = new ioa::automaton_manager<ioa::shm_sender_automaton<message> > (this, ioa::make_allocator<ioa::shm_sender_automaton<message> > (descriptor));
+    ioa::make_binding_manager (this, &m_self, &bench_sender::produce, sender, &ioa::shm_sender_automaton<message>::send);
+  }
+
+  // TCP loopback.
+  bench_sender (const int fd,
+		const int count,
+		const size_t size) :
+    m_self (ioa::get_aid ()),
+    m_count (count),
+    m_payload (size, 'x'),
+    m_produced (0),
+    m_fd (fd),
+    m_connection (new ioa::automaton_manager<ioa::tcp_connection_automaton> (this, ioa::make_allocator<ioa::tcp_connection_automaton> ())),
+    m_proxy_created (false)
+  {
+    add_observable (m_connection);
+  }
+
+private:
+  bool create_proxy_precondition () const {
+    return !m_proxy_created && m_connection->get_state () == ioa::automaton_manager_interface::CREATED;
+  }
+
+  void create_proxy_effect () {
+    m_proxy_created = true;
+    new ioa::automaton_manager<ioa::connection_init_automaton> (this, ioa::make_allocator<ioa::connection_init_automaton> (m_connection->get_handle (), m_fd));
+    ioa::automaton_manager<ioa::remote_sender_automaton<message> >* sender = new ioa::automaton_manager<ioa::remote_sender_automaton<message> > (this, ioa::make_allocator<ioa::remote_sender_automaton<message> > (m_connection->get_handle ()));
+    ioa::make_binding_manager (this, &m_self, &bench_sender::produce, sender, &ioa::remote_sender_automaton<message>::send);
+  }
+
+  void create_proxy_schedule () const {
+    schedule ();
+  }
+
+  UP_INTERNAL (bench_sender, create_proxy);
+
+  bool produce_precondition () const {
+    return m_produced != m_count && ioa::binding_count (&bench_sender::produce) != 0;
+  }
+
+  message produce_effect () {
+    ++m_produced;
+    return message (now_usec (), m_payload);
+  }
+
+  void produce_schedule () const {
+    schedule ();
+  }
+
+  V_UP_OUTPUT (bench_sender, produce, message);
+};
+
+class bench_receiver :
+  public ioa::automaton,
+  private ioa::observer
+{
+private:
+  ioa::handle_manager<bench_receiver> m_self;
+  const std::string m_name;
+  const int m_count;
+  std::vector<long long> m_latency;
+  long long m_first;
+  int m_fd;
+  ioa::automaton_manager<ioa::tcp_connection_automaton>* m_connection;
+  ioa::automaton_manager<ioa::shm_receiver_automaton<message> >* m_receiver;
+  bool m_proxy_created;
+  bool m_stopped;
+
+  void schedule () const {
+    if (create_proxy_precondition ()) {
+      ioa::schedule (&bench_receiver::create_proxy);
+    }
+    if (stop_precondition ()) {
+      ioa::schedule (&bench_receiver::stop);
+    }
+  }
+
+  void observe (ioa::observable*) {
+    schedule ();
+  }
+
+public:
+  // Shared memory.
+  bench_receiver (const ioa::shm_ring_descriptor& descriptor,
+		  const int count) :
+    m_self (ioa::get_aid ()),
+    m_name ("shm"),
+    m_count (count),
+    m_first (0),
+    m_fd (-1),
+    m_connection (0),
+    m_receiver (new ioa::automaton_manager<ioa::shm_receiver_automaton<message> > (this, ioa::make_allocator<ioa::shm_receiver_automaton<message> > (descriptor))),
+    m_proxy_created (true),
+    m_stopped (false)
+  {
+    m_latency.reserve (m_count);
+    ioa::make_binding_manager (this, m_receiver, &ioa::shm_receiver_automaton<message>::receive, &m_self, &bench_receiver::consume);
+  }
+
+  // TCP loopback.
+  bench_receiver (const int fd,
+		  const int count) :
+    m_self (ioa::get_aid ()),
+    m_name ("tcp"),
+    m_count (count),
+    m_first (0),
+    m_fd (fd),
+    m_connection (new ioa::automaton_manager<ioa::tcp_connection_automaton> (this, ioa::make_allocator<ioa::tcp_connection_automaton> ())),
+    m_receiver (0),
+    m_proxy_created (false),
+    m_stopped (false)
+  {
+    m_latency.reserve (m_count);
+    add_observable (m_connection);
+  }
+
+private:
+  bool create_proxy_precondition () const {
+    return !m_proxy_created && m_connection->get_state () == ioa::automaton_manager_interface::CREATED;
+  }
+
+  void create_proxy_effect () {
+    m_proxy_created = true;
+    new ioa::automaton_manager<ioa::connection_init_automaton> (this, ioa::make_allocator<ioa::connection_init_automaton> (m_connection->get_handle (), m_fd));
+    ioa::automaton_manager<ioa::remote_receiver_automaton<message> >* receiver = new ioa::automaton_manager<ioa::remote_receiver_automaton<message> > (this, ioa::make_allocator<ioa::remote_receiver_automaton<message> > (m_connection->get_handle ()));
+    ioa::make_binding_manager (this, receiver, &ioa::remote_receiver_automaton<message>::receive, &m_self, &bench_receiver::consume);
+  }
+
+  void create_proxy_schedule () const {
+    schedule ();
+  }
+
+  UP_INTERNAL (bench_receiver, create_proxy);
+
+  void consume_effect (const message& m) {
+    const long long now = now_usec ();
+    if (m_latency.empty ()) {
+      m_first = m.first;
+    }
+    m_latency.push_back (now - m.first);
+    if (static_cast<int> (m_latency.size ()) == m_count) {
+      const double seconds = (now - m_first) / 1000000.0;
+      std::sort (m_latency.begin (), m_latency.end ());
+      std::cout << m_name
+		<< " messages=" << m_count
+		<< " throughput=" << (seconds > 0 ? m_count / seconds : 0) << "/s"
+		<< " latency_us p50=" << m_latency[m_count / 2]
+		<< " p99=" << m_latency[(m_count * 99) / 100]
+		<< " max=" << m_latency.back ()
+		<< std::endl;
+    }
+  }
+
+  void consume_schedule () const {
+    schedule ();
+  }
+
+  V_UP_INPUT (bench_receiver, consume, message);
+
+  bool stop_precondition () const {
+    return static_cast<int> (m_latency.size ()) == m_count && !m_stopped;
+  }
+
+  void stop_effect () {
+    // Closing the transport lets both schedulers run out of work.
+    m_stopped = true;
+    if (m_connection != 0) {
+      m_connection->destroy ();
+    }
+    if (m_receiver != 0) {
+      m_receiver->destroy ();
+    }
+  }
+
+  void stop_schedule () const {
+    schedule ();
+  }
+
+  UP_INTERNAL (bench_receiver, stop);
+};
+
+static void
+set_nonblocking (const int fd) {
+  const int flags = fcntl (fd, F_GETFL, 0);
+  if (flags == -1 || fcntl (fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+    perror ("fcntl");
+    exit (EXIT_FAILURE);
+  }
+}
+
+static void
+run_shm (const int count,
+	 const size_t size) {
+  ioa::shm_ring_descriptor descriptor;
+  const int err = ioa::shm_ring::create (1 << 20, descriptor);
+  if (err != 0) {
+    std::cerr << "shm_ring::create: " << strerror (err) << std::endl;
+    exit (EXIT_FAILURE);
+  }
+
+  const pid_t pid = fork ();
+  if (pid == 0) {
+    ioa::global_fifo_scheduler sched;
+    ioa::run (sched, ioa::make_allocator<bench_receiver> (descriptor, count));
+    exit (EXIT_SUCCESS);
+  }
+
+  ioa::global_fifo_scheduler sched;
+  ioa::run (sched, ioa::make_allocator<bench_sender> (descriptor, count, size));
+  waitpid (pid, 0, 0);
+}
+
+static void
+run_tcp (const int count,
+	 const size_t size) {
+  // Listen on an ephemeral loopback port.
+  const int listen_fd = socket (AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr;
+  memset (&addr, 0, sizeof (addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+  socklen_t length = sizeof (addr);
+  if (listen_fd == -1 ||
+      bind (listen_fd, reinterpret_cast<sockaddr*> (&addr), sizeof (addr)) == -1 ||
+      listen (listen_fd, 1) == -1 ||
+      getsockname (listen_fd, reinterpret_cast<sockaddr*> (&addr), &length) == -1) {
+    perror ("listen");
+    exit (EXIT_FAILURE);
+  }
+
+  const pid_t pid = fork ();
+  if (pid == 0) {
+    const int fd = accept (listen_fd, 0, 0);
+    if (fd == -1) {
+      perror ("accept");
+      exit (EXIT_FAILURE);
+    }
+    close (listen_fd);
+    set_nonblocking (fd);
+    ioa::global_fifo_scheduler sched;
+    ioa::run (sched, ioa::make_allocator<bench_receiver> (fd, count));
+    exit (EXIT_SUCCESS);
+  }
+
+  close (listen_fd);
+  const int fd = socket (AF_INET, SOCK_STREAM, 0);
+  if (fd == -1 ||
+      connect (fd, reinterpret_cast<sockaddr*> (&addr), sizeof (addr)) == -1) {
+    perror ("connect");
+    exit (EXIT_FAILURE);
+  }
+  set_nonblocking (fd);
+  ioa::global_fifo_scheduler sched;
+  ioa::run (sched, ioa::make_allocator<bench_sender> (fd, count, size));
+  waitpid (pid, 0, 0);
+}
+
+int
+main (int argc, char* argv[]) {
+  if (argc > 3) {
+    std::cerr << "Usage: " << argv[0] << " [COUNT] [SIZE]" << std::endl;
+    exit (EXIT_FAILURE);
+  }
+
+  const int count = argc > 1 ? atoi (argv[1]) : 100000;
+  const size_t size = argc > 2 ? atoi (argv[2]) : 64;
+  if (count <= 0) {
+    std::cerr << "COUNT must be positive" << std::endl;
+    exit (EXIT_FAILURE);
+  }
+
+  run_shm (count, size);
+  run_tcp (count, size);
+
+  return 0; 
+}
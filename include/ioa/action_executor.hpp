@@ -22,8 +22,13 @@
 #include <ioa/action.hpp>
 #include <ioa/model_interface.hpp>
 #include <ioa/system_scheduler_interface.hpp>
+#include <ioa/mutex.hpp>
+#include <algorithm>
 #include <memory>
 #include <map>
+#include <set>
+#include <vector>
+#include <deque>
 
 namespace ioa {
 
@@ -509,6 +514,104 @@ namespace ioa {
 
   };
 
+  // A binding_buffer holds the values of a buffered binding until they are delivered.
+  // The output pushes and the input delivers so the buffer has its own lock.
+  template <class IE> class binding_buffer;
+
+  template <>
+  class binding_buffer<unvalued_input_executor_interface>
+  {
+  private:
+    const size_t m_capacity;
+    mutable mutex m_mutex;
+    size_t m_count;
+
+  public:
+    binding_buffer (const size_t capacity) :
+      m_capacity (capacity),
+      m_count (0)
+    { }
+
+    bool full () const {
+      m_mutex.lock ();
+      const bool retval = m_capacity != 0 && m_count >= m_capacity;
+      m_mutex.unlock ();
+      return retval;
+    }
+
+    // Returns true if the buffer was empty, i.e., a delivery must be scheduled.
+    bool push () {
+      m_mutex.lock ();
+      const bool retval = m_count == 0;
+      ++m_count;
+      m_mutex.unlock ();
+      return retval;
+    }
+
+    // Returns true if the buffer was full, i.e., the output must be scheduled.
+    bool deliver (system_scheduler_interface& system_scheduler,
+		  const unvalued_input_executor_interface& input) {
+      m_mutex.lock ();
+      const size_t count = m_count;
+      m_count = 0;
+      m_mutex.unlock ();
+
+      for (size_t idx = 0; idx != count; ++idx) {
+	input (system_scheduler);
+      }
+
+      return m_capacity != 0 && count >= m_capacity;
+    }
+  };
+
+  template <class VT>
+  class binding_buffer<valued_input_executor_interface<VT> >
+  {
+  private:
+    const size_t m_capacity;
+    mutable mutex m_mutex;
+    std::deque<VT> m_queue;
+
+  public:
+    binding_buffer (const size_t capacity) :
+      m_capacity (capacity)
+    { }
+
+    bool full () const {
+      m_mutex.lock ();
+      const bool retval = m_capacity != 0 && m_queue.size () >= m_capacity;
+      m_mutex.unlock ();
+      return retval;
+    }
+
+    // Returns true if the buffer was empty, i.e., a delivery must be scheduled.
+    bool push (const VT& value) {
+      m_mutex.lock ();
+      const bool retval = m_queue.empty ();
+      m_queue.push_back (value);
+      m_mutex.unlock ();
+      return retval;
+    }
+
+    // Returns true if the buffer was full, i.e., the output must be scheduled.
+    bool deliver (system_scheduler_interface& system_scheduler,
+		  const valued_input_executor_interface<VT>& input) {
+      // Take the whole batch so the output can keep producing while we deliver.
+      std::deque<VT> batch;
+      m_mutex.lock ();
+      batch.swap (m_queue);
+      m_mutex.unlock ();
+
+      for (typename std::deque<VT>::const_iterator pos = batch.begin ();
+	   pos != batch.end ();
+	   ++pos) {
+	input (system_scheduler, *pos);
+      }
+
+      return m_capacity != 0 && batch.size () >= m_capacity;
+    }
+  };
+
   template <class I, class M, class OE, class IE>
   class output_core :
     public action_executor_core<I, M>
@@ -523,19 +626,29 @@ namespace ioa {
       std::auto_ptr<IE> m_input;
       const aid_t m_binder;
       void* const m_key;
+      std::auto_ptr<binding_buffer<IE> > m_buffer;
+      // Automata that are being destroyed are not notified.
+      bool m_notify_binder;
+      bool m_notify_output;
+      bool m_notify_input;
       
       record (system_scheduler_interface& system_scheduler,
 	      model_interface& model,
 	      const OE& output,
 	      const input_executor_interface& input,
 	      const aid_t binder,
-	      void* const key) :
+	      void* const key,
+	      const fifo* f) :
 	m_system_scheduler (system_scheduler),
 	m_model (model),
 	m_output (output),
 	m_input (dynamic_cast<IE*> (input.clone ().release ())),
 	m_binder (binder),
-	m_key (key)
+	m_key (key),
+	m_buffer (f != 0 ? new binding_buffer<IE> (f->capacity ()) : 0),
+	m_notify_binder (true),
+	m_notify_output (true),
+	m_notify_input (true)
       {
 	m_model.add_bind_key (m_binder, m_key);
 	m_system_scheduler.bound (m_binder, BOUND_RESULT, m_key);
@@ -544,15 +657,72 @@ namespace ioa {
       }
       
       ~record () {
-	m_model.remove_bind_key (m_binder, m_key);
-	m_system_scheduler.unbound (m_binder, UNBOUND_RESULT, m_key);
-	m_system_scheduler.output_unbound (m_output);
-	m_system_scheduler.input_unbound (*m_input.get ());
+	if (m_notify_binder) {
+	  m_model.remove_bind_key (m_binder, m_key);
+	  m_system_scheduler.unbound (m_binder, UNBOUND_RESULT, m_key);
+	}
+	if (m_notify_output) {
+	  m_system_scheduler.output_unbound (m_output);
+	}
+	if (m_notify_input) {
+	  m_system_scheduler.input_unbound (*m_input.get ());
+	}
+      }
+
+      bool buffered () const {
+	return m_buffer.get () != 0;
+      }
+
+      void execute (system_scheduler_interface& system_scheduler) const {
+	if (m_buffer.get () == 0) {
+	  (*m_input) (system_scheduler);
+	}
+	else if (m_buffer->push ()) {
+	  system_scheduler.deliver (*m_input);
+	}
+      }
+
+      template <class VT>
+      void execute (system_scheduler_interface& system_scheduler,
+		    const VT& value) const {
+	if (m_buffer.get () == 0) {
+	  (*m_input) (system_scheduler, value);
+	}
+	else if (m_buffer->push (value)) {
+	  system_scheduler.deliver (*m_input);
+	}
       }
       
     };
 
     std::map<aid_t, record*> m_records;
+    // The inputs of the records by binder so the records of a binder can be found without a scan.
+    std::multimap<aid_t, aid_t> m_binder_inputs;
+
+    void erase_record (const typename std::map<aid_t, record*>::iterator pos) {
+      const aid_t binder = pos->second->m_binder;
+      for (std::multimap<aid_t, aid_t>::iterator b = m_binder_inputs.lower_bound (binder);
+	   b != m_binder_inputs.end () && b->first == binder;
+	   ++b) {
+	if (b->second == pos->first) {
+	  m_binder_inputs.erase (b);
+	  break;
+	}
+      }
+      delete pos->second;
+      m_records.erase (pos);
+    }
+
+    void erase_dying_record (const typename std::map<aid_t, record*>::iterator pos,
+			     const std::vector<aid_t>& dying,
+			     const bool output_dying,
+			     std::vector<std::pair<aid_t, aid_t> >& removed) {
+      pos->second->m_notify_output = !output_dying;
+      pos->second->m_notify_input = !std::binary_search (dying.begin (), dying.end (), pos->first);
+      pos->second->m_notify_binder = !std::binary_search (dying.begin (), dying.end (), pos->second->m_binder);
+      removed.push_back (std::make_pair (pos->first, pos->second->m_binder));
+      erase_record (pos);
+    }
 
     output_core (const automaton_handle<I>& handle,
 		 M I::*member_ptr,
@@ -573,10 +743,14 @@ namespace ioa {
 
     void lock_in_order (model_interface& model) const {
       // Lock in order.
+      // Buffered inputs are locked when their values are delivered.
       bool output_processed = false;
       for (typename std::map<aid_t, record*>::const_iterator pos = m_records.begin ();
 	   pos != m_records.end ();
 	   ++pos) {
+	if (pos->second->buffered ()) {
+	  continue;
+	}
 	if (!output_processed &&
 	    this->m_handle < pos->first) {
 	  model.lock_automaton (this->m_handle);
@@ -584,6 +758,9 @@ namespace ioa {
 	}
 	model.lock_automaton (pos->first);
       }
+      if (!output_processed) {
+	model.lock_automaton (this->m_handle);
+      }
     }
 
     void unlock_in_order (model_interface& model) const {
@@ -592,6 +769,9 @@ namespace ioa {
       for (typename std::map<aid_t, record*>::const_iterator pos = m_records.begin ();
 	   pos != m_records.end ();
 	   ++pos) {
+	if (pos->second->buffered ()) {
+	  continue;
+	}
 	if (!output_processed &&
 	    this->m_handle < pos->first) {
 	  model.unlock_automaton (this->m_handle);
@@ -599,6 +779,9 @@ namespace ioa {
 	}
 	model.unlock_automaton (pos->first);
       }
+      if (!output_processed) {
+	model.unlock_automaton (this->m_handle);
+      }
     }
 
     bool involves_output (const OE& this_output, const action_executor_interface& output) const {
@@ -650,7 +833,30 @@ namespace ioa {
     }
 
     size_t size () const {
-      return m_records.size ();
+      // A buffered binding that is full does not count.
+      // Outputs that check binding_count in their preconditions are then throttled by the slowest input.
+      size_t count = 0;
+      for (typename std::map<aid_t, record*>::const_iterator pos = m_records.begin ();
+	   pos != m_records.end ();
+	   ++pos) {
+	if (!pos->second->buffered () || !pos->second->m_buffer->full ()) {
+	  ++count;
+	}
+      }
+      return count;
+    }
+
+    bool full () const {
+      // The output is withheld while any of its buffered bindings is full.
+      // The delivery that makes room schedules it again (see deliver).
+      for (typename std::map<aid_t, record*>::const_iterator pos = m_records.begin ();
+	   pos != m_records.end ();
+	   ++pos) {
+	if (pos->second->buffered () && pos->second->m_buffer->full ()) {
+	  return true;
+	}
+      }
+      return false;
     }
 
     void bind (system_scheduler_interface& system_scheduler,
@@ -658,25 +864,46 @@ namespace ioa {
 	       const OE& output,
 	       const input_executor_interface& input,
 	       const aid_t binder,
-	       void* const key) {
-      m_records.insert (std::make_pair (input.get_aid (), new record (system_scheduler, model, output, input, binder, key)));
+	       void* const key,
+	       const fifo* f) {
+      m_records.insert (std::make_pair (input.get_aid (), new record (system_scheduler, model, output, input, binder, key, f)));
+      m_binder_inputs.insert (std::make_pair (binder, input.get_aid ()));
     }
 
-    void unbind (const aid_t binder,
-		 void* const key) {
-      for (typename std::map<aid_t, record*>::iterator pos = m_records.begin ();
-	   pos != m_records.end ();
-	   ) {
-	if (pos->second->m_binder == binder &&
-	    pos->second->m_key == key) {
-	  delete pos->second;
-	  m_records.erase (pos++);
-	  break;
-	}
-	else {
-	  ++pos;
+    void deliver (model_interface& model,
+		  system_scheduler_interface& system_scheduler,
+		  const OE& output,
+		  const input_executor_interface& input) const {
+      typename std::map<aid_t, record*>::const_iterator pos = m_records.find (input.get_aid ());
+      if (pos == m_records.end () ||
+	  !pos->second->buffered () ||
+	  *(pos->second->m_input) != input) {
+	return;
+      }
+
+      model.lock_automaton (pos->first);
+      const bool was_full = pos->second->m_buffer->deliver (system_scheduler, *(pos->second->m_input));
+      model.unlock_automaton (pos->first);
+
+      if (was_full) {
+	// The output may have been waiting for room.
+	system_scheduler.drained (output);
+      }
+    }
+
+    aid_t unbind (const aid_t binder,
+		  void* const key) {
+      for (std::multimap<aid_t, aid_t>::const_iterator b = m_binder_inputs.lower_bound (binder);
+	   b != m_binder_inputs.end () && b->first == binder;
+	   ++b) {
+	typename std::map<aid_t, record*>::iterator pos = m_records.find (b->second);
+	if (pos->second->m_key == key) {
+	  const aid_t input = pos->first;
+	  erase_record (pos);
+	  return input;
 	}
       }
+      return -1;
     }
 
     void unbind_automaton (const aid_t aid) {
@@ -688,20 +915,43 @@ namespace ioa {
 	  delete pos->second;
 	}
 	m_records.clear ();
+	m_binder_inputs.clear ();
       }
       else {
-	// Look for the aid
-	for (typename std::map<aid_t, record*>::iterator pos = m_records.begin ();
-	     pos != m_records.end ();
-	     ) {
-	  if (pos->first == aid ||
-	      pos->second->m_binder == aid) {
-	    delete pos->second;
-	    m_records.erase (pos++);
-	  }
-	  else {
-	    ++pos;
-	  }
+	// Look for the aid as input and as binder.
+	typename std::map<aid_t, record*>::iterator pos = m_records.find (aid);
+	if (pos != m_records.end ()) {
+	  erase_record (pos);
+	}
+	while (m_binder_inputs.find (aid) != m_binder_inputs.end ()) {
+	  erase_record (m_records.find (m_binder_inputs.find (aid)->second));
+	}
+      }
+    }
+
+    void unbind_automata (const std::vector<aid_t>& dying,
+			  const std::vector<aid_t>& involved,
+			  std::vector<std::pair<aid_t, aid_t> >& removed) {
+      const bool output_dying = std::binary_search (dying.begin (), dying.end (), this->m_handle);
+      if (output_dying) {
+	// Every record goes.
+	while (!m_records.empty ()) {
+	  erase_dying_record (m_records.begin (), dying, output_dying, removed);
+	}
+	return;
+      }
+
+      // Only the records of the involved automata are visited so a fan-out output is not scanned for each of its inputs.
+      for (std::vector<aid_t>::const_iterator aid = involved.begin ();
+	   aid != involved.end ();
+	   ++aid) {
+	typename std::map<aid_t, record*>::iterator pos = m_records.find (*aid);
+	if (pos != m_records.end ()) {
+	  erase_dying_record (pos, dying, output_dying, removed);
+	}
+	std::multimap<aid_t, aid_t>::const_iterator b;
+	while ((b = m_binder_inputs.find (*aid)) != m_binder_inputs.end ()) {
+	  erase_dying_record (m_records.find (b->second), dying, output_dying, removed);
 	}
       }
     }
@@ -735,14 +985,15 @@ namespace ioa {
 
       // Execute.
       system_scheduler.set_current_aid (this->m_handle);
-      if (((this->m_instance)->*(this->m_member_ptr)).precondition (const_cast<const I&> (*(this->m_instance)))) {
+      if (!this->full () &&
+	  ((this->m_instance)->*(this->m_member_ptr)).precondition (const_cast<const I&> (*(this->m_instance)))) {
 	((this->m_instance)->*(this->m_member_ptr)).effect (*(this->m_instance));
 	((this->m_instance)->*(this->m_member_ptr)).schedule (const_cast<const I&> (*(this->m_instance)));
 	system_scheduler.clear_current_aid ();
 	for (typename std::map<aid_t, record*>::const_iterator pos = this->m_records.begin ();
 	     pos != this->m_records.end ();
 	     ++pos) {
-	  (*(pos->second->m_input)) (system_scheduler);
+	  pos->second->execute (system_scheduler);
 	}	  
       }
       else {
@@ -832,18 +1083,31 @@ namespace ioa {
 	       model_interface& model,
 	       const input_executor_interface& input,
 	       const aid_t aid,
-	       void* const key) {
-      output_core<I, M, unvalued_output_executor_interface, unvalued_input_executor_interface>::bind (system_scheduler, model, *this, input, aid, key);
+	       void* const key,
+	       const fifo* f) {
+      output_core<I, M, unvalued_output_executor_interface, unvalued_input_executor_interface>::bind (system_scheduler, model, *this, input, aid, key, f);
+    }
+
+    void deliver (model_interface& model,
+		  system_scheduler_interface& system_scheduler,
+		  const input_executor_interface& input) const {
+      output_core<I, M, unvalued_output_executor_interface, unvalued_input_executor_interface>::deliver (model, system_scheduler, *this, input);
     }
 
-    void unbind (const aid_t aid,
-		 void* const key) {
-      output_core<I, M, unvalued_output_executor_interface, unvalued_input_executor_interface>::unbind (aid, key);
+    aid_t unbind (const aid_t aid,
+		  void* const key) {
+      return output_core<I, M, unvalued_output_executor_interface, unvalued_input_executor_interface>::unbind (aid, key);
     }
 
     void unbind_automaton (const aid_t aid) {
       output_core<I, M, unvalued_output_executor_interface, unvalued_input_executor_interface>::unbind_automaton (aid);
     }
+
+    void unbind_automata (const std::vector<aid_t>& dying,
+			  const std::vector<aid_t>& involved,
+			  std::vector<std::pair<aid_t, aid_t> >& removed) {
+      output_core<I, M, unvalued_output_executor_interface, unvalued_input_executor_interface>::unbind_automata (dying, involved, removed);
+    }
       
   };
 
@@ -878,14 +1142,15 @@ namespace ioa {
 
       // Execute.
       system_scheduler.set_current_aid (this->m_handle);
-      if (((this->m_instance)->*(this->m_member_ptr)).precondition (const_cast<const I&> (*(this->m_instance)), m_parameter)) {
+      if (!this->full () &&
+	  ((this->m_instance)->*(this->m_member_ptr)).precondition (const_cast<const I&> (*(this->m_instance)), m_parameter)) {
 	((this->m_instance)->*(this->m_member_ptr)).effect (*(this->m_instance), m_parameter);
 	((this->m_instance)->*(this->m_member_ptr)).schedule (const_cast<const I&> (*(this->m_instance)), m_parameter);
 	system_scheduler.clear_current_aid ();
 	for (typename std::map<aid_t, record*>::const_iterator pos = this->m_records.begin ();
 	     pos != this->m_records.end ();
 	     ++pos) {
-	  (*(pos->second->m_input)) (system_scheduler);
+	  pos->second->execute (system_scheduler);
 	}	  
       }
       else {
@@ -975,19 +1240,32 @@ namespace ioa {
 	       model_interface& model,
 	       const input_executor_interface& input,
 	       const aid_t aid,
-	       void* const key) {
-      output_core<I, M, unvalued_output_executor_interface, unvalued_input_executor_interface>::bind (system_scheduler, model, *this, input, aid, key);
+	       void* const key,
+	       const fifo* f) {
+      output_core<I, M, unvalued_output_executor_interface, unvalued_input_executor_interface>::bind (system_scheduler, model, *this, input, aid, key, f);
+    }
+
+    void deliver (model_interface& model,
+		  system_scheduler_interface& system_scheduler,
+		  const input_executor_interface& input) const {
+      output_core<I, M, unvalued_output_executor_interface, unvalued_input_executor_interface>::deliver (model, system_scheduler, *this, input);
     }
 
-    void unbind (const aid_t aid,
-		 void* const key) {
-      output_core<I, M, unvalued_output_executor_interface, unvalued_input_executor_interface>::unbind (aid, key);
+    aid_t unbind (const aid_t aid,
+		  void* const key) {
+      return output_core<I, M, unvalued_output_executor_interface, unvalued_input_executor_interface>::unbind (aid, key);
     }
 
     void unbind_automaton (const aid_t aid) {
       output_core<I, M, unvalued_output_executor_interface, unvalued_input_executor_interface>::unbind_automaton (aid);
     }
 
+    void unbind_automata (const std::vector<aid_t>& dying,
+			  const std::vector<aid_t>& involved,
+			  std::vector<std::pair<aid_t, aid_t> >& removed) {
+      output_core<I, M, unvalued_output_executor_interface, unvalued_input_executor_interface>::unbind_automata (dying, involved, removed);
+    }
+
   };
 
   template <class I, class M>
@@ -1032,14 +1310,15 @@ namespace ioa {
 
       // Execute.
       system_scheduler.set_current_aid (this->m_handle);
-      if (((this->m_instance)->*(this->m_member_ptr)).precondition (const_cast<const I&> (*(this->m_instance)), m_parameter)) {
+      if (!this->full () &&
+	  ((this->m_instance)->*(this->m_member_ptr)).precondition (const_cast<const I&> (*(this->m_instance)), m_parameter)) {
 	((this->m_instance)->*(this->m_member_ptr)).effect (*(this->m_instance), m_parameter);
 	((this->m_instance)->*(this->m_member_ptr)).schedule (const_cast<const I&> (*(this->m_instance)), m_parameter);
 	system_scheduler.clear_current_aid ();
 	for (typename std::map<aid_t, record*>::const_iterator pos = this->m_records.begin ();
 	     pos != this->m_records.end ();
 	     ++pos) {
-	  (*(pos->second->m_input)) (system_scheduler);
+	  pos->second->execute (system_scheduler);
 	}	  
       }
       else {
@@ -1127,19 +1406,32 @@ namespace ioa {
 	       model_interface& model,
 	       const input_executor_interface& input,
 	       const aid_t aid,
-	       void* const key) {
-      output_core<I, M, unvalued_output_executor_interface, unvalued_input_executor_interface>::bind (system_scheduler, model, *this, input, aid, key);
+	       void* const key,
+	       const fifo* f) {
+      output_core<I, M, unvalued_output_executor_interface, unvalued_input_executor_interface>::bind (system_scheduler, model, *this, input, aid, key, f);
     }
 
-    void unbind (const aid_t aid,
-		 void* const key) {
-      output_core<I, M, unvalued_output_executor_interface, unvalued_input_executor_interface>::unbind (aid, key);
+    void deliver (model_interface& model,
+		  system_scheduler_interface& system_scheduler,
+		  const input_executor_interface& input) const {
+      output_core<I, M, unvalued_output_executor_interface, unvalued_input_executor_interface>::deliver (model, system_scheduler, *this, input);
+    }
+
+    aid_t unbind (const aid_t aid,
+		  void* const key) {
+      return output_core<I, M, unvalued_output_executor_interface, unvalued_input_executor_interface>::unbind (aid, key);
     }
 
     void unbind_automaton (const aid_t aid) {
       output_core<I, M, unvalued_output_executor_interface, unvalued_input_executor_interface>::unbind_automaton (aid);
     }
 
+    void unbind_automata (const std::vector<aid_t>& dying,
+			  const std::vector<aid_t>& involved,
+			  std::vector<std::pair<aid_t, aid_t> >& removed) {
+      output_core<I, M, unvalued_output_executor_interface, unvalued_input_executor_interface>::unbind_automata (dying, involved, removed);
+    }
+
   };
 
   template <class I, class M, class VT>
@@ -1173,7 +1465,8 @@ namespace ioa {
 
       // Execute.
       system_scheduler.set_current_aid (this->m_handle);
-      if (((this->m_instance)->*(this->m_member_ptr)).precondition (const_cast<const I&> (*(this->m_instance)))) {
+      if (!this->full () &&
+	  ((this->m_instance)->*(this->m_member_ptr)).precondition (const_cast<const I&> (*(this->m_instance)))) {
 	VT v = ((this->m_instance)->*(this->m_member_ptr)).effect (*(this->m_instance));
 	((this->m_instance)->*(this->m_member_ptr)).schedule (const_cast<const I&> (*(this->m_instance)));
 	const VT& value = v;
@@ -1181,7 +1474,7 @@ namespace ioa {
 	for (typename std::map<aid_t, record*>::const_iterator pos = this->m_records.begin ();
 	     pos != this->m_records.end ();
 	     ++pos) {
-	  (*(pos->second->m_input)) (system_scheduler, value);
+	  pos->second->execute (system_scheduler, value);
 	}	  
       }
       else {
@@ -1267,19 +1560,32 @@ namespace ioa {
 	       model_interface& model,
 	       const input_executor_interface& input,
 	       const aid_t aid,
-	       void* const key) {
-      output_core<I, M, valued_output_executor_interface<VT>, valued_input_executor_interface<VT> >::bind (system_scheduler, model, *this, input, aid, key);
+	       void* const key,
+	       const fifo* f) {
+      output_core<I, M, valued_output_executor_interface<VT>, valued_input_executor_interface<VT> >::bind (system_scheduler, model, *this, input, aid, key, f);
+    }
+
+    void deliver (model_interface& model,
+		  system_scheduler_interface& system_scheduler,
+		  const input_executor_interface& input) const {
+      output_core<I, M, valued_output_executor_interface<VT>, valued_input_executor_interface<VT> >::deliver (model, system_scheduler, *this, input);
     }
 
-    void unbind (const aid_t aid,
-		 void* const key) {
-      output_core<I, M, valued_output_executor_interface<VT>, valued_input_executor_interface<VT> >::unbind (aid, key);
+    aid_t unbind (const aid_t aid,
+		  void* const key) {
+      return output_core<I, M, valued_output_executor_interface<VT>, valued_input_executor_interface<VT> >::unbind (aid, key);
     }
 
     void unbind_automaton (const aid_t aid) {
       output_core<I, M, valued_output_executor_interface<VT>, valued_input_executor_interface<VT> >::unbind_automaton (aid);
     }
 
+    void unbind_automata (const std::vector<aid_t>& dying,
+			  const std::vector<aid_t>& involved,
+			  std::vector<std::pair<aid_t, aid_t> >& removed) {
+      output_core<I, M, valued_output_executor_interface<VT>, valued_input_executor_interface<VT> >::unbind_automata (dying, involved, removed);
+    }
+
   };
 
   template <class I, class M, class VT, class PT>
@@ -1317,7 +1623,8 @@ namespace ioa {
 
       // Execute.
       system_scheduler.set_current_aid (this->m_handle);
-      if (((this->m_instance)->*(this->m_member_ptr)).precondition (const_cast<const I&> (*(this->m_instance)), m_parameter)) {
+      if (!this->full () &&
+	  ((this->m_instance)->*(this->m_member_ptr)).precondition (const_cast<const I&> (*(this->m_instance)), m_parameter)) {
 	VT v = ((this->m_instance)->*(this->m_member_ptr)).effect (*(this->m_instance), m_parameter);
 	((this->m_instance)->*(this->m_member_ptr)).schedule (const_cast<const I&> (*(this->m_instance)), m_parameter);
 	const VT& value = v;
@@ -1325,7 +1632,7 @@ namespace ioa {
 	for (typename std::map<aid_t, record*>::const_iterator pos = this->m_records.begin ();
 	     pos != this->m_records.end ();
 	     ++pos) {
-	  (*(pos->second->m_input)) (system_scheduler, value);
+	  pos->second->execute (system_scheduler, value);
 	}	  
       }
       else {
@@ -1411,19 +1718,32 @@ namespace ioa {
 	       model_interface& model,
 	       const input_executor_interface& input,
 	       const aid_t aid,
-	       void* const key) {
-      output_core<I, M, valued_output_executor_interface<VT>, valued_input_executor_interface<VT> >::bind (system_scheduler, model, *this, input, aid, key);
+	       void* const key,
+	       const fifo* f) {
+      output_core<I, M, valued_output_executor_interface<VT>, valued_input_executor_interface<VT> >::bind (system_scheduler, model, *this, input, aid, key, f);
+    }
+
+    void deliver (model_interface& model,
+		  system_scheduler_interface& system_scheduler,
+		  const input_executor_interface& input) const {
+      output_core<I, M, valued_output_executor_interface<VT>, valued_input_executor_interface<VT> >::deliver (model, system_scheduler, *this, input);
     }
 
-    void unbind (const aid_t aid,
-		 void* const key) {
-      output_core<I, M, valued_output_executor_interface<VT>, valued_input_executor_interface<VT> >::unbind (aid, key);
+    aid_t unbind (const aid_t aid,
+		  void* const key) {
+      return output_core<I, M, valued_output_executor_interface<VT>, valued_input_executor_interface<VT> >::unbind (aid, key);
     }
 
     void unbind_automaton (const aid_t aid) {
       output_core<I, M, valued_output_executor_interface<VT>, valued_input_executor_interface<VT> >::unbind_automaton (aid);
     }
 
+    void unbind_automata (const std::vector<aid_t>& dying,
+			  const std::vector<aid_t>& involved,
+			  std::vector<std::pair<aid_t, aid_t> >& removed) {
+      output_core<I, M, valued_output_executor_interface<VT>, valued_input_executor_interface<VT> >::unbind_automata (dying, involved, removed);
+    }
+
   };
 
   template <class I, class M, class VT>
@@ -1468,7 +1788,8 @@ namespace ioa {
 
       // Execute.
       system_scheduler.set_current_aid (this->m_handle);
-      if (((this->m_instance)->*(this->m_member_ptr)).precondition (const_cast<const I&> (*(this->m_instance)), m_parameter)) {
+      if (!this->full () &&
+	  ((this->m_instance)->*(this->m_member_ptr)).precondition (const_cast<const I&> (*(this->m_instance)), m_parameter)) {
 	VT v = ((this->m_instance)->*(this->m_member_ptr)).effect (*(this->m_instance), m_parameter);
 	((this->m_instance)->*(this->m_member_ptr)).schedule (const_cast<const I&> (*(this->m_instance)), m_parameter);
 	const VT& value = v;
@@ -1476,7 +1797,7 @@ namespace ioa {
 	for (typename std::map<aid_t, record*>::const_iterator pos = this->m_records.begin ();
 	     pos != this->m_records.end ();
 	     ++pos) {
-	  (*(pos->second->m_input)) (system_scheduler, value);
+	  pos->second->execute (system_scheduler, value);
 	}	  
       }
       else {
@@ -1564,19 +1885,32 @@ namespace ioa {
 	       model_interface& model,
 	       const input_executor_interface& input,
 	       const aid_t aid,
-	       void* const key) {
-      output_core<I, M, valued_output_executor_interface<VT>, valued_input_executor_interface<VT> >::bind (system_scheduler, model, *this, input, aid, key);
+	       void* const key,
+	       const fifo* f) {
+      output_core<I, M, valued_output_executor_interface<VT>, valued_input_executor_interface<VT> >::bind (system_scheduler, model, *this, input, aid, key, f);
     }
 
-    void unbind (const aid_t aid,
-		 void* const key) {
-      output_core<I, M, valued_output_executor_interface<VT>, valued_input_executor_interface<VT> >::unbind (aid, key);
+    void deliver (model_interface& model,
+		  system_scheduler_interface& system_scheduler,
+		  const input_executor_interface& input) const {
+      output_core<I, M, valued_output_executor_interface<VT>, valued_input_executor_interface<VT> >::deliver (model, system_scheduler, *this, input);
+    }
+
+    aid_t unbind (const aid_t aid,
+		  void* const key) {
+      return output_core<I, M, valued_output_executor_interface<VT>, valued_input_executor_interface<VT> >::unbind (aid, key);
     }
 
     void unbind_automaton (const aid_t aid) {
       output_core<I, M, valued_output_executor_interface<VT>, valued_input_executor_interface<VT> >::unbind_automaton (aid);
     }
 
+    void unbind_automata (const std::vector<aid_t>& dying,
+			  const std::vector<aid_t>& involved,
+			  std::vector<std::pair<aid_t, aid_t> >& removed) {
+      output_core<I, M, valued_output_executor_interface<VT>, valued_input_executor_interface<VT> >::unbind_automata (dying, involved, removed);
+    }
+
   };
 
   template <class I, class M>
@@ -1804,6 +2138,8 @@ namespace ioa {
   private:
     action_executor<OI, OM> m_output;
     action_executor<II, IM> m_input;
+    bool m_buffered;
+    fifo m_fifo;
 
   public:
     bind_executor (const automaton_handle<OI>& output_handle,
@@ -1811,7 +2147,8 @@ namespace ioa {
 		   const automaton_handle<II>& input_handle,
 		   IM II::*input_member_ptr) :
       m_output (output_handle, output_member_ptr),
-      m_input (input_handle, input_member_ptr)
+      m_input (input_handle, input_member_ptr),
+      m_buffered (false)
     { }
 
     bind_executor (const automaton_handle<OI>& output_handle,
@@ -1820,7 +2157,8 @@ namespace ioa {
 		   const automaton_handle<II>& input_handle,
 		   IM II::*input_member_ptr) :
       m_output (output_handle, output_member_ptr, output_parameter),
-      m_input (input_handle, input_member_ptr)
+      m_input (input_handle, input_member_ptr),
+      m_buffered (false)
     { }
 
     bind_executor (const automaton_handle<OI>& output_handle,
@@ -1829,7 +2167,8 @@ namespace ioa {
 		   IM II::*input_member_ptr,
 		   const typename IM::parameter_type& input_parameter) :
       m_output (output_handle, output_member_ptr),
-      m_input (input_handle, input_member_ptr, input_parameter)
+      m_input (input_handle, input_member_ptr, input_parameter),
+      m_buffered (false)
     { }
 
     bind_executor (const automaton_handle<OI>& output_handle,
@@ -1839,7 +2178,8 @@ namespace ioa {
 		   IM II::*input_member_ptr,
 		   const typename IM::parameter_type& input_parameter) :
       m_output (output_handle, output_member_ptr, output_parameter),
-      m_input (input_handle, input_member_ptr, input_parameter)
+      m_input (input_handle, input_member_ptr, input_parameter),
+      m_buffered (false)
     { }
 
     output_executor_interface& get_output () {
@@ -1850,6 +2190,15 @@ namespace ioa {
       return m_input;
     }
 
+    void set_fifo (const fifo& f) {
+      m_buffered = true;
+      m_fifo = f;
+    }
+
+    const fifo* get_fifo () const {
+      return m_buffered ? &m_fifo : 0;
+    }
+
   };
   
   template <class OI, class OM, class II, class IM>
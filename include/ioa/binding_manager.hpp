@@ -135,6 +135,8 @@ namespace ioa {
     input_observer m_input_observer;
 
     state_t m_state;
+    bool m_buffered;
+    fifo m_fifo;
 
     void set_output_handle (const automaton_handle<OI>& output_handle) {
       m_output_handle = output_handle;
@@ -164,15 +166,29 @@ namespace ioa {
       // This need to be initialized after the handles because they might set the handle.
       m_output_observer (this, output),
       m_input_observer (this, input),
-      m_state (START)
+      m_state (START),
+      m_buffered (false)
     { }
 
   protected:
 
     virtual ~binding_manager_core () { }
 
+    std::auto_ptr<bind_executor_interface> buffer (std::auto_ptr<bind_executor_interface> exec) const {
+      if (m_buffered) {
+	exec->set_fifo (m_fifo);
+      }
+      return exec;
+    }
+
   public:
 
+    // Must be called before the binding is made, i.e., right after construction.
+    void set_fifo (const fifo& f) {
+      m_buffered = true;
+      m_fifo = f;
+    }
+
     void unbind () {
       if (m_output_handle != -1 && m_input_handle != -1) {
 	m_automaton->unbind (this);
@@ -246,8 +262,8 @@ namespace ioa {
   private:
 
     std::auto_ptr<bind_executor_interface> get_executor () const {
-      return make_bind_executor (this->m_output_handle, this->m_output_member_ptr,
-				 this->m_input_handle, this->m_input_member_ptr);
+      return this->buffer (make_bind_executor (this->m_output_handle, this->m_output_member_ptr,
+						    this->m_input_handle, this->m_input_member_ptr));
     }
 
   public:
@@ -272,8 +288,8 @@ namespace ioa {
     IP m_input_parameter;
 
     std::auto_ptr<bind_executor_interface> get_executor () const {
-      return make_bind_executor (this->m_output_handle, this->m_output_member_ptr,
-				 this->m_input_handle, this->m_input_member_ptr, this->m_input_parameter);
+      return this->buffer (make_bind_executor (this->m_output_handle, this->m_output_member_ptr,
+						    this->m_input_handle, this->m_input_member_ptr, this->m_input_parameter));
     }
 
   public:
@@ -296,8 +312,8 @@ namespace ioa {
   {
   private:
     std::auto_ptr<bind_executor_interface> get_executor () const {
-      return make_bind_executor (this->m_output_handle, this->m_output_member_ptr,
-				 this->m_input_handle, this->m_input_member_ptr);
+      return this->buffer (make_bind_executor (this->m_output_handle, this->m_output_member_ptr,
+						    this->m_input_handle, this->m_input_member_ptr));
     }
 
   public:
@@ -322,8 +338,8 @@ namespace ioa {
     OP m_output_parameter;
 
     std::auto_ptr<bind_executor_interface> get_executor () const {
-      return make_bind_executor (this->m_output_handle, this->m_output_member_ptr, this->m_output_parameter,
-				 this->m_input_handle, this->m_input_member_ptr);
+      return this->buffer (make_bind_executor (this->m_output_handle, this->m_output_member_ptr, this->m_output_parameter,
+						    this->m_input_handle, this->m_input_member_ptr));
     }
 
   public:
@@ -351,8 +367,8 @@ namespace ioa {
     IP m_input_parameter;
 
     std::auto_ptr<bind_executor_interface> get_executor () const {
-      return make_bind_executor (this->m_output_handle, this->m_output_member_ptr, m_output_parameter,
-				 this->m_input_handle, this->m_input_member_ptr, m_input_parameter);
+      return this->buffer (make_bind_executor (this->m_output_handle, this->m_output_member_ptr, m_output_parameter,
+						    this->m_input_handle, this->m_input_member_ptr, m_input_parameter));
     }
 
   public:
@@ -381,8 +397,8 @@ namespace ioa {
     OP m_output_parameter;
 
     std::auto_ptr<bind_executor_interface> get_executor () const {
-      return make_bind_executor (this->m_output_handle, this->m_output_member_ptr, m_output_parameter,
-				 this->m_input_handle, this->m_input_member_ptr);
+      return this->buffer (make_bind_executor (this->m_output_handle, this->m_output_member_ptr, m_output_parameter,
+						    this->m_input_handle, this->m_input_member_ptr));
     }
 
   public:
@@ -405,8 +421,8 @@ namespace ioa {
   {
   private:
     std::auto_ptr<bind_executor_interface> get_executor () const {
-      return make_bind_executor (this->m_output_handle, this->m_output_member_ptr,
-				 this->m_input_handle, this->m_input_member_ptr);
+      return this->buffer (make_bind_executor (this->m_output_handle, this->m_output_member_ptr,
+						    this->m_input_handle, this->m_input_member_ptr));
     }
 
   public:
@@ -431,8 +447,8 @@ namespace ioa {
     IP m_input_parameter;
 
     std::auto_ptr<bind_executor_interface> get_executor () const {
-      return make_bind_executor (this->m_output_handle, this->m_output_member_ptr,
-				 this->m_input_handle, this->m_input_member_ptr, this->m_input_parameter);
+      return this->buffer (make_bind_executor (this->m_output_handle, this->m_output_member_ptr,
+						    this->m_input_handle, this->m_input_member_ptr, this->m_input_parameter));
     }
 
   public:
@@ -455,8 +471,8 @@ namespace ioa {
   {
   private:
     std::auto_ptr<bind_executor_interface> get_executor () const {
-      return make_bind_executor (this->m_output_handle, this->m_output_member_ptr,
-				 this->m_input_handle, this->m_input_member_ptr);
+      return this->buffer (make_bind_executor (this->m_output_handle, this->m_output_member_ptr,
+						    this->m_input_handle, this->m_input_member_ptr));
     }
 
   public:
@@ -558,6 +574,60 @@ namespace ioa {
     return new binding_manager<OI, OM, II, IM> (automaton, output, output_member_ptr, output_parameter, input, input_member_ptr, input_parameter);
   }
 
+  // Buffered bindings.
+
+  template <class OI, class OM, class II, class IM>
+  binding_manager<OI, OM, II, IM>* make_binding_manager (automaton* automaton,
+							 automaton_handle_interface<OI>* output,
+							 OM OI::*output_member_ptr,
+							 automaton_handle_interface<II>* input,
+							 IM II::*input_member_ptr,
+							 const fifo& f) {
+    binding_manager<OI, OM, II, IM>* retval = new binding_manager<OI, OM, II, IM> (automaton, output, output_member_ptr, input, input_member_ptr);
+    retval->set_fifo (f);
+    return retval;
+  }
+
+  template <class OI, class OM, class II, class IM>
+  binding_manager<OI, OM, II, IM>* make_binding_manager (automaton* automaton,
+							 automaton_handle_interface<OI>* output,
+							 OM OI::*output_member_ptr,
+							 typename OM::parameter_type parameter,
+							 automaton_handle_interface<II>* input,
+							 IM II::*input_member_ptr,
+							 const fifo& f) {
+    binding_manager<OI, OM, II, IM>* retval = new binding_manager<OI, OM, II, IM> (automaton, output, output_member_ptr, parameter, input, input_member_ptr);
+    retval->set_fifo (f);
+    return retval;
+  }
+
+  template <class OI, class OM, class II, class IM>
+  binding_manager<OI, OM, II, IM>* make_binding_manager (automaton* automaton,
+							 automaton_handle_interface<OI>* output,
+							 OM OI::*output_member_ptr,
+							 automaton_handle_interface<II>* input,
+							 IM II::*input_member_ptr,
+							 typename IM::parameter_type parameter,
+							 const fifo& f) {
+    binding_manager<OI, OM, II, IM>* retval = new binding_manager<OI, OM, II, IM> (automaton, output, output_member_ptr, input, input_member_ptr, parameter);
+    retval->set_fifo (f);
+    return retval;
+  }
+
+  template <class OI, class OM, class II, class IM>
+  binding_manager<OI, OM, II, IM>* make_binding_manager (automaton* automaton,
+							 automaton_handle_interface<OI>* output,
+							 OM OI::*output_member_ptr,
+							 typename OM::parameter_type output_parameter,
+							 automaton_handle_interface<II>* input,
+							 IM II::*input_member_ptr,
+							 typename IM::parameter_type input_parameter,
+							 const fifo& f) {
+    binding_manager<OI, OM, II, IM>* retval = new binding_manager<OI, OM, II, IM> (automaton, output, output_member_ptr, output_parameter, input, input_member_ptr, input_parameter);
+    retval->set_fifo (f);
+    return retval;
+  }
+
 }
 
 #endif
@@ -0,0 +1,198 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#ifndef __channel_hpp__
+#define __channel_hpp__
+
+#include <ioa/ioa.hpp>
+#include <ioa/ring_buffer.hpp>
+#include <vector>
+
+namespace ioa {
+
+  /*
+    Bounded Channel I/O Automaton
+
+    Values sent to the channel are stored in a ring buffer that is allocated when the channel is created.
+    Values are received one at a time with receive or in batches of up to batch_size with receive_batch.
+
+    The backpressure output reports true when the number of stored values reaches the high watermark and false when it falls to the low watermark.
+    The current state is also reported whenever backpressure is bound so a producer can wait for the first report before sending.
+    A producer that binds to backpressure and stops sending while it is true will not overflow the channel provided capacity - high_watermark covers the values it sends before it sees the report.
+    Values sent to a full channel are dropped and counted.
+    The dropped output reports the number of values dropped since its last report.
+  */
+  template <class T>
+  class channel :
+    public automaton,
+    private observer
+  {
+  private:
+    ring_buffer<T> m_buffer;
+    const size_t m_high_watermark;
+    const size_t m_low_watermark;
+    const size_t m_batch_size;
+    bool m_congested;
+    bool m_congested_reported;
+    size_t m_dropped;
+
+    void schedule () const {
+      if (receive_precondition ()) {
+	ioa::schedule (&channel::receive);
+      }
+      if (receive_batch_precondition ()) {
+	ioa::schedule (&channel::receive_batch);
+      }
+      if (backpressure_precondition ()) {
+	ioa::schedule (&channel::backpressure);
+      }
+      if (dropped_precondition ()) {
+	ioa::schedule (&channel::dropped);
+      }
+    }
+
+    void observe (observable* o) {
+      if (o == &backpressure && backpressure.recent_op == BOUND) {
+	// Report the current state to the new producer.
+	m_congested_reported = !m_congested;
+	schedule ();
+      }
+    }
+
+    void update_congestion () {
+      if (!m_congested && m_buffer.size () >= m_high_watermark) {
+	m_congested = true;
+      }
+      else if (m_congested && m_buffer.size () <= m_low_watermark) {
+	m_congested = false;
+      }
+    }
+
+  public:
+    channel (const size_t capacity = 1024,
+	     const size_t high_watermark = 768,
+	     const size_t low_watermark = 256,
+	     const size_t batch_size = 64) :
+      m_buffer (capacity),
+      m_high_watermark (std::min (high_watermark, capacity)),
+      m_low_watermark (std::min (low_watermark, high_watermark)),
+      m_batch_size (batch_size),
+      m_congested (false),
+      m_congested_reported (false),
+      m_dropped (0)
+    {
+      assert (m_batch_size != 0);
+      add_observable (&backpressure);
+    }
+
+  private:
+    void send_effect (const T& t) {
+      if (!m_buffer.full ()) {
+	m_buffer.push (t);
+	update_congestion ();
+      }
+      else {
+	++m_dropped;
+      }
+    }
+
+    void send_schedule () const {
+      schedule ();
+    }
+
+  public:
+    V_UP_INPUT (channel, send, T);
+
+  private:
+    bool receive_precondition () const {
+      return !m_buffer.empty () && binding_count (&channel::receive) != 0;
+    }
+
+    T receive_effect () {
+      T retval = T ();
+      m_buffer.pop_swap (retval);
+      update_congestion ();
+      return retval;
+    }
+
+    void receive_schedule () const {
+      schedule ();
+    }
+
+  public:
+    V_UP_OUTPUT (channel, receive, T);
+
+  private:
+    bool receive_batch_precondition () const {
+      return !m_buffer.empty () && binding_count (&channel::receive_batch) != 0;
+    }
+
+    std::vector<T> receive_batch_effect () {
+      std::vector<T> retval (std::min (m_batch_size, m_buffer.size ()));
+      for (typename std::vector<T>::iterator pos = retval.begin ();
+	   pos != retval.end ();
+	   ++pos) {
+	m_buffer.pop_swap (*pos);
+      }
+      update_congestion ();
+      return retval;
+    }
+
+    void receive_batch_schedule () const {
+      schedule ();
+    }
+
+  public:
+    V_UP_OUTPUT (channel, receive_batch, std::vector<T>);
+
+  private:
+    bool backpressure_precondition () const {
+      return m_congested != m_congested_reported && binding_count (&channel::backpressure) != 0;
+    }
+
+    bool backpressure_effect () {
+      m_congested_reported = m_congested;
+      return m_congested;
+    }
+
+    void backpressure_schedule () const {
+      schedule ();
+    }
+
+  public:
+    V_UP_OUTPUT (channel, backpressure, bool);
+
+  private:
+    bool dropped_precondition () const {
+      return m_dropped != 0 && binding_count (&channel::dropped) != 0;
+    }
+
+    size_t dropped_effect () {
+      const size_t retval = m_dropped;
+      m_dropped = 0;
+      return retval;
+    }
+
+    void dropped_schedule () const {
+      schedule ();
+    }
+
+  public:
+    V_UP_OUTPUT (channel, dropped, size_t);
+  };
+
+}
+
+#endif
@@ -0,0 +1,161 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef __chunk_hpp__
+#define __chunk_hpp__
+
+#include <ioa/mutex.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace ioa {
+
+  class chunk_pool;
+
+  /*
+    A fixed-size block of memory owned by a chunk_pool.
+    The block is returned to the pool when the last reference is released.
+  */
+  struct chunk_buffer
+  {
+    volatile int refs;
+    chunk_pool* pool;
+    char* data;
+  };
+
+  void release_chunk_buffer (chunk_buffer* buffer);
+
+  /*
+    Chunk Pool
+
+    Allocates chunk_buffers of one size and recycles them.
+    The pool is reference counted: the creator holds one reference and every outstanding buffer holds one.
+    Call release () instead of delete when the creator is done with the pool.
+    Up to max_free buffers are kept for reuse and the rest are freed.
+  */
+  class chunk_pool
+  {
+  private:
+    const size_t m_chunk_size;
+    const size_t m_max_free;
+    volatile int m_refs;
+    mutex m_mutex;
+    std::vector<chunk_buffer*> m_free;
+
+    chunk_pool (const chunk_pool&) : m_chunk_size (0), m_max_free (0) { }
+    void operator= (const chunk_pool&) { }
+    ~chunk_pool ();
+    
+  public:
+    chunk_pool (const size_t chunk_size,
+		const size_t max_free = 64);
+    void release ();
+    size_t chunk_size () const;
+    // Returns a buffer with one reference.
+    chunk_buffer* allocate ();
+    // Called when the last reference to buffer is released.
+    void recycle (chunk_buffer* buffer);
+  };
+
+  /*
+    Chunk
+
+    An immutable handle to bytes in a chunk_buffer.
+    Copying a chunk copies the handle, not the bytes.
+  */
+  class chunk
+  {
+  private:
+    chunk_buffer* m_buffer;
+    const char* m_data;
+    size_t m_size;
+
+  public:
+    chunk () :
+      m_buffer (0),
+      m_data (0),
+      m_size (0)
+    { }
+
+    // Takes over the caller's reference to buffer.
+    chunk (chunk_buffer* buffer,
+	   const size_t size) :
+      m_buffer (buffer),
+      m_data (buffer->data),
+      m_size (size)
+    { }
+
+    chunk (const chunk& other) :
+      m_buffer (other.m_buffer),
+      m_data (other.m_data),
+      m_size (other.m_size)
+    {
+      if (m_buffer != 0) {
+	__sync_add_and_fetch (&m_buffer->refs, 1);
+      }
+    }
+
+    ~chunk () {
+      if (m_buffer != 0) {
+	release_chunk_buffer (m_buffer);
+      }
+    }
+
+    chunk& operator= (const chunk& other) {
+      chunk tmp (other);
+      swap (tmp);
+      return *this;
+    }
+
+    void swap (chunk& other) {
+      std::swap (m_buffer, other.m_buffer);
+      std::swap (m_data, other.m_data);
+      std::swap (m_size, other.m_size);
+    }
+
+    const char* data () const {
+      return m_data;
+    }
+
+    size_t size () const {
+      return m_size;
+    }
+
+    bool empty () const {
+      return m_size == 0;
+    }
+
+    // Returns a handle to part of this chunk.
+    chunk substr (const size_t pos,
+		  const size_t n) const {
+      chunk retval (*this);
+      retval.m_data += std::min (pos, m_size);
+      retval.m_size = std::min (n, m_size - std::min (pos, m_size));
+      return retval;
+    }
+
+    std::string str () const {
+      return std::string (m_data, m_size);
+    }
+  };
+
+  typedef std::vector<chunk> chunk_list;
+
+}
+
+#endif
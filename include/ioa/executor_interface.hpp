@@ -20,12 +20,35 @@
 #include <ioa/aid.hpp>
 #include <cstdlib>
 #include <memory>
+#include <set>
+#include <vector>
 
 namespace ioa {
 
   class model_interface;
   class system_scheduler_interface;
 
+  /*
+    A fifo turns a binding into a buffered binding.
+    Values produced by the output are queued in the binding and delivered to the input in batches by a separate action.
+    The output and input are not locked together so they may execute on different threads.
+    A capacity of 0 means the queue is unbounded.
+  */
+  class fifo
+  {
+  private:
+    size_t m_capacity;
+
+  public:
+    explicit fifo (const size_t capacity = 0) :
+      m_capacity (capacity)
+    { }
+
+    size_t capacity () const {
+      return m_capacity;
+    }
+  };
+
   class action_executor_interface
   {
   public:
@@ -114,10 +137,20 @@ namespace ioa {
 		       model_interface&,
 		       const input_executor_interface&,
 		       const aid_t,
-		       void* const) = 0;
-    virtual void unbind (const aid_t,
-			 void* const) = 0;
+		       void* const,
+		       const fifo*) = 0;
+    virtual void deliver (model_interface&,
+			  system_scheduler_interface&,
+			  const input_executor_interface&) const = 0;
+    virtual aid_t unbind (const aid_t,
+			  void* const) = 0;
     virtual void unbind_automaton (const aid_t) = 0;
+    // Remove every record whose output, input, or binder is one of the dying automata and append the (input, binder) of each.
+    // dying is sorted and its automata are not notified.
+    // involved lists the dying automata that are inputs or binders of the records so only their records are visited.
+    virtual void unbind_automata (const std::vector<aid_t>& dying,
+				  const std::vector<aid_t>& involved,
+				  std::vector<std::pair<aid_t, aid_t> >&) = 0;
     virtual void set_parameter (const aid_t) = 0;
     virtual void bound (model_interface&,
 			system_scheduler_interface&) const = 0;
@@ -160,6 +193,8 @@ namespace ioa {
     virtual ~bind_executor_interface () { }
     virtual output_executor_interface& get_output () = 0;
     virtual input_executor_interface& get_input () = 0;
+    virtual void set_fifo (const fifo&) = 0;
+    virtual const fifo* get_fifo () const = 0;
   };
 
 }
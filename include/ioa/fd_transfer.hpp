@@ -0,0 +1,91 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef __fd_transfer_hpp__
+#define __fd_transfer_hpp__
+
+#include <algorithm>
+#include <unistd.h>
+
+namespace ioa {
+
+  /*
+    FD Transfer
+
+    Hands ownership of a file descriptor from one automaton to another as the value of an action.
+    Copies share the descriptor.
+    The first call to take () returns the descriptor and every later call returns -1.
+    If no copy takes the descriptor, the last copy to be destroyed closes it so a transfer that is dropped does not leak.
+  */
+  class fd_transfer
+  {
+  private:
+    struct state
+    {
+      volatile int refs;
+      volatile int fd;
+    };
+
+    state* m_state;
+
+    void release () {
+      if (m_state != 0 && __sync_sub_and_fetch (&m_state->refs, 1) == 0) {
+	if (m_state->fd != -1) {
+	  ::close (m_state->fd);
+	}
+	delete m_state;
+      }
+    }
+
+  public:
+    fd_transfer () :
+      m_state (0)
+    { }
+
+    explicit fd_transfer (const int fd) :
+      m_state (new state)
+    {
+      m_state->refs = 1;
+      m_state->fd = fd;
+    }
+
+    fd_transfer (const fd_transfer& other) :
+      m_state (other.m_state)
+    {
+      if (m_state != 0) {
+	__sync_add_and_fetch (&m_state->refs, 1);
+      }
+    }
+
+    ~fd_transfer () {
+      release ();
+    }
+
+    fd_transfer& operator= (const fd_transfer& other) {
+      fd_transfer tmp (other);
+      std::swap (m_state, tmp.m_state);
+      return *this;
+    }
+
+    // Returns the descriptor and gives up ownership or -1 if it has already been taken.
+    int take () const {
+      return m_state != 0 ? __sync_lock_test_and_set (&m_state->fd, -1) : -1;
+    }
+  };
+
+}
+
+#endif
@@ -0,0 +1,197 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef __file_automaton_hpp__
+#define __file_automaton_hpp__
+
+#include <ioa/ioa.hpp>
+#include <ioa/chunk.hpp>
+#include <deque>
+#include <map>
+#include <string>
+#include <fcntl.h>
+#include <sys/types.h>
+
+namespace ioa {
+
+  class file_io;
+
+  /*
+    File Automaton
+
+    Reads, writes, and syncs a file on a pool of I/O threads so a slow disk never blocks an action.
+    Each request is answered on the matching complete output with the same parameter.
+    Reads are delivered in chunks from a chunk_pool.
+    An fsync completes after every write requested before it.
+    While stream is bound, the file is read from the start in chunks with up to readahead reads ahead of the one being delivered; an empty chunk marks the end of the file.
+  */
+  class file_automaton :
+    public automaton,
+    private observer
+  {
+  public:
+    struct read_arg {
+      off_t offset;
+      size_t length;
+
+      read_arg (const off_t o = 0,
+		const size_t l = 0) :
+	offset (o),
+	length (l)
+      { }
+    };
+
+    struct read_val {
+      off_t offset;
+      // Shorter than requested at the end of the file.
+      chunk_list data;
+      int error;
+
+      read_val () :
+	offset (0),
+	error (0)
+      { }
+    };
+
+    struct write_arg {
+      off_t offset;
+      std::string data;
+
+      write_arg (const off_t o = 0,
+		 const std::string& d = std::string ()) :
+	offset (o),
+	data (d)
+      { }
+    };
+
+    struct write_val {
+      off_t offset;
+      size_t length;
+      int error;
+
+      write_val () :
+	offset (0),
+	length (0),
+	error (0)
+      { }
+    };
+
+  private:
+    file_io* m_io;
+    const size_t m_chunk_size;
+    const size_t m_readahead;
+    int m_errno;
+    bool m_error_reported;
+    // Requests handed to the I/O threads whose results have not been collected.
+    size_t m_outstanding;
+    bool m_read_ready_wait;
+    std::map<aid_t, std::deque<read_val> > m_read_complete;
+    std::map<aid_t, std::deque<write_val> > m_write_complete;
+    std::map<aid_t, std::deque<int> > m_fsync_complete;
+    // Stream reads by offset.
+    std::map<off_t, chunk> m_stream_buffer;
+    off_t m_stream_next;
+    off_t m_stream_offset;
+    size_t m_stream_pending;
+    bool m_stream_eof;
+    bool m_stream_end_reported;
+
+    void schedule () const;
+    void observe (observable* o);
+    void fill_stream ();
+    void collect ();
+
+  public:
+    /*
+      Opens path with flags and mode and starts threads I/O threads.
+      Reads are split into chunks of chunk_size bytes.
+    */
+    file_automaton (const std::string& path,
+		    const int flags = O_RDONLY,
+		    const mode_t mode = 0666,
+		    const size_t threads = 2,
+		    const size_t chunk_size = 65536,
+		    const size_t readahead = 4);
+    ~file_automaton ();
+
+  private:
+    void read_effect (const read_arg& arg, aid_t aid);
+    void read_schedule (aid_t) const;
+  public:
+    V_AP_INPUT (file_automaton, read, read_arg);
+
+  private:
+    bool read_complete_precondition (aid_t aid) const;
+    read_val read_complete_effect (aid_t aid);
+    void read_complete_schedule (aid_t) const;
+  public:
+    V_AP_OUTPUT (file_automaton, read_complete, read_val);
+
+  private:
+    void write_effect (const write_arg& arg, aid_t aid);
+    void write_schedule (aid_t) const;
+  public:
+    V_AP_INPUT (file_automaton, write, write_arg);
+
+  private:
+    bool write_complete_precondition (aid_t aid) const;
+    write_val write_complete_effect (aid_t aid);
+    void write_complete_schedule (aid_t) const;
+  public:
+    V_AP_OUTPUT (file_automaton, write_complete, write_val);
+
+  private:
+    void fsync_effect (aid_t aid);
+    void fsync_schedule (aid_t) const;
+  public:
+    UV_AP_INPUT (file_automaton, fsync);
+
+  private:
+    bool fsync_complete_precondition (aid_t aid) const;
+    int fsync_complete_effect (aid_t aid);
+    void fsync_complete_schedule (aid_t) const;
+  public:
+    V_AP_OUTPUT (file_automaton, fsync_complete, int);
+
+  private:
+    bool stream_precondition () const;
+    chunk stream_effect ();
+    void stream_schedule () const;
+  public:
+    V_UP_OUTPUT (file_automaton, stream, chunk);
+
+  private:
+    bool error_precondition () const;
+    int error_effect ();
+    void error_schedule () const;
+  public:
+    V_UP_OUTPUT (file_automaton, error, int);
+
+  private:
+    bool schedule_read_ready_precondition () const;
+    void schedule_read_ready_effect ();
+    void schedule_read_ready_schedule () const;
+    UP_INTERNAL (file_automaton, schedule_read_ready);
+
+    bool read_ready_precondition () const;
+    void read_ready_effect ();
+    void read_ready_schedule () const;
+    UP_INTERNAL (file_automaton, read_ready);
+  };
+
+}
+
+#endif
@@ -0,0 +1,134 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef __framing_automaton_hpp__
+#define __framing_automaton_hpp__
+
+#include <ioa/ioa.hpp>
+#include <ioa/chunk.hpp>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace ioa {
+
+  /*
+    Framing
+
+    Splits the byte stream of a tcp_connection_automaton into messages and joins outgoing messages into the stream.
+    Bind receive or receive_chunks to the connection's output of the same name and send to the connection's send input.
+    The application sends with send_message and receives with message.
+
+    A length-prefixed frame is a 32-bit length in network byte order followed by that many bytes.
+    A delimited frame is the bytes before the next occurrence of the delimiter.
+
+    Received bytes are kept as a queue of chunks and scanned in place, once, so reassembling a large message costs time linear in its size.
+    A message is delivered as the chunks, or parts of chunks, that hold it so its bytes are not copied when the connection delivers receive_chunks.
+    Bytes delivered by receive are copied into chunks first, packed one after another so small receives share a chunk.
+    Messages sent between two sends to the connection are joined into one buffer.
+    A frame longer than max_frame bytes is an EMSGSIZE error and stops the automaton.
+  */
+  class framing_automaton :
+    public automaton,
+    private observer
+  {
+  private:
+    chunk_pool* m_pool;
+    const std::string m_delimiter;
+    // The partial-match table of the delimiter.
+    std::vector<size_t> m_failure;
+    const size_t m_max_frame;
+
+    // The chunk that received strings are being copied into and the number of its bytes in use.
+    chunk m_copy;
+    size_t m_copy_used;
+
+    std::deque<chunk> m_pending;
+    size_t m_pending_size;
+    // For delimited frames, where the scan stopped, the number of pending bytes before that point, and the number of delimiter bytes they end with.
+    size_t m_scan_index;
+    size_t m_scan_offset;
+    size_t m_scanned;
+    size_t m_matched;
+
+    std::deque<chunk_list> m_messages;
+    std::string m_send_buffer;
+    int m_errno;
+    bool m_error_reported;
+
+    void schedule () const;
+    void observe (observable* o);
+    void append (const chunk& c);
+    void parse ();
+    bool parse_length_prefixed ();
+    bool parse_delimited ();
+    void consume (size_t size,
+		  chunk_list* out);
+
+  public:
+    // Length-prefixed frames.
+    framing_automaton (const size_t max_frame = 1 << 24);
+    // Delimited frames.
+    framing_automaton (const std::string& delimiter,
+		       const size_t max_frame = 1 << 24);
+    ~framing_automaton ();
+
+    // Copies the bytes of a message into one string.
+    static std::string str (const chunk_list& message);
+
+  private:
+    void receive_effect (const std::string& buf);
+    void receive_schedule () const;
+  public:
+    V_UP_INPUT (framing_automaton, receive, std::string);
+
+  private:
+    void receive_chunks_effect (const chunk_list& chunks);
+    void receive_chunks_schedule () const;
+  public:
+    V_UP_INPUT (framing_automaton, receive_chunks, chunk_list);
+
+  private:
+    bool message_precondition () const;
+    chunk_list message_effect ();
+    void message_schedule () const;
+  public:
+    V_UP_OUTPUT (framing_automaton, message, chunk_list);
+
+  private:
+    void send_message_effect (const std::string& buf);
+    void send_message_schedule () const;
+  public:
+    V_UP_INPUT (framing_automaton, send_message, std::string);
+
+  private:
+    bool send_precondition () const;
+    std::string send_effect ();
+    void send_schedule () const;
+  public:
+    V_UP_OUTPUT (framing_automaton, send, std::string);
+
+  private:
+    bool error_precondition () const;
+    int error_effect ();
+    void error_schedule () const;
+  public:
+    V_UP_OUTPUT (framing_automaton, error, int);
+  };
+
+}
+
+#endif
@@ -34,8 +34,24 @@ namespace ioa {
     void operator= (const global_fifo_scheduler&) { }
 
   public:
-    global_fifo_scheduler ();
+    enum backend_t {
+      // Waits for file descriptors and timers with select.
+      SELECT_BACKEND,
+      /*
+	Waits with io_uring: registrations become polls, the earliest timer becomes a timeout, and one io_uring_enter submits them and waits.
+	Descriptors are not limited to FD_SETSIZE.
+	Falls back to select if the kernel does not support io_uring or the ring fails.
+	Only readiness is waited for with io_uring; the socket automata still read and write with ordinary system calls.
+	Multishot accept, provided-buffer receives, batched sends through the ring, and io_uring in the other schedulers are not implemented (see TODO).
+      */
+      IO_URING_BACKEND,
+    };
+
+    global_fifo_scheduler (const backend_t backend = SELECT_BACKEND);
     ~global_fifo_scheduler ();
+
+    // The backend in use, which is SELECT_BACKEND after a fall back.
+    backend_t get_backend () const;
     
     aid_t get_current_aid ();
     
@@ -53,6 +69,11 @@ namespace ioa {
     
     void schedule_after (action_runnable_interface*,
 			 const time&);
+
+    void schedule_every (action_runnable_interface*,
+			 const time&);
+
+    void cancel_timer (action_runnable_interface*);
     
     void schedule_read_ready (action_runnable_interface*,
 			      int fd);
@@ -0,0 +1,304 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef __inbox_automaton_hpp__
+#define __inbox_automaton_hpp__
+
+#include <ioa/ioa.hpp>
+#include <deque>
+#include <vector>
+#include <algorithm>
+#include <errno.h>
+#include <unistd.h>
+
+namespace ioa {
+
+  /*
+    The wakeup of an inbox.
+    It is an eventfd on Linux and a non-blocking pipe elsewhere.
+  */
+  class inbox_signal
+  {
+  private:
+    int m_read_fd;
+    int m_write_fd;
+
+    // No copying.
+    inbox_signal (const inbox_signal&) { }
+    void operator= (const inbox_signal&) { }
+
+  public:
+    inbox_signal ();
+    ~inbox_signal ();
+    // The descriptor that becomes readable when signalled or -1 if it could not be created.
+    int get_fd () const;
+    void signal ();
+    void clear ();
+  };
+
+  /*
+    Inbox
+
+    Carries values from threads outside of the scheduler to an inbox_automaton<T>.
+    Any number of threads may call post () concurrently without taking a lock.
+    Posted values are pushed onto a lock-free stack and only the post that finds the stack empty signals the inbox_signal so a burst of posts costs one wakeup.
+    The automaton takes the whole stack at once and delivers it in the order the values were posted.
+    The inbox must outlive the automaton that drains it.
+  */
+  template <class T>
+  class inbox
+  {
+  private:
+    struct node
+    {
+      node* next;
+      T value;
+
+      node (const T& t) :
+	next (0),
+	value (t)
+      { }
+    };
+
+    node* volatile m_head;
+    inbox_signal m_signal;
+
+    // No copying.
+    inbox (const inbox&) { }
+    void operator= (const inbox&) { }
+
+    static void release (node* n) {
+      while (n != 0) {
+	node* next = n->next;
+	delete n;
+	n = next;
+      }
+    }
+
+  public:
+    inbox () :
+      m_head (0)
+    { }
+
+    ~inbox () {
+      release (m_head);
+    }
+
+    // The descriptor of the signal or -1 if it could not be created.
+    int get_fd () const {
+      return m_signal.get_fd ();
+    }
+
+    void post (const T& t) {
+      node* n = new node (t);
+      node* head = m_head;
+      for (;;) {
+	n->next = head;
+	node* const prev = __sync_val_compare_and_swap (&m_head, head, n);
+	if (prev == head) {
+	  break;
+	}
+	head = prev;
+      }
+
+      if (head == 0) {
+	// The consumer has taken everything before this value.
+	m_signal.signal ();
+      }
+    }
+
+    // Appends every posted value to values in the order they were posted.
+    void take (std::deque<T>& values) {
+      node* n = __sync_lock_test_and_set (&m_head, static_cast<node*> (0));
+      const size_t first = values.size ();
+      for (node* pos = n; pos != 0; pos = pos->next) {
+	values.push_back (pos->value);
+      }
+      // The stack is newest first.
+      std::reverse (values.begin () + first, values.end ());
+      release (n);
+    }
+
+    void clear () {
+      m_signal.clear ();
+    }
+  };
+
+  /*
+    Inbox Automaton
+
+    Delivers the values posted to an inbox<T>.
+    Each wakeup takes every value posted since the last one.
+    If receive_batch is bound, the values are delivered together as one vector.
+    Otherwise, they are delivered one at a time by receive.
+    The inbox is not drained again until the values have been delivered.
+  */
+  template <class T>
+  class inbox_automaton :
+    public automaton,
+    private observer
+  {
+  private:
+    enum state_t {
+      DRAIN,
+      READ_READY_WAIT,
+    };
+
+    inbox<T>* const m_inbox;
+    // A duplicate of the inbox's descriptor so the automaton can close its registration.
+    int m_fd;
+    state_t m_state;
+    std::deque<T> m_values;
+    int m_errno;
+    bool m_error_reported;
+
+    void schedule () const {
+      if (drain_precondition ()) {
+	ioa::schedule (&inbox_automaton::drain);
+      }
+      if (receive_precondition ()) {
+	ioa::schedule (&inbox_automaton::receive);
+      }
+      if (receive_batch_precondition ()) {
+	ioa::schedule (&inbox_automaton::receive_batch);
+      }
+      if (error_precondition ()) {
+	ioa::schedule (&inbox_automaton::error);
+      }
+    }
+
+    void observe (observable*) {
+      // A new binding might enable an output.
+      schedule ();
+    }
+
+  public:
+    inbox_automaton (inbox<T>* i) :
+      m_inbox (i),
+      m_fd (i->get_fd () != -1 ? dup (i->get_fd ()) : -1),
+      m_state (DRAIN),
+      m_errno (0),
+      m_error_reported (false)
+    {
+      add_observable (&receive);
+      add_observable (&receive_batch);
+      add_observable (&error);
+      if (m_fd == -1) {
+	m_errno = i->get_fd () != -1 ? errno : EBADF;
+      }
+      schedule ();
+    }
+
+    ~inbox_automaton () {
+      if (m_fd != -1) {
+	ioa::close (m_fd);
+      }
+    }
+
+  private:
+    bool drain_precondition () const {
+      return m_errno == 0 && m_state == DRAIN && m_values.empty ();
+    }
+
+    void drain_effect () {
+      // Clear before taking so a value posted after the take signals again.
+      m_inbox->clear ();
+      m_inbox->take (m_values);
+      if (m_values.empty ()) {
+	m_state = READ_READY_WAIT;
+	ioa::schedule_read_ready (&inbox_automaton::read_ready, m_fd);
+      }
+    }
+
+    void drain_schedule () const {
+      schedule ();
+    }
+
+    UP_INTERNAL (inbox_automaton, drain);
+
+    bool read_ready_precondition () const {
+      return m_state == READ_READY_WAIT;
+    }
+
+    void read_ready_effect () {
+      m_state = DRAIN;
+    }
+
+    void read_ready_schedule () const {
+      schedule ();
+    }
+
+    UP_INTERNAL (inbox_automaton, read_ready);
+
+    bool receive_precondition () const {
+      return !m_values.empty () &&
+	binding_count (&inbox_automaton::receive_batch) == 0 &&
+	binding_count (&inbox_automaton::receive) != 0;
+    }
+
+    T receive_effect () {
+      T retval = T ();
+      std::swap (retval, m_values.front ());
+      m_values.pop_front ();
+      return retval;
+    }
+
+    void receive_schedule () const {
+      schedule ();
+    }
+
+  public:
+    V_UP_OUTPUT (inbox_automaton, receive, T);
+
+  private:
+    bool receive_batch_precondition () const {
+      return !m_values.empty () && binding_count (&inbox_automaton::receive_batch) != 0;
+    }
+
+    std::vector<T> receive_batch_effect () {
+      std::vector<T> retval (m_values.begin (), m_values.end ());
+      m_values.clear ();
+      return retval;
+    }
+
+    void receive_batch_schedule () const {
+      schedule ();
+    }
+
+  public:
+    V_UP_OUTPUT (inbox_automaton, receive_batch, std::vector<T>);
+
+  private:
+    bool error_precondition () const {
+      return m_errno != 0 && !m_error_reported && binding_count (&inbox_automaton::error) != 0;
+    }
+
+    int error_effect () {
+      m_error_reported = true;
+      return m_errno;
+    }
+
+    void error_schedule () const {
+      schedule ();
+    }
+
+  public:
+    V_UP_OUTPUT (inbox_automaton, error, int);
+  };
+
+}
+
+#endif
@@ -140,6 +140,30 @@ namespace ioa {
 
       return 0;
     }
+
+    // Orders addresses by family, host, and port so they can be used as keys.
+    // Invalid addresses are equivalent.
+    bool operator< (const inet_address& o) const {
+      if (m_errno != 0 || o.m_errno != 0) {
+	return m_errno == 0 && o.m_errno != 0;
+      }
+      if (m_length != o.m_length) {
+	return m_length < o.m_length;
+      }
+      int r = 0;
+      switch (m_length) {
+      case sizeof (sockaddr_in):
+	r = memcmp (&m_addr4.sin_addr, &o.m_addr4.sin_addr, sizeof (in_addr));
+	break;
+      case sizeof (sockaddr_in6):
+	r = memcmp (&m_addr6.sin6_addr, &o.m_addr6.sin6_addr, sizeof (in6_addr));
+	break;
+      }
+      if (r != 0) {
+	return r < 0;
+      }
+      return port () < o.port ();
+    }
   };
 
   class inet_mreq
@@ -72,6 +72,9 @@ namespace ioa {
     virtual int execute_input_bound (input_executor_interface& exec) = 0;
     virtual int execute_output_unbound (output_executor_interface& exec) = 0;
     virtual int execute_input_unbound (input_executor_interface& exec) = 0;
+
+    // Delivering the values of a buffered binding.
+    virtual int execute_deliver (input_executor_interface& exec) = 0;
   };
 
 }
@@ -0,0 +1,201 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef __remote_automaton_hpp__
+#define __remote_automaton_hpp__
+
+#include <ioa/tcp_connection_automaton.hpp>
+#include <ioa/serialization.hpp>
+#include <deque>
+#include <errno.h>
+
+namespace ioa {
+
+  /*
+    Remote Binding Proxies
+
+    A remote_sender_automaton<T> and a remote_receiver_automaton<T> on opposite ends of a connection carry the values of one action between processes.
+    In the sending process, bind the output to the sender's send input.
+    In the receiving process, bind the receiver's receive output to the input.
+    The connection can be any stream socket handed to a tcp_connection_automaton, e.g., TCP loopback or a Unix domain socket.
+
+    Values are framed with serialization<T> (see <ioa/serialization.hpp>).
+    The sender has at most one write outstanding on the connection.
+    Values that arrive while a write is outstanding are appended to the next write so the per-value cost falls as the load increases.
+  */
+  template <class T>
+  class remote_sender_automaton :
+    public automaton
+  {
+  private:
+    handle_manager<remote_sender_automaton> m_self;
+    handle_manager<tcp_connection_automaton> m_connection;
+    std::string m_batch;
+    bool m_writing;
+
+    void schedule () const {
+      if (write_precondition ()) {
+	ioa::schedule (&remote_sender_automaton::write);
+      }
+    }
+
+  public:
+    remote_sender_automaton (const automaton_handle<tcp_connection_automaton>& connection) :
+      m_self (get_aid ()),
+      m_connection (connection),
+      m_writing (false)
+    {
+      make_binding_manager (this,
+			    &m_self, &remote_sender_automaton::write,
+			    &m_connection, &tcp_connection_automaton::send);
+      make_binding_manager (this,
+			    &m_connection, &tcp_connection_automaton::send_complete,
+			    &m_self, &remote_sender_automaton::write_complete);
+    }
+
+  private:
+    void send_effect (const T& t) {
+      write_frame (m_batch, t);
+    }
+
+    void send_schedule () const {
+      schedule ();
+    }
+
+  public:
+    V_UP_INPUT (remote_sender_automaton, send, T);
+
+  private:
+    bool write_precondition () const {
+      return !m_writing && !m_batch.empty () && binding_count (&remote_sender_automaton::write) != 0;
+    }
+
+    std::string write_effect () {
+      std::string retval;
+      retval.swap (m_batch);
+      m_writing = true;
+      return retval;
+    }
+
+    void write_schedule () const {
+      schedule ();
+    }
+
+    V_UP_OUTPUT (remote_sender_automaton, write, std::string);
+
+    void write_complete_effect () {
+      m_writing = false;
+    }
+
+    void write_complete_schedule () const {
+      schedule ();
+    }
+
+    UV_UP_INPUT (remote_sender_automaton, write_complete);
+  };
+
+  template <class T>
+  class remote_receiver_automaton :
+    public automaton
+  {
+  private:
+    handle_manager<remote_receiver_automaton> m_self;
+    handle_manager<tcp_connection_automaton> m_connection;
+    // Bytes of an incomplete frame.
+    std::string m_buffer;
+    std::deque<T> m_values;
+    int m_errno;
+    bool m_error_reported;
+
+    void schedule () const {
+      if (receive_precondition ()) {
+	ioa::schedule (&remote_receiver_automaton::receive);
+      }
+      if (error_precondition ()) {
+	ioa::schedule (&remote_receiver_automaton::error);
+      }
+    }
+
+  public:
+    remote_receiver_automaton (const automaton_handle<tcp_connection_automaton>& connection) :
+      m_self (get_aid ()),
+      m_connection (connection),
+      m_errno (0),
+      m_error_reported (false)
+    {
+      make_binding_manager (this,
+			    &m_connection, &tcp_connection_automaton::receive,
+			    &m_self, &remote_receiver_automaton::read);
+    }
+
+  private:
+    void read_effect (const std::string& buf) {
+      if (m_errno != 0) {
+	return;
+      }
+
+      m_buffer.append (buf);
+      if (!read_frames (m_buffer, m_values)) {
+	m_buffer.clear ();
+	m_errno = EPROTO;
+      }
+    }
+
+    void read_schedule () const {
+      schedule ();
+    }
+
+    V_UP_INPUT (remote_receiver_automaton, read, std::string);
+
+    bool receive_precondition () const {
+      return !m_values.empty () && binding_count (&remote_receiver_automaton::receive) != 0;
+    }
+
+    T receive_effect () {
+      T retval = T ();
+      std::swap (retval, m_values.front ());
+      m_values.pop_front ();
+      return retval;
+    }
+
+    void receive_schedule () const {
+      schedule ();
+    }
+
+  public:
+    V_UP_OUTPUT (remote_receiver_automaton, receive, T);
+
+  private:
+    bool error_precondition () const {
+      return m_errno != 0 && !m_error_reported && binding_count (&remote_receiver_automaton::error) != 0;
+    }
+
+    int error_effect () {
+      m_error_reported = true;
+      return m_errno;
+    }
+
+    void error_schedule () const {
+      schedule ();
+    }
+
+  public:
+    V_UP_OUTPUT (remote_receiver_automaton, error, int);
+  };
+
+}
+
+#endif
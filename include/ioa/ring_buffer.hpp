@@ -0,0 +1,100 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#ifndef __ring_buffer_hpp__
+#define __ring_buffer_hpp__
+
+#include <vector>
+#include <algorithm>
+#include <cassert>
+
+namespace ioa {
+
+  /*
+    A fixed-capacity FIFO whose storage is allocated once.
+    Elements are swapped out of the buffer so types that own memory, e.g., std::string, are handed off without a copy.
+    T must be default constructible.
+  */
+  template <class T>
+  class ring_buffer
+  {
+  private:
+    std::vector<T> m_buffer;
+    size_t m_head;
+    size_t m_size;
+
+  public:
+    explicit ring_buffer (const size_t capacity) :
+      m_buffer (capacity),
+      m_head (0),
+      m_size (0)
+    {
+      assert (capacity != 0);
+    }
+
+    size_t capacity () const {
+      return m_buffer.size ();
+    }
+
+    size_t size () const {
+      return m_size;
+    }
+
+    bool empty () const {
+      return m_size == 0;
+    }
+
+    bool full () const {
+      return m_size == m_buffer.size ();
+    }
+
+    const T& front () const {
+      assert (!empty ());
+      return m_buffer[m_head];
+    }
+
+    void push (const T& t) {
+      assert (!full ());
+      m_buffer[(m_head + m_size) % m_buffer.size ()] = t;
+      ++m_size;
+    }
+
+    // Push by swapping t into the buffer.  t is left with the previous contents of the slot.
+    void push_swap (T& t) {
+      assert (!full ());
+      std::swap (m_buffer[(m_head + m_size) % m_buffer.size ()], t);
+      ++m_size;
+    }
+
+    void pop () {
+      assert (!empty ());
+      m_buffer[m_head] = T ();
+      m_head = (m_head + 1) % m_buffer.size ();
+      --m_size;
+    }
+
+    // Pop by swapping the front into t.
+    void pop_swap (T& t) {
+      assert (!empty ());
+      std::swap (m_buffer[m_head], t);
+      m_buffer[m_head] = T ();
+      m_head = (m_head + 1) % m_buffer.size ();
+      --m_size;
+    }
+  };
+
+}
+
+#endif
@@ -63,6 +63,34 @@ namespace ioa {
     scheduler->schedule_after (make_action_runnable (automaton_handle<I> (get_aid ()), member_ptr, param), offset);
   }
   
+  template <class I, class M>
+  void schedule_every (M I::*member_ptr,
+		       const time& period) {
+    assert (scheduler != 0);
+    scheduler->schedule_every (make_action_runnable (automaton_handle<I> (get_aid ()), member_ptr), period);
+  }
+  
+  template <class I, class M>
+  void schedule_every (M I::*member_ptr,
+		       const typename M::parameter_type& param,
+		       const time& period) {
+    assert (scheduler != 0);
+    scheduler->schedule_every (make_action_runnable (automaton_handle<I> (get_aid ()), member_ptr, param), period);
+  }
+  
+  template <class I, class M>
+  void cancel_timer (M I::*member_ptr) {
+    assert (scheduler != 0);
+    scheduler->cancel_timer (make_action_runnable (automaton_handle<I> (get_aid ()), member_ptr));
+  }
+  
+  template <class I, class M>
+  void cancel_timer (M I::*member_ptr,
+		     const typename M::parameter_type& param) {
+    assert (scheduler != 0);
+    scheduler->cancel_timer (make_action_runnable (automaton_handle<I> (get_aid ()), member_ptr, param));
+  }
+  
   template <class I, class M>
   void schedule_read_ready (M I::*member_ptr,
 			    int fd) {
@@ -44,6 +44,12 @@ namespace ioa {
 
     virtual void schedule_after (action_runnable_interface*,
 				 const time&) = 0;
+
+    // The runnable identifies the timer:  an action has at most one.
+    virtual void schedule_every (action_runnable_interface*,
+				 const time&) = 0;
+
+    virtual void cancel_timer (action_runnable_interface*) = 0;
     
     virtual void schedule_read_ready (action_runnable_interface*,
 				      int fd) = 0;
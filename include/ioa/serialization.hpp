@@ -0,0 +1,210 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef __serialization_hpp__
+#define __serialization_hpp__
+
+#include <stdint.h>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ioa {
+
+  /*
+    Serialization Trait
+
+    serialization<T>::write appends the representation of a T to a string.
+    serialization<T>::read parses a T from [pos, end), advances pos past it, and returns false if the input is malformed or too short.
+    The representation uses the native byte order and sizes so it is only meant for processes on the same host.
+    Specialize serialization for other value types that are sent between processes.
+  */
+  template <class T>
+  struct serialization;
+
+  template <class T>
+  struct pod_serialization
+  {
+    static void write (std::string& out,
+		       const T& t) {
+      out.append (reinterpret_cast<const char*> (&t), sizeof (T));
+    }
+
+    static bool read (const char*& pos,
+		      const char* end,
+		      T& t) {
+      if (end - pos < static_cast<ptrdiff_t> (sizeof (T))) {
+	return false;
+      }
+      memcpy (&t, pos, sizeof (T));
+      pos += sizeof (T);
+      return true;
+    }
+  };
+
+  template <> struct serialization<bool> : public pod_serialization<bool> { };
+  template <> struct serialization<char> : public pod_serialization<char> { };
+  template <> struct serialization<signed char> : public pod_serialization<signed char> { };
+  template <> struct serialization<unsigned char> : public pod_serialization<unsigned char> { };
+  template <> struct serialization<short> : public pod_serialization<short> { };
+  template <> struct serialization<unsigned short> : public pod_serialization<unsigned short> { };
+  template <> struct serialization<int> : public pod_serialization<int> { };
+  template <> struct serialization<unsigned int> : public pod_serialization<unsigned int> { };
+  template <> struct serialization<long> : public pod_serialization<long> { };
+  template <> struct serialization<unsigned long> : public pod_serialization<unsigned long> { };
+  template <> struct serialization<long long> : public pod_serialization<long long> { };
+  template <> struct serialization<unsigned long long> : public pod_serialization<unsigned long long> { };
+  template <> struct serialization<float> : public pod_serialization<float> { };
+  template <> struct serialization<double> : public pod_serialization<double> { };
+
+  template <>
+  struct serialization<std::string>
+  {
+    static void write (std::string& out,
+		       const std::string& s) {
+      serialization<uint32_t>::write (out, s.size ());
+      out.append (s);
+    }
+
+    static bool read (const char*& pos,
+		      const char* end,
+		      std::string& s) {
+      uint32_t size;
+      if (!serialization<uint32_t>::read (pos, end, size) ||
+	  static_cast<uint32_t> (end - pos) < size) {
+	return false;
+      }
+      s.assign (pos, size);
+      pos += size;
+      return true;
+    }
+  };
+
+  template <class T, class U>
+  struct serialization<std::pair<T, U> >
+  {
+    static void write (std::string& out,
+		       const std::pair<T, U>& p) {
+      serialization<T>::write (out, p.first);
+      serialization<U>::write (out, p.second);
+    }
+
+    static bool read (const char*& pos,
+		      const char* end,
+		      std::pair<T, U>& p) {
+      return serialization<T>::read (pos, end, p.first) &&
+	serialization<U>::read (pos, end, p.second);
+    }
+  };
+
+  template <class T>
+  struct serialization<std::vector<T> >
+  {
+    static void write (std::string& out,
+		       const std::vector<T>& v) {
+      serialization<uint32_t>::write (out, v.size ());
+      for (typename std::vector<T>::const_iterator pos = v.begin ();
+	   pos != v.end ();
+	   ++pos) {
+	serialization<T>::write (out, *pos);
+      }
+    }
+
+    static bool read (const char*& pos,
+		      const char* end,
+		      std::vector<T>& v) {
+      uint32_t size;
+      if (!serialization<uint32_t>::read (pos, end, size)) {
+	return false;
+      }
+      v.clear ();
+      for (uint32_t i = 0; i < size; ++i) {
+	v.push_back (T ());
+	if (!serialization<T>::read (pos, end, v.back ())) {
+	  return false;
+	}
+      }
+      return true;
+    }
+  };
+
+  /*
+    A frame is a 32-bit length followed by a serialized value.
+    Frames let a receiver find value boundaries in a byte stream.
+  */
+  template <class T>
+  void write_frame (std::string& out,
+		    const T& t) {
+    const std::string::size_type start = out.size ();
+    out.append (sizeof (uint32_t), '\0');
+    serialization<T>::write (out, t);
+    const uint32_t length = out.size () - start - sizeof (uint32_t);
+    memcpy (&out[start], &length, sizeof (uint32_t));
+  }
+
+  // Returns the size of the complete frame beginning at pos or 0 if the frame is incomplete.
+  inline size_t frame_size (const char* pos,
+			    const char* end) {
+    uint32_t length;
+    if (!serialization<uint32_t>::read (pos, end, length) ||
+	static_cast<uint32_t> (end - pos) < length) {
+      return 0;
+    }
+    return sizeof (uint32_t) + length;
+  }
+
+  // Parses the complete frame beginning at pos and advances pos past it.
+  template <class T>
+  bool read_frame (const char*& pos,
+		   const char* end,
+		   T& t) {
+    const size_t size = frame_size (pos, end);
+    assert (size != 0);
+    const char* frame_end = pos + size;
+    pos += sizeof (uint32_t);
+    const bool retval = serialization<T>::read (pos, frame_end, t) && pos == frame_end;
+    pos = frame_end;
+    return retval;
+  }
+
+  /*
+    Parses the complete frames at the front of buffer, appends the values to values, and removes the frames from buffer.
+    The bytes of an incomplete frame are left in buffer.
+    Returns false if a frame is malformed.
+  */
+  template <class C>
+  bool read_frames (std::string& buffer,
+		    C& values) {
+    const char* const begin = buffer.data ();
+    const char* const end = begin + buffer.size ();
+    const char* pos = begin;
+    while (frame_size (pos, end) != 0) {
+      values.push_back (typename C::value_type ());
+      if (!read_frame (pos, end, values.back ())) {
+	values.pop_back ();
+	return false;
+      }
+    }
+    buffer.erase (0, pos - begin);
+    return true;
+  }
+
+}
+
+#endif
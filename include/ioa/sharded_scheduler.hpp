@@ -0,0 +1,88 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef __sharded_scheduler_hpp__
+#define __sharded_scheduler_hpp__
+
+#include <ioa/scheduler_interface.hpp>
+
+namespace ioa {
+
+  class sharded_scheduler_impl;
+
+  /*
+    A multi-threaded scheduler with one execution thread (shard) per processor and affinity by automaton.
+    An automaton is assigned to a shard when it is created and all of its local actions execute on that shard.
+    Shards hand actions to each other through single-producer/single-consumer queues; threads outside the scheduler share a locked queue per shard.
+    Bindings between automata on different shards are made buffered (see ioa::fifo) so the output and input are never executed together.
+    A shard count of 0 means one shard per available processor.
+    This is not a shared-nothing design.
+    There is one model, so every shard takes the model's shared_mutex and the per-automaton locks when it executes an action, and system actions, timers, and file descriptors are served by shared threads as in simple_scheduler.
+    Giving each shard its own model and binding state is not implemented (see TODO).
+  */
+  class sharded_scheduler :
+    public scheduler_interface
+  {
+  private:
+    sharded_scheduler_impl* m_impl;
+    
+    sharded_scheduler (const sharded_scheduler&) { }
+    void operator= (const sharded_scheduler&) { }
+
+  public:
+    sharded_scheduler (const int shards = 0);
+    ~sharded_scheduler ();
+    
+    aid_t get_current_aid ();
+    
+    size_t binding_count (const action_executor_interface&);
+    
+    void schedule (automaton::sys_create_type automaton::*ptr);
+    
+    void schedule (automaton::sys_bind_type automaton::*ptr);
+    
+    void schedule (automaton::sys_unbind_type automaton::*ptr);
+    
+    void schedule (automaton::sys_destroy_type automaton::*ptr);
+
+    void schedule (action_runnable_interface*);
+    
+    void schedule_after (action_runnable_interface*,
+			 const time&);
+
+    void schedule_every (action_runnable_interface*,
+			 const time&);
+
+    void cancel_timer (action_runnable_interface*);
+    
+    void schedule_read_ready (action_runnable_interface*,
+			      int fd);
+    
+    void schedule_write_ready (action_runnable_interface*,
+			       int fd);
+
+    void close (int fd);
+
+    void run (std::auto_ptr<allocator_interface> allocator);
+
+    void begin_sys_call () { }
+
+    void end_sys_call () { }
+  };
+
+}
+
+#endif
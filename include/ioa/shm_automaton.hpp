@@ -0,0 +1,280 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef __shm_automaton_hpp__
+#define __shm_automaton_hpp__
+
+#include <ioa/ioa.hpp>
+#include <ioa/shm_ring.hpp>
+#include <ioa/serialization.hpp>
+#include <deque>
+#include <errno.h>
+#include <unistd.h>
+
+namespace ioa {
+
+  /*
+    Shared Memory Binding Proxies
+
+    A shm_sender_automaton<T> and a shm_receiver_automaton<T> on opposite ends of a shared memory ring carry the values of one action between processes on the same host.
+    They play the same roles as remote_sender_automaton<T> and remote_receiver_automaton<T> (see <ioa/remote_automaton.hpp>) without a system call per write.
+    Each takes ownership of the descriptor it is given.
+    Create the ring with shm_ring::create before fork () or pass the descriptor over a Unix domain socket.
+
+    The sender writes frames directly into the ring.
+    When the ring is full, the sender keeps the remaining bytes and waits for the reader to signal the space eventfd.
+    The receiver drains everything in the ring when it has no undelivered values and waits on the data eventfd when the ring is empty.
+  */
+  template <class T>
+  class shm_sender_automaton :
+    public automaton
+  {
+  private:
+    shm_ring_descriptor m_descriptor;
+    shm_ring m_ring;
+    // Bytes that did not fit in the ring.
+    std::string m_pending;
+    bool m_waiting;
+    int m_errno;
+    bool m_error_reported;
+
+    void schedule () const {
+      if (error_precondition ()) {
+	ioa::schedule (&shm_sender_automaton::error);
+      }
+    }
+
+    void flush () {
+      while (!m_pending.empty ()) {
+	const ssize_t n = m_ring.write (m_pending.data (), m_pending.size ());
+	if (n == -1) {
+	  m_errno = errno;
+	  m_pending.clear ();
+	  break;
+	}
+	m_pending.erase (0, n);
+	if (n != 0 && m_ring.reader_waiting ()) {
+	  shm_ring::signal (m_descriptor.data_fd);
+	}
+	if (m_pending.empty () || m_waiting) {
+	  break;
+	}
+	if (m_ring.wait_for_space ()) {
+	  m_waiting = true;
+	  ioa::schedule_read_ready (&shm_sender_automaton::space_ready, m_descriptor.space_fd);
+	}
+      }
+    }
+
+  public:
+    shm_sender_automaton (const shm_ring_descriptor& descriptor) :
+      m_descriptor (descriptor),
+      m_waiting (false),
+      m_error_reported (false)
+    {
+      m_errno = m_ring.attach (m_descriptor.memory_fd);
+      ::close (m_descriptor.memory_fd);
+      m_descriptor.memory_fd = -1;
+      schedule ();
+    }
+
+    ~shm_sender_automaton () {
+      ioa::close (m_descriptor.data_fd);
+      ioa::close (m_descriptor.space_fd);
+    }
+
+  private:
+    void send_effect (const T& t) {
+      if (m_errno == 0) {
+	write_frame (m_pending, t);
+	flush ();
+      }
+    }
+
+    void send_schedule () const {
+      schedule ();
+    }
+
+  public:
+    V_UP_INPUT (shm_sender_automaton, send, T);
+
+  private:
+    bool space_ready_precondition () const {
+      return m_waiting;
+    }
+
+    void space_ready_effect () {
+      m_waiting = false;
+      shm_ring::clear (m_descriptor.space_fd);
+      flush ();
+    }
+
+    void space_ready_schedule () const {
+      schedule ();
+    }
+
+    UP_INTERNAL (shm_sender_automaton, space_ready);
+
+    bool error_precondition () const {
+      return m_errno != 0 && !m_error_reported && binding_count (&shm_sender_automaton::error) != 0;
+    }
+
+    int error_effect () {
+      m_error_reported = true;
+      return m_errno;
+    }
+
+    void error_schedule () const {
+      schedule ();
+    }
+
+  public:
+    V_UP_OUTPUT (shm_sender_automaton, error, int);
+  };
+
+  template <class T>
+  class shm_receiver_automaton :
+    public automaton
+  {
+  private:
+    enum state_t {
+      SCHEDULE_READ_READY,
+      READ_READY_WAIT,
+    };
+
+    shm_ring_descriptor m_descriptor;
+    shm_ring m_ring;
+    state_t m_state;
+    // Bytes of an incomplete frame.
+    std::string m_buffer;
+    std::deque<T> m_values;
+    int m_errno;
+    bool m_error_reported;
+
+    void schedule () const {
+      if (drain_precondition ()) {
+	ioa::schedule (&shm_receiver_automaton::drain);
+      }
+      if (receive_precondition ()) {
+	ioa::schedule (&shm_receiver_automaton::receive);
+      }
+      if (error_precondition ()) {
+	ioa::schedule (&shm_receiver_automaton::error);
+      }
+    }
+
+  public:
+    shm_receiver_automaton (const shm_ring_descriptor& descriptor) :
+      m_descriptor (descriptor),
+      m_state (SCHEDULE_READ_READY),
+      m_error_reported (false)
+    {
+      m_errno = m_ring.attach (m_descriptor.memory_fd);
+      ::close (m_descriptor.memory_fd);
+      m_descriptor.memory_fd = -1;
+      schedule ();
+    }
+
+    ~shm_receiver_automaton () {
+      ioa::close (m_descriptor.data_fd);
+      ioa::close (m_descriptor.space_fd);
+    }
+
+  private:
+    bool drain_precondition () const {
+      return m_errno == 0 && m_state == SCHEDULE_READ_READY && m_values.empty ();
+    }
+
+    void drain_effect () {
+      const ssize_t n = m_ring.read (m_buffer);
+      if (n == -1) {
+	m_buffer.clear ();
+	m_errno = errno;
+	return;
+      }
+      if (n != 0 && m_ring.writer_waiting ()) {
+	shm_ring::signal (m_descriptor.space_fd);
+      }
+      if (!read_frames (m_buffer, m_values)) {
+	m_buffer.clear ();
+	m_errno = EPROTO;
+      }
+      else if (m_values.empty () && m_ring.wait_for_data ()) {
+	m_state = READ_READY_WAIT;
+	ioa::schedule_read_ready (&shm_receiver_automaton::data_ready, m_descriptor.data_fd);
+      }
+    }
+
+    void drain_schedule () const {
+      schedule ();
+    }
+
+    UP_INTERNAL (shm_receiver_automaton, drain);
+
+    bool data_ready_precondition () const {
+      return m_state == READ_READY_WAIT;
+    }
+
+    void data_ready_effect () {
+      m_state = SCHEDULE_READ_READY;
+      shm_ring::clear (m_descriptor.data_fd);
+    }
+
+    void data_ready_schedule () const {
+      schedule ();
+    }
+
+    UP_INTERNAL (shm_receiver_automaton, data_ready);
+
+    bool receive_precondition () const {
+      return !m_values.empty () && binding_count (&shm_receiver_automaton::receive) != 0;
+    }
+
+    T receive_effect () {
+      T retval = T ();
+      std::swap (retval, m_values.front ());
+      m_values.pop_front ();
+      return retval;
+    }
+
+    void receive_schedule () const {
+      schedule ();
+    }
+
+  public:
+    V_UP_OUTPUT (shm_receiver_automaton, receive, T);
+
+  private:
+    bool error_precondition () const {
+      return m_errno != 0 && !m_error_reported && binding_count (&shm_receiver_automaton::error) != 0;
+    }
+
+    int error_effect () {
+      m_error_reported = true;
+      return m_errno;
+    }
+
+    void error_schedule () const {
+      schedule ();
+    }
+
+  public:
+    V_UP_OUTPUT (shm_receiver_automaton, error, int);
+  };
+
+}
+
+#endif
@@ -0,0 +1,109 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef __shm_ring_hpp__
+#define __shm_ring_hpp__
+
+#include <stdint.h>
+#include <cstddef>
+#include <string>
+#include <sys/types.h>
+
+namespace ioa {
+
+  /*
+    The file descriptors that name a shared memory ring.
+    They can be inherited across fork () or passed over a Unix domain socket.
+  */
+  struct shm_ring_descriptor
+  {
+    // The shared memory.
+    int memory_fd;
+    // Signaled by the writer when the reader is waiting for data.
+    int data_fd;
+    // Signaled by the reader when the writer is waiting for space.
+    int space_fd;
+
+    shm_ring_descriptor () :
+      memory_fd (-1),
+      data_fd (-1),
+      space_fd (-1)
+    { }
+  };
+
+  /*
+    Shared Memory Ring
+
+    A single-producer/single-consumer byte ring in memory shared by two processes.
+    The writer and reader do not make system calls unless the other side is waiting.
+    A side that finds the ring full (writer) or empty (reader) calls wait_for_space () or wait_for_data () and, if they return true, waits for its eventfd to become readable.
+    If the peer corrupts the counters in the shared header, read () and write () fail with EPROTO and the ring is detached.
+    Rings can only be created on Linux.
+  */
+  class shm_ring
+  {
+  private:
+    struct header;
+    header* m_header;
+    char* m_data;
+    size_t m_mapping_size;
+    size_t m_capacity;
+
+    shm_ring (const shm_ring&) { }
+    void operator= (const shm_ring&) { }
+
+  public:
+    // Creates a ring that holds capacity bytes.  Returns 0 or an errno value (ENOSYS if not on Linux).
+    static int create (const size_t capacity,
+		       shm_ring_descriptor& descriptor);
+    // Duplicates the file descriptors, e.g., so both ends can be used in one process.
+    static int duplicate (const shm_ring_descriptor& descriptor,
+			  shm_ring_descriptor& copy);
+    // Increments and clears an eventfd.
+    static void signal (const int fd);
+    static void clear (const int fd);
+
+    shm_ring ();
+    ~shm_ring ();
+
+    // Maps the ring.  Returns 0 or an errno value.
+    int attach (const int memory_fd);
+    // Unmaps the ring.
+    void detach ();
+    bool attached () const;
+    size_t capacity () const;
+
+    // Writer.
+    // Copies as many bytes as will fit and returns the number copied or -1 with errno set to EPROTO.
+    ssize_t write (const char* buf,
+		   const size_t size);
+    // Returns true if the reader was waiting and should be signaled.
+    bool reader_waiting ();
+    // Returns true if the writer should wait for space.
+    bool wait_for_space ();
+
+    // Reader.
+    // Appends all available bytes to buf and returns the number appended or -1 with errno set to EPROTO.
+    ssize_t read (std::string& buf);
+    // Returns true if the writer was waiting and should be signaled.
+    bool writer_waiting ();
+    // Returns true if the reader should wait for data.
+    bool wait_for_data ();
+  };
+
+}
+
+#endif
@@ -52,6 +52,11 @@ namespace ioa {
     
     void schedule_after (action_runnable_interface*,
 			 const time&);
+
+    void schedule_every (action_runnable_interface*,
+			 const time&);
+
+    void cancel_timer (action_runnable_interface*);
     
     void schedule_read_ready (action_runnable_interface*,
 			      int fd);
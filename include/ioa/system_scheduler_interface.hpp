@@ -72,6 +72,11 @@ namespace ioa {
     virtual void destroyed (const aid_t automaton,
 			    const destroyed_t,
 			    void* const key) = 0;
+
+    // Buffered bindings.
+    virtual void deliver (const input_executor_interface&) = 0;
+
+    virtual void drained (const output_executor_interface&) = 0;
   };
 
 }
@@ -18,12 +18,14 @@
 #define __tcp_acceptor_automaton_hpp__
 
 #include <ioa/tcp_connection_automaton.hpp>
+#include <map>
 #include <queue>
 
 namespace ioa {
 
   class tcp_acceptor_automaton :
-    public automaton
+    public automaton,
+    private observer
   {
   private:    
     enum state_t {
@@ -35,16 +37,34 @@ namespace ioa {
     int m_fd;
     int m_errno;
     bool m_error_reported;
+    const size_t m_accept_batch;
     handle_manager<tcp_acceptor_automaton> m_self;
 
     std::queue<automaton_handle<tcp_connection_automaton> > m_connection_queue;
     std::queue<int> m_fd_queue;
+    // Connections that have been given an fd through init and the bindings that are being made to them.
+    std::map<aid_t, std::pair<handle_manager<tcp_connection_automaton>, int> > m_handoffs;
+    std::map<binding_manager_interface*, aid_t> m_bindings;
 
     void schedule () const;
+    void observe (observable* o);
+    void recycle (const aid_t aid);
 
   public:
+    /*
+      Each readiness accepts connections until the backlog is empty or accept_batch connections have been accepted.
+      Connections are accepted non-blocking.
+      If reuse_port is true, the socket is bound with SO_REUSEPORT so several acceptors can listen on one port and the kernel spreads connections among them.
+      Under a multi-threaded scheduler such as sharded_scheduler, the acceptors run on different threads.
+
+      An accepted socket goes either to a tcp_connection_automaton given to accept or to the accepted output.
+      A connection given to accept is bound to init, receives the socket, and stays bound until it is destroyed.
+      The value of accepted owns the socket until a tcp_connection_automaton is created with it.
+    */
     tcp_acceptor_automaton (const ioa::inet_address& address,
-			    const int backlog = 5);
+			    const int backlog = 5,
+			    const bool reuse_port = false,
+			    const size_t accept_batch = 64);
     ~tcp_acceptor_automaton ();
 
   private:
@@ -54,6 +74,13 @@ namespace ioa {
   public:
     V_AP_INPUT (tcp_acceptor_automaton, accept, automaton_handle<tcp_connection_automaton>);
 
+  private:
+    bool accepted_precondition () const;
+    fd_transfer accepted_effect ();
+    void accepted_schedule () const;
+  public:
+    V_UP_OUTPUT (tcp_acceptor_automaton, accepted, fd_transfer);
+
   private:
     bool error_precondition () const;
     int error_effect ();
@@ -72,15 +99,15 @@ namespace ioa {
     void read_ready_schedule () const;
     UP_INTERNAL (tcp_acceptor_automaton, read_ready);
 
-    bool create_helper_precondition () const;
-    void create_helper_effect ();
-    void create_helper_schedule () const;
-    UP_INTERNAL (tcp_acceptor_automaton, create_helper);
+    bool handoff_precondition () const;
+    void handoff_effect ();
+    void handoff_schedule () const;
+    UP_INTERNAL (tcp_acceptor_automaton, handoff);
 
-    void done_effect (const int&,
-		      automaton_manager<connection_init_automaton>*);
-    void done_schedule (automaton_manager<connection_init_automaton>*) const;
-    V_P_INPUT (tcp_acceptor_automaton, done, int, automaton_manager<connection_init_automaton>*);
+    bool init_precondition (aid_t aid) const;
+    int init_effect (aid_t aid);
+    void init_schedule (aid_t) const;
+    V_AP_OUTPUT (tcp_acceptor_automaton, init, int);
   };
 
 }
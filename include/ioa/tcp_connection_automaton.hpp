@@ -19,19 +19,44 @@
 
 #include <ioa/ioa.hpp>
 #include <ioa/inet_address.hpp>
+#include <ioa/chunk.hpp>
+#include <ioa/fd_transfer.hpp>
 #include <string>
+#include <deque>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
 
 namespace ioa {
 
+  /*
+    A region of an open file to be sent with sendfile.
+    The file must stay open until the connection reports send_complete.
+  */
+  struct file_region
+  {
+    int fd;
+    off_t offset;
+    size_t length;
+
+    file_region (const int f = -1,
+		 const off_t o = 0,
+		 const size_t l = 0) :
+      fd (f),
+      offset (o),
+      length (l)
+    { }
+  };
+
   class tcp_connection_automaton :
-    public automaton
+    public automaton,
+    private observer
   {
   private:
     enum send_state_t {
       SEND_WAIT,
       SCHEDULE_WRITE_READY,
       WRITE_READY_WAIT,
-      SEND_COMPLETE_READY,
     };
 
     enum receive_state_t {
@@ -40,20 +65,115 @@ namespace ioa {
       RECEIVE_READY,
     };
 
+    enum send_kind_t {
+      SEND_COPY,
+      SEND_ZEROCOPY,
+      SEND_FILE,
+    };
+
+    struct send_item
+    {
+      send_kind_t kind;
+      std::string data;
+      file_region file;
+      // True if a zero-copy send refers to data.
+      bool pinned;
+
+      send_item (const send_kind_t k,
+		 const std::string& d,
+		 const file_region& f) :
+	kind (k),
+	data (d),
+	file (f),
+	pinned (false)
+      { }
+
+      size_t size () const {
+	return kind == SEND_FILE ? file.length : data.size ();
+      }
+    };
+
+    enum zerocopy_t {
+      ZEROCOPY_UNKNOWN,
+      ZEROCOPY_ENABLED,
+      ZEROCOPY_DISABLED,
+    };
+
     int m_fd;
     int m_errno;
     bool m_connected_reported;
     bool m_error_reported;
     send_state_t m_send_state;
-    std::string m_send_buffer;
-    ssize_t m_bytes_written;
+    // Items waiting to be written and the number of bytes of the first item that have been written.
+    std::deque<send_item> m_send_queue;
+    size_t m_send_offset;
+    size_t m_send_queued;
+    std::vector<struct iovec> m_send_iov;
+    bool m_send_complete;
+    const size_t m_high_watermark;
+    const size_t m_low_watermark;
+    bool m_congested;
+    bool m_congested_reported;
+    // Zero-copy buffers that have been written but not released by the kernel with the sequence number of the last send that used them.
+    zerocopy_t m_zerocopy;
+    uint32_t m_zerocopy_sequence;
+    std::deque<std::pair<uint32_t, std::string> > m_zerocopy_pending;
+    // A duplicate of m_fd so completions can be waited for independently of reads.
+    int m_errqueue_fd;
+    bool m_errqueue_wait;
     receive_state_t m_receive_state;
     std::string m_receive_buffer;
     char* m_buffer;
     ssize_t m_buffer_size;
+    // Chunked receive.
+    chunk_pool* m_pool;
+    const size_t m_chunk_count;
+    std::vector<chunk_buffer*> m_chunks;
+    std::vector<struct iovec> m_iov;
+    chunk_list m_receive_chunks;
+
+    void read_chunks ();
+    void update_congestion ();
+    void enqueue (const send_kind_t kind,
+		  const std::string& buf,
+		  const file_region& file);
+    ssize_t write_copy ();
+    ssize_t write_zerocopy ();
+    ssize_t write_file ();
+    void written (size_t bytes);
+    void reap_zerocopy ();
+    void update_send_complete ();
+    void adopt (const int fd);
+    void observe (observable* o);
 
   public:
-    tcp_connection_automaton ();
+    /*
+      If chunk_size is not zero, received bytes are read directly into chunk_count chunks of chunk_size bytes with one readv per read and delivered by receive_chunks.
+      Otherwise, they are copied into a string and delivered by receive.
+
+      Sent buffers are queued and written together with one writev per write.
+      Buffers of at least 16KB sent with send_zerocopy are written with MSG_ZEROCOPY where the socket supports it and held until the kernel reports that it no longer needs them.
+      A connection destroyed while the kernel holds its buffers leaves them and the socket to a background thread that closes the socket when they are released.
+      Smaller buffers and sockets without MSG_ZEROCOPY fall back to send.
+      Regions sent with send_file are written with sendfile.
+      send_complete indicates that the queue is empty and the kernel has released every zero-copy buffer.
+      Destroying the connection waits briefly for outstanding zero-copy buffers to be released and leaks any that are not.
+      backpressure reports true when the queue holds high_watermark bytes and false when it falls to low_watermark bytes.
+      The queue is not bounded so a sender that ignores backpressure can exhaust memory.
+    */
+    tcp_connection_automaton (const size_t chunk_size = 0,
+			      const size_t chunk_count = 8,
+			      const size_t high_watermark = 1 << 20,
+			      const size_t low_watermark = 1 << 18);
+    /*
+      Takes the connected socket in fd and starts connected without waiting for init.
+      Creating the connection with the fd from an acceptor or connector costs one create instead of a helper automaton and its bindings.
+    */
+    tcp_connection_automaton (const fd_transfer& fd,
+			      const size_t chunk_size = 0,
+			      const size_t chunk_count = 8,
+			      const size_t high_watermark = 1 << 20,
+			      const size_t low_watermark = 1 << 18);
     ~tcp_connection_automaton ();
 
   private:
@@ -65,6 +185,18 @@ namespace ioa {
   public:
     V_UP_INPUT (tcp_connection_automaton, send, std::string);
 
+  private:
+    void send_zerocopy_effect (const std::string& buf);
+    void send_zerocopy_schedule () const;
+  public:
+    V_UP_INPUT (tcp_connection_automaton, send_zerocopy, std::string);
+
+  private:
+    void send_file_effect (const file_region& file);
+    void send_file_schedule () const;
+  public:
+    V_UP_INPUT (tcp_connection_automaton, send_file, file_region);
+
   private:
     bool schedule_write_precondition () const;
     void schedule_write_effect ();
@@ -76,6 +208,12 @@ namespace ioa {
     void write_ready_schedule () const;
     UP_INTERNAL (tcp_connection_automaton, write_ready);
 
+    void wait_errqueue ();
+    bool errqueue_ready_precondition () const;
+    void errqueue_ready_effect ();
+    void errqueue_ready_schedule () const;
+    UP_INTERNAL (tcp_connection_automaton, errqueue_ready);
+
   private:
     bool send_complete_precondition () const;
     void send_complete_effect ();
@@ -83,6 +221,13 @@ namespace ioa {
   public:
     UV_UP_OUTPUT (tcp_connection_automaton, send_complete);
 
+  private:
+    bool backpressure_precondition () const;
+    bool backpressure_effect ();
+    void backpressure_schedule () const;
+  public:
+    V_UP_OUTPUT (tcp_connection_automaton, backpressure, bool);
+
   private:
     bool schedule_read_precondition () const;
     void schedule_read_effect ();
@@ -101,6 +246,13 @@ namespace ioa {
   public:
     V_UP_OUTPUT (tcp_connection_automaton, receive, std::string);
 
+  private:
+    bool receive_chunks_precondition () const;
+    chunk_list receive_chunks_effect ();
+    void receive_chunks_schedule () const;
+  public:
+    V_UP_OUTPUT (tcp_connection_automaton, receive_chunks, chunk_list);
+
   private:
     void init_effect (const int&);
     void init_schedule () const;
@@ -0,0 +1,182 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef __tcp_connection_pool_automaton_hpp__
+#define __tcp_connection_pool_automaton_hpp__
+
+#include <ioa/tcp_connector_automaton.hpp>
+#include <map>
+#include <deque>
+
+namespace ioa {
+
+  /*
+    TCP Connection Pool
+
+    Hands out connected tcp_connection_automata by address and keeps released ones open for the next request to the same address.
+    A client gives an address to acquire and receives a connection on acquired.
+    It binds to the connection, unbinds when it is done, and gives the handle back to release.
+    A connection should only be released once its responses have been received since the next client would receive them otherwise.
+    Only the client holding a connection can release it.
+    When a client unbinds, the connections leased to it but not yet delivered are pooled and the ones it received are destroyed since they may still have responses in flight.
+    Connections that fail while pooled are destroyed.
+    A failed connect is reported on error to the client that has waited longest for the address.
+    A connection whose automaton cannot be created is reported the same way as ECONNABORTED.
+  */
+  class tcp_connection_pool_automaton :
+    public automaton,
+    private observer
+  {
+  public:
+    struct connection_val {
+      inet_address address;
+      automaton_handle<tcp_connection_automaton> connection;
+
+      connection_val () { }
+
+      connection_val (const inet_address& a,
+		      const automaton_handle<tcp_connection_automaton>& c) :
+	address (a),
+	connection (c)
+      { }
+    };
+
+    struct error_val {
+      inet_address address;
+      int error;
+
+      error_val () :
+	error (0)
+      { }
+
+      error_val (const inet_address& a,
+		 const int e) :
+	address (a),
+	error (e)
+      { }
+    };
+
+  private:
+    enum connection_state_t {
+      CREATING,
+      IDLE,
+      LEASED,
+    };
+
+    struct entry {
+      inet_address address;
+      automaton_manager<tcp_connection_automaton>* manager;
+      connection_state_t state;
+      // The client holding a LEASED connection.
+      aid_t client;
+
+      entry (const inet_address& a,
+	     automaton_manager<tcp_connection_automaton>* m) :
+	address (a),
+	manager (m),
+	state (CREATING),
+	client (-1)
+      { }
+    };
+
+    handle_manager<tcp_connection_pool_automaton> m_self;
+    const time m_timeout;
+    const size_t m_retries;
+    const time m_backoff;
+    const size_t m_max_idle;
+    // Connectors and connections are identified by a key so their bindings can be made before they exist.
+    size_t m_next_key;
+    std::map<size_t, std::pair<inet_address, automaton_manager<tcp_connector_automaton>*> > m_connectors;
+    std::map<size_t, entry> m_connections;
+    std::map<aid_t, size_t> m_keys;
+    // Idle connections by address with the most recently released last.
+    std::map<inet_address, std::deque<size_t> > m_idle;
+    // Clients waiting for a connection by address and the number of connections being set up for them.
+    std::map<inet_address, std::deque<aid_t> > m_waiting;
+    std::map<inet_address, size_t> m_connecting;
+    std::map<aid_t, std::deque<connection_val> > m_acquired;
+    std::map<aid_t, std::deque<error_val> > m_errors;
+
+    void schedule () const;
+    void observe (observable* o);
+    void purge (const aid_t aid);
+    void connect (const inet_address& address);
+    void lease (const size_t key,
+		const aid_t aid);
+    void pool (const size_t key);
+    void remove (const size_t key);
+    void forget (const size_t key);
+    void fail (const inet_address& address,
+	       const int error);
+
+  public:
+    /*
+      Connects with a tcp_connector_automaton created with timeout, retries, and backoff.
+      Keeps up to max_idle released connections for each address.
+    */
+    tcp_connection_pool_automaton (const size_t max_idle = 8,
+				   const time& timeout = time (5, 0),
+				   const size_t retries = 2,
+				   const time& backoff = time (0, 100000));
+
+  private:
+    void acquire_effect (const inet_address& address,
+			 aid_t aid);
+    void acquire_schedule (aid_t) const;
+  public:
+    V_AP_INPUT (tcp_connection_pool_automaton, acquire, inet_address);
+
+  private:
+    bool acquired_precondition (aid_t aid) const;
+    connection_val acquired_effect (aid_t aid);
+    void acquired_schedule (aid_t) const;
+  public:
+    V_AP_OUTPUT (tcp_connection_pool_automaton, acquired, connection_val);
+
+  private:
+    void release_effect (const automaton_handle<tcp_connection_automaton>& connection,
+			 aid_t aid);
+    void release_schedule (aid_t) const;
+  public:
+    V_AP_INPUT (tcp_connection_pool_automaton, release, automaton_handle<tcp_connection_automaton>);
+
+  private:
+    bool error_precondition (aid_t aid) const;
+    error_val error_effect (aid_t aid);
+    void error_schedule (aid_t) const;
+  public:
+    V_AP_OUTPUT (tcp_connection_pool_automaton, error, error_val);
+
+  private:
+    void connected_effect (const fd_transfer& fd,
+			   size_t key);
+    void connected_schedule (size_t) const;
+    V_P_INPUT (tcp_connection_pool_automaton, connected, fd_transfer, size_t);
+
+    void connect_error_effect (const int& error,
+			       size_t key);
+    void connect_error_schedule (size_t) const;
+    V_P_INPUT (tcp_connection_pool_automaton, connect_error, int, size_t);
+
+    void connection_error_effect (const int& error,
+				  size_t key);
+    void connection_error_schedule (size_t) const;
+    V_P_INPUT (tcp_connection_pool_automaton, connection_error, int, size_t);
+  };
+
+}
+
+#endif
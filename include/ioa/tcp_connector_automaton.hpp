@@ -21,21 +21,54 @@
 
 namespace ioa {
   
+  /*
+    TCP Connector
+
+    Connects a non-blocking stream socket to an address.
+    A connect that has not completed within timeout fails with ETIMEDOUT; a zero timeout waits forever.
+    A failed connect is retried up to retries times after waiting backoff, which doubles after each retry.
+    The error of the last attempt is reported once the retries are used up.
+  */
   class tcp_connector_automaton :
-    public automaton
+    public automaton,
+    private observer
   {
   private:
     handle_manager<tcp_connector_automaton> m_self;
-    automaton_handle<tcp_connection_automaton> m_connection;
+    handle_manager<tcp_connection_automaton> m_connection;
+    const inet_address m_address;
+    const time m_timeout;
+    time m_deadline;
+    size_t m_retries;
+    time m_backoff;
     int m_fd;
+    bool m_connected;
+    bool m_retry_wait;
     int m_errno;
     bool m_error_reported;
 
     void schedule () const;
+    void observe (observable* o);
+    void attempt ();
+    void fail (const int error);
 
   public:
+    /*
+      Connects to address and hands the connected socket to connection through its init input.
+    */
+    tcp_connector_automaton (const inet_address& address,
+			     const automaton_handle<tcp_connection_automaton>& connection,
+			     const time& timeout = time (),
+			     const size_t retries = 0,
+			     const time& backoff = time (0, 100000));
+    /*
+      Connects to address and hands the connected socket out through connected.
+      Creating a tcp_connection_automaton with the value of connected is the cheapest way to set up a connection.
+    */
     tcp_connector_automaton (const inet_address& address,
-			     const automaton_handle<tcp_connection_automaton>& connection);
+			     const time& timeout = time (),
+			     const size_t retries = 0,
+			     const time& backoff = time (0, 100000));
     ~tcp_connector_automaton ();
 
   private:
@@ -45,15 +78,33 @@ namespace ioa {
   public:
     V_UP_OUTPUT (tcp_connector_automaton, error, int);
 
+  private:
+    bool connected_precondition () const;
+    fd_transfer connected_effect ();
+    void connected_schedule () const;
+  public:
+    V_UP_OUTPUT (tcp_connector_automaton, connected, fd_transfer);
+
   private:
     bool write_ready_precondition () const;
     void write_ready_effect ();
     void write_ready_schedule () const;
     UP_INTERNAL (tcp_connector_automaton, write_ready);
 
-    void done_effect (const int&);
-    void done_schedule () const;
-    V_UP_INPUT (tcp_connector_automaton, done, int);
+    bool timeout_precondition () const;
+    void timeout_effect ();
+    void timeout_schedule () const;
+    UP_INTERNAL (tcp_connector_automaton, timeout);
+
+    bool retry_precondition () const;
+    void retry_effect ();
+    void retry_schedule () const;
+    UP_INTERNAL (tcp_connector_automaton, retry);
+
+    bool init_precondition () const;
+    int init_effect ();
+    void init_schedule () const;
+    V_UP_OUTPUT (tcp_connector_automaton, init, int);
 
   };
 
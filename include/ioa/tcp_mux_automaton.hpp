@@ -0,0 +1,218 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef __tcp_mux_automaton_hpp__
+#define __tcp_mux_automaton_hpp__
+
+#include <ioa/ioa.hpp>
+#include <ioa/fd_transfer.hpp>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace ioa {
+
+  /*
+    TCP Multiplexer
+
+    Owns many connected sockets and multiplexes them over one set of actions.
+    Sockets are added through add, which can be bound to the accepted output of a tcp_acceptor_automaton or the connected output of a tcp_connector_automaton.
+    Each socket gets an id that is reported by opened and carried by the values of send, receive, disconnect, and error.
+    opened and the errors of a socket are only queued while they are bound so a server that ignores them does not accumulate them.
+    The sockets are watched with one epoll instance so the scheduler sees one fd no matter how many sockets there are.
+    A socket is closed and its id retired after error reports on it.
+    The end of a socket's stream is reported by closed and the socket stays open for writing until it is disconnected.
+    If closed is not bound, the socket is disconnected once its queued bytes are written.
+    backpressure reports true for a socket when high_watermark bytes are queued for it and false when they fall to low_watermark bytes.
+    Errors of the multiplexer itself are reported with id 0.
+  */
+  class tcp_mux_automaton :
+    public automaton
+  {
+  public:
+    typedef uint64_t connection_id;
+
+    struct message {
+      connection_id id;
+      std::string data;
+
+      message (const connection_id i = 0,
+	       const std::string& d = std::string ()) :
+	id (i),
+	data (d)
+      { }
+    };
+
+    struct error_val {
+      connection_id id;
+      int error;
+
+      error_val (const connection_id i = 0,
+		 const int e = 0) :
+	id (i),
+	error (e)
+      { }
+    };
+
+    struct backpressure_val {
+      connection_id id;
+      bool congested;
+
+      backpressure_val (const connection_id i = 0,
+			const bool c = false) :
+	id (i),
+	congested (c)
+      { }
+    };
+
+  private:
+    enum state_t {
+      SCHEDULE_READ_READY,
+      READ_READY_WAIT,
+    };
+
+    struct connection {
+      int fd;
+      // Bytes waiting to be written starting at offset.
+      std::string send_buffer;
+      size_t offset;
+      bool writing;
+      bool closing;
+      // The peer finished sending.
+      bool eof;
+      bool congested;
+
+      connection (const int f = -1) :
+	fd (f),
+	offset (0),
+	writing (false),
+	closing (false),
+	eof (false),
+	congested (false)
+      { }
+    };
+
+    state_t m_state;
+    int m_epoll;
+    int m_errno;
+    bool m_error_reported;
+    connection_id m_next_id;
+    std::map<connection_id, connection> m_connections;
+    // Space for struct epoll_event so this header does not need <sys/epoll.h>.
+    std::vector<char> m_events;
+    std::vector<char> m_buffer;
+    const size_t m_high_watermark;
+    const size_t m_low_watermark;
+    std::deque<connection_id> m_opened;
+    std::deque<message> m_receive_queue;
+    std::deque<error_val> m_error_queue;
+    std::deque<connection_id> m_closed;
+    std::deque<backpressure_val> m_backpressure_queue;
+
+    void schedule () const;
+    void watch (const connection_id id,
+		connection& c,
+		const bool writing);
+    void remove (const connection_id id,
+		 const int error);
+    void read_socket (const connection_id id,
+		      connection& c);
+    void write_socket (const connection_id id,
+		       connection& c);
+    void update_congestion (const connection_id id,
+			    connection& c);
+
+  public:
+    /*
+      Each readiness handles up to max_events sockets and reads up to buffer_size bytes from each readable socket.
+      The sockets are not read again until every received message has been delivered.
+    */
+    tcp_mux_automaton (const size_t max_events = 256,
+		       const size_t buffer_size = 65536,
+		       const size_t high_watermark = 1 << 20,
+		       const size_t low_watermark = 1 << 18);
+    ~tcp_mux_automaton ();
+
+  private:
+    void add_effect (const fd_transfer& fd);
+    void add_schedule () const;
+  public:
+    V_UP_INPUT (tcp_mux_automaton, add, fd_transfer);
+
+  private:
+    bool opened_precondition () const;
+    connection_id opened_effect ();
+    void opened_schedule () const;
+  public:
+    V_UP_OUTPUT (tcp_mux_automaton, opened, connection_id);
+
+  private:
+    void send_effect (const message& m);
+    void send_schedule () const;
+  public:
+    V_UP_INPUT (tcp_mux_automaton, send, message);
+
+  private:
+    void disconnect_effect (const connection_id& id);
+    void disconnect_schedule () const;
+  public:
+    V_UP_INPUT (tcp_mux_automaton, disconnect, connection_id);
+
+  private:
+    bool receive_precondition () const;
+    message receive_effect ();
+    void receive_schedule () const;
+  public:
+    V_UP_OUTPUT (tcp_mux_automaton, receive, message);
+
+  private:
+    bool closed_precondition () const;
+    connection_id closed_effect ();
+    void closed_schedule () const;
+  public:
+    V_UP_OUTPUT (tcp_mux_automaton, closed, connection_id);
+
+  private:
+    bool backpressure_precondition () const;
+    backpressure_val backpressure_effect ();
+    void backpressure_schedule () const;
+  public:
+    V_UP_OUTPUT (tcp_mux_automaton, backpressure, backpressure_val);
+
+  private:
+    bool error_precondition () const;
+    error_val error_effect ();
+    void error_schedule () const;
+  public:
+    V_UP_OUTPUT (tcp_mux_automaton, error, error_val);
+
+  private:
+    bool schedule_read_ready_precondition () const;
+    void schedule_read_ready_effect ();
+    void schedule_read_ready_schedule () const;
+    UP_INTERNAL (tcp_mux_automaton, schedule_read_ready);
+
+    bool read_ready_precondition () const;
+    void read_ready_effect ();
+    void read_ready_schedule () const;
+    UP_INTERNAL (tcp_mux_automaton, read_ready);
+  };
+
+}
+
+#endif
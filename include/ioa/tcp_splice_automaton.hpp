@@ -0,0 +1,142 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef __tcp_splice_automaton_hpp__
+#define __tcp_splice_automaton_hpp__
+
+#include <ioa/ioa.hpp>
+#include <ioa/fd_transfer.hpp>
+#include <stdint.h>
+
+namespace ioa {
+
+  /*
+    TCP Splice
+
+    Forwards bytes between two connected sockets in both directions without copying them to user space.
+    Each direction moves bytes from its source socket into a pipe and from the pipe to its destination socket with splice.
+    A direction stops reading when its pipe is full so a slow destination holds back its source.
+    When a source reaches the end of its stream and the pipe has drained, the destination is shut down for writing so half-closed connections are forwarded.
+    splice is Linux-only; elsewhere the automaton reports ENOSYS through error.
+  */
+  class tcp_splice_automaton :
+    public automaton,
+    private observer
+  {
+  public:
+    // The number of bytes written from a to b and from b to a.
+    struct bytes_val {
+      uint64_t forward;
+      uint64_t backward;
+
+      bytes_val (const uint64_t f = 0,
+		 const uint64_t b = 0) :
+	forward (f),
+	backward (b)
+      { }
+
+      bool operator!= (const bytes_val& o) const {
+	return forward != o.forward || backward != o.backward;
+      }
+    };
+
+  private:
+    enum direction_t {
+      FORWARD,
+      BACKWARD,
+      DIRECTION_COUNT,
+    };
+
+    struct direction
+    {
+      int source;
+      int destination;
+      int pipe[2];
+      size_t capacity;
+      size_t buffered;
+      // The pipe cannot take more bytes even though buffered is below capacity.
+      bool pipe_full;
+      bool read_wait;
+      bool write_wait;
+      bool eof;
+      bool shutdown;
+    };
+
+    int m_fd[2];
+    direction m_direction[DIRECTION_COUNT];
+    bytes_val m_bytes;
+    bytes_val m_bytes_reported;
+    bool m_closed_reported;
+    int m_errno;
+    bool m_error_reported;
+
+    void schedule () const;
+    void observe (observable* o);
+    void prepare (const int d,
+		  const size_t pipe_size);
+
+  public:
+    /*
+      Takes the connected sockets in a and b.
+      pipe_size bounds the bytes in flight in each direction.
+    */
+    tcp_splice_automaton (const fd_transfer& a,
+			  const fd_transfer& b,
+			  const size_t pipe_size = 1 << 16);
+    ~tcp_splice_automaton ();
+
+  private:
+    bool pump_precondition (int d) const;
+    void pump_effect (int d);
+    void pump_schedule (int) const;
+    P_INTERNAL (tcp_splice_automaton, pump, int);
+
+    bool read_ready_precondition (int d) const;
+    void read_ready_effect (int d);
+    void read_ready_schedule (int) const;
+    P_INTERNAL (tcp_splice_automaton, read_ready, int);
+
+    bool write_ready_precondition (int d) const;
+    void write_ready_effect (int d);
+    void write_ready_schedule (int) const;
+    P_INTERNAL (tcp_splice_automaton, write_ready, int);
+
+  private:
+    bool bytes_precondition () const;
+    bytes_val bytes_effect ();
+    void bytes_schedule () const;
+  public:
+    V_UP_OUTPUT (tcp_splice_automaton, bytes, bytes_val);
+
+  private:
+    bool closed_precondition () const;
+    void closed_effect ();
+    void closed_schedule () const;
+  public:
+    // Both directions have been forwarded to the end.
+    UV_UP_OUTPUT (tcp_splice_automaton, closed);
+
+  private:
+    bool error_precondition () const;
+    int error_effect ();
+    void error_schedule () const;
+  public:
+    V_UP_OUTPUT (tcp_splice_automaton, error, int);
+  };
+
+}
+
+#endif
@@ -18,21 +18,33 @@
 #define __time_hpp__
 
 #include <sys/time.h>
+#include <time.h>
+#include <stdint.h>
 
 // Class for representing time offsets.
 
+/*
+  A time is a signed count of nanoseconds.
+  Points in time returned by now are offsets from an arbitrary origin on a monotonic clock:  they are comparable with each other but not with the time of day.
+*/
+
 namespace ioa {
 
   class time
   {
+  public:
+    enum clock_source {
+      // clock_gettime (CLOCK_MONOTONIC).
+      MONOTONIC_CLOCK,
+      // The time stamp counter calibrated against the monotonic clock.
+      TSC_CLOCK,
+    };
+
   private:
-    // These should either both be positive or both be negative.
-    long m_sec;
-    long m_usec;
-    
-    void check ();
-    void normalize ();
-    long long compare (const time& o) const;
+    int64_t m_nsec;
+
+    static clock_source m_source;
+    static volatile int64_t m_coarse;
 
   public:
     time ();
@@ -40,8 +52,11 @@ namespace ioa {
 	  long usec);
     time (const time& o);
     time (const struct timeval& t);
+    time (const struct timespec& t);
+    static time from_nsec (int64_t nsec);
     long sec () const;
     long usec () const;
+    int64_t nsec () const;
     time& operator= (const time& o);
     time operator+ (const time& o) const;
     time operator- (const time& o) const;
@@ -54,7 +69,19 @@ namespace ioa {
     bool operator>= (const time& o) const;
     bool operator<= (const time& o) const;
     operator struct timeval () const;
+    operator struct timespec () const;
     static time now ();
+    // The latest value of refresh, which never goes backward.  Schedulers refresh when they wait for timers.
+    static time coarse ();
+    static time refresh ();
+    /*
+      Selects the source of now.
+      Selecting TSC_CLOCK fails if the processor does not have an invariant time stamp counter.
+      The counter is calibrated without blocking:  now reads the monotonic clock until 10 milliseconds after its first call.
+      Select before starting a scheduler.
+    */
+    static bool set_clock_source (clock_source source);
+    static clock_source get_clock_source ();
   };
 
 }
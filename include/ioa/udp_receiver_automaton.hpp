@@ -19,8 +19,12 @@
 
 #include <ioa/ioa.hpp>
 #include <ioa/inet_address.hpp>
+#include <ioa/chunk.hpp>
 #include <queue>
 #include <string>
+#include <vector>
+#include <stdint.h>
+#include <sys/socket.h>
 
 namespace ioa {
 
@@ -39,6 +43,19 @@ namespace ioa {
       { }
     };
 
+    struct datagram {
+      inet_address address;
+      chunk buffer;
+
+      datagram (const inet_address& a,
+		const chunk& b) :
+	address (a),
+	buffer (b)
+      { }
+    };
+
+    typedef std::vector<datagram> receive_batch_val;
+
   private:
     enum state_t {
       SCHEDULE_READ_READY,
@@ -52,15 +69,51 @@ namespace ioa {
     ssize_t m_buf_size;
     std::queue<receive_val> m_recv_queue;
     bool m_error_reported;
+    // Batched receive.
+    chunk_pool* m_pool;
+    const size_t m_batch_size;
+    std::vector<chunk_buffer*> m_chunks;
+    std::vector<inet_address> m_addresses;
+    std::vector<struct iovec> m_iov;
+#ifdef __linux__
+    typedef struct mmsghdr batch_msg;
+#else
+    // recvmmsg is Linux-only; elsewhere the batch is filled with one recvmsg per datagram.
+    struct batch_msg {
+      struct msghdr msg_hdr;
+      unsigned int msg_len;
+    };
+#endif
+    std::vector<batch_msg> m_msgs;
+    std::vector<char> m_control;
+    receive_batch_val m_recv_batch;
+    // Datagrams the kernel dropped because the receive buffer was full.
+    uint32_t m_drops;
+    uint32_t m_drops_reported;
 
   private:
-    void prepare_socket (const inet_address& address);
+    void prepare_socket (const inet_address& address,
+			 const int recv_buf_size);
+    void prepare_batch (const size_t datagram_size);
+    void read_batch ();
     void schedule () const;
 
   public:
-    udp_receiver_automaton (const inet_address& address);
+    /*
+      If batch_size is zero, each datagram is copied into a string and delivered by receive.
+      Otherwise, up to batch_size datagrams of at most datagram_size bytes are read with one recvmmsg per read into pooled chunks and delivered together by receive_batch.
+      Longer datagrams are truncated.
+      If recv_buf_size is not zero, it sets SO_RCVBUF.
+    */
+    udp_receiver_automaton (const inet_address& address,
+			    const size_t batch_size = 0,
+			    const size_t datagram_size = 2048,
+			    const int recv_buf_size = 0);
     udp_receiver_automaton (const inet_address& group_addr,
-			    const inet_address& local_addr);
+			    const inet_address& local_addr,
+			    const size_t batch_size = 0,
+			    const size_t datagram_size = 2048,
+			    const int recv_buf_size = 0);
     ~udp_receiver_automaton ();
 
   private:
@@ -70,6 +123,21 @@ namespace ioa {
   public:
     V_UP_OUTPUT (udp_receiver_automaton, receive, receive_val);
 
+  private:
+    bool receive_batch_precondition () const;
+    receive_batch_val receive_batch_effect ();
+    void receive_batch_schedule () const;
+  public:
+    V_UP_OUTPUT (udp_receiver_automaton, receive_batch, receive_batch_val);
+
+  private:
+    bool drops_precondition () const;
+    uint32_t drops_effect ();
+    void drops_schedule () const;
+  public:
+    // The number of datagrams dropped since the socket was opened.  Only reported in batched mode where SO_RXQ_OVFL is available.
+    V_UP_OUTPUT (udp_receiver_automaton, drops, uint32_t);
+
   private:
     bool error_precondition () const;
     int error_effect ();
@@ -20,7 +20,10 @@
 #include <ioa/ioa.hpp>
 #include <ioa/inet_address.hpp>
 #include <list>
+#include <map>
 #include <string>
+#include <vector>
+#include <stdint.h>
 
 namespace ioa {
 
@@ -59,21 +62,49 @@ namespace ioa {
     };
 
     std::list<std::pair<aid_t, send_arg> > m_send_queue;
-    std::set<aid_t> m_send_set; // Set of aids in send_queue.
+    std::map<aid_t, size_t> m_send_count; // Number of datagrams of each aid in send_queue.
     std::set<aid_t> m_complete_set;
+    const size_t m_window;
 
     state_t m_state;
     int m_fd;
     int m_errno;
     bool m_error_reported;
+    // Reused by each write.
+#ifdef __linux__
+    typedef struct mmsghdr batch_msg;
+#else
+    // sendmmsg is Linux-only; elsewhere the batch is written with one sendmsg per datagram.
+    struct batch_msg {
+      struct msghdr msg_hdr;
+      unsigned int msg_len;
+    };
+#endif
+    std::vector<batch_msg> m_msgs;
+    std::vector<struct iovec> m_iov;
+    std::vector<char> m_control;
+    std::vector<size_t> m_msg_count; // Number of queued datagrams in each message.
+    bool m_gso;
 
     void schedule () const;
     void observe (observable* o);
     void purge (const aid_t aid);
     void add_to_complete_set (const aid_t aid);
+    size_t prepare_messages ();
+    void complete_messages (const size_t count);
 
   public:
-    udp_sender_automaton (const size_t send_buf_size = 0);
+    /*
+      Each parameter may have up to window datagrams queued.
+      A send beyond the window is dropped.
+      send_complete occurs when every datagram sent by the parameter has been written so one send_complete may acknowledge several sends.
+      With a window of 1, a send is also dropped until the send_complete of the previous send has occurred.
+      With a larger window, a send is accepted while a send_complete is pending and that send_complete then waits for the new datagram as well.
+      Queued datagrams are written with one sendmmsg per write and consecutive datagrams of equal size to the same address are combined with UDP_SEGMENT where available.
+      If send_buf_size is not zero, it sets SO_SNDBUF.
+    */
+    udp_sender_automaton (const size_t send_buf_size = 0,
+			  const size_t window = 1);
     ~udp_sender_automaton ();
 
   private:
@@ -0,0 +1,87 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef __unix_acceptor_automaton_hpp__
+#define __unix_acceptor_automaton_hpp__
+
+#include <ioa/unix_connection_automaton.hpp>
+#include <queue>
+
+namespace ioa {
+
+  class unix_acceptor_automaton :
+    public automaton,
+    private observer
+  {
+  private:
+    enum state_t {
+      SCHEDULE_READ_READY,
+      READ_READY_WAIT,
+    };
+    unix_address m_address;
+    state_t m_state;
+    int m_fd;
+    int m_errno;
+    bool m_error_reported;
+    bool m_bound;
+    const size_t m_accept_batch;
+    std::queue<int> m_fd_queue;
+
+    void schedule () const;
+    void observe (observable* o);
+
+  public:
+    /*
+      Listens on address with a socket of type SOCK_STREAM or SOCK_SEQPACKET.
+      Each readiness accepts connections until the backlog is empty or accept_batch connections have been accepted.
+      The value of accepted owns the socket until a unix_connection_automaton is created with it.
+      A path in the file system is removed when the acceptor is destroyed but a stale path left by a process that exited without destroying its acceptor makes the bind fail with EADDRINUSE.
+    */
+    unix_acceptor_automaton (const unix_address& address,
+			     const int type = SOCK_STREAM,
+			     const int backlog = 5,
+			     const size_t accept_batch = 64);
+    ~unix_acceptor_automaton ();
+
+  private:
+    bool accepted_precondition () const;
+    fd_transfer accepted_effect ();
+    void accepted_schedule () const;
+  public:
+    V_UP_OUTPUT (unix_acceptor_automaton, accepted, fd_transfer);
+
+  private:
+    bool error_precondition () const;
+    int error_effect ();
+    void error_schedule () const;
+  public:
+    V_UP_OUTPUT (unix_acceptor_automaton, error, int);
+
+  private:
+    bool schedule_read_ready_precondition () const;
+    void schedule_read_ready_effect ();
+    void schedule_read_ready_schedule () const;
+    UP_INTERNAL (unix_acceptor_automaton, schedule_read_ready);
+
+    bool read_ready_precondition () const;
+    void read_ready_effect ();
+    void read_ready_schedule () const;
+    UP_INTERNAL (unix_acceptor_automaton, read_ready);
+  };
+
+}
+
+#endif
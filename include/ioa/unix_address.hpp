@@ -0,0 +1,111 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef __unix_address_hpp__
+#define __unix_address_hpp__
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <errno.h>
+
+namespace ioa {
+
+  /*
+    The address of a Unix domain socket.
+    A path that starts with a null character names a socket in the Linux abstract namespace, which has no file and disappears with the socket.
+    An empty path is an unnamed socket.
+  */
+  class unix_address
+  {
+  private:
+    int m_errno;
+    socklen_t m_length;
+    sockaddr_un m_addr;
+
+  public:
+    unix_address () :
+      m_errno (0),
+      m_length (offsetof (sockaddr_un, sun_path))
+    {
+      memset (&m_addr, 0, sizeof (sockaddr_un));
+      m_addr.sun_family = AF_UNIX;
+    }
+
+    unix_address (const std::string& path) :
+      m_errno (0)
+    {
+      memset (&m_addr, 0, sizeof (sockaddr_un));
+      m_addr.sun_family = AF_UNIX;
+      if (path.size () >= sizeof (m_addr.sun_path)) {
+	m_errno = ENAMETOOLONG;
+	m_length = offsetof (sockaddr_un, sun_path);
+      }
+      else {
+	memcpy (m_addr.sun_path, path.data (), path.size ());
+	// Abstract names are not null-terminated.
+	const bool abstract = !path.empty () && path[0] == '\0';
+	m_length = offsetof (sockaddr_un, sun_path) + path.size () + (abstract || path.empty () ? 0 : 1);
+      }
+    }
+
+    int get_errno () const {
+      return m_errno;
+    }
+
+    const sockaddr* get_sockaddr () const {
+      return reinterpret_cast<const sockaddr*> (&m_addr);
+    }
+
+    sockaddr* get_sockaddr_ptr () {
+      return reinterpret_cast<sockaddr*> (&m_addr);
+    }
+
+    socklen_t get_socklen () const {
+      return m_length;
+    }
+
+    // Makes room for the longest address so the pointers can be given to accept or recvfrom.
+    socklen_t* get_socklen_ptr () {
+      m_length = sizeof (sockaddr_un);
+      return &m_length;
+    }
+
+    bool is_abstract () const {
+      return m_length > offsetof (sockaddr_un, sun_path) && m_addr.sun_path[0] == '\0';
+    }
+
+    std::string path () const {
+      if (m_length <= offsetof (sockaddr_un, sun_path)) {
+	return std::string ();
+      }
+      const size_t size = m_length - offsetof (sockaddr_un, sun_path);
+      if (is_abstract ()) {
+	return std::string (m_addr.sun_path, size);
+      }
+      return std::string (m_addr.sun_path, strnlen (m_addr.sun_path, size));
+    }
+
+    bool operator< (const unix_address& o) const {
+      return path () < o.path ();
+    }
+  };
+
+}
+
+#endif
@@ -0,0 +1,156 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef __unix_connection_automaton_hpp__
+#define __unix_connection_automaton_hpp__
+
+#include <ioa/ioa.hpp>
+#include <ioa/unix_address.hpp>
+#include <ioa/fd_transfer.hpp>
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace ioa {
+
+  /*
+    Bytes and the file descriptors that travel with them as SCM_RIGHTS.
+    Sending a message gives the descriptors to the receiver.
+  */
+  struct unix_message
+  {
+    std::string data;
+    std::vector<fd_transfer> fds;
+
+    unix_message (const std::string& d = std::string ()) :
+      data (d)
+    { }
+
+    unix_message (const std::string& d,
+		  const fd_transfer& fd) :
+      data (d),
+      fds (1, fd)
+    { }
+  };
+
+  class unix_connection_automaton :
+    public automaton,
+    private observer
+  {
+  private:
+    enum send_state_t {
+      SEND_WAIT,
+      SCHEDULE_WRITE_READY,
+      WRITE_READY_WAIT,
+    };
+
+    enum receive_state_t {
+      SCHEDULE_READ_READY,
+      READ_READY_WAIT,
+      RECEIVE_READY,
+    };
+
+    struct send_item
+    {
+      std::string data;
+      std::vector<int> fds;
+    };
+
+    int m_fd;
+    int m_errno;
+    bool m_error_reported;
+    send_state_t m_send_state;
+    // Messages waiting to be written and the number of bytes of the first message that have been written.
+    std::deque<send_item> m_send_queue;
+    size_t m_send_offset;
+    bool m_send_complete;
+    receive_state_t m_receive_state;
+    std::vector<char> m_buffer;
+    const size_t m_max_fds;
+    unix_message m_receive_message;
+
+    void schedule () const;
+    void observe (observable* o);
+    void close_queued_fds ();
+
+  public:
+    /*
+      Takes the connected SOCK_STREAM or SOCK_SEQPACKET socket in fd.
+      Each read receives at most buffer_size bytes and max_fds descriptors.
+
+      The descriptors of a sent message are taken from their transfers when the message is sent and attached to its first byte.
+      A stream socket does not preserve message boundaries but the kernel never delivers bytes that follow descriptors in the same receive, so each received message carries the descriptors of the send that started it.
+      A message with descriptors but no bytes is sent as one zero byte since a stream socket drops the descriptors of an empty write.
+      On a SOCK_SEQPACKET socket, each send is received as one message and a message longer than buffer_size is truncated.
+    */
+    unix_connection_automaton (const fd_transfer& fd,
+			       const size_t buffer_size = 65536,
+			       const size_t max_fds = 16);
+    ~unix_connection_automaton ();
+
+  private:
+    void send_effect (const unix_message& message);
+    void send_schedule () const;
+  public:
+    V_UP_INPUT (unix_connection_automaton, send, unix_message);
+
+  private:
+    bool schedule_write_precondition () const;
+    void schedule_write_effect ();
+    void schedule_write_schedule () const;
+    UP_INTERNAL (unix_connection_automaton, schedule_write);
+
+    bool write_ready_precondition () const;
+    void write_ready_effect ();
+    void write_ready_schedule () const;
+    UP_INTERNAL (unix_connection_automaton, write_ready);
+
+  private:
+    bool send_complete_precondition () const;
+    void send_complete_effect ();
+    void send_complete_schedule () const;
+  public:
+    UV_UP_OUTPUT (unix_connection_automaton, send_complete);
+
+  private:
+    bool schedule_read_precondition () const;
+    void schedule_read_effect ();
+    void schedule_read_schedule () const;
+    UP_INTERNAL (unix_connection_automaton, schedule_read);
+
+    bool read_ready_precondition () const;
+    void read_ready_effect ();
+    void read_ready_schedule () const;
+    UP_INTERNAL (unix_connection_automaton, read_ready);
+
+  private:
+    bool receive_precondition () const;
+    unix_message receive_effect ();
+    void receive_schedule () const;
+  public:
+    V_UP_OUTPUT (unix_connection_automaton, receive, unix_message);
+
+  private:
+    bool error_precondition () const;
+    int error_effect ();
+    void error_schedule () const;
+  public:
+    V_UP_OUTPUT (unix_connection_automaton, error, int);
+  };
+
+}
+
+#endif
@@ -0,0 +1,89 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef __unix_connector_automaton_hpp__
+#define __unix_connector_automaton_hpp__
+
+#include <ioa/unix_connection_automaton.hpp>
+
+namespace ioa {
+  
+  /*
+    Unix Connector
+
+    Connects a non-blocking SOCK_STREAM or SOCK_SEQPACKET socket to an address.
+    A failed connect, including one refused because the listener's backlog is full or the listener does not exist yet, is retried up to retries times after waiting backoff, which doubles after each retry.
+    The error of the last attempt is reported once the retries are used up.
+  */
+  class unix_connector_automaton :
+    public automaton,
+    private observer
+  {
+  private:
+    const unix_address m_address;
+    const int m_type;
+    size_t m_retries;
+    time m_backoff;
+    int m_fd;
+    bool m_connected;
+    bool m_retry_wait;
+    int m_errno;
+    bool m_error_reported;
+
+    void schedule () const;
+    void observe (observable* o);
+    void attempt ();
+    void fail (const int error);
+
+  public:
+    /*
+      Connects to address and hands the connected socket out through connected.
+    */
+    unix_connector_automaton (const unix_address& address,
+			      const int type = SOCK_STREAM,
+			      const size_t retries = 0,
+			      const time& backoff = time (0, 100000));
+    ~unix_connector_automaton ();
+
+  private:
+    bool error_precondition () const;
+    int error_effect ();
+    void error_schedule () const;
+  public:
+    V_UP_OUTPUT (unix_connector_automaton, error, int);
+
+  private:
+    bool connected_precondition () const;
+    fd_transfer connected_effect ();
+    void connected_schedule () const;
+  public:
+    V_UP_OUTPUT (unix_connector_automaton, connected, fd_transfer);
+
+  private:
+    bool write_ready_precondition () const;
+    void write_ready_effect ();
+    void write_ready_schedule () const;
+    UP_INTERNAL (unix_connector_automaton, write_ready);
+
+    bool retry_precondition () const;
+    void retry_effect ();
+    void retry_schedule () const;
+    UP_INTERNAL (unix_connector_automaton, retry);
+  };
+
+}
+
+#endif
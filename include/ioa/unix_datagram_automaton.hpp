@@ -0,0 +1,156 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef __unix_datagram_automaton_hpp__
+#define __unix_datagram_automaton_hpp__
+
+#include <ioa/unix_connection_automaton.hpp>
+
+namespace ioa {
+
+  class unix_datagram_automaton :
+    public automaton,
+    private observer
+  {
+  public:
+    struct send_arg {
+      unix_address address;
+      unix_message message;
+
+      send_arg (const unix_address& a,
+		const unix_message& m) :
+	address (a),
+	message (m)
+      { }
+    };
+
+    struct receive_val {
+      unix_address address;
+      unix_message message;
+
+      receive_val () { }
+
+      receive_val (const unix_address& a,
+		   const unix_message& m) :
+	address (a),
+	message (m)
+      { }
+    };
+
+  private:
+    enum send_state_t {
+      SEND_WAIT,
+      SCHEDULE_WRITE_READY,
+      WRITE_READY_WAIT,
+    };
+
+    enum receive_state_t {
+      SCHEDULE_READ_READY,
+      READ_READY_WAIT,
+      RECEIVE_READY,
+    };
+
+    struct send_item
+    {
+      unix_address address;
+      std::string data;
+      std::vector<int> fds;
+    };
+
+    const unix_address m_address;
+    int m_fd;
+    int m_errno;
+    bool m_error_reported;
+    bool m_bound;
+    send_state_t m_send_state;
+    std::deque<send_item> m_send_queue;
+    bool m_send_complete;
+    receive_state_t m_receive_state;
+    std::vector<char> m_buffer;
+    const size_t m_max_fds;
+    receive_val m_receive_val;
+
+    void schedule () const;
+    void observe (observable* o);
+
+  public:
+    /*
+      Opens a SOCK_DGRAM socket bound to address or an unnamed socket that can only send if address is empty.
+      Each read receives one datagram of at most buffer_size bytes with at most max_fds descriptors.
+      Longer datagrams are truncated.
+
+      The descriptors of a sent message are taken from their transfers when the message is sent.
+      A datagram that cannot be delivered because its destination does not exist or is too long is dropped.
+      send_complete occurs when every queued datagram has been written.
+      A path in the file system is removed when the automaton is destroyed.
+    */
+    unix_datagram_automaton (const unix_address& address = unix_address (),
+			     const size_t buffer_size = 65536,
+			     const size_t max_fds = 16);
+    ~unix_datagram_automaton ();
+
+  private:
+    void send_effect (const send_arg& arg);
+    void send_schedule () const;
+  public:
+    V_UP_INPUT (unix_datagram_automaton, send, send_arg);
+
+  private:
+    bool send_complete_precondition () const;
+    void send_complete_effect ();
+    void send_complete_schedule () const;
+  public:
+    UV_UP_OUTPUT (unix_datagram_automaton, send_complete);
+
+  private:
+    bool receive_precondition () const;
+    receive_val receive_effect ();
+    void receive_schedule () const;
+  public:
+    V_UP_OUTPUT (unix_datagram_automaton, receive, receive_val);
+
+  private:
+    bool error_precondition () const;
+    int error_effect ();
+    void error_schedule () const;
+  public:
+    V_UP_OUTPUT (unix_datagram_automaton, error, int);
+
+  private:
+    bool schedule_write_ready_precondition () const;
+    void schedule_write_ready_effect ();
+    void schedule_write_ready_schedule () const;
+    UP_INTERNAL (unix_datagram_automaton, schedule_write_ready);
+
+    bool write_ready_precondition () const;
+    void write_ready_effect ();
+    void write_ready_schedule () const;
+    UP_INTERNAL (unix_datagram_automaton, write_ready);
+
+    bool schedule_read_ready_precondition () const;
+    void schedule_read_ready_effect ();
+    void schedule_read_ready_schedule () const;
+    UP_INTERNAL (unix_datagram_automaton, schedule_read_ready);
+
+    bool read_ready_precondition () const;
+    void read_ready_effect ();
+    void read_ready_schedule () const;
+    UP_INTERNAL (unix_datagram_automaton, read_ready);
+  };
+
+}
+
+#endif
@@ -38,16 +38,7 @@ namespace ioa {
 	 ++pos) {
       (*pos)->destroyed (AUTOMATON_DESTROYED_RESULT);
     }
-    for (std::set<system_automaton_manager_interface*>::const_iterator pos = m_destroy_send.begin ();
-	 pos != m_destroy_send.end ();
-	 ++pos) {
-      (*pos)->destroyed (AUTOMATON_DESTROYED_RESULT);
-    }
-    for (std::set<system_automaton_manager_interface*>::const_iterator pos = m_destroy_recv.begin ();
-	 pos != m_destroy_recv.end ();
-	 ++pos) {
-      (*pos)->destroyed (AUTOMATON_DESTROYED_RESULT);
-    }
+    // Helpers in m_destroy_send and m_destroy_recv are also in m_create_recv or m_create_done and have been signaled.
     for (std::set<system_binding_manager_interface*>::const_iterator pos = m_bind_send.begin ();
 	 pos != m_bind_send.end ();
 	 ++pos) {
@@ -63,16 +54,7 @@ namespace ioa {
 	 ++pos) {
       (*pos)->unbound (UNBOUND_RESULT);
     }
-    for (std::set<system_binding_manager_interface*>::const_iterator pos = m_unbind_send.begin ();
-	 pos != m_unbind_send.end ();
-	 ++pos) {
-      (*pos)->unbound (UNBOUND_RESULT);
-    }
-    for (std::set<system_binding_manager_interface*>::const_iterator pos = m_unbind_recv.begin ();
-	 pos != m_unbind_recv.end ();
-	 ++pos) {
-      (*pos)->unbound (UNBOUND_RESULT);
-    }
+    // Helpers in m_unbind_send and m_unbind_recv are also in m_bind_recv or m_bind_done and have been signaled.
   }
 
   void automaton::create (system_automaton_manager_interface* helper) {
@@ -62,6 +62,11 @@ namespace ioa {
     m_system_scheduler.destroyed (m_aid, AUTOMATON_DESTROYED_RESULT, key);
   }
 
+  void automaton_record::clear_children () {
+    // Used when the children are destroyed with the parent so nobody is told.
+    m_children.clear ();
+  }
+
   automaton_record* automaton_record::get_child (void* const key) const {
     std::map<void*, automaton_record*>::const_iterator pos = m_children.find (key);
     if (pos != m_children.end ()) {
@@ -72,13 +77,8 @@ namespace ioa {
     }
   }
 
-  std::pair<void*, automaton_record*> automaton_record::get_first_child () const {
-    if (m_children.empty ()) {
-      return std::pair<void*, automaton_record*> (0, 0);
-    }
-    else {
-      return *(m_children.begin ());
-    }
+  const std::map<void*, automaton_record*>& automaton_record::get_children () const {
+    return m_children;
   }
 
   void automaton_record::set_parent (void* const key,
@@ -107,4 +107,20 @@ namespace ioa {
     m_bind_keys.erase (key);
   }
 
+  void automaton_record::add_binding (output_executor_interface* binding) {
+    ++m_bindings[binding];
+  }
+
+  void automaton_record::remove_binding (output_executor_interface* binding) {
+    std::map<output_executor_interface*, size_t>::iterator pos = m_bindings.find (binding);
+    assert (pos != m_bindings.end ());
+    if (--pos->second == 0) {
+      m_bindings.erase (pos);
+    }
+  }
+
+  const std::map<output_executor_interface*, size_t>& automaton_record::get_bindings () const {
+    return m_bindings;
+  }
+
 }
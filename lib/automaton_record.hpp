@@ -28,6 +28,7 @@ namespace ioa {
 
   class system_scheduler_interface;
   class automaton;
+  class output_executor_interface;
 
   class automaton_record :
     public mutex
@@ -40,6 +41,9 @@ namespace ioa {
     void* m_key;
     automaton_record* m_parent;
     std::set<void*> m_bind_keys;
+    // The bindings involving this automaton as output, input, or binder.
+    // The count is the number of binding records that refer to this automaton.
+    std::map<output_executor_interface*, size_t> m_bindings;
     
   public:
     automaton_record (system_scheduler_interface&,
@@ -52,8 +56,9 @@ namespace ioa {
     void add_child (void* const key,
 		    automaton_record* child);
     void remove_child (void* const key);
+    void clear_children ();
     automaton_record* get_child (void* const key) const;
-    std::pair<void*, automaton_record*> get_first_child () const;
+    const std::map<void*, automaton_record*>& get_children () const;
     void set_parent (void* const key,
 		     automaton_record* parent);
     void* get_key () const;
@@ -61,6 +66,9 @@ namespace ioa {
     bool bind_key_exists (void* const key) const;
     void add_bind_key (void* const key);
     void remove_bind_key (void* const key);
+    void add_binding (output_executor_interface* binding);
+    void remove_binding (output_executor_interface* binding);
+    const std::map<output_executor_interface*, size_t>& get_bindings () const;
   };
   
 }
@@ -0,0 +1,97 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <ioa/chunk.hpp>
+
+#include "lock.hpp"
+
+#include <cassert>
+
+namespace ioa {
+
+  void release_chunk_buffer (chunk_buffer* buffer) {
+    if (__sync_sub_and_fetch (&buffer->refs, 1) == 0) {
+      buffer->pool->recycle (buffer);
+    }
+  }
+
+  chunk_pool::chunk_pool (const size_t chunk_size,
+			  const size_t max_free) :
+    m_chunk_size (chunk_size),
+    m_max_free (max_free),
+    m_refs (1)
+  {
+    assert (m_chunk_size != 0);
+  }
+
+  chunk_pool::~chunk_pool () {
+    for (std::vector<chunk_buffer*>::const_iterator pos = m_free.begin ();
+	 pos != m_free.end ();
+	 ++pos) {
+      delete[] reinterpret_cast<char*> (*pos);
+    }
+  }
+
+  void chunk_pool::release () {
+    if (__sync_sub_and_fetch (&m_refs, 1) == 0) {
+      delete this;
+    }
+  }
+
+  size_t chunk_pool::chunk_size () const {
+    return m_chunk_size;
+  }
+
+  chunk_buffer* chunk_pool::allocate () {
+    __sync_add_and_fetch (&m_refs, 1);
+
+    chunk_buffer* buffer = 0;
+    {
+      lock lock (m_mutex);
+      if (!m_free.empty ()) {
+	buffer = m_free.back ();
+	m_free.pop_back ();
+      }
+    }
+
+    if (buffer == 0) {
+      // The header and the data are allocated together.
+      char* block = new char[sizeof (chunk_buffer) + m_chunk_size];
+      buffer = reinterpret_cast<chunk_buffer*> (block);
+      buffer->pool = this;
+      buffer->data = block + sizeof (chunk_buffer);
+    }
+
+    buffer->refs = 1;
+    return buffer;
+  }
+
+  void chunk_pool::recycle (chunk_buffer* buffer) {
+    bool keep;
+    {
+      lock lock (m_mutex);
+      keep = m_free.size () < m_max_free;
+      if (keep) {
+	m_free.push_back (buffer);
+      }
+    }
+    if (!keep) {
+      delete[] reinterpret_cast<char*> (buffer);
+    }
+    release ();
+  }
+
+}
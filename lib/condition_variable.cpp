@@ -50,4 +50,11 @@ namespace ioa {
     assert (r == 0);
   }
 
+  void condition_variable::notify_all () {
+    BEGIN_SYS_CALL;
+    int r = pthread_cond_broadcast (&m_cond);
+    END_SYS_CALL;
+    assert (r == 0);
+  }
+
 }
@@ -33,6 +33,7 @@ namespace ioa {
     ~condition_variable ();
     void wait (lock& lock);
     void notify_one ();
+    void notify_all ();
   };
 
 }
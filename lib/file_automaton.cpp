@@ -0,0 +1,620 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <ioa/file_automaton.hpp>
+
+#include "thread.hpp"
+#include "lock.hpp"
+#include "condition_variable.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+namespace ioa {
+
+  /*
+    The state shared by a file_automaton and its I/O threads.
+    Requests are taken in order but may finish in any order, except that an fsync is not taken until the requests before it have finished.
+    Each finished request signals signal_fd so the automaton can collect the result from event_fd.
+    Both are the same eventfd on Linux and the two ends of a pipe elsewhere.
+  */
+  class file_io
+  {
+  public:
+    enum kind_t {
+      READ,
+      WRITE,
+      FSYNC,
+      STREAM,
+    };
+
+    struct request {
+      kind_t kind;
+      aid_t aid;
+      off_t offset;
+      size_t length;
+      std::string data;
+
+      request (const kind_t k = READ,
+	       const aid_t a = -1,
+	       const off_t o = 0,
+	       const size_t l = 0,
+	       const std::string& d = std::string ()) :
+	kind (k),
+	aid (a),
+	offset (o),
+	length (l),
+	data (d)
+      { }
+    };
+
+    struct result {
+      kind_t kind;
+      aid_t aid;
+      off_t offset;
+      // Bytes read or written.
+      size_t length;
+      chunk_list data;
+      int error;
+
+      result (const request& r) :
+	kind (r.kind),
+	aid (r.aid),
+	offset (r.offset),
+	length (0),
+	error (0)
+      { }
+    };
+
+    const int fd;
+    const int event_fd;
+    const int signal_fd;
+
+  private:
+    chunk_pool* m_pool;
+    mutex m_mutex;
+    condition_variable m_cond;
+    std::deque<request> m_requests;
+    std::deque<result> m_results;
+    size_t m_active;
+    bool m_stop;
+    std::vector<thread*> m_threads;
+
+    file_io (const file_io&) : fd (-1), event_fd (-1), signal_fd (-1) { }
+    void operator= (const file_io&) { }
+
+    void run ();
+    void read (const request& r,
+	       result& res);
+    void write (const request& r,
+		result& res);
+
+  public:
+    file_io (const int f,
+	     const int e,
+	     const int s,
+	     const size_t chunk_size,
+	     const size_t threads) :
+      fd (f),
+      event_fd (e),
+      signal_fd (s),
+      m_pool (new chunk_pool (chunk_size)),
+      m_active (0),
+      m_stop (false)
+    {
+      for (size_t i = 0; i < threads; ++i) {
+	m_threads.push_back (new thread (*this, &file_io::run));
+      }
+    }
+
+    // Waits for the requests being performed and drops the rest.
+    ~file_io () {
+      {
+	lock l (m_mutex);
+	m_stop = true;
+	m_cond.notify_all ();
+      }
+      for (std::vector<thread*>::iterator pos = m_threads.begin ();
+	   pos != m_threads.end ();
+	   ++pos) {
+	(*pos)->join ();
+	delete *pos;
+      }
+      m_results.clear ();
+      m_pool->release ();
+      ::close (fd);
+    }
+
+    void submit (const request& r) {
+      lock l (m_mutex);
+      m_requests.push_back (r);
+      m_cond.notify_one ();
+    }
+
+    void collect (std::deque<result>& results) {
+      lock l (m_mutex);
+      results.swap (m_results);
+    }
+  };
+
+  void file_io::run () {
+    for (;;) {
+      request r;
+      {
+	lock l (m_mutex);
+	while (!m_stop &&
+	       (m_requests.empty () ||
+		(m_requests.front ().kind == FSYNC && m_active != 0))) {
+	  m_cond.wait (l);
+	}
+	if (m_stop) {
+	  return;
+	}
+	r = m_requests.front ();
+	m_requests.pop_front ();
+	++m_active;
+      }
+
+      result res (r);
+      switch (r.kind) {
+      case READ:
+      case STREAM:
+	read (r, res);
+	break;
+      case WRITE:
+	write (r, res);
+	break;
+      case FSYNC:
+	if (::fsync (fd) == -1) {
+	  res.error = errno;
+	}
+	break;
+      }
+
+      {
+	lock l (m_mutex);
+	--m_active;
+	m_results.push_back (res);
+	if (m_active == 0) {
+	  // Release a waiting fsync.
+	  m_cond.notify_all ();
+	}
+      }
+
+      const uint64_t one = 1;
+      ::write (signal_fd, &one, sizeof (one));
+    }
+  }
+
+  void file_io::read (const request& r,
+		      result& res) {
+    off_t offset = r.offset;
+    size_t remaining = r.length;
+    while (remaining != 0) {
+      chunk_buffer* buffer = m_pool->allocate ();
+      const size_t want = std::min (remaining, m_pool->chunk_size ());
+      size_t got = 0;
+      while (got != want) {
+	const ssize_t bytes_read = pread (fd, buffer->data + got, want - got, offset + got);
+	if (bytes_read > 0) {
+	  got += bytes_read;
+	}
+	else if (bytes_read == -1 && errno == EINTR) {
+	  continue;
+	}
+	else {
+	  if (bytes_read == -1) {
+	    res.error = errno;
+	  }
+	  break;
+	}
+      }
+
+      if (got == 0) {
+	release_chunk_buffer (buffer);
+	break;
+      }
+      res.data.push_back (chunk (buffer, got));
+      res.length += got;
+      offset += got;
+      remaining -= got;
+      if (got != want) {
+	// End of file or error.
+	break;
+      }
+    }
+  }
+
+  void file_io::write (const request& r,
+		       result& res) {
+    while (res.length != r.data.size ()) {
+      const ssize_t bytes_written = pwrite (fd, r.data.data () + res.length, r.data.size () - res.length, r.offset + res.length);
+      if (bytes_written >= 0) {
+	res.length += bytes_written;
+      }
+      else if (errno != EINTR) {
+	res.error = errno;
+	break;
+      }
+    }
+  }
+
+  // Fills fds with the read and write ends of a non-blocking completion channel.
+  static int make_event_fd (int fds[2]) {
+#ifdef __linux__
+    fds[0] = fds[1] = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+    return fds[0];
+#else
+    if (pipe (fds) == -1) {
+      return -1;
+    }
+    for (int i = 0; i < 2; ++i) {
+      fcntl (fds[i], F_SETFL, O_NONBLOCK);
+      fcntl (fds[i], F_SETFD, FD_CLOEXEC);
+    }
+    return 0;
+#endif
+  }
+
+  file_automaton::file_automaton (const std::string& path,
+				  const int flags,
+				  const mode_t mode,
+				  const size_t threads,
+				  const size_t chunk_size,
+				  const size_t readahead) :
+    m_io (0),
+    m_chunk_size (std::max (chunk_size, static_cast<size_t> (1))),
+    m_readahead (std::max (readahead, static_cast<size_t> (1))),
+    m_errno (0),
+    m_error_reported (false),
+    m_outstanding (0),
+    m_read_ready_wait (false),
+    m_stream_next (0),
+    m_stream_offset (0),
+    m_stream_pending (0),
+    m_stream_eof (false),
+    m_stream_end_reported (false)
+  {
+    add_observable (&read_complete);
+    add_observable (&write_complete);
+    add_observable (&fsync_complete);
+    add_observable (&stream);
+
+    const int fd = open (path.c_str (), flags | O_CLOEXEC, mode);
+    if (fd == -1) {
+      m_errno = errno;
+    }
+    else {
+      int event_fd[2];
+      if (make_event_fd (event_fd) == -1) {
+	m_errno = errno;
+	::close (fd);
+      }
+      else {
+	m_io = new file_io (fd, event_fd[0], event_fd[1], m_chunk_size, std::max (threads, static_cast<size_t> (1)));
+      }
+    }
+
+    if (m_io == 0) {
+      // The stream is empty.
+      m_stream_eof = true;
+    }
+
+    schedule ();
+  }
+
+  file_automaton::~file_automaton () {
+    if (m_io != 0) {
+      const int event_fd = m_io->event_fd;
+      const int signal_fd = m_io->signal_fd;
+      delete m_io;
+      ioa::close (event_fd);
+      if (signal_fd != event_fd) {
+	::close (signal_fd);
+      }
+    }
+  }
+
+  void file_automaton::schedule () const {
+    for (std::map<aid_t, std::deque<read_val> >::const_iterator pos = m_read_complete.begin ();
+	 pos != m_read_complete.end ();
+	 ++pos) {
+      if (read_complete_precondition (pos->first)) {
+	ioa::schedule (&file_automaton::read_complete, pos->first);
+      }
+    }
+    for (std::map<aid_t, std::deque<write_val> >::const_iterator pos = m_write_complete.begin ();
+	 pos != m_write_complete.end ();
+	 ++pos) {
+      if (write_complete_precondition (pos->first)) {
+	ioa::schedule (&file_automaton::write_complete, pos->first);
+      }
+    }
+    for (std::map<aid_t, std::deque<int> >::const_iterator pos = m_fsync_complete.begin ();
+	 pos != m_fsync_complete.end ();
+	 ++pos) {
+      if (fsync_complete_precondition (pos->first)) {
+	ioa::schedule (&file_automaton::fsync_complete, pos->first);
+      }
+    }
+    if (stream_precondition ()) {
+      ioa::schedule (&file_automaton::stream);
+    }
+    if (error_precondition ()) {
+      ioa::schedule (&file_automaton::error);
+    }
+    if (schedule_read_ready_precondition ()) {
+      ioa::schedule (&file_automaton::schedule_read_ready);
+    }
+  }
+
+  void file_automaton::observe (observable* o) {
+    // Drop the results nobody will receive.
+    if (o == &read_complete && read_complete.recent_op == UNBOUND) {
+      m_read_complete.erase (read_complete.recent_parameter);
+    }
+    else if (o == &write_complete && write_complete.recent_op == UNBOUND) {
+      m_write_complete.erase (write_complete.recent_parameter);
+    }
+    else if (o == &fsync_complete && fsync_complete.recent_op == UNBOUND) {
+      m_fsync_complete.erase (fsync_complete.recent_parameter);
+    }
+    else if (o == &stream) {
+      fill_stream ();
+    }
+
+    schedule ();
+  }
+
+  void file_automaton::fill_stream () {
+    while (!m_stream_eof &&
+	   m_stream_pending + m_stream_buffer.size () < m_readahead &&
+	   binding_count (&file_automaton::stream) != 0) {
+      m_io->submit (file_io::request (file_io::STREAM, -1, m_stream_next, m_chunk_size));
+      ++m_outstanding;
+      ++m_stream_pending;
+      m_stream_next += m_chunk_size;
+    }
+  }
+
+  void file_automaton::collect () {
+    std::deque<file_io::result> results;
+    m_io->collect (results);
+    m_outstanding -= results.size ();
+
+    for (std::deque<file_io::result>::const_iterator pos = results.begin ();
+	 pos != results.end ();
+	 ++pos) {
+      switch (pos->kind) {
+      case file_io::READ:
+	if (binding_count (&file_automaton::read_complete, pos->aid) != 0) {
+	  read_val v;
+	  v.offset = pos->offset;
+	  v.data = pos->data;
+	  v.error = pos->error;
+	  m_read_complete[pos->aid].push_back (v);
+	}
+	break;
+      case file_io::WRITE:
+	if (binding_count (&file_automaton::write_complete, pos->aid) != 0) {
+	  write_val v;
+	  v.offset = pos->offset;
+	  v.length = pos->length;
+	  v.error = pos->error;
+	  m_write_complete[pos->aid].push_back (v);
+	}
+	break;
+      case file_io::FSYNC:
+	if (binding_count (&file_automaton::fsync_complete, pos->aid) != 0) {
+	  m_fsync_complete[pos->aid].push_back (pos->error);
+	}
+	break;
+      case file_io::STREAM:
+	--m_stream_pending;
+	if (!pos->data.empty ()) {
+	  m_stream_buffer.insert (std::make_pair (pos->offset, pos->data.front ()));
+	}
+	if (pos->error != 0 && m_errno == 0) {
+	  m_errno = pos->error;
+	}
+	if (pos->length != m_chunk_size) {
+	  // Stop reading ahead at the end of the file.
+	  m_stream_eof = true;
+	}
+	break;
+      }
+    }
+  }
+
+  void file_automaton::read_effect (const read_arg& arg,
+				    aid_t aid) {
+    if (m_io == 0) {
+      read_val v;
+      v.offset = arg.offset;
+      v.error = m_errno;
+      m_read_complete[aid].push_back (v);
+      return;
+    }
+    m_io->submit (file_io::request (file_io::READ, aid, arg.offset, arg.length));
+    ++m_outstanding;
+  }
+
+  void file_automaton::read_schedule (aid_t) const {
+    schedule ();
+  }
+
+  bool file_automaton::read_complete_precondition (aid_t aid) const {
+    std::map<aid_t, std::deque<read_val> >::const_iterator pos = m_read_complete.find (aid);
+    return pos != m_read_complete.end () && binding_count (&file_automaton::read_complete, aid) != 0;
+  }
+
+  file_automaton::read_val file_automaton::read_complete_effect (aid_t aid) {
+    std::map<aid_t, std::deque<read_val> >::iterator pos = m_read_complete.find (aid);
+    const read_val retval = pos->second.front ();
+    pos->second.pop_front ();
+    if (pos->second.empty ()) {
+      m_read_complete.erase (pos);
+    }
+    return retval;
+  }
+
+  void file_automaton::read_complete_schedule (aid_t) const {
+    schedule ();
+  }
+
+  void file_automaton::write_effect (const write_arg& arg,
+				     aid_t aid) {
+    if (m_io == 0) {
+      write_val v;
+      v.offset = arg.offset;
+      v.error = m_errno;
+      m_write_complete[aid].push_back (v);
+      return;
+    }
+    m_io->submit (file_io::request (file_io::WRITE, aid, arg.offset, arg.data.size (), arg.data));
+    ++m_outstanding;
+  }
+
+  void file_automaton::write_schedule (aid_t) const {
+    schedule ();
+  }
+
+  bool file_automaton::write_complete_precondition (aid_t aid) const {
+    std::map<aid_t, std::deque<write_val> >::const_iterator pos = m_write_complete.find (aid);
+    return pos != m_write_complete.end () && binding_count (&file_automaton::write_complete, aid) != 0;
+  }
+
+  file_automaton::write_val file_automaton::write_complete_effect (aid_t aid) {
+    std::map<aid_t, std::deque<write_val> >::iterator pos = m_write_complete.find (aid);
+    const write_val retval = pos->second.front ();
+    pos->second.pop_front ();
+    if (pos->second.empty ()) {
+      m_write_complete.erase (pos);
+    }
+    return retval;
+  }
+
+  void file_automaton::write_complete_schedule (aid_t) const {
+    schedule ();
+  }
+
+  void file_automaton::fsync_effect (aid_t aid) {
+    if (m_io == 0) {
+      m_fsync_complete[aid].push_back (m_errno);
+      return;
+    }
+    m_io->submit (file_io::request (file_io::FSYNC, aid));
+    ++m_outstanding;
+  }
+
+  void file_automaton::fsync_schedule (aid_t) const {
+    schedule ();
+  }
+
+  bool file_automaton::fsync_complete_precondition (aid_t aid) const {
+    std::map<aid_t, std::deque<int> >::const_iterator pos = m_fsync_complete.find (aid);
+    return pos != m_fsync_complete.end () && binding_count (&file_automaton::fsync_complete, aid) != 0;
+  }
+
+  int file_automaton::fsync_complete_effect (aid_t aid) {
+    std::map<aid_t, std::deque<int> >::iterator pos = m_fsync_complete.find (aid);
+    const int retval = pos->second.front ();
+    pos->second.pop_front ();
+    if (pos->second.empty ()) {
+      m_fsync_complete.erase (pos);
+    }
+    return retval;
+  }
+
+  void file_automaton::fsync_complete_schedule (aid_t) const {
+    schedule ();
+  }
+
+  bool file_automaton::stream_precondition () const {
+    return (m_stream_buffer.count (m_stream_offset) != 0 ||
+	    (m_stream_eof && m_stream_pending == 0 && !m_stream_end_reported)) &&
+      binding_count (&file_automaton::stream) != 0;
+  }
+
+  chunk file_automaton::stream_effect () {
+    std::map<off_t, chunk>::iterator pos = m_stream_buffer.find (m_stream_offset);
+    if (pos == m_stream_buffer.end ()) {
+      m_stream_end_reported = true;
+      return chunk ();
+    }
+
+    const chunk retval = pos->second;
+    m_stream_buffer.erase (pos);
+    m_stream_offset += m_chunk_size;
+    fill_stream ();
+    return retval;
+  }
+
+  void file_automaton::stream_schedule () const {
+    schedule ();
+  }
+
+  bool file_automaton::error_precondition () const {
+    return m_errno != 0 && !m_error_reported && binding_count (&file_automaton::error) != 0;
+  }
+
+  int file_automaton::error_effect () {
+    m_error_reported = true;
+    return m_errno;
+  }
+
+  void file_automaton::error_schedule () const {
+    schedule ();
+  }
+
+  bool file_automaton::schedule_read_ready_precondition () const {
+    return m_outstanding != 0 && !m_read_ready_wait;
+  }
+
+  void file_automaton::schedule_read_ready_effect () {
+    ioa::schedule_read_ready (&file_automaton::read_ready, m_io->event_fd);
+    m_read_ready_wait = true;
+  }
+
+  void file_automaton::schedule_read_ready_schedule () const {
+    schedule ();
+  }
+
+  bool file_automaton::read_ready_precondition () const {
+    return m_read_ready_wait;
+  }
+
+  void file_automaton::read_ready_effect () {
+    m_read_ready_wait = false;
+    // Drain the eventfd counter or every pending byte of the pipe.
+    char buf[64];
+    while (::read (m_io->event_fd, buf, sizeof (buf)) > 0) { }
+    collect ();
+    fill_stream ();
+  }
+
+  void file_automaton::read_ready_schedule () const {
+    schedule ();
+  }
+
+}
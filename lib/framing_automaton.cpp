@@ -0,0 +1,324 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <ioa/framing_automaton.hpp>
+
+#include <arpa/inet.h>
+#include <cstring>
+#include <errno.h>
+#include <stdint.h>
+
+namespace ioa {
+
+  // Received strings are packed into chunks of this size.
+  static const size_t COPY_CHUNK_SIZE = 65536;
+
+  void framing_automaton::schedule () const {
+    if (message_precondition ()) {
+      ioa::schedule (&framing_automaton::message);
+    }
+    if (send_precondition ()) {
+      ioa::schedule (&framing_automaton::send);
+    }
+    if (error_precondition ()) {
+      ioa::schedule (&framing_automaton::error);
+    }
+  }
+
+  void framing_automaton::observe (observable*) {
+    // A new binding might enable an output.
+    schedule ();
+  }
+
+  framing_automaton::framing_automaton (const size_t max_frame) :
+    m_pool (new chunk_pool (COPY_CHUNK_SIZE)),
+    m_max_frame (max_frame),
+    m_copy_used (0),
+    m_pending_size (0),
+    m_scan_index (0),
+    m_scan_offset (0),
+    m_scanned (0),
+    m_matched (0),
+    m_errno (0),
+    m_error_reported (false)
+  {
+    add_observable (&message);
+    add_observable (&send);
+    add_observable (&error);
+  }
+
+  framing_automaton::framing_automaton (const std::string& delimiter,
+					const size_t max_frame) :
+    m_pool (new chunk_pool (COPY_CHUNK_SIZE)),
+    m_delimiter (delimiter),
+    m_failure (delimiter.size (), 0),
+    m_max_frame (max_frame),
+    m_copy_used (0),
+    m_pending_size (0),
+    m_scan_index (0),
+    m_scan_offset (0),
+    m_scanned (0),
+    m_matched (0),
+    m_errno (0),
+    m_error_reported (false)
+  {
+    add_observable (&message);
+    add_observable (&send);
+    add_observable (&error);
+
+    if (m_delimiter.empty ()) {
+      m_errno = EINVAL;
+    }
+
+    // m_failure[i] is the length of the longest proper prefix of the delimiter that is also a suffix of its first i + 1 bytes.
+    for (size_t i = 1, k = 0; i < m_delimiter.size (); ++i) {
+      while (k != 0 && m_delimiter[i] != m_delimiter[k]) {
+	k = m_failure[k - 1];
+      }
+      if (m_delimiter[i] == m_delimiter[k]) {
+	++k;
+      }
+      m_failure[i] = k;
+    }
+  }
+
+  framing_automaton::~framing_automaton () {
+    // Outstanding chunks hold their own references.
+    m_pool->release ();
+  }
+
+  std::string framing_automaton::str (const chunk_list& message) {
+    size_t size = 0;
+    for (chunk_list::const_iterator pos = message.begin (); pos != message.end (); ++pos) {
+      size += pos->size ();
+    }
+    std::string retval;
+    retval.reserve (size);
+    for (chunk_list::const_iterator pos = message.begin (); pos != message.end (); ++pos) {
+      retval.append (pos->data (), pos->size ());
+    }
+    return retval;
+  }
+
+  void framing_automaton::append (const chunk& c) {
+    if (!c.empty ()) {
+      m_pending.push_back (c);
+      m_pending_size += c.size ();
+    }
+  }
+
+  void framing_automaton::consume (size_t size,
+				   chunk_list* out) {
+    m_pending_size -= size;
+    while (size != 0) {
+      const chunk& front = m_pending.front ();
+      if (front.size () <= size) {
+	if (out != 0) {
+	  out->push_back (front);
+	}
+	size -= front.size ();
+	m_pending.pop_front ();
+      }
+      else {
+	if (out != 0) {
+	  out->push_back (front.substr (0, size));
+	}
+	m_pending.front () = front.substr (size, front.size () - size);
+	size = 0;
+      }
+    }
+  }
+
+  bool framing_automaton::parse_length_prefixed () {
+    if (m_pending_size < sizeof (uint32_t)) {
+      return false;
+    }
+
+    // The length may straddle chunks.
+    char header[sizeof (uint32_t)];
+    size_t copied = 0;
+    for (std::deque<chunk>::const_iterator pos = m_pending.begin (); copied != sizeof (uint32_t); ++pos) {
+      const size_t n = std::min (pos->size (), sizeof (uint32_t) - copied);
+      memcpy (header + copied, pos->data (), n);
+      copied += n;
+    }
+    uint32_t length;
+    memcpy (&length, header, sizeof (uint32_t));
+    length = ntohl (length);
+
+    if (length > m_max_frame) {
+      m_errno = EMSGSIZE;
+      return false;
+    }
+
+    if (m_pending_size < sizeof (uint32_t) + length) {
+      return false;
+    }
+
+    consume (sizeof (uint32_t), 0);
+    m_messages.push_back (chunk_list ());
+    consume (length, &m_messages.back ());
+    return true;
+  }
+
+  bool framing_automaton::parse_delimited () {
+    // Resume where the last scan stopped.
+    for (; m_scan_index != m_pending.size (); ++m_scan_index, m_scan_offset = 0) {
+      const chunk& c = m_pending[m_scan_index];
+      for (; m_scan_offset != c.size (); ++m_scan_offset) {
+	const char b = c.data ()[m_scan_offset];
+	while (m_matched != 0 && b != m_delimiter[m_matched]) {
+	  m_matched = m_failure[m_matched - 1];
+	}
+	if (b == m_delimiter[m_matched]) {
+	  ++m_matched;
+	}
+	++m_scanned;
+
+	if (m_matched == m_delimiter.size ()) {
+	  const size_t length = m_scanned - m_delimiter.size ();
+	  m_scan_index = 0;
+	  m_scan_offset = 0;
+	  m_scanned = 0;
+	  m_matched = 0;
+	  m_messages.push_back (chunk_list ());
+	  consume (length, &m_messages.back ());
+	  consume (m_delimiter.size (), 0);
+	  return true;
+	}
+	else if (m_scanned - m_matched > m_max_frame) {
+	  m_errno = EMSGSIZE;
+	  return false;
+	}
+      }
+    }
+    return false;
+  }
+
+  void framing_automaton::parse () {
+    if (m_delimiter.empty ()) {
+      while (m_errno == 0 && parse_length_prefixed ()) { }
+    }
+    else {
+      while (m_errno == 0 && parse_delimited ()) { }
+    }
+  }
+
+  void framing_automaton::receive_effect (const std::string& buf) {
+    if (m_errno != 0) {
+      return;
+    }
+    for (size_t offset = 0; offset < buf.size (); ) {
+      if (m_copy.empty () || m_copy_used == m_copy.size ()) {
+	m_copy = chunk (m_pool->allocate (), m_pool->chunk_size ());
+	m_copy_used = 0;
+      }
+      // Earlier handles only cover the bytes before m_copy_used so the rest of the buffer is free to fill.
+      const size_t n = std::min (buf.size () - offset, m_copy.size () - m_copy_used);
+      memcpy (const_cast<char*> (m_copy.data ()) + m_copy_used, buf.data () + offset, n);
+      append (m_copy.substr (m_copy_used, n));
+      m_copy_used += n;
+      offset += n;
+    }
+    parse ();
+  }
+
+  void framing_automaton::receive_schedule () const {
+    schedule ();
+  }
+
+  void framing_automaton::receive_chunks_effect (const chunk_list& chunks) {
+    if (m_errno != 0) {
+      return;
+    }
+    for (chunk_list::const_iterator pos = chunks.begin (); pos != chunks.end (); ++pos) {
+      append (*pos);
+    }
+    parse ();
+  }
+
+  void framing_automaton::receive_chunks_schedule () const {
+    schedule ();
+  }
+
+  bool framing_automaton::message_precondition () const {
+    return !m_messages.empty () && binding_count (&framing_automaton::message) != 0;
+  }
+
+  chunk_list framing_automaton::message_effect () {
+    chunk_list retval;
+    retval.swap (m_messages.front ());
+    m_messages.pop_front ();
+    return retval;
+  }
+
+  void framing_automaton::message_schedule () const {
+    schedule ();
+  }
+
+  void framing_automaton::send_message_effect (const std::string& buf) {
+    if (m_errno != 0) {
+      return;
+    }
+    if (buf.size () > m_max_frame) {
+      m_errno = EMSGSIZE;
+      return;
+    }
+
+    if (m_delimiter.empty ()) {
+      const uint32_t length = htonl (buf.size ());
+      m_send_buffer.append (reinterpret_cast<const char*> (&length), sizeof (uint32_t));
+      m_send_buffer.append (buf);
+    }
+    else {
+      m_send_buffer.append (buf);
+      m_send_buffer.append (m_delimiter);
+    }
+  }
+
+  void framing_automaton::send_message_schedule () const {
+    schedule ();
+  }
+
+  bool framing_automaton::send_precondition () const {
+    return m_errno == 0 && !m_send_buffer.empty () && binding_count (&framing_automaton::send) != 0;
+  }
+
+  std::string framing_automaton::send_effect () {
+    // Every message queued since the last send goes out together.
+    std::string retval;
+    retval.swap (m_send_buffer);
+    return retval;
+  }
+
+  void framing_automaton::send_schedule () const {
+    schedule ();
+  }
+
+  bool framing_automaton::error_precondition () const {
+    return m_errno != 0 && !m_error_reported && binding_count (&framing_automaton::error) != 0;
+  }
+
+  int framing_automaton::error_effect () {
+    m_error_reported = true;
+    return m_errno;
+  }
+
+  void framing_automaton::error_schedule () const {
+    schedule ();
+  }
+
+}
@@ -19,13 +19,18 @@
 #include <ioa/system_scheduler_interface.hpp>
 
 #include "model.hpp"
+#include "timer_set.hpp"
 
 #include <algorithm>
 #include <queue>
+#include <list>
 
 #include <unistd.h>
+#include <poll.h>
 #include <sys/select.h>
 
+#include "uring.hpp"
+
 #include "sys_create_runnable.hpp"
 #include "sys_bind_runnable.hpp"
 #include "sys_unbind_runnable.hpp"
@@ -41,10 +46,10 @@
 #include "input_bound_runnable.hpp"
 #include "output_unbound_runnable.hpp"
 #include "input_unbound_runnable.hpp"
+#include "deliver_runnable.hpp"
 
 namespace ioa {
 
-  typedef std::pair<time, action_runnable_interface*> time_action;
   typedef std::pair<int, action_runnable_interface*> fd_action;
 
   class global_fifo_scheduler_impl :
@@ -55,12 +60,23 @@ namespace ioa {
     model m_model;
     std::queue<runnable_interface*> m_configq;
     std::list<action_runnable_interface*> m_userq;
-    std::queue<time_action> m_timerq;
+    std::queue<timer_request> m_timerq;
     std::queue<fd_action> m_readq;
     std::queue<fd_action> m_writeq;
     std::set<int> m_close;
     aid_t m_current_aid;
 
+    // The io_uring backend.
+    // Each poll and timeout gets a sequence number that comes back in its completion.
+    uring* m_uring;
+    uint64_t m_next_sequence;
+    std::map<uint64_t, std::pair<int, bool> > m_polls;
+    std::map<int, uint64_t> m_read_polls;
+    std::map<int, uint64_t> m_write_polls;
+    bool m_timer_armed;
+    uint64_t m_timer_sequence;
+    time m_timer_deadline;
+
     struct action_runnable_equal
     {
       const action_runnable_interface* m_ptr;
@@ -98,8 +114,8 @@ namespace ioa {
       }
     }
 
-    void schedule_timerq (action_runnable_interface* r, const time& offset) {
-      m_timerq.push (std::make_pair (time::now () + offset, r));
+    void schedule_timerq (const timer_request& request) {
+      m_timerq.push (request);
     }
   
     void schedule_readq (action_runnable_interface* r, int fd) {
@@ -110,19 +126,125 @@ namespace ioa {
       m_writeq.push (std::make_pair (fd, r));
     }
 
-    struct compare_action_runnable
-    {
-      bool operator() (const action_runnable_interface* x,
-		       const action_runnable_interface* y) const {
-	return (*x) < (*y);
+    void arm_polls (std::map<int, action_runnable_interface*>& actions,
+		    std::map<int, uint64_t>& polls,
+		    const bool write) {
+      for (std::map<int, action_runnable_interface*>::const_iterator pos = actions.begin ();
+	   pos != actions.end ();
+	   ++pos) {
+	if (polls.find (pos->first) == polls.end ()) {
+	  const uint64_t sequence = m_next_sequence;
+	  if (!m_uring->poll_add (pos->first, write ? POLLOUT : POLLIN, sequence)) {
+	    // The ring is full.  The rest are armed on the next pass.
+	    return;
+	  }
+	  ++m_next_sequence;
+	  polls.insert (std::make_pair (pos->first, sequence));
+	  m_polls.insert (std::make_pair (sequence, std::make_pair (pos->first, write)));
+	}
       }
-    };
+    }
+
+    void disarm_poll (std::map<int, uint64_t>& polls,
+		      const int fd) {
+      std::map<int, uint64_t>::iterator pos = polls.find (fd);
+      if (pos != polls.end ()) {
+	// The poll holds a reference to the file so closing the descriptor does not cancel it.
+	m_uring->poll_remove (pos->second);
+	m_polls.erase (pos->second);
+	polls.erase (pos);
+      }
+    }
+
+    /*
+      Arms a poll for each new registration and a timeout for the earliest timer, submits them, and waits for a completion with one io_uring_enter.
+    */
+    void wait_uring (const timer_set& timers,
+		     std::map<int, action_runnable_interface*>& read_actions,
+		     std::map<int, action_runnable_interface*>& write_actions) {
+      arm_polls (read_actions, m_read_polls, false);
+      arm_polls (write_actions, m_write_polls, true);
+
+      if (!timers.empty () &&
+	  (!m_timer_armed || timers.next () < m_timer_deadline)) {
+	if (m_timer_armed) {
+	  // A stale expiration is ignored.
+	  m_uring->timeout_remove (m_timer_sequence);
+	}
+	const time deadline = timers.next ();
+	const time now = time::coarse ();
+	m_timer_armed = m_uring->timeout (deadline > now ? deadline - now : time (0, 0), m_next_sequence);
+	if (m_timer_armed) {
+	  m_timer_sequence = m_next_sequence++;
+	  m_timer_deadline = deadline;
+	}
+      }
+
+      // Do not sleep past a timer that could not be armed.
+      const bool wait = m_configq.empty () && m_userq.empty () && (!m_polls.empty () || m_timer_armed) && (timers.empty () || m_timer_armed);
+      if (m_uring->enter (wait) == -1) {
+	// The ring is unusable.  The registrations are still in read_actions and write_actions so select takes over.
+	delete m_uring;
+	m_uring = 0;
+	m_polls.clear ();
+	m_read_polls.clear ();
+	m_write_polls.clear ();
+	m_timer_armed = false;
+	return;
+      }
+
+      uint64_t data;
+      int result;
+      while (m_uring->next (data, result)) {
+	if (m_timer_armed && data == m_timer_sequence) {
+	  m_timer_armed = false;
+	  continue;
+	}
+
+	std::map<uint64_t, std::pair<int, bool> >::iterator pos = m_polls.find (data);
+	if (pos == m_polls.end ()) {
+	  // A removal or a cancelled poll.
+	  continue;
+	}
+	const int fd = pos->second.first;
+	const bool write = pos->second.second;
+	m_polls.erase (pos);
+	(write ? m_write_polls : m_read_polls).erase (fd);
+	std::map<int, action_runnable_interface*>& actions = write ? write_actions : read_actions;
+	std::map<int, action_runnable_interface*>::iterator a = actions.find (fd);
+	if (a != actions.end ()) {
+	  schedule_userq (a->second);
+	  actions.erase (a);
+	}
+      }
+    }
 
   public:
-    global_fifo_scheduler_impl () :
+    global_fifo_scheduler_impl (const global_fifo_scheduler::backend_t backend) :
       m_model (*this),
-      m_current_aid (-1)
-    { }
+      m_current_aid (-1),
+      m_uring (0),
+      m_next_sequence (1),
+      m_timer_armed (false),
+      m_timer_sequence (0)
+    {
+      if (backend == global_fifo_scheduler::IO_URING_BACKEND) {
+	m_uring = new uring (256);
+	if (!m_uring->valid ()) {
+	  // Fall back to select.
+	  delete m_uring;
+	  m_uring = 0;
+	}
+      }
+    }
+
+    ~global_fifo_scheduler_impl () {
+      delete m_uring;
+    }
+
+    global_fifo_scheduler::backend_t get_backend () const {
+      return m_uring != 0 ? global_fifo_scheduler::IO_URING_BACKEND : global_fifo_scheduler::SELECT_BACKEND;
+    }
 
     aid_t get_current_aid () {
       assert (m_current_aid != -1);
@@ -156,7 +278,16 @@ namespace ioa {
 
     void schedule_after (action_runnable_interface* r,
 			 const time& offset) {
-      schedule_timerq (r, offset);
+      schedule_timerq (timer_request (timer_request::AFTER, r, time::now () + offset, time ()));
+    }
+
+    void schedule_every (action_runnable_interface* r,
+			 const time& period) {
+      schedule_timerq (timer_request (timer_request::EVERY, r, time::now () + period, period));
+    }
+
+    void cancel_timer (action_runnable_interface* r) {
+      schedule_timerq (timer_request (timer_request::CANCEL, r, time (), time ()));
     }
 
     void schedule_read_ready (action_runnable_interface* r,
@@ -174,8 +305,7 @@ namespace ioa {
       assert (m_userq.empty ());
       assert (runnable_interface::count () == 0);
 
-      std::multimap<time, action_runnable_interface*> time_to_action;
-      std::map<action_runnable_interface*, time, compare_action_runnable> action_to_time;
+      timer_set timers;
       std::map<int, action_runnable_interface*> read_actions;
       std::map<int, action_runnable_interface*> write_actions;
       
@@ -195,36 +325,8 @@ namespace ioa {
     
     	// Process registrations.
 	while (!m_timerq.empty ()) {
-	  time_action a = m_timerq.front ();
+	  timers.apply (m_timerq.front ());
 	  m_timerq.pop ();
-
-	  std::map<action_runnable_interface*, time, compare_action_runnable>::iterator pos = action_to_time.find (a.second);
-
-	  if (pos == action_to_time.end ()) {
-	    // Insert new action.
-	    time_to_action.insert (a);
-	    action_to_time.insert (std::make_pair (a.second, a.first));
-	  }
-	  else if (a.first < pos->second) {
-	    // Action already has a time but new time is earlier.
-
-	    // Remove old action.
-	    delete pos->first;
-	    std::multimap<time, action_runnable_interface*>::iterator pos2;
-	    for (pos2 = time_to_action.find (pos->second);
-		 pos2 != time_to_action.end () && pos2->second != pos->first;
-		 ++pos2) ;;
-	    time_to_action.erase (pos2);
-	    action_to_time.erase (pos);
-
-	    // Insert new action.
-	    time_to_action.insert (a);
-	    action_to_time.insert (std::make_pair (a.second, a.first));
-	  }
-	  else {
-	    // Action will execute after existing action.
-	    delete a.second;
-	  }
 	}
 
 	while (!m_readq.empty ()) {
@@ -261,12 +363,12 @@ namespace ioa {
 	test_timeout = 0;
 
 	// If the timer queue is empty, set a timeout.
-	if (!time_to_action.empty ()) {
-    	  time now = time::now ();
+	if (!timers.empty ()) {
+    	  time now = time::refresh ();
 
-    	  if (time_to_action.begin ()->first > now) {
+    	  if (timers.next () > now) {
     	    // Timer is some time in future.
-    	    timeout = time_to_action.begin ()->first - now;
+    	    timeout = timers.next () - now;
     	  }
     	  else {
     	    // Timer is in the past.  Return immediately.
@@ -277,35 +379,52 @@ namespace ioa {
     	}
 
 	// If we have work to do, go immediately.
-	if (!m_configq.empty () || !m_userq.empty ()) {
+	// The wait cannot block so the clock does not need to be read again after it.
+	const bool busy = !m_configq.empty () || !m_userq.empty ();
+	if (busy) {
 	  timeout = time (0, 0);
 	  test_timeout = &timeout;
 	}
 
-	// We only need to select if we have fds or timers.
-	if (!read_actions.empty () || !write_actions.empty () || !time_to_action.empty ()) {
-	  
-	  // Remove closed fds.
-	  for (std::set<int>::const_iterator pos = m_close.begin ();
-	       pos != m_close.end ();
-	       ++pos) {
-	    std::map<int, action_runnable_interface*>::iterator p;
+	// Remove closed fds.
+	for (std::set<int>::const_iterator pos = m_close.begin ();
+	     pos != m_close.end ();
+	     ++pos) {
+	  std::map<int, action_runnable_interface*>::iterator p;
 
-	    p = read_actions.find (*pos);
-	    if (p != read_actions.end ()) {
-	      delete p->second;
-	      read_actions.erase (p);
-	    }
+	  p = read_actions.find (*pos);
+	  if (p != read_actions.end ()) {
+	    delete p->second;
+	    read_actions.erase (p);
+	  }
 
-	    p = write_actions.find (*pos);
-	    if (p != write_actions.end ()) {
-	      delete p->second;
-	      write_actions.erase (p);
-	    }
+	  p = write_actions.find (*pos);
+	  if (p != write_actions.end ()) {
+	    delete p->second;
+	    write_actions.erase (p);
+	  }
 
-	    ::close (*pos);	    
+	  if (m_uring != 0) {
+	    disarm_poll (m_read_polls, *pos);
+	    disarm_poll (m_write_polls, *pos);
 	  }
 
+	  ::close (*pos);	    
+	}
+	m_close.clear ();
+
+	if (m_uring != 0) {
+	  wait_uring (timers, read_actions, write_actions);
+
+	  // Process timers.
+	  time now = busy ? time::coarse () : time::refresh ();
+	  while (action_runnable_interface* a = timers.expire (now, m_model)) {
+	    schedule_userq (a);
+	  }
+	}
+	// We only need to select if we have fds or timers.
+	else if (!read_actions.empty () || !write_actions.empty () || !timers.empty ()) {
+	  
 	  // Determine the read set.
 	  for (std::map<int, action_runnable_interface*>::const_iterator pos = read_actions.begin ();
 	       pos != read_actions.end ();
@@ -332,12 +451,9 @@ namespace ioa {
 	  
 	  // Process timers.
 	  {
-	    time now = time::now ();
+	    time now = busy ? time::coarse () : time::refresh ();
 	    
-	    while (!time_to_action.empty () && time_to_action.begin ()->first < now) {
-	      action_runnable_interface* a = time_to_action.begin ()->second;
-	      time_to_action.erase (time_to_action.begin ());
-	      action_to_time.erase (a);
+	    while (action_runnable_interface* a = timers.expire (now, m_model)) {
 	      schedule_userq (a);
 	    }
 	  }
@@ -376,8 +492,6 @@ namespace ioa {
 
 	}
 
-	m_close.clear ();
-
 	// Process configuration actions.
 	if (!m_configq.empty ()) {
 	  runnable_interface* r = m_configq.front ();
@@ -401,6 +515,13 @@ namespace ioa {
 
       // Consequently, we are going to reset.
 
+      if (m_uring != 0 && m_timer_armed) {
+	// Do not leave a timeout behind for the next run.
+	m_uring->timeout_remove (m_timer_sequence);
+	m_uring->enter (false);
+	m_timer_armed = false;
+      }
+
       // We clear the system first because it might add something to a run queue.
       m_model.clear ();
     
@@ -504,16 +625,28 @@ namespace ioa {
 		    void* const key) {
       schedule_configq (make_action_runnable (automaton_handle<automaton> (aid), &automaton::sys_destroyed, std::make_pair (t, key), system_input_category ()));
     }
+
+    void deliver (const input_executor_interface& exec) {
+      schedule_userq (new deliver_runnable (exec));
+    }
+
+    void drained (const output_executor_interface& exec) {
+      schedule_userq (new output_exec_runnable (exec));
+    }
   };
 
-  global_fifo_scheduler::global_fifo_scheduler () :
-    m_impl (new global_fifo_scheduler_impl ())
+  global_fifo_scheduler::global_fifo_scheduler (const backend_t backend) :
+    m_impl (new global_fifo_scheduler_impl (backend))
   { }
 
   global_fifo_scheduler::~global_fifo_scheduler () {
     delete m_impl;
   }
     
+  global_fifo_scheduler::backend_t global_fifo_scheduler::get_backend () const {
+    return m_impl->get_backend ();
+  }
+
   aid_t global_fifo_scheduler::get_current_aid () {
     return m_impl->get_current_aid ();
   }
@@ -547,6 +680,15 @@ namespace ioa {
     m_impl->schedule_after (r, offset);
   }
   
+  void global_fifo_scheduler::schedule_every (action_runnable_interface* r,
+					      const time& period) {
+    m_impl->schedule_every (r, period);
+  }
+
+  void global_fifo_scheduler::cancel_timer (action_runnable_interface* r) {
+    m_impl->cancel_timer (r);
+  }
+  
   void global_fifo_scheduler::schedule_read_ready (action_runnable_interface* r,
 						   int fd) {
     m_impl->schedule_read_ready (r, fd);
@@ -0,0 +1,74 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include <ioa/inbox_automaton.hpp>
+
+#include <fcntl.h>
+#include <stdint.h>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+namespace ioa {
+
+  inbox_signal::inbox_signal () :
+    m_read_fd (-1),
+    m_write_fd (-1)
+  {
+#ifdef __linux__
+    m_read_fd = m_write_fd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+#else
+    int fd[2];
+    if (pipe (fd) == 0) {
+      for (int i = 0; i < 2; ++i) {
+	fcntl (fd[i], F_SETFL, O_NONBLOCK);
+	fcntl (fd[i], F_SETFD, FD_CLOEXEC);
+      }
+      m_read_fd = fd[0];
+      m_write_fd = fd[1];
+    }
+#endif
+  }
+
+  inbox_signal::~inbox_signal () {
+    if (m_read_fd != -1) {
+      ::close (m_read_fd);
+    }
+    if (m_write_fd != m_read_fd) {
+      ::close (m_write_fd);
+    }
+  }
+
+  int inbox_signal::get_fd () const {
+    return m_read_fd;
+  }
+
+  void inbox_signal::signal () {
+    // An eventfd adds the value and a pipe takes the bytes.  Either way the reader wakes up.
+    const uint64_t one = 1;
+    ssize_t r = ::write (m_write_fd, &one, sizeof (one));
+    (void)r;
+  }
+
+  void inbox_signal::clear () {
+    // Reset the eventfd counter or empty the pipe.
+    char buf[64];
+    while (::read (m_read_fd, buf, sizeof (buf)) > 0) { }
+  }
+
+}
@@ -46,17 +46,21 @@ namespace ioa {
   }
 
   void model::clear (void) {
-   // Delete all root automata.
-    while (!m_records.empty ()) {
-      for (std::map<aid_t, automaton_record*>::const_iterator pos = m_records.begin ();
-	   pos != m_records.end ();
-	   ++pos) {
-	if (pos->second->get_parent () == 0) {
-	  inner_destroy (pos->second);
-	  break;
-	}
+    // Delete all root automata.
+    std::vector<automaton_record*> roots;
+    for (std::map<aid_t, automaton_record*>::const_iterator pos = m_records.begin ();
+	 pos != m_records.end ();
+	 ++pos) {
+      if (pos->second->get_parent () == 0) {
+	roots.push_back (pos->second);
       }
     }
+
+    for (std::vector<automaton_record*>::const_iterator pos = roots.begin ();
+	 pos != roots.end ();
+	 ++pos) {
+      inner_destroy (*pos);
+    }
     
     assert (m_aids.empty ());
     assert (m_instances.empty ());
@@ -174,49 +178,35 @@ namespace ioa {
       return -1;
     }
     
-    std::list<output_executor_interface*>::const_iterator pos = std::find_if (m_bindings.begin (),
-									      m_bindings.end (),
-									      binding_equal (output, input, binder));
-    
-    if (pos != m_bindings.end ()) {
+    if (find_binding (output.get_aid (), binding_equal (output, input, binder)) != 0) {
       // Bound.
       m_system_scheduler.bound (binder, BINDING_EXISTS_RESULT, key);
       return -1;
     }
     
-    std::list<output_executor_interface*>::const_iterator in_pos = std::find_if (m_bindings.begin (),
-										 m_bindings.end (),
-										 binding_input_equal (input));
-    
-    if (in_pos != m_bindings.end ()) {
+    if (find_binding (input.get_aid (), binding_input_equal (input)) != 0) {
       // Input unavailable.
       m_system_scheduler.bound (binder, INPUT_ACTION_UNAVAILABLE_RESULT, key);
       return -1;
     }
     
-    std::list<output_executor_interface*>::const_iterator out_pos = std::find_if (m_bindings.begin (),
-										  m_bindings.end (),
-										  binding_output_equal (output));
+    output_executor_interface* c = find_binding (output.get_aid (), binding_output_equal (output));
     
     if (output.get_aid () == input.get_aid () ||
-	(out_pos != m_bindings.end () && (*out_pos)->involves_input_automaton (input.get_aid ()))) {
+	(c != 0 && c->involves_input_automaton (input.get_aid ()))) {
       // Output unavailable.
       m_system_scheduler.bound (binder, OUTPUT_ACTION_UNAVAILABLE_RESULT, key);
       return -1;
     }
     
-    output_executor_interface* c;
-    
-    if (out_pos != m_bindings.end ()) {
-      c = *out_pos;
-    }
-    else {
+    if (c == 0) {
       c = output.clone ().release ();
-      m_bindings.push_front (c);
+      m_bindings.insert (c);
     }
     
     // Bind.
-    c->bind (m_system_scheduler, *this, input, binder, key);
+    c->bind (m_system_scheduler, *this, input, binder, key, bind_exec->get_fifo ());
+    add_binding_record (c, input.get_aid (), binder);
     
     return 0;
   }    
@@ -231,24 +221,21 @@ namespace ioa {
       return -1;
     }
     
-    std::list<output_executor_interface*>::iterator pos = std::find_if (m_bindings.begin (),
-									m_bindings.end (),
-									binding_aid_key_equal (binder, key));
+    output_executor_interface* c = find_binding (binder, binding_aid_key_equal (binder, key));
     
-    if (pos == m_bindings.end ()) {
+    if (c == 0) {
       // Not bound.
       m_system_scheduler.unbound (binder, BIND_KEY_DNE_RESULT, key);
       return -1;
     }
     
-    output_executor_interface* c = *pos;
-    
     // Unbind.
-    c->unbind (binder, key);
+    const aid_t input = c->unbind (binder, key);
+    remove_binding_record (c, input, binder);
     
     if (c->empty ()) {
+      m_bindings.erase (c);
       delete c;
-      m_bindings.erase (pos);
     }
     
     return 0;
@@ -285,38 +272,101 @@ namespace ioa {
     return 0;
   }
 
+  void model::add_binding_record (output_executor_interface* binding,
+				  const aid_t input,
+				  const aid_t binder) {
+    m_records[binding->get_aid ()]->add_binding (binding);
+    m_records[input]->add_binding (binding);
+    m_records[binder]->add_binding (binding);
+  }
+
+  void model::remove_binding_record (output_executor_interface* binding,
+				     const aid_t input,
+				     const aid_t binder) {
+    m_records[binding->get_aid ()]->remove_binding (binding);
+    m_records[input]->remove_binding (binding);
+    m_records[binder]->remove_binding (binding);
+  }
+
   void model::inner_destroy (automaton_record* automaton)
   {
-    for (std::pair<void*, automaton_record*> p = automaton->get_first_child ();
-	 p.second != 0;
-	 p = automaton->get_first_child ()) {
-      inner_destroy (p.second);
+    // Collect the subtree.
+    std::vector<automaton_record*> subtree;
+    std::vector<aid_t> aids;
+    subtree.push_back (automaton);
+    for (size_t idx = 0; idx != subtree.size (); ++idx) {
+      automaton_record* record = subtree[idx];
+      aids.push_back (record->get_aid ());
+      const std::map<void*, automaton_record*>& children = record->get_children ();
+      for (std::map<void*, automaton_record*>::const_iterator pos = children.begin ();
+	   pos != children.end ();
+	   ++pos) {
+	subtree.push_back (pos->second);
+      }
     }
-    
+    std::sort (aids.begin (), aids.end ());
+
+    // Collect the bindings involving the subtree and the automata of the subtree involved in each.
+    std::map<output_executor_interface*, std::vector<aid_t> > bindings;
+    for (std::vector<automaton_record*>::const_iterator pos = subtree.begin ();
+	 pos != subtree.end ();
+	 ++pos) {
+      const std::map<output_executor_interface*, size_t>& b = (*pos)->get_bindings ();
+      for (std::map<output_executor_interface*, size_t>::const_iterator bpos = b.begin ();
+	   bpos != b.end ();
+	   ++bpos) {
+	bindings[bpos->first].push_back ((*pos)->get_aid ());
+      }
+    }
+
     // Update bindings.
-    for (std::list<output_executor_interface*>::iterator pos = m_bindings.begin ();
-	 pos != m_bindings.end ();
-	 ) {
-      (*pos)->unbind_automaton (automaton->get_aid ());
-      if ((*pos)->empty ()) {
-	delete *pos;
-	pos = m_bindings.erase (pos);
+    // Only the automata outside of the subtree are notified.
+    std::vector<std::pair<aid_t, aid_t> > removed;
+    for (std::map<output_executor_interface*, std::vector<aid_t> >::const_iterator pos = bindings.begin ();
+	 pos != bindings.end ();
+	 ++pos) {
+      output_executor_interface* c = pos->first;
+      const aid_t output = c->get_aid ();
+      const bool output_dying = std::binary_search (aids.begin (), aids.end (), output);
+      removed.clear ();
+      c->unbind_automata (aids, pos->second, removed);
+      for (std::vector<std::pair<aid_t, aid_t> >::const_iterator rpos = removed.begin ();
+	   rpos != removed.end ();
+	   ++rpos) {
+	if (!output_dying) {
+	  m_records[output]->remove_binding (c);
+	}
+	if (!std::binary_search (aids.begin (), aids.end (), rpos->first)) {
+	  m_records[rpos->first]->remove_binding (c);
+	}
+	if (!std::binary_search (aids.begin (), aids.end (), rpos->second)) {
+	  m_records[rpos->second]->remove_binding (c);
+	}
       }
-      else {
-	++pos;
+      if (c->empty ()) {
+	m_bindings.erase (c);
+	delete c;
       }
     }
 
     // Update parent-child relationships.
+    // Only the parent of the subtree is told.
     automaton_record* parent = automaton->get_parent ();
     if (parent != 0) {
       parent->remove_child (automaton->get_key ());
     }
-    
-    m_aids.replace (automaton->get_aid ());
-    m_instances.erase (automaton->get_instance ());
-    m_records.erase (automaton->get_aid ());
-    delete automaton;
+
+    // Children before parents.
+    for (std::vector<automaton_record*>::reverse_iterator pos = subtree.rbegin ();
+	 pos != subtree.rend ();
+	 ++pos) {
+      automaton_record* record = *pos;
+      record->clear_children ();
+      m_aids.replace (record->get_aid ());
+      m_instances.erase (record->get_instance ());
+      m_records.erase (record->get_aid ());
+      delete record;
+    }
   }
 
   int model::execute (output_executor_interface& exec) {
@@ -327,16 +377,14 @@ namespace ioa {
       return -1;
     }
     
-    std::list<output_executor_interface*>::const_iterator out_pos = std::find_if (m_bindings.begin (),
-										  m_bindings.end (),
-										  binding_output_equal (exec));
+    output_executor_interface* c = find_binding (exec.get_aid (), binding_output_equal (exec));
     
-    if (out_pos == m_bindings.end ()) {
+    if (c == 0) {
       // Not bound.
       exec (*this, m_system_scheduler);
     }
     else {
-      (*(*out_pos)) (*this, m_system_scheduler);
+      (*c) (*this, m_system_scheduler);
     }
     
     return 0;
@@ -522,6 +570,25 @@ namespace ioa {
     return 0;
   }
 
+  int model::execute_deliver (input_executor_interface& exec) {
+    shared_lock lock (m_mutex);
+    
+    if (!exec.fetch_instance (*this)) {
+      // Automaton does not exist.
+      return -1;
+    }
+
+    output_executor_interface* c = find_binding (exec.get_aid (), binding_input_equal (exec));
+
+    if (c == 0) {
+      // Not bound.  Undelivered values were discarded when the binding was removed.
+      return -1;
+    }
+
+    c->deliver (*this, m_system_scheduler, exec);
+    return 0;
+  }
+
   automaton* model::get_instance (const aid_t aid) {
     std::map<aid_t, automaton_record*>::const_iterator pos = m_records.find (aid);
     if (pos != m_records.end ()) {
@@ -532,6 +599,11 @@ namespace ioa {
     }
   }
 
+  bool model::exists (const aid_t aid) {
+    shared_lock lock (m_mutex);
+    return m_records.find (aid) != m_records.end ();
+  }
+
   void model::lock_automaton (const aid_t handle) {
     m_records[handle]->lock ();
   }
@@ -542,22 +614,16 @@ namespace ioa {
 
   // This should only be called from user code because we don't get a lock.
   size_t model::binding_count (const action_executor_interface& action) const {
-    std::list<output_executor_interface*>::const_iterator in_pos = std::find_if (m_bindings.begin (),
-										 m_bindings.end (),
-										 binding_input_equal (action));
-    
-    if (in_pos != m_bindings.end ()) {
+    if (find_binding (action.get_aid (), binding_input_equal (action)) != 0) {
       // Input is bound.
       return 1;
     }
     
-    std::list<output_executor_interface*>::const_iterator out_pos = std::find_if (m_bindings.begin (),
-										  m_bindings.end (),
-										  binding_output_equal (action));
+    output_executor_interface* c = find_binding (action.get_aid (), binding_output_equal (action));
     
-    if (out_pos != m_bindings.end ()) {
+    if (c != 0) {
       // Output is bound.
-      return (*out_pos)->size ();
+      return c->size ();
     }
     
     return 0;
@@ -20,7 +20,8 @@
 #include <ioa/action.hpp>
 #include "sequential_set.hpp"
 #include <map>
-#include <list>
+#include <set>
+#include <vector>
 #include "automaton_record.hpp"
 #include <ioa/shared_mutex.hpp>
 #include <ioa/allocator_interface.hpp>
@@ -112,8 +113,33 @@ namespace ioa {
     sequential_set<aid_t> m_aids;
     std::set<automaton*> m_instances;
     std::map<aid_t, automaton_record*> m_records;
-    std::list<output_executor_interface*> m_bindings;
-
+    std::set<output_executor_interface*> m_bindings;
+
+    // Bindings are found through the index of an automaton involved in them.
+    template <class P>
+    output_executor_interface* find_binding (const aid_t aid,
+					     P p) const {
+      std::map<aid_t, automaton_record*>::const_iterator rec = m_records.find (aid);
+      if (rec == m_records.end ()) {
+	return 0;
+      }
+      const std::map<output_executor_interface*, size_t>& bindings = rec->second->get_bindings ();
+      for (std::map<output_executor_interface*, size_t>::const_iterator pos = bindings.begin ();
+	   pos != bindings.end ();
+	   ++pos) {
+	if (p (pos->first)) {
+	  return pos->first;
+	}
+      }
+      return 0;
+    }
+
+    void add_binding_record (output_executor_interface* binding,
+			     const aid_t input,
+			     const aid_t binder);
+    void remove_binding_record (output_executor_interface* binding,
+				const aid_t input,
+				const aid_t binder);
     void inner_destroy (automaton_record* automaton);
     
   public:
@@ -149,10 +175,12 @@ namespace ioa {
     int execute_input_bound (input_executor_interface& exec);
     int execute_output_unbound (output_executor_interface& exec);
     int execute_input_unbound (input_executor_interface& exec);
+    int execute_deliver (input_executor_interface& exec);
     
     size_t binding_count (const action_executor_interface& action) const;
     
     automaton* get_instance (const aid_t aid);
+    bool exists (const aid_t aid);
     void lock_automaton (const aid_t handle);
     void unlock_automaton (const aid_t handle);
   };
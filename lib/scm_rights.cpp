@@ -0,0 +1,106 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "scm_rights.hpp"
+
+#include <cstring>
+
+namespace ioa {
+
+  ssize_t send_with_fds (const int fd,
+			 const sockaddr* address,
+			 const socklen_t address_length,
+			 const char* buf,
+			 const size_t size,
+			 const std::vector<int>& fds) {
+    struct iovec iov;
+    iov.iov_base = const_cast<char*> (buf);
+    iov.iov_len = size;
+
+    struct msghdr hdr;
+    memset (&hdr, 0, sizeof (hdr));
+    hdr.msg_name = const_cast<sockaddr*> (address);
+    hdr.msg_namelen = address != 0 ? address_length : 0;
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1;
+
+    std::vector<char> control;
+    if (!fds.empty ()) {
+      control.resize (CMSG_SPACE (fds.size () * sizeof (int)));
+      hdr.msg_control = &control[0];
+      hdr.msg_controllen = control.size ();
+      struct cmsghdr* cmsg = CMSG_FIRSTHDR (&hdr);
+      cmsg->cmsg_level = SOL_SOCKET;
+      cmsg->cmsg_type = SCM_RIGHTS;
+      cmsg->cmsg_len = CMSG_LEN (fds.size () * sizeof (int));
+      memcpy (CMSG_DATA (cmsg), &fds[0], fds.size () * sizeof (int));
+    }
+
+    // A closed peer is reported as EPIPE instead of raising SIGPIPE.
+    return sendmsg (fd, &hdr, MSG_NOSIGNAL);
+  }
+
+  ssize_t receive_with_fds (const int fd,
+			    sockaddr* address,
+			    socklen_t* address_length,
+			    char* buf,
+			    const size_t size,
+			    const size_t max_fds,
+			    std::vector<fd_transfer>& fds) {
+    struct iovec iov;
+    iov.iov_base = buf;
+    iov.iov_len = size;
+
+    struct msghdr hdr;
+    memset (&hdr, 0, sizeof (hdr));
+    hdr.msg_name = address;
+    hdr.msg_namelen = address != 0 ? *address_length : 0;
+    hdr.msg_iov = &iov;
+    hdr.msg_iovlen = 1;
+
+    std::vector<char> control (CMSG_SPACE (max_fds * sizeof (int)));
+    hdr.msg_control = &control[0];
+    hdr.msg_controllen = control.size ();
+
+    int flags = 0;
+#ifdef MSG_CMSG_CLOEXEC
+    flags |= MSG_CMSG_CLOEXEC;
+#endif
+    const ssize_t r = recvmsg (fd, &hdr, flags);
+    if (r == -1) {
+      return r;
+    }
+
+    if (address != 0) {
+      *address_length = hdr.msg_namelen;
+    }
+
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR (&hdr); cmsg != 0; cmsg = CMSG_NXTHDR (&hdr, cmsg)) {
+      if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+	const size_t count = (cmsg->cmsg_len - CMSG_LEN (0)) / sizeof (int);
+	for (size_t i = 0; i != count; ++i) {
+	  int received;
+	  memcpy (&received, CMSG_DATA (cmsg) + i * sizeof (int), sizeof (int));
+	  // The transfer owns the descriptor so it is closed if nobody takes it.
+	  fds.push_back (fd_transfer (received));
+	}
+      }
+    }
+
+    return r;
+  }
+
+}
@@ -0,0 +1,55 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef __scm_rights_hpp__
+#define __scm_rights_hpp__
+
+#include <ioa/fd_transfer.hpp>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+
+namespace ioa {
+
+  /*
+    Sends size bytes of buf on the Unix domain socket fd with fds attached as SCM_RIGHTS.
+    address may be null for a connected socket.
+    Returns the result of sendmsg.
+  */
+  ssize_t send_with_fds (const int fd,
+			 const sockaddr* address,
+			 const socklen_t address_length,
+			 const char* buf,
+			 const size_t size,
+			 const std::vector<int>& fds);
+
+  /*
+    Receives up to size bytes into buf from the Unix domain socket fd.
+    The descriptors that arrive with the bytes are appended to fds and at most max_fds are accepted; the kernel closes the rest.
+    address may be null.
+    Returns the result of recvmsg.
+  */
+  ssize_t receive_with_fds (const int fd,
+			    sockaddr* address,
+			    socklen_t* address_length,
+			    char* buf,
+			    const size_t size,
+			    const size_t max_fds,
+			    std::vector<fd_transfer>& fds);
+
+}
+
+#endif
@@ -0,0 +1,860 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <ioa/sharded_scheduler.hpp>
+
+#include <ioa/system_scheduler_interface.hpp>
+
+#include "model.hpp"
+#include "timer_set.hpp"
+#include "blocking_list.hpp"
+#include "spsc_queue.hpp"
+#include "thread_key.hpp"
+#include "lock.hpp"
+#include "thread.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <list>
+#include <set>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sched.h>
+#include <sys/select.h>
+#include <unistd.h>
+
+#include "sys_create_runnable.hpp"
+#include "sys_bind_runnable.hpp"
+#include "sys_unbind_runnable.hpp"
+#include "sys_destroy_runnable.hpp"
+
+#include "create_runnable.hpp"
+#include "bind_runnable.hpp"
+#include "unbind_runnable.hpp"
+#include "destroy_runnable.hpp"
+
+#include "output_exec_runnable.hpp"
+#include "output_bound_runnable.hpp"
+#include "input_bound_runnable.hpp"
+#include "output_unbound_runnable.hpp"
+#include "input_unbound_runnable.hpp"
+#include "deliver_runnable.hpp"
+
+namespace ioa {
+
+  class sharded_scheduler_impl :
+    public system_scheduler_interface
+  {
+  private:
+    typedef std::pair<int, action_runnable_interface*> fd_action;
+
+    struct compare_action_runnable
+    {
+      bool operator() (const action_runnable_interface* x,
+		       const action_runnable_interface* y) const {
+	return (*x) < (*y);
+      }
+    };
+
+    class shard
+    {
+    public:
+      // Only touched by the thread running the shard.
+      std::deque<action_runnable_interface*> m_runq;
+      std::set<action_runnable_interface*, compare_action_runnable> m_pending;
+      // One queue per thread that can schedule actions on this shard.
+      std::vector<spsc_queue<action_runnable_interface*>*> m_inq;
+      // Threads that are not part of the scheduler share a locked queue.
+      mutex m_foreign_mutex;
+      std::deque<action_runnable_interface*> m_foreign;
+      volatile int m_has_foreign;
+      int m_wakeup_fd[2];
+      volatile int m_sleeping;
+      int m_cpu;
+
+      shard (const size_t producers,
+	     const int cpu) :
+	m_has_foreign (0),
+	m_sleeping (0),
+	m_cpu (cpu)
+      {
+	for (size_t i = 0; i < producers; ++i) {
+	  m_inq.push_back (new spsc_queue<action_runnable_interface*> ());
+	}
+      }
+
+      ~shard () {
+	clear ();
+	for (size_t i = 0; i < m_inq.size (); ++i) {
+	  delete m_inq[i];
+	}
+      }
+
+      void clear () {
+	for (std::deque<action_runnable_interface*>::iterator pos = m_runq.begin ();
+	     pos != m_runq.end ();
+	     ++pos) {
+	  delete *pos;
+	}
+	m_runq.clear ();
+	m_pending.clear ();
+	for (size_t i = 0; i < m_inq.size (); ++i) {
+	  action_runnable_interface* r;
+	  while (m_inq[i]->pop (r)) {
+	    delete r;
+	  }
+	}
+	lock lock (m_foreign_mutex);
+	for (std::deque<action_runnable_interface*>::iterator pos = m_foreign.begin ();
+	     pos != m_foreign.end ();
+	     ++pos) {
+	  delete *pos;
+	}
+	m_foreign.clear ();
+	m_has_foreign = 0;
+      }
+
+      void push_foreign (action_runnable_interface* r) {
+	lock lock (m_foreign_mutex);
+	m_foreign.push_back (r);
+	m_has_foreign = 1;
+      }
+
+      void push_local (action_runnable_interface* r) {
+	// See the comment on duplicates in simple_scheduler.cpp.
+	if (m_pending.insert (r).second) {
+	  m_runq.push_back (r);
+	}
+	else {
+	  delete r;
+	}
+      }
+
+      size_t drain () {
+	size_t count = 0;
+	action_runnable_interface* r;
+	for (size_t i = 0; i < m_inq.size (); ++i) {
+	  while (m_inq[i]->pop (r)) {
+	    push_local (r);
+	    ++count;
+	  }
+	}
+	if (m_has_foreign) {
+	  std::deque<action_runnable_interface*> foreign;
+	  {
+	    lock lock (m_foreign_mutex);
+	    foreign.swap (m_foreign);
+	    m_has_foreign = 0;
+	  }
+	  for (std::deque<action_runnable_interface*>::const_iterator pos = foreign.begin ();
+	       pos != foreign.end ();
+	       ++pos) {
+	    push_local (*pos);
+	  }
+	  count += foreign.size ();
+	}
+	return count;
+      }
+
+      void wakeup () {
+	// The pipe may be full in which case the shard is already awake.
+	char c = 0;
+	ssize_t bytes_written = write (m_wakeup_fd[1], &c, 1);
+	(void)bytes_written;
+      }
+    };
+
+    // Identifies the queue a thread uses when scheduling on a shard.
+    struct producer
+    {
+      size_t index;
+      shard* home;
+
+      producer (const size_t i,
+		shard* h) :
+	index (i),
+	home (h)
+      { }
+    };
+
+    model m_model;
+    const int SHARD_COUNT;
+    // The shards are producers 0 to SHARD_COUNT - 1.
+    const size_t SYS_PRODUCER;
+    const size_t IO_PRODUCER;
+    std::vector<shard*> m_shards;
+    std::vector<producer*> m_producers;
+    int m_next_shard;
+    blocking_list<std::pair<bool, runnable_interface*> > m_sysq;
+    int m_wakeup_fd[2];
+    blocking_list<timer_request> m_timerq;
+    blocking_list<fd_action> m_readq;
+    blocking_list<fd_action> m_writeq;
+    blocking_list<int> m_closeq;
+    thread_key<aid_t> m_current_aid;
+    thread_key<producer*> m_producer;
+
+    static int shard_count (const int shards) {
+      if (shards > 0) {
+	return shards;
+      }
+      long cpus = sysconf (_SC_NPROCESSORS_ONLN);
+      return cpus > 0 ? cpus : 1;
+    }
+
+    shard* shard_of (const aid_t aid) const {
+      return m_shards[aid % SHARD_COUNT];
+    }
+
+    bool keep_going () {
+      // The criteria for continuing is simple: a runnable exists.
+      return runnable_interface::count () != 0;
+    }
+
+    bool thread_keep_going () {
+      bool retval = keep_going ();
+      if (!retval) {
+	// Unblock every thread.  See simple_scheduler.cpp.
+	m_sysq.push (std::pair<bool, runnable_interface*> (false, 0));
+	for (int i = 0; i < SHARD_COUNT; ++i) {
+	  m_shards[i]->wakeup ();
+	}
+	wakeup_io_thread ();
+      }
+      return retval;
+    }
+
+    void enter (producer* p) {
+      m_producer.set (p);
+      clear_current_aid ();
+    }
+
+    void schedule_sysq (runnable_interface* r) {
+      m_sysq.push (std::make_pair (true, r));
+    }
+
+    void process_sysq () {
+      enter (m_producers[SYS_PRODUCER]);
+      while (thread_keep_going ()) {
+	std::pair<bool, runnable_interface*> r = m_sysq.pop ();
+	if (r.first) {
+	  (*r.second) (m_model);
+	  delete r.second;
+	}
+      }
+    }
+
+    void schedule_execq (action_runnable_interface* r) {
+      shard* s = shard_of (r->get_action ().get_aid ());
+      producer* p = m_producer.get ();
+      if (p != 0 && p->home == s) {
+	s->push_local (r);
+      }
+      else {
+	if (p != 0) {
+	  s->m_inq[p->index]->push (r);
+	}
+	else {
+	  // A thread that is not part of the scheduler, e.g., run () creating the root.
+	  // There may be several so they cannot use a single-producer queue.
+	  s->push_foreign (r);
+	}
+	// Pairs with the barrier in sleep ().
+	__sync_synchronize ();
+	if (s->m_sleeping) {
+	  s->wakeup ();
+	}
+      }
+    }
+
+    void sleep (shard* s) {
+      s->m_sleeping = 1;
+      __sync_synchronize ();
+      // A producer either sees m_sleeping or we see its runnable.
+      if (s->drain () == 0 && keep_going ()) {
+	struct pollfd pfd;
+	pfd.fd = s->m_wakeup_fd[0];
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	poll (&pfd, 1, -1);
+	char c[64];
+	while (read (s->m_wakeup_fd[0], c, sizeof (c)) > 0) ;;
+      }
+      s->m_sleeping = 0;
+    }
+
+    void pin (shard* s) {
+#ifdef __linux__
+      cpu_set_t set;
+      CPU_ZERO (&set);
+      CPU_SET (s->m_cpu, &set);
+      // Pinning is advisory.  The shard still runs if the processor is unavailable.
+      pthread_setaffinity_np (pthread_self (), sizeof (set), &set);
+#endif
+    }
+
+    void process_shard () {
+      // Claim the next shard.
+      const int idx = __sync_fetch_and_add (&m_next_shard, 1);
+      shard* s = m_shards[idx];
+      enter (m_producers[idx]);
+      pin (s);
+
+      for (;;) {
+	s->drain ();
+	if (!s->m_runq.empty ()) {
+	  action_runnable_interface* r = s->m_runq.front ();
+	  s->m_runq.pop_front ();
+	  s->m_pending.erase (r);
+	  (*r) (m_model);
+	  delete r;
+	}
+	else if (thread_keep_going ()) {
+	  sleep (s);
+	}
+	else {
+	  break;
+	}
+      }
+    }
+
+    void wakeup_io_thread () {
+      char c;
+      ssize_t bytes_written = write (m_wakeup_fd[1], &c, 1);
+      assert (bytes_written == 1);
+    }
+
+    void schedule_timerq (const timer_request& request) {
+      if (m_timerq.push (request) == 1) {
+	wakeup_io_thread ();
+      }
+    }
+  
+    void schedule_readq (action_runnable_interface* r, int fd) {
+      if (m_readq.push (std::make_pair (fd, r)) == 1) {
+	wakeup_io_thread ();
+      }
+    }
+
+    void schedule_writeq (action_runnable_interface* r, int fd) {
+      if (m_writeq.push (std::make_pair (fd, r)) == 1) {
+	wakeup_io_thread ();
+      }
+    }
+
+    void process_ioq () {
+      enter (m_producers[IO_PRODUCER]);
+    
+      timer_set timers;
+      std::map<int, action_runnable_interface*> read_actions;
+      std::map<int, action_runnable_interface*> write_actions;
+    
+      fd_set read_set;
+      FD_ZERO (&read_set);
+      fd_set write_set;
+      FD_ZERO (&write_set);
+
+      while (thread_keep_going ()) {
+	// Take the closed fds before the registrations.
+	// A registration made before an fd was closed is then drained with or before the close and cannot outlive it.
+	std::list<int> closed;
+	{
+	  lock lock (m_closeq.list_mutex);
+	  closed.swap (m_closeq.list);
+	}
+
+	// Process registrations.
+	{
+	  lock lock (m_timerq.list_mutex);
+	  while (!m_timerq.list.empty ()) {
+	    timers.apply (m_timerq.list.front ());
+	    m_timerq.list.pop_front ();
+	  }
+	}
+
+	{
+	  lock lock (m_readq.list_mutex);
+	  while (!m_readq.list.empty ()) {
+	    fd_action a = m_readq.list.front ();
+	    m_readq.list.pop_front ();
+	    
+	    if (read_actions.find (a.first) == read_actions.end ()) {
+	      read_actions.insert (a);
+	    }
+	    else {
+	      delete a.second;
+	    }
+	  }
+	}
+
+	{
+	  lock lock (m_writeq.list_mutex);
+	  while (!m_writeq.list.empty ()) {
+	    fd_action a = m_writeq.list.front ();
+	    m_writeq.list.pop_front ();
+	    
+	    if (write_actions.find (a.first) == write_actions.end ()) {
+	      write_actions.insert (a);
+	    }
+	    else {
+	      delete a.second;
+	    }
+	  }
+	}
+
+	// Determine timeout for select.
+	// Default is to wait forever.
+	struct timeval* test_timeout;
+	struct timeval timeout;
+      
+	if (timers.empty ()) {
+	  test_timeout = 0;
+	}
+	else {
+	  time now = time::refresh ();
+
+	  if (timers.next () > now) {
+	    timeout = timers.next () - now;
+	  }
+	  else {
+	    timeout = time (0, 0);
+	  }
+
+	  test_timeout = &timeout;
+	}
+
+	// Remove closed fds.
+	for (std::list<int>::const_iterator pos = closed.begin ();
+	     pos != closed.end ();
+	     ++pos) {
+	  std::map<int, action_runnable_interface*>::iterator p;
+
+	  p = read_actions.find (*pos);
+	  if (p != read_actions.end ()) {
+	    delete p->second;
+	    read_actions.erase (p);
+	  }
+
+	  p = write_actions.find (*pos);
+	  if (p != write_actions.end ()) {
+	    delete p->second;
+	    write_actions.erase (p);
+	  }
+
+	  ::close (*pos);
+	}
+
+	// Deleting the registrations of closed fds may have removed the last runnable.
+	if (!keep_going ()) {
+	  continue;
+	}
+
+	for (std::map<int, action_runnable_interface*>::const_iterator pos = read_actions.begin ();
+	     pos != read_actions.end ();
+	     ++pos) {
+	  FD_SET (pos->first, &read_set);
+	}
+
+	for (std::map<int, action_runnable_interface*>::const_iterator pos = write_actions.begin ();
+	     pos != write_actions.end ();
+	     ++pos) {
+	  FD_SET (pos->first, &write_set);
+	}
+      
+	FD_SET (m_wakeup_fd[0], &read_set);
+
+	int max_fd = m_wakeup_fd[0];
+	if (!read_actions.empty ()) {
+	  max_fd = std::max ((--read_actions.end ())->first, max_fd);
+	}
+	if (!write_actions.empty ()) {
+	  max_fd = std::max ((--write_actions.end ())->first, max_fd);
+	}
+	int select_result = select (max_fd + 1, &read_set, &write_set, 0, test_timeout);
+	assert (select_result >= 0);
+      
+	// Process timers.
+	{
+	  time now = time::refresh ();
+
+	  while (action_runnable_interface* a = timers.expire (now, m_model)) {
+	    schedule_execq (a);
+	  }
+	}
+
+	if (select_result > 0) {
+	  for (std::map<int, action_runnable_interface*>::iterator pos = read_actions.begin ();
+	       pos != read_actions.end ();
+	       ) {
+	    if (FD_ISSET (pos->first, &read_set)) {
+	      FD_CLR (pos->first, &read_set);
+	      schedule_execq (pos->second);
+	      read_actions.erase (pos++);
+	    }
+	    else {
+	      ++pos;
+	    }
+	  }
+	}
+
+	if (select_result > 0) {
+	  for (std::map<int, action_runnable_interface*>::iterator pos = write_actions.begin ();
+	       pos != write_actions.end ();
+	       ) {
+	    if (FD_ISSET (pos->first, &write_set)) {
+	      FD_CLR (pos->first, &write_set);
+	      schedule_execq (pos->second);
+	      write_actions.erase (pos++);
+	    }
+	    else {
+	      ++pos;
+	    }
+	  }
+	}
+
+	if (select_result > 0) {
+	  if (FD_ISSET (m_wakeup_fd[0], &read_set)) {
+	    char c[3];
+	    assert (read (m_wakeup_fd[0], c, 3) > 0);
+	  }
+	}
+
+      }
+    }
+
+  public:
+    sharded_scheduler_impl (const int shards) :
+      m_model (*this),
+      SHARD_COUNT (shard_count (shards)),
+      SYS_PRODUCER (SHARD_COUNT),
+      IO_PRODUCER (SHARD_COUNT + 1)
+    {
+      // Spread the shards over the processors we are allowed to use.
+      std::vector<int> cpus;
+#ifdef __linux__
+      cpu_set_t set;
+      CPU_ZERO (&set);
+      if (sched_getaffinity (0, sizeof (set), &set) == 0) {
+	for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+	  if (CPU_ISSET (cpu, &set)) {
+	    cpus.push_back (cpu);
+	  }
+	}
+      }
+#endif
+      if (cpus.empty ()) {
+	cpus.push_back (0);
+      }
+
+      for (int i = 0; i < SHARD_COUNT; ++i) {
+	m_shards.push_back (new shard (IO_PRODUCER + 1, cpus[i % cpus.size ()]));
+	m_producers.push_back (new producer (i, m_shards[i]));
+      }
+      m_producers.push_back (new producer (SYS_PRODUCER, 0));
+      m_producers.push_back (new producer (IO_PRODUCER, 0));
+    }
+
+    ~sharded_scheduler_impl () {
+      for (int i = 0; i < SHARD_COUNT; ++i) {
+	delete m_shards[i];
+      }
+      for (size_t i = 0; i < m_producers.size (); ++i) {
+	delete m_producers[i];
+      }
+    }
+
+    aid_t get_current_aid () {
+      aid_t retval = m_current_aid.get ();
+      assert (retval != -1);
+      return retval;
+    }
+
+    size_t binding_count (const action_executor_interface& ac) {
+      return m_model.binding_count (ac);
+    }
+  
+    void schedule (automaton::sys_create_type automaton::*member_ptr) {
+      schedule_sysq (new sys_create_runnable (get_current_aid ()));
+    }
+  
+    void schedule (automaton::sys_bind_type automaton::*member_ptr) {
+      schedule_sysq (new sys_bind_runnable (get_current_aid ()));
+    }
+
+    void schedule (automaton::sys_unbind_type automaton::*member_ptr) {
+      schedule_sysq (new sys_unbind_runnable (get_current_aid ()));
+    }
+  
+    void schedule (automaton::sys_destroy_type automaton::*member_ptr) {
+      schedule_sysq (new sys_destroy_runnable (get_current_aid ()));
+    }
+
+    void schedule (action_runnable_interface* r) {
+      schedule_execq (r);
+    }
+
+    void schedule_after (action_runnable_interface* r,
+			 const time& offset) {
+      schedule_timerq (timer_request (timer_request::AFTER, r, time::now () + offset, time ()));
+    }
+
+    void schedule_every (action_runnable_interface* r,
+			 const time& period) {
+      schedule_timerq (timer_request (timer_request::EVERY, r, time::now () + period, period));
+    }
+
+    void cancel_timer (action_runnable_interface* r) {
+      schedule_timerq (timer_request (timer_request::CANCEL, r, time (), time ()));
+    }
+
+    void schedule_read_ready (action_runnable_interface* r,
+			      int fd) {
+      schedule_readq (r, fd);
+    }
+
+    void schedule_write_ready (action_runnable_interface* r,
+			       int fd) {
+      schedule_writeq (r, fd);
+    }
+
+    void run (std::auto_ptr<allocator_interface> allocator) {
+      int r;
+    
+      assert (m_sysq.list.size () == 0);
+      assert (!keep_going ());
+    
+      r = pipe (m_wakeup_fd);
+      assert (r == 0);
+      r = fcntl (m_wakeup_fd[0], F_SETFL, O_NONBLOCK);
+      assert (r == 0);
+      r = fcntl (m_wakeup_fd[1], F_SETFL, O_NONBLOCK);
+      assert (r == 0);
+
+      for (int i = 0; i < SHARD_COUNT; ++i) {
+	r = pipe (m_shards[i]->m_wakeup_fd);
+	assert (r == 0);
+	r = fcntl (m_shards[i]->m_wakeup_fd[0], F_SETFL, O_NONBLOCK);
+	assert (r == 0);
+	r = fcntl (m_shards[i]->m_wakeup_fd[1], F_SETFL, O_NONBLOCK);
+	assert (r == 0);
+      }
+
+      m_model.create (allocator);
+    
+      m_next_shard = 0;
+      thread sysq_thread (*this, &sharded_scheduler_impl::process_sysq);
+      thread ioq_thread (*this, &sharded_scheduler_impl::process_ioq);
+
+      std::vector<thread*> threads;
+      for (int i = 0; i < SHARD_COUNT; ++i) {
+	threads.push_back (new thread (*this, &sharded_scheduler_impl::process_shard));
+      }
+      for (int i = 0; i < SHARD_COUNT; ++i) {
+	threads[i]->join ();
+	delete threads[i];
+      }
+      threads.clear ();
+
+      ioq_thread.join ();
+      sysq_thread.join ();
+
+      // Reset.  See simple_scheduler.cpp.
+      m_model.clear ();
+    
+      for (std::list<std::pair<bool, runnable_interface*> >::iterator pos = m_sysq.list.begin ();
+	   pos != m_sysq.list.end ();
+	   ++pos) {
+	delete pos->second;
+      }
+      m_sysq.list.clear ();
+
+      for (int i = 0; i < SHARD_COUNT; ++i) {
+	m_shards[i]->clear ();
+	::close (m_shards[i]->m_wakeup_fd[0]);
+	::close (m_shards[i]->m_wakeup_fd[1]);
+      }
+        
+      ::close (m_wakeup_fd[0]);
+      ::close (m_wakeup_fd[1]);
+
+      assert (m_sysq.list.size () == 0);
+      assert (!keep_going ());
+    }
+  
+    void close (int fd) {
+      if (m_closeq.push (fd) == 1) {
+	wakeup_io_thread ();
+      }
+    }
+
+    void set_current_aid (const aid_t aid) {
+      assert (aid != -1);
+      m_current_aid.set (aid);
+    }
+  
+    void clear_current_aid () {
+      m_current_aid.set (-1);
+    }
+
+    void create (const aid_t automaton,
+		 std::auto_ptr<allocator_interface> allocator,
+		 void* const key) {
+      schedule_sysq (new create_runnable (automaton, allocator, key));
+    }
+
+    void bind (const aid_t automaton,
+	       std::auto_ptr<bind_executor_interface> exec,
+	       void* const key) {
+      // A binding that crosses shards is carried by the input's shard queue.
+      if (exec->get_fifo () == 0 &&
+	  shard_of (exec->get_output ().get_aid ()) != shard_of (exec->get_input ().get_aid ())) {
+	exec->set_fifo (fifo ());
+      }
+      schedule_sysq (new bind_runnable (automaton, exec, key));
+    }
+  
+    void unbind (const aid_t automaton,
+		 void* const key) {
+      schedule_sysq (new unbind_runnable (automaton, key));
+    }
+  
+    void destroy (const aid_t automaton,
+		  void* const key) {
+      schedule_sysq (new destroy_runnable (automaton, key));
+    }
+
+    void created (const aid_t aid,
+		  const created_t t,
+		  void* const key,
+		  const aid_t child) {
+      schedule_sysq (make_action_runnable (automaton_handle<automaton> (aid), &automaton::sys_created, automaton::created_arg_t (t, key, child), system_input_category ()));
+    }
+  
+    void bound (const aid_t aid,
+		const bound_t t,
+		void* const key) {
+      schedule_sysq (make_action_runnable (automaton_handle<automaton> (aid), &automaton::sys_bound, std::make_pair (t, key), system_input_category ()));
+    }
+
+    void output_bound (const output_executor_interface& exec) {
+      schedule_sysq (new output_bound_runnable (exec));
+      schedule_execq (new output_exec_runnable (exec));
+    }
+
+    void input_bound (const input_executor_interface& exec) {
+      schedule_sysq (new input_bound_runnable (exec));
+    }
+
+    void unbound (const aid_t aid,
+		  const unbound_t t,
+		  void* const key) {
+      schedule_sysq (make_action_runnable (automaton_handle<automaton> (aid), &automaton::sys_unbound, std::make_pair (t, key), system_input_category ()));
+    }
+
+    void output_unbound (const output_executor_interface& exec) {
+      schedule_sysq (new output_unbound_runnable (exec));
+      schedule_execq (new output_exec_runnable (exec));
+    }
+
+    void input_unbound (const input_executor_interface& exec) {
+      schedule_sysq (new input_unbound_runnable (exec));
+    }
+
+    void destroyed (const aid_t aid,
+		    const destroyed_t t,
+		    void* const key) {
+      schedule_sysq (make_action_runnable (automaton_handle<automaton> (aid), &automaton::sys_destroyed, std::make_pair (t, key), system_input_category ()));
+    }
+
+    void deliver (const input_executor_interface& exec) {
+      schedule_execq (new deliver_runnable (exec));
+    }
+
+    void drained (const output_executor_interface& exec) {
+      schedule_execq (new output_exec_runnable (exec));
+    }
+  };
+
+  sharded_scheduler::sharded_scheduler (const int shards) :
+    m_impl (new sharded_scheduler_impl (shards))
+  { }
+
+  sharded_scheduler::~sharded_scheduler () {
+    delete m_impl;
+  }
+    
+  aid_t sharded_scheduler::get_current_aid () {
+    return m_impl->get_current_aid ();
+  }
+  
+  size_t sharded_scheduler::binding_count (const action_executor_interface& ac) {
+    return m_impl->binding_count (ac);
+  }
+  
+  void sharded_scheduler::schedule (automaton::sys_create_type automaton::*ptr) {
+    m_impl->schedule (ptr);
+  }
+    
+  void sharded_scheduler::schedule (automaton::sys_bind_type automaton::*ptr) {
+    m_impl->schedule (ptr);
+  }
+  
+  void sharded_scheduler::schedule (automaton::sys_unbind_type automaton::*ptr) {
+    m_impl->schedule (ptr);
+  }
+  
+  void sharded_scheduler::schedule (automaton::sys_destroy_type automaton::*ptr) {
+    m_impl->schedule (ptr);
+  }
+  
+  void sharded_scheduler::schedule (action_runnable_interface* r) {
+    m_impl->schedule (r);
+  }
+  
+  void sharded_scheduler::schedule_after (action_runnable_interface* r,
+					  const time& offset) {
+    m_impl->schedule_after (r, offset);
+  }
+  
+  void sharded_scheduler::schedule_every (action_runnable_interface* r,
+					  const time& period) {
+    m_impl->schedule_every (r, period);
+  }
+
+  void sharded_scheduler::cancel_timer (action_runnable_interface* r) {
+    m_impl->cancel_timer (r);
+  }
+  
+  void sharded_scheduler::schedule_read_ready (action_runnable_interface* r,
+					       int fd) {
+    m_impl->schedule_read_ready (r, fd);
+  }
+  
+  void sharded_scheduler::schedule_write_ready (action_runnable_interface* r,
+						int fd) {
+    m_impl->schedule_write_ready (r, fd);
+  }
+
+  void sharded_scheduler::close (int fd) {
+    m_impl->close (fd);
+  }
+
+  void sharded_scheduler::run (std::auto_ptr<allocator_interface> allocator) {
+    m_impl->run (allocator);
+  }
+  
+}
@@ -0,0 +1,268 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <ioa/shm_ring.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+namespace ioa {
+
+  /*
+    The counters only increase so the number of bytes in the ring is tail - head.
+    The counters are on separate cache lines so the reader and writer do not share a line.
+    The header is writable by the peer so every value read from it is checked before it is used to index the data.
+  */
+  struct shm_ring::header
+  {
+    uint64_t capacity;
+    char pad0[56];
+    // Written by the reader.
+    volatile uint64_t head;
+    volatile uint32_t reader_waiting;
+    char pad1[52];
+    // Written by the writer.
+    volatile uint64_t tail;
+    volatile uint32_t writer_waiting;
+    char pad2[52];
+  };
+
+  int shm_ring::create (const size_t capacity,
+			shm_ring_descriptor& descriptor) {
+    assert (capacity != 0);
+
+#ifdef __linux__
+    shm_ring_descriptor d;
+    d.memory_fd = memfd_create ("ioa_shm_ring", MFD_CLOEXEC);
+    if (d.memory_fd == -1) {
+      return errno;
+    }
+
+    int err = 0;
+    const size_t size = sizeof (header) + capacity;
+    void* ptr = MAP_FAILED;
+    if (ftruncate (d.memory_fd, size) == -1 ||
+	(ptr = mmap (0, size, PROT_READ | PROT_WRITE, MAP_SHARED, d.memory_fd, 0)) == MAP_FAILED) {
+      err = errno;
+    }
+    else {
+      // The rest of the header is zero.
+      static_cast<header*> (ptr)->capacity = capacity;
+      munmap (ptr, size);
+
+      d.data_fd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+      if (d.data_fd == -1) {
+	err = errno;
+      }
+      else {
+	d.space_fd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (d.space_fd == -1) {
+	  err = errno;
+	  ::close (d.data_fd);
+	}
+      }
+    }
+
+    if (err != 0) {
+      ::close (d.memory_fd);
+      return err;
+    }
+
+    descriptor = d;
+    return 0;
+#else
+    // memfd_create and eventfd are Linux-only.
+    (void)descriptor;
+    return ENOSYS;
+#endif
+  }
+
+  int shm_ring::duplicate (const shm_ring_descriptor& descriptor,
+			   shm_ring_descriptor& copy) {
+    shm_ring_descriptor d;
+    d.memory_fd = dup (descriptor.memory_fd);
+    d.data_fd = dup (descriptor.data_fd);
+    d.space_fd = dup (descriptor.space_fd);
+    if (d.memory_fd == -1 || d.data_fd == -1 || d.space_fd == -1) {
+      const int err = errno;
+      ::close (d.memory_fd);
+      ::close (d.data_fd);
+      ::close (d.space_fd);
+      return err;
+    }
+    copy = d;
+    return 0;
+  }
+
+  void shm_ring::signal (const int fd) {
+    const uint64_t one = 1;
+    // Fails only if the counter would overflow in which case the fd is readable.
+    ssize_t r = ::write (fd, &one, sizeof (one));
+    (void)r;
+  }
+
+  void shm_ring::clear (const int fd) {
+    uint64_t value;
+    ssize_t r = ::read (fd, &value, sizeof (value));
+    (void)r;
+  }
+
+  shm_ring::shm_ring () :
+    m_header (0),
+    m_data (0),
+    m_mapping_size (0),
+    m_capacity (0)
+  { }
+
+  shm_ring::~shm_ring () {
+    detach ();
+  }
+
+  void shm_ring::detach () {
+    if (m_header != 0) {
+      munmap (m_header, m_mapping_size);
+      m_header = 0;
+      m_data = 0;
+    }
+  }
+
+  int shm_ring::attach (const int memory_fd) {
+    assert (m_header == 0);
+
+    const off_t size = lseek (memory_fd, 0, SEEK_END);
+    if (size == -1) {
+      return errno;
+    }
+    if (size < static_cast<off_t> (sizeof (header))) {
+      return EINVAL;
+    }
+
+    void* ptr = mmap (0, size, PROT_READ | PROT_WRITE, MAP_SHARED, memory_fd, 0);
+    if (ptr == MAP_FAILED) {
+      return errno;
+    }
+
+    m_header = static_cast<header*> (ptr);
+    m_data = static_cast<char*> (ptr) + sizeof (header);
+    m_mapping_size = size;
+    // The peer can change the header so the capacity is taken once, here.
+    m_capacity = m_header->capacity;
+    if (m_capacity == 0 || m_capacity != m_mapping_size - sizeof (header)) {
+      detach ();
+      return EINVAL;
+    }
+    return 0;
+  }
+
+  bool shm_ring::attached () const {
+    return m_header != 0;
+  }
+
+  size_t shm_ring::capacity () const {
+    return m_capacity;
+  }
+
+  ssize_t shm_ring::write (const char* buf,
+			   const size_t size) {
+    const uint64_t capacity = m_capacity;
+    const uint64_t head = m_header->head;
+    // Read head before overwriting the bytes it frees.
+    __sync_synchronize ();
+    const uint64_t tail = m_header->tail;
+    if (tail - head > capacity) {
+      // The reader claims to have consumed bytes that were never written.
+      detach ();
+      errno = EPROTO;
+      return -1;
+    }
+    const size_t n = std::min (static_cast<uint64_t> (size), capacity - (tail - head));
+    const size_t offset = tail % capacity;
+    const size_t first = std::min (n, static_cast<size_t> (capacity - offset));
+    memcpy (m_data + offset, buf, first);
+    memcpy (m_data, buf + first, n - first);
+    // Publish the bytes before the new tail.
+    __sync_synchronize ();
+    m_header->tail = tail + n;
+    return n;
+  }
+
+  bool shm_ring::reader_waiting () {
+    // Pairs with the barrier in wait_for_data ().
+    __sync_synchronize ();
+    return m_header->reader_waiting != 0 && __sync_bool_compare_and_swap (&m_header->reader_waiting, 1, 0);
+  }
+
+  bool shm_ring::wait_for_space () {
+    m_header->writer_waiting = 1;
+    __sync_synchronize ();
+    if (m_header->tail - m_header->head < m_capacity) {
+      // The reader freed space after we looked.
+      __sync_bool_compare_and_swap (&m_header->writer_waiting, 1, 0);
+      return false;
+    }
+    return true;
+  }
+
+  ssize_t shm_ring::read (std::string& buf) {
+    const uint64_t capacity = m_capacity;
+    const uint64_t tail = m_header->tail;
+    // Read tail before the bytes it publishes.
+    __sync_synchronize ();
+    const uint64_t head = m_header->head;
+    if (tail - head > capacity) {
+      // The writer claims to have written more than the ring holds.
+      detach ();
+      errno = EPROTO;
+      return -1;
+    }
+    const size_t n = tail - head;
+    const size_t offset = head % capacity;
+    const size_t first = std::min (n, static_cast<size_t> (capacity - offset));
+    buf.append (m_data + offset, first);
+    buf.append (m_data, n - first);
+    // Finish copying before freeing the bytes.
+    __sync_synchronize ();
+    m_header->head = head + n;
+    return n;
+  }
+
+  bool shm_ring::writer_waiting () {
+    // Pairs with the barrier in wait_for_space ().
+    __sync_synchronize ();
+    return m_header->writer_waiting != 0 && __sync_bool_compare_and_swap (&m_header->writer_waiting, 1, 0);
+  }
+
+  bool shm_ring::wait_for_data () {
+    m_header->reader_waiting = 1;
+    __sync_synchronize ();
+    if (m_header->tail != m_header->head) {
+      // The writer added data after we looked.
+      __sync_bool_compare_and_swap (&m_header->reader_waiting, 1, 0);
+      return false;
+    }
+    return true;
+  }
+
+}
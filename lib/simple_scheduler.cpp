@@ -19,6 +19,7 @@
 #include <ioa/system_scheduler_interface.hpp>
 
 #include "model.hpp"
+#include "timer_set.hpp"
 #include "blocking_list.hpp"
 #include "thread_key.hpp"
 #include "lock.hpp"
@@ -46,6 +47,7 @@
 #include "input_bound_runnable.hpp"
 #include "output_unbound_runnable.hpp"
 #include "input_unbound_runnable.hpp"
+#include "deliver_runnable.hpp"
 
 #include <iostream>
 
@@ -58,7 +60,6 @@ namespace ioa {
     return (os << d);
   }
 
-  typedef std::pair<time, action_runnable_interface*> time_action;
   typedef std::pair<int, action_runnable_interface*> fd_action;
 
   class simple_scheduler_impl :
@@ -140,7 +141,7 @@ namespace ioa {
     mutex m_context_mutex;
     std::vector<thread_context*> m_contexts;
     int m_wakeup_fd[2];
-    blocking_list<time_action> m_timerq;
+    blocking_list<timer_request> m_timerq;
     blocking_list<fd_action> m_readq;
     blocking_list<fd_action> m_writeq;
     // TODO:  Replace with block set.  Actually, all of these could be sets.
@@ -166,13 +167,6 @@ namespace ioa {
       }
     };
 
-    struct compare_action_runnable
-    {
-      bool operator() (const action_runnable_interface* x,
-		       const action_runnable_interface* y) const {
-	return (*x) < (*y);
-      }
-    };
 
     bool keep_going () {
       // The criteria for continuing is simple: a runnable exists.
@@ -287,8 +281,8 @@ namespace ioa {
       assert (bytes_written == 1);
     }
 
-    void schedule_timerq (action_runnable_interface* r, const time& offset) {
-      if (m_timerq.push (std::make_pair (time::now () + offset, r)) == 1) {
+    void schedule_timerq (const timer_request& request) {
+      if (m_timerq.push (request) == 1) {
 	wakeup_io_thread ();
       }
     }
@@ -308,8 +302,7 @@ namespace ioa {
     void process_ioq () {
       clear_current_aid ();
     
-      std::multimap<time, action_runnable_interface*> time_to_action;
-      std::map<action_runnable_interface*, time, compare_action_runnable> action_to_time;
+      timer_set timers;
       std::map<int, action_runnable_interface*> read_actions;
       std::map<int, action_runnable_interface*> write_actions;
     
@@ -325,36 +318,8 @@ namespace ioa {
 	{
 	  lock lock (m_timerq.list_mutex);
 	  while (!m_timerq.list.empty ()) {
-	    time_action a = m_timerq.list.front ();
+	    timers.apply (m_timerq.list.front ());
 	    m_timerq.list.pop_front ();
-
-	    std::map<action_runnable_interface*, time, compare_action_runnable>::iterator pos = action_to_time.find (a.second);
-	    
-	    if (pos == action_to_time.end ()) {
-	      // Insert new action.
-	      time_to_action.insert (a);
-	      action_to_time.insert (std::make_pair (a.second, a.first));
-	    }
-	    else if (a.first < pos->second) {
-	      // Action already has a time but new time is earlier.
-	      
-	      // Remove old action.
-	      delete pos->first;
-	      std::multimap<time, action_runnable_interface*>::iterator pos2;
-	      for (pos2 = time_to_action.find (pos->second);
-		   pos2 != time_to_action.end () && pos2->second != pos->first;
-		   ++pos2) ;;
-	      time_to_action.erase (pos2);
-	      action_to_time.erase (pos);
-	      
-	      // Insert new action.
-	      time_to_action.insert (a);
-	      action_to_time.insert (std::make_pair (a.second, a.first));
-	    }
-	    else {
-	      // Action will execute after existing action.
-	      delete a.second;
-	    }
 	  }
 	}
 
@@ -393,15 +358,15 @@ namespace ioa {
 	struct timeval* test_timeout;
 	struct timeval timeout;
       
-	if (time_to_action.empty ()) {
+	if (timers.empty ()) {
 	  test_timeout = 0;
 	}
 	else {
-	  time now = time::now ();
+	  time now = time::refresh ();
 
-	  if (time_to_action.begin ()->first > now) {
+	  if (timers.next () > now) {
 	    // Timer is some time in future.
-	    timeout = time_to_action.begin ()->first - now;
+	    timeout = timers.next () - now;
 	  }
 	  else {
 	    // Timer is in the past.  Return immediately.
@@ -436,6 +401,11 @@ namespace ioa {
 	  }
 	}
 
+	// Cancelled timers and the registrations of closed fds may have been the last runnables.
+	if (!keep_going ()) {
+	  continue;
+	}
+
 	// Determine the read set.
 	for (std::map<int, action_runnable_interface*>::const_iterator pos = read_actions.begin ();
 	     pos != read_actions.end ();
@@ -466,12 +436,9 @@ namespace ioa {
       
 	// Process timers.
 	{
-	  time now = time::now ();
+	  time now = time::refresh ();
 
-	  while (!time_to_action.empty () && time_to_action.begin ()->first < now) {
-	    action_runnable_interface* a = time_to_action.begin ()->second;
-	    time_to_action.erase (time_to_action.begin ());
-	    action_to_time.erase (a);
+	  while (action_runnable_interface* a = timers.expire (now, m_model)) {
 	    schedule_execq (a);
 	  }
 	}
@@ -579,7 +546,16 @@ namespace ioa {
 
     void schedule_after (action_runnable_interface* r,
 			 const time& offset) {
-      schedule_timerq (r, offset);
+      schedule_timerq (timer_request (timer_request::AFTER, r, time::now () + offset, time ()));
+    }
+
+    void schedule_every (action_runnable_interface* r,
+			 const time& period) {
+      schedule_timerq (timer_request (timer_request::EVERY, r, time::now () + period, period));
+    }
+
+    void cancel_timer (action_runnable_interface* r) {
+      schedule_timerq (timer_request (timer_request::CANCEL, r, time (), time ()));
     }
 
     void schedule_read_ready (action_runnable_interface* r,
@@ -763,6 +739,14 @@ namespace ioa {
       schedule_sysq (make_action_runnable (automaton_handle<automaton> (aid), &automaton::sys_destroyed, std::make_pair (t, key), system_input_category ()));
     }
 
+    void deliver (const input_executor_interface& exec) {
+      schedule_execq (new deliver_runnable (exec));
+    }
+
+    void drained (const output_executor_interface& exec) {
+      schedule_execq (new output_exec_runnable (exec));
+    }
+
     void begin_sys_call () {
       thread_context* context = m_con.get ();
       if (context != 0) {
@@ -819,6 +803,15 @@ namespace ioa {
     m_impl->schedule_after (r, offset);
   }
   
+  void simple_scheduler::schedule_every (action_runnable_interface* r,
+					 const time& period) {
+    m_impl->schedule_every (r, period);
+  }
+
+  void simple_scheduler::cancel_timer (action_runnable_interface* r) {
+    m_impl->cancel_timer (r);
+  }
+  
   void simple_scheduler::schedule_read_ready (action_runnable_interface* r,
 					      int fd) {
     m_impl->schedule_read_ready (r, fd);
@@ -0,0 +1,89 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef __spsc_queue_hpp__
+#define __spsc_queue_hpp__
+
+namespace ioa {
+
+  /*
+    An unbounded single-producer/single-consumer queue.
+    Exactly one thread may call push () and exactly one thread may call pop ().
+    Neither side takes a lock.
+    The consumer owns the list up to and including m_head which is always a stub node.
+    The producer owns m_tail and publishes a node by linking it after the barrier.
+  */
+  template <class T>
+  class spsc_queue
+  {
+  private:
+    struct node
+    {
+      node* volatile next;
+      T value;
+
+      node () :
+	next (0)
+      { }
+    };
+
+    node* m_head;
+    node* m_tail;
+
+    // No copying.
+    spsc_queue (const spsc_queue&) { }
+    void operator= (const spsc_queue&) { }
+
+  public:
+    spsc_queue () :
+      m_head (new node ()),
+      m_tail (m_head)
+    { }
+
+    ~spsc_queue () {
+      while (m_head != 0) {
+	node* next = m_head->next;
+	delete m_head;
+	m_head = next;
+      }
+    }
+
+    void push (const T& t) {
+      node* n = new node ();
+      n->value = t;
+      // The value must be visible before the node is.
+      __sync_synchronize ();
+      m_tail->next = n;
+      m_tail = n;
+    }
+
+    bool pop (T& t) {
+      node* next = m_head->next;
+      if (next == 0) {
+	return false;
+      }
+      __sync_synchronize ();
+      t = next->value;
+      delete m_head;
+      m_head = next;
+      return true;
+    }
+
+  };
+
+}
+
+#endif
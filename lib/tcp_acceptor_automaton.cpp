@@ -16,18 +16,25 @@
 
  #include <ioa/tcp_acceptor_automaton.hpp>
 
+#include <algorithm>
 #include <fcntl.h>
 
 namespace ioa {
 
   tcp_acceptor_automaton::tcp_acceptor_automaton (const ioa::inet_address& address,
-						  const int backlog) :
+						  const int backlog,
+						  const bool reuse_port,
+						  const size_t accept_batch) :
     m_address (address),
     m_state (SCHEDULE_READ_READY),
     m_errno (0),
     m_error_reported (false),
+    m_accept_batch (std::max (accept_batch, static_cast<size_t> (1))),
     m_self (get_aid ())
   {
+    add_observable (&accepted);
+    add_observable (&init);
+
     try {
       // Open a socket.
       m_fd = socket (AF_INET, SOCK_STREAM, 0);
@@ -67,6 +74,20 @@ namespace ioa {
       //       }
       // #endif
 
+      if (reuse_port) {
+#ifdef SO_REUSEPORT
+	// Share the port with other acceptors.
+	const int val = 1;
+	if (setsockopt (m_fd, SOL_SOCKET, SO_REUSEPORT, &val, sizeof (val)) == -1) {
+	  m_errno = errno;
+	  throw std::exception ();
+	}
+#else
+	m_errno = ENOPROTOOPT;
+	throw std::exception ();
+#endif
+      }
+
       // Bind.
       if (::bind (m_fd, address.get_sockaddr (), address.get_socklen ()) == -1) {
 	m_errno = errno;
@@ -85,12 +106,17 @@ namespace ioa {
 
   tcp_acceptor_automaton::~tcp_acceptor_automaton () {
     if (m_fd != -1) {
-      close (m_fd);
+      ioa::close (m_fd);
     }
     while (!m_fd_queue.empty ()) {
       close (m_fd_queue.front ());
       m_fd_queue.pop ();
     }
+    for (std::map<aid_t, std::pair<handle_manager<tcp_connection_automaton>, int> >::const_iterator pos = m_handoffs.begin ();
+	 pos != m_handoffs.end ();
+	 ++pos) {
+      close (pos->second.second);
+    }
   }
 
   void tcp_acceptor_automaton::schedule () const {
@@ -100,8 +126,66 @@ namespace ioa {
     if (schedule_read_ready_precondition ()) {
       ioa::schedule (&tcp_acceptor_automaton::schedule_read_ready);
     }
-    if (create_helper_precondition ()) {
-      ioa::schedule (&tcp_acceptor_automaton::create_helper);
+    if (accepted_precondition ()) {
+      ioa::schedule (&tcp_acceptor_automaton::accepted);
+    }
+    if (handoff_precondition ()) {
+      ioa::schedule (&tcp_acceptor_automaton::handoff);
+    }
+
+    // init is scheduled when its binding is made.
+  }
+
+  void tcp_acceptor_automaton::observe (observable* o) {
+    if (o == &accepted) {
+      // A new consumer might let us accept.
+      schedule ();
+    }
+    else if (o == &init) {
+      if (init.recent_op == BOUND) {
+	ioa::schedule (&tcp_acceptor_automaton::init, init.recent_parameter);
+      }
+      else if (init.recent_op == UNBOUND) {
+	// The connection was destroyed before it received the fd.
+	recycle (init.recent_parameter);
+	schedule ();
+      }
+    }
+    else {
+      binding_manager_interface* bm = static_cast<binding_manager_interface*> (o);
+      std::map<binding_manager_interface*, aid_t>::iterator pos = m_bindings.find (bm);
+      if (pos == m_bindings.end ()) {
+	return;
+      }
+      switch (bm->get_state ()) {
+      case binding_manager_interface::START:
+	break;
+      case binding_manager_interface::OUTPUT_AUTOMATON_DNE:
+      case binding_manager_interface::INPUT_AUTOMATON_DNE:
+      case binding_manager_interface::BINDING_EXISTS:
+      case binding_manager_interface::INPUT_ACTION_UNAVAILABLE:
+      case binding_manager_interface::OUTPUT_ACTION_UNAVAILABLE:
+	// The binding manager deletes itself.
+	recycle (pos->second);
+	m_bindings.erase (pos);
+	schedule ();
+	break;
+      case binding_manager_interface::BOUND:
+	// Bound connections are handled through init.
+	m_bindings.erase (pos);
+	remove_observable (bm);
+	break;
+      case binding_manager_interface::UNBOUND:
+	break;
+      }
+    }
+  }
+
+  void tcp_acceptor_automaton::recycle (const aid_t aid) {
+    std::map<aid_t, std::pair<handle_manager<tcp_connection_automaton>, int> >::iterator pos = m_handoffs.find (aid);
+    if (pos != m_handoffs.end ()) {
+      m_fd_queue.push (pos->second.second);
+      m_handoffs.erase (pos);
     }
   }
 
@@ -115,6 +199,20 @@ namespace ioa {
     schedule ();
   }
 
+  bool tcp_acceptor_automaton::accepted_precondition () const {
+    return !m_fd_queue.empty () && binding_count (&tcp_acceptor_automaton::accepted) != 0;
+  }
+
+  fd_transfer tcp_acceptor_automaton::accepted_effect () {
+    fd_transfer retval (m_fd_queue.front ());
+    m_fd_queue.pop ();
+    return retval;
+  }
+
+  void tcp_acceptor_automaton::accepted_schedule () const {
+    schedule ();
+  }
+
   bool tcp_acceptor_automaton::error_precondition () const {
     return m_errno != 0 && m_error_reported == false && binding_count (&tcp_acceptor_automaton::error) != 0;
   }
@@ -129,7 +227,8 @@ namespace ioa {
   }
 
   bool tcp_acceptor_automaton::schedule_read_ready_precondition () const {
-    return  m_state == SCHEDULE_READ_READY && m_errno == 0 && !m_connection_queue.empty () && m_fd_queue.empty ();
+    return m_state == SCHEDULE_READ_READY && m_errno == 0 && m_fd_queue.empty () &&
+      (!m_connection_queue.empty () || binding_count (&tcp_acceptor_automaton::accepted) != 0);
   }
 
   void tcp_acceptor_automaton::schedule_read_ready_effect () {
@@ -149,13 +248,33 @@ namespace ioa {
   void tcp_acceptor_automaton::read_ready_effect () {
     m_state = SCHEDULE_READ_READY;
 
-    inet_address address;
-    int connection_fd = ::accept (m_fd, address.get_sockaddr_ptr (), address.get_socklen_ptr ());
-    if (connection_fd != -1) {
-      m_fd_queue.push (connection_fd);	
-    }
-    else {
-      m_errno = errno;
+    // Drain the backlog.
+    for (size_t count = 0; count != m_accept_batch; ++count) {
+      inet_address address;
+#ifdef SOCK_NONBLOCK
+      int connection_fd = ::accept4 (m_fd, address.get_sockaddr_ptr (), address.get_socklen_ptr (), SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+      int connection_fd = ::accept (m_fd, address.get_sockaddr_ptr (), address.get_socklen_ptr ());
+      if (connection_fd != -1) {
+	fcntl (connection_fd, F_SETFL, fcntl (connection_fd, F_GETFL, 0) | O_NONBLOCK);
+	fcntl (connection_fd, F_SETFD, FD_CLOEXEC);
+      }
+#endif
+      if (connection_fd != -1) {
+	m_fd_queue.push (connection_fd);
+      }
+      else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+	// Empty.
+	break;
+      }
+      else if (errno == EINTR || errno == ECONNABORTED) {
+	// The connection went away before it was accepted.
+	continue;
+      }
+      else {
+	m_errno = errno;
+	break;
+      }
     }
   }
 
@@ -163,33 +282,48 @@ namespace ioa {
     schedule ();
   }
 
-  bool tcp_acceptor_automaton::create_helper_precondition () const {
+  bool tcp_acceptor_automaton::handoff_precondition () const {
     return !m_connection_queue.empty () && !m_fd_queue.empty ();
   }
 
-  void tcp_acceptor_automaton::create_helper_effect () {
-    automaton_manager<connection_init_automaton>* helper = make_automaton_manager (this, make_allocator<connection_init_automaton> (m_connection_queue.front (), m_fd_queue.front ()));
+  void tcp_acceptor_automaton::handoff_effect () {
+    const automaton_handle<tcp_connection_automaton> conn = m_connection_queue.front ();
     m_connection_queue.pop ();
+
+    if (m_handoffs.count (conn) != 0) {
+      // The connection is already waiting for an fd.
+      return;
+    }
+
+    // Bind init directly to the connection instead of going through a helper automaton.
+    std::pair<handle_manager<tcp_connection_automaton>, int>& handoff = m_handoffs[conn];
+    handoff.first = handle_manager<tcp_connection_automaton> (conn);
+    handoff.second = m_fd_queue.front ();
     m_fd_queue.pop ();
-    make_binding_manager (this,
-			  helper, &connection_init_automaton::done,
-			  &m_self, &tcp_acceptor_automaton::done, helper);
+    binding_manager_interface* bm = make_binding_manager (this,
+							  &m_self, &tcp_acceptor_automaton::init,
+							  &handoff.first, &tcp_connection_automaton::init);
+    m_bindings.insert (std::make_pair (bm, conn));
+    add_observable (bm);
   }
 
-  void tcp_acceptor_automaton::create_helper_schedule () const {
+  void tcp_acceptor_automaton::handoff_schedule () const {
     schedule ();
   }
 
-  void tcp_acceptor_automaton::done_effect (const int& fd,
-					    automaton_manager<connection_init_automaton>* helper) {
-    if (fd != -1) {
-      // Recycle.
-      m_fd_queue.push (fd);
-    }
-    helper->destroy ();
+  bool tcp_acceptor_automaton::init_precondition (aid_t aid) const {
+    return m_handoffs.count (aid) != 0 && binding_count (&tcp_acceptor_automaton::init, aid) != 0;
+  }
+
+  int tcp_acceptor_automaton::init_effect (aid_t aid) {
+    std::map<aid_t, std::pair<handle_manager<tcp_connection_automaton>, int> >::iterator pos = m_handoffs.find (aid);
+    const int fd = pos->second.second;
+    // The binding stays until the connection is destroyed.
+    m_handoffs.erase (pos);
+    return fd;
   }
 
-  void tcp_acceptor_automaton::done_schedule (automaton_manager<connection_init_automaton>*) const {
+  void tcp_acceptor_automaton::init_schedule (aid_t) const {
     schedule ();
   }
 
@@ -15,14 +15,191 @@
 */
 
 #include <ioa/tcp_connection_automaton.hpp>
+#include <ioa/inbox_automaton.hpp>
+#include "thread.hpp"
+#include "lock.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <list>
 #include <sys/ioctl.h>
 #include <errno.h>
 #include <unistd.h>
 #include <sys/socket.h>
+#include <netinet/in.h>
+#include <poll.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+#ifdef MSG_ZEROCOPY
+#include <linux/errqueue.h>
+#endif
 
 namespace ioa {
 
+  // Below this size copying is cheaper than pinning pages and reaping the completion.
+  static const size_t ZEROCOPY_THRESHOLD = 16384;
+
+  typedef std::deque<std::pair<uint32_t, std::string> > zerocopy_queue;
+
+#ifdef MSG_ZEROCOPY
+  static void release_zerocopy (zerocopy_queue& pending,
+				const uint32_t sequence) {
+    // Sequence numbers wrap.
+    while (!pending.empty () &&
+	   static_cast<int32_t> (pending.front ().first - sequence) <= 0) {
+      pending.pop_front ();
+    }
+  }
+#endif
+
+  // Drops the pending buffers whose completions are queued on fd and returns the error reported by the socket or 0.
+  static int reap_errqueue (const int fd,
+			    zerocopy_queue& pending) {
+    int error = 0;
+#ifdef MSG_ZEROCOPY
+    for (;;) {
+      char control[CMSG_SPACE (sizeof (struct sock_extended_err)) + 64];
+      struct msghdr msg;
+      memset (&msg, 0, sizeof (msg));
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof (control);
+      if (recvmsg (fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) == -1) {
+	if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+	  error = errno;
+	}
+	break;
+      }
+
+      for (struct cmsghdr* cm = CMSG_FIRSTHDR (&msg); cm != 0; cm = CMSG_NXTHDR (&msg, cm)) {
+	if ((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+	    (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)) {
+	  const struct sock_extended_err* err = reinterpret_cast<const struct sock_extended_err*> (CMSG_DATA (cm));
+	  if (err->ee_origin == SO_EE_ORIGIN_ZEROCOPY && err->ee_errno == 0) {
+	    // ee_info through ee_data have completed.
+	    release_zerocopy (pending, err->ee_data);
+	  }
+	  else if (err->ee_errno != 0) {
+	    error = err->ee_errno;
+	  }
+	}
+      }
+    }
+#endif
+    return error;
+  }
+
+  /*
+    Keeps the sockets of destroyed connections open until the kernel releases their zero-copy buffers.
+    The kernel may still be reading the buffers so they cannot be freed, and the socket cannot be closed, before it reports that it is done.
+    A peer that stops acknowledging holds them until the connection times out.
+    One thread, started by the first connection that needs it, polls the error queues of every adopted socket.
+  */
+  class zerocopy_reaper
+  {
+  private:
+    struct grave {
+      int fd;
+      zerocopy_queue pending;
+      // Hung up sockets are always ready so they are reaped on a timer instead of polled.
+      bool hung_up;
+
+      grave (const int f) :
+	fd (f),
+	hung_up (false)
+      { }
+    };
+
+    mutex m_mutex;
+    inbox_signal m_signal;
+    std::list<grave> m_graves;
+    thread* m_thread;
+
+    static zerocopy_reaper* m_instance;
+    static pthread_once_t m_once;
+
+    static void create () {
+      m_instance = new zerocopy_reaper ();
+    }
+
+    zerocopy_reaper () :
+      m_thread (0)
+    { }
+
+    void run () {
+      std::vector<struct pollfd> fds;
+      for (;;) {
+	bool hung_up = false;
+	fds.clear ();
+	struct pollfd p;
+	p.fd = m_signal.get_fd ();
+	p.events = POLLIN;
+	p.revents = 0;
+	fds.push_back (p);
+	{
+	  lock l (m_mutex);
+	  for (std::list<grave>::const_iterator pos = m_graves.begin ();
+	       pos != m_graves.end ();
+	       ++pos) {
+	    if (pos->hung_up) {
+	      hung_up = true;
+	    }
+	    else {
+	      // The error queue is reported as POLLERR.
+	      p.fd = pos->fd;
+	      p.events = 0;
+	      fds.push_back (p);
+	    }
+	  }
+	}
+
+	poll (&fds[0], fds.size (), hung_up ? 10 : -1);
+	m_signal.clear ();
+
+	// Only this thread removes graves so the polled ones are still in order.
+	lock l (m_mutex);
+	size_t polled = 1;
+	for (std::list<grave>::iterator pos = m_graves.begin ();
+	     pos != m_graves.end ();) {
+	  bool hup = false;
+	  if (!pos->hung_up && polled != fds.size () && fds[polled].fd == pos->fd) {
+	    hup = (fds[polled].revents & POLLHUP) != 0;
+	    ++polled;
+	  }
+	  reap_errqueue (pos->fd, pos->pending);
+	  if (pos->pending.empty ()) {
+	    ::close (pos->fd);
+	    pos = m_graves.erase (pos);
+	    continue;
+	  }
+	  pos->hung_up = pos->hung_up || hup;
+	  ++pos;
+	}
+      }
+    }
+
+  public:
+    static zerocopy_reaper& instance () {
+      pthread_once (&m_once, create);
+      return *m_instance;
+    }
+
+    // Takes fd and the buffers it still holds.
+    void adopt (const int fd,
+		zerocopy_queue& pending) {
+      lock l (m_mutex);
+      m_graves.push_back (grave (fd));
+      m_graves.back ().pending.swap (pending);
+      if (m_thread == 0) {
+	m_thread = new thread (*this, &zerocopy_reaper::run);
+      }
+      m_signal.signal ();
+    }
+  };
+
+  zerocopy_reaper* zerocopy_reaper::m_instance = 0;
+  pthread_once_t zerocopy_reaper::m_once = PTHREAD_ONCE_INIT;
+
   void tcp_connection_automaton::schedule () const {
     if (schedule_write_precondition ()) {
       ioa::schedule (&tcp_connection_automaton::schedule_write);
@@ -30,12 +207,18 @@ namespace ioa {
     if (send_complete_precondition ()) {
       ioa::schedule (&tcp_connection_automaton::send_complete);
     }
+    if (backpressure_precondition ()) {
+      ioa::schedule (&tcp_connection_automaton::backpressure);
+    }
     if (schedule_read_precondition ()) {
       ioa::schedule (&tcp_connection_automaton::schedule_read);
     }
     if (receive_precondition ()) {
       ioa::schedule (&tcp_connection_automaton::receive);
     }
+    if (receive_chunks_precondition ()) {
+      ioa::schedule (&tcp_connection_automaton::receive_chunks);
+    }
     if (connected_precondition ()) {
       ioa::schedule (&tcp_connection_automaton::connected);
     }
@@ -44,36 +227,178 @@ namespace ioa {
     }
   }
 
-  tcp_connection_automaton::tcp_connection_automaton () :
+  tcp_connection_automaton::tcp_connection_automaton (const size_t chunk_size,
+						      const size_t chunk_count,
+						      const size_t high_watermark,
+						      const size_t low_watermark) :
+    m_fd (-1),
+    m_errno (0),
+    m_connected_reported (false),
+    m_error_reported (false),
+    m_send_state (SEND_WAIT),
+    m_send_offset (0),
+    m_send_queued (0),
+    m_send_iov (64),
+    m_send_complete (false),
+    m_high_watermark (high_watermark),
+    m_low_watermark (std::min (low_watermark, high_watermark)),
+    m_congested (false),
+    m_congested_reported (false),
+    m_zerocopy (ZEROCOPY_UNKNOWN),
+    m_zerocopy_sequence (0),
+    m_errqueue_fd (-1),
+    m_errqueue_wait (false),
+    m_receive_state (SCHEDULE_READ_READY),
+    m_buffer (0),
+    m_buffer_size (0),
+    m_pool (chunk_size != 0 ? new chunk_pool (chunk_size) : 0),
+    m_chunk_count (std::max (chunk_count, static_cast<size_t> (1))),
+    m_iov (m_chunk_count)
+  {
+    add_observable (&backpressure);
+  }
+
+  tcp_connection_automaton::tcp_connection_automaton (const fd_transfer& fd,
+						      const size_t chunk_size,
+						      const size_t chunk_count,
+						      const size_t high_watermark,
+						      const size_t low_watermark) :
     m_fd (-1),
     m_errno (0),
     m_connected_reported (false),
     m_error_reported (false),
     m_send_state (SEND_WAIT),
+    m_send_offset (0),
+    m_send_queued (0),
+    m_send_iov (64),
+    m_send_complete (false),
+    m_high_watermark (high_watermark),
+    m_low_watermark (std::min (low_watermark, high_watermark)),
+    m_congested (false),
+    m_congested_reported (false),
+    m_zerocopy (ZEROCOPY_UNKNOWN),
+    m_zerocopy_sequence (0),
+    m_errqueue_fd (-1),
+    m_errqueue_wait (false),
     m_receive_state (SCHEDULE_READ_READY),
     m_buffer (0),
-    m_buffer_size (0)
-  { }
+    m_buffer_size (0),
+    m_pool (chunk_size != 0 ? new chunk_pool (chunk_size) : 0),
+    m_chunk_count (std::max (chunk_count, static_cast<size_t> (1))),
+    m_iov (m_chunk_count)
+  {
+    add_observable (&backpressure);
+    const int f = fd.take ();
+    if (f != -1) {
+      adopt (f);
+    }
+    else {
+      m_errno = EBADF;
+    }
+    schedule ();
+  }
 
   tcp_connection_automaton::~tcp_connection_automaton () {
+    if (m_fd != -1 && !m_zerocopy_pending.empty ()) {
+      reap_zerocopy ();
+      if (!m_zerocopy_pending.empty ()) {
+	// The scheduler may still be watching m_fd so the reaper gets a duplicate that keeps the socket open.
+	const int fd = dup (m_fd);
+	if (fd != -1) {
+	  zerocopy_reaper::instance ().adopt (fd, m_zerocopy_pending);
+	}
+	else {
+	  // Without a descriptor the completions cannot be seen.  Leak the buffers rather than let the allocator reuse pages that are still being sent.
+	  zerocopy_queue* leaked = new zerocopy_queue ();
+	  leaked->swap (m_zerocopy_pending);
+	}
+      }
+    }
+    if (m_errqueue_fd != -1) {
+      ioa::close (m_errqueue_fd);
+    }
     if (m_fd != -1) {
       ioa::close (m_fd);
     }
     delete[] m_buffer;
+    for (std::vector<chunk_buffer*>::const_iterator pos = m_chunks.begin ();
+	 pos != m_chunks.end ();
+	 ++pos) {
+      release_chunk_buffer (*pos);
+    }
+    if (m_pool != 0) {
+      m_pool->release ();
+    }
   }
 
-  void tcp_connection_automaton::send_effect (const std::string& buf) {
-    if (m_errno == 0 && m_send_state == SEND_WAIT) {
-      m_send_buffer = buf;
-      m_bytes_written = 0;
-      m_send_state = SCHEDULE_WRITE_READY;
+  void tcp_connection_automaton::observe (observable* o) {
+    if (o == &backpressure && backpressure.recent_op == BOUND) {
+      // Report the current state to the new sender.
+      m_congested_reported = !m_congested;
+      schedule ();
+    }
+  }
+
+  void tcp_connection_automaton::update_congestion () {
+    if (!m_congested && m_send_queued >= m_high_watermark) {
+      m_congested = true;
+    }
+    else if (m_congested && m_send_queued <= m_low_watermark) {
+      m_congested = false;
     }
   }
 
+  void tcp_connection_automaton::update_send_complete () {
+    if (m_send_queue.empty () && m_zerocopy_pending.empty ()) {
+      m_send_complete = true;
+    }
+  }
+
+  void tcp_connection_automaton::enqueue (const send_kind_t kind,
+					  const std::string& buf,
+					  const file_region& file) {
+    if (m_errno == 0) {
+      const send_item item (kind, buf, file);
+      if (item.size () != 0) {
+	m_send_queue.push_back (item);
+	m_send_queued += item.size ();
+	m_send_complete = false;
+	update_congestion ();
+	if (m_send_state == SEND_WAIT) {
+	  m_send_state = SCHEDULE_WRITE_READY;
+	}
+      }
+      else {
+	update_send_complete ();
+      }
+    }
+  }
+
+  void tcp_connection_automaton::send_effect (const std::string& buf) {
+    enqueue (SEND_COPY, buf, file_region ());
+  }
+
   void tcp_connection_automaton::send_schedule () const {
     schedule ();
   }
 
+  void tcp_connection_automaton::send_zerocopy_effect (const std::string& buf) {
+    // Small strings may live inside the string object and cannot be pinned.
+    enqueue (buf.size () >= ZEROCOPY_THRESHOLD ? SEND_ZEROCOPY : SEND_COPY, buf, file_region ());
+  }
+
+  void tcp_connection_automaton::send_zerocopy_schedule () const {
+    schedule ();
+  }
+
+  void tcp_connection_automaton::send_file_effect (const file_region& file) {
+    enqueue (SEND_FILE, std::string (), file);
+  }
+
+  void tcp_connection_automaton::send_file_schedule () const {
+    schedule ();
+  }
+
   bool tcp_connection_automaton::schedule_write_precondition () const {
     return m_fd != -1 && m_errno == 0 && m_send_state == SCHEDULE_WRITE_READY;
   }
@@ -91,48 +416,223 @@ namespace ioa {
     return m_fd != -1 && m_errno == 0 && m_send_state == WRITE_READY_WAIT;
   }
 
-  void tcp_connection_automaton::write_ready_effect () {
-    // Write to the socket.
+  ssize_t tcp_connection_automaton::write_copy () {
+    // Gather as many queued buffers as one call accepts.
+    size_t count = 0;
+    std::deque<send_item>::const_iterator pos = m_send_queue.begin ();
+    for (; count < m_send_iov.size () && pos != m_send_queue.end () && pos->kind != SEND_FILE; ++count, ++pos) {
+      if (pos->kind == SEND_ZEROCOPY && m_zerocopy == ZEROCOPY_ENABLED && count != 0) {
+	break;
+      }
+      const size_t offset = (count == 0) ? m_send_offset : 0;
+      m_send_iov[count].iov_base = const_cast<char*> (pos->data.data ()) + offset;
+      m_send_iov[count].iov_len = pos->data.size () - offset;
+    }
+
 #ifdef MSG_NOSIGNAL
-    ssize_t bytes_written = ::send (m_fd, static_cast<const char*> (m_send_buffer->data ()) + m_bytes_written, m_send_buffer->size () - m_bytes_written, MSG_NOSIGNAL);
+    struct msghdr msg;
+    memset (&msg, 0, sizeof (msg));
+    msg.msg_iov = &m_send_iov[0];
+    msg.msg_iovlen = count;
+    return sendmsg (m_fd, &msg, MSG_NOSIGNAL);
 #else
-    ssize_t bytes_written = write (m_fd, static_cast<const char*> (m_send_buffer.data ()) + m_bytes_written, m_send_buffer.size () - m_bytes_written);
+    return writev (m_fd, &m_send_iov[0], count);
 #endif
+  }
 
-    if (bytes_written == -1) {
-      m_errno = errno;
+  ssize_t tcp_connection_automaton::write_zerocopy () {
+#ifdef MSG_ZEROCOPY
+    if (m_zerocopy == ZEROCOPY_UNKNOWN) {
+      const int set = 1;
+      m_zerocopy = (setsockopt (m_fd, SOL_SOCKET, SO_ZEROCOPY, &set, sizeof (int)) == 0) ? ZEROCOPY_ENABLED : ZEROCOPY_DISABLED;
     }
-    else {
-      // We have made progress.
-      m_bytes_written += bytes_written;
-      
-      if (m_bytes_written == static_cast<ssize_t> (m_send_buffer.size ())) {
-	// We are done with this buffer.
-	m_send_state = SEND_COMPLETE_READY;
+
+    if (m_zerocopy == ZEROCOPY_ENABLED) {
+      send_item& item = m_send_queue.front ();
+      struct iovec iov;
+      iov.iov_base = const_cast<char*> (item.data.data ()) + m_send_offset;
+      iov.iov_len = item.data.size () - m_send_offset;
+      struct msghdr msg;
+      memset (&msg, 0, sizeof (msg));
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+      const ssize_t bytes_written = sendmsg (m_fd, &msg, MSG_ZEROCOPY | MSG_NOSIGNAL);
+      if (bytes_written != -1) {
+	// Every successful call consumes one notification sequence number.
+	++m_zerocopy_sequence;
+	item.pinned = true;
+	return bytes_written;
+      }
+      else if (errno != ENOBUFS) {
+	return -1;
+      }
+      // Out of option memory for notifications.  Copy instead.
+    }
+#else
+    m_zerocopy = ZEROCOPY_DISABLED;
+#endif
+    return write_copy ();
+  }
+
+  ssize_t tcp_connection_automaton::write_file () {
+    const file_region& file = m_send_queue.front ().file;
+    off_t offset = file.offset + m_send_offset;
+    const size_t length = file.length - m_send_offset;
+#ifdef __linux__
+    const ssize_t bytes_written = sendfile (m_fd, file.fd, &offset, length);
+#else
+    char buffer[65536];
+    ssize_t bytes_written = pread (file.fd, buffer, std::min (length, sizeof (buffer)), offset);
+    if (bytes_written > 0) {
+      bytes_written = write (m_fd, buffer, bytes_written);
+    }
+#endif
+    if (bytes_written == 0) {
+      // The file is shorter than the region.
+      errno = EIO;
+      return -1;
+    }
+    return bytes_written;
+  }
+
+  void tcp_connection_automaton::written (size_t bytes) {
+    // Discard the items that were written.
+    m_send_queued -= bytes;
+    while (bytes != 0) {
+      send_item& item = m_send_queue.front ();
+      const size_t left = item.size () - m_send_offset;
+      if (bytes >= left) {
+	bytes -= left;
+	if (item.pinned) {
+	  // Swap so the kernel's pages stay where they are.
+	  m_zerocopy_pending.push_back (std::make_pair (m_zerocopy_sequence - 1, std::string ()));
+	  m_zerocopy_pending.back ().second.swap (item.data);
+	}
+	m_send_queue.pop_front ();
+	m_send_offset = 0;
       }
       else {
-	// Not done.
+	m_send_offset += bytes;
+	bytes = 0;
+      }
+    }
+    update_congestion ();
+  }
+
+  void tcp_connection_automaton::write_ready_effect () {
+    ssize_t bytes_written;
+    switch (m_send_queue.front ().kind) {
+    case SEND_COPY:
+      bytes_written = write_copy ();
+      break;
+    case SEND_ZEROCOPY:
+      bytes_written = write_zerocopy ();
+      break;
+    case SEND_FILE:
+      bytes_written = write_file ();
+      break;
+    default:
+      assert (false);
+      bytes_written = -1;
+      break;
+    }
+
+    if (bytes_written == -1) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+	// Spurious.  Wait again.
 	m_send_state = SCHEDULE_WRITE_READY;
       }
+      else {
+	m_errno = errno;
+      }
+      return;
+    }
+
+    // We have made progress.
+    written (bytes_written);
+
+    if (!m_zerocopy_pending.empty () && !m_errqueue_wait) {
+      wait_errqueue ();
+    }
+
+    if (m_send_queue.empty ()) {
+      m_send_state = SEND_WAIT;
+      update_send_complete ();
+    }
+    else {
+      m_send_state = SCHEDULE_WRITE_READY;
     }
   }
 
   void tcp_connection_automaton::write_ready_schedule () const {
     schedule ();
   }
+
+  void tcp_connection_automaton::reap_zerocopy () {
+    const int error = reap_errqueue (m_fd, m_zerocopy_pending);
+    if (error != 0) {
+      m_errno = error;
+    }
+
+    if (m_send_queue.empty ()) {
+      update_send_complete ();
+    }
+  }
+
+  void tcp_connection_automaton::wait_errqueue () {
+    // Reads and completions are waited for separately so a receiver that is not keeping up does not delay send_complete.
+    if (m_errqueue_fd == -1) {
+      m_errqueue_fd = dup (m_fd);
+      if (m_errqueue_fd == -1) {
+	m_errno = errno;
+	return;
+      }
+    }
+    m_errqueue_wait = true;
+    ioa::schedule_read_ready (&tcp_connection_automaton::errqueue_ready, m_errqueue_fd);
+  }
+
+  bool tcp_connection_automaton::errqueue_ready_precondition () const {
+    return m_fd != -1 && m_errqueue_wait;
+  }
+
+  void tcp_connection_automaton::errqueue_ready_effect () {
+    m_errqueue_wait = false;
+    reap_zerocopy ();
+    if (m_errno == 0 && !m_zerocopy_pending.empty ()) {
+      wait_errqueue ();
+    }
+  }
+
+  void tcp_connection_automaton::errqueue_ready_schedule () const {
+    schedule ();
+  }
   
   bool tcp_connection_automaton::send_complete_precondition () const {
-    return m_send_state == SEND_COMPLETE_READY && binding_count (&tcp_connection_automaton::send_complete) != 0;
+    return m_send_complete && binding_count (&tcp_connection_automaton::send_complete) != 0;
   }
 
   void tcp_connection_automaton::send_complete_effect () {
-    m_send_state = SEND_WAIT;
+    m_send_complete = false;
   }
 
   void tcp_connection_automaton::send_complete_schedule () const {
     schedule ();
   }
   
+  bool tcp_connection_automaton::backpressure_precondition () const {
+    return m_congested != m_congested_reported && binding_count (&tcp_connection_automaton::backpressure) != 0;
+  }
+
+  bool tcp_connection_automaton::backpressure_effect () {
+    m_congested_reported = m_congested;
+    return m_congested;
+  }
+
+  void tcp_connection_automaton::backpressure_schedule () const {
+    schedule ();
+  }
+
   bool tcp_connection_automaton::schedule_read_precondition () const {
     return m_fd != -1 && m_errno == 0 && m_receive_state == SCHEDULE_READ_READY;
   }
@@ -150,7 +650,57 @@ namespace ioa {
     return m_fd != -1 && m_errno == 0 && m_receive_state == READ_READY_WAIT;
   }
 
+  void tcp_connection_automaton::read_chunks () {
+    // Keep m_chunk_count buffers ready so one readv can fill all of them.
+    while (m_chunks.size () < m_chunk_count) {
+      m_chunks.push_back (m_pool->allocate ());
+    }
+
+    const size_t chunk_size = m_pool->chunk_size ();
+    for (size_t i = 0; i < m_chunk_count; ++i) {
+      m_iov[i].iov_base = m_chunks[i]->data;
+      m_iov[i].iov_len = chunk_size;
+    }
+
+    ssize_t bytes_read = readv (m_fd, &m_iov[0], m_chunk_count);
+    if (bytes_read == -1) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+	// Spurious.  Wait again.
+	m_receive_state = SCHEDULE_READ_READY;
+      }
+      else {
+	m_errno = errno;
+      }
+      return;
+    }
+    else if (bytes_read == 0) {
+      m_errno = ECONNRESET;
+      return;
+    }
+
+    // Hand the filled buffers to chunks.
+    size_t used = 0;
+    for (; bytes_read > 0; ++used) {
+      const size_t size = std::min (static_cast<size_t> (bytes_read), chunk_size);
+      m_receive_chunks.push_back (chunk (m_chunks[used], size));
+      bytes_read -= size;
+    }
+    m_chunks.erase (m_chunks.begin (), m_chunks.begin () + used);
+
+    m_receive_state = RECEIVE_READY;
+  }
+
   void tcp_connection_automaton::read_ready_effect () {
+    if (!m_zerocopy_pending.empty ()) {
+      // Completions also make the socket readable.
+      reap_zerocopy ();
+    }
+
+    if (m_pool != 0) {
+      read_chunks ();
+      return;
+    }
+
     // Determine the number of bytes we can read without blocking.
     int num_bytes;
     if (ioctl (m_fd, FIONREAD, &num_bytes) == -1) {
@@ -158,6 +708,22 @@ namespace ioa {
       return;
     }
 
+    if (num_bytes == 0) {
+      // Either the peer closed or only the error queue is ready.
+      char c;
+      const ssize_t r = recv (m_fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+      if (r == 0) {
+	m_errno = ECONNRESET;
+      }
+      else if (r == -1 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+	m_errno = errno;
+      }
+      else {
+	m_receive_state = SCHEDULE_READ_READY;
+      }
+      return;
+    }
+
     // Resize the buffer to hold num_bytes.
     if (m_buffer_size < num_bytes) {
       delete[] m_buffer;
@@ -183,7 +749,7 @@ namespace ioa {
   }
   
   bool tcp_connection_automaton::receive_precondition () const {
-    return m_receive_state == RECEIVE_READY && binding_count (&tcp_connection_automaton::receive) != 0;
+    return m_pool == 0 && m_receive_state == RECEIVE_READY && binding_count (&tcp_connection_automaton::receive) != 0;
   }
 
   std::string tcp_connection_automaton::receive_effect () {
@@ -195,17 +761,36 @@ namespace ioa {
     schedule ();
   }
 
-  void tcp_connection_automaton::init_effect (const int& fd) {
-    if (m_fd == -1) {
-      m_fd = fd;
+  bool tcp_connection_automaton::receive_chunks_precondition () const {
+    return m_pool != 0 && m_receive_state == RECEIVE_READY && binding_count (&tcp_connection_automaton::receive_chunks) != 0;
+  }
+
+  chunk_list tcp_connection_automaton::receive_chunks_effect () {
+    m_receive_state = SCHEDULE_READ_READY;
+    chunk_list retval;
+    retval.swap (m_receive_chunks);
+    return retval;
+  }
+
+  void tcp_connection_automaton::receive_chunks_schedule () const {
+    schedule ();
+  }
+
+  void tcp_connection_automaton::adopt (const int fd) {
+    m_fd = fd;
 
-      // No SIGPIPE.
+    // No SIGPIPE.
 #ifdef SO_NOSIGPIPE
-      const int set = 1;
-      if (setsockopt (m_fd, SOL_SOCKET, SO_NOSIGPIPE, &set, sizeof (int)) == -1) {
-	m_errno = errno;
-      }
+    const int set = 1;
+    if (setsockopt (m_fd, SOL_SOCKET, SO_NOSIGPIPE, &set, sizeof (int)) == -1) {
+      m_errno = errno;
+    }
 #endif
+  }
+
+  void tcp_connection_automaton::init_effect (const int& fd) {
+    if (m_fd == -1) {
+      adopt (fd);
     }
   }
 
@@ -0,0 +1,345 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <ioa/tcp_connection_pool_automaton.hpp>
+
+#include <algorithm>
+#include <vector>
+#include <errno.h>
+
+namespace ioa {
+
+  tcp_connection_pool_automaton::tcp_connection_pool_automaton (const size_t max_idle,
+								const time& timeout,
+								const size_t retries,
+								const time& backoff) :
+    m_self (get_aid ()),
+    m_timeout (timeout),
+    m_retries (retries),
+    m_backoff (backoff),
+    m_max_idle (max_idle),
+    m_next_key (0)
+  {
+    add_observable (&acquire);
+    add_observable (&acquired);
+  }
+
+  void tcp_connection_pool_automaton::schedule () const {
+    for (std::map<aid_t, std::deque<connection_val> >::const_iterator pos = m_acquired.begin ();
+	 pos != m_acquired.end ();
+	 ++pos) {
+      if (acquired_precondition (pos->first)) {
+	ioa::schedule (&tcp_connection_pool_automaton::acquired, pos->first);
+      }
+    }
+    for (std::map<aid_t, std::deque<error_val> >::const_iterator pos = m_errors.begin ();
+	 pos != m_errors.end ();
+	 ++pos) {
+      if (error_precondition (pos->first)) {
+	ioa::schedule (&tcp_connection_pool_automaton::error, pos->first);
+      }
+    }
+  }
+
+  void tcp_connection_pool_automaton::observe (observable* o) {
+    if (o == &acquire && acquire.recent_op == UNBOUND) {
+      purge (acquire.recent_parameter);
+    }
+    else if (o == &acquired && acquired.recent_op == UNBOUND) {
+      purge (acquired.recent_parameter);
+    }
+    else {
+      for (std::map<size_t, entry>::iterator pos = m_connections.begin ();
+	   pos != m_connections.end ();
+	   ++pos) {
+	if (pos->second.manager != o) {
+	  continue;
+	}
+
+	const size_t key = pos->first;
+	const automaton_manager_interface::state_t state = pos->second.manager->get_state ();
+	if (pos->second.state == CREATING && state == automaton_manager_interface::CREATED) {
+	  m_keys.insert (std::make_pair (pos->second.manager->get_handle (), key));
+	  make_binding_manager (this,
+				pos->second.manager, &tcp_connection_automaton::error,
+				&m_self, &tcp_connection_pool_automaton::connection_error, key);
+	  --m_connecting[pos->second.address];
+	  pool (key);
+	}
+	else if (state == automaton_manager_interface::INSTANCE_EXISTS || state == automaton_manager_interface::DESTROYED) {
+	  forget (key);
+	}
+	break;
+      }
+    }
+
+    schedule ();
+  }
+
+  void tcp_connection_pool_automaton::purge (const aid_t aid) {
+    // Stop waiting first so the connections taken back are not leased to aid again.
+    for (std::map<inet_address, std::deque<aid_t> >::iterator w = m_waiting.begin ();
+	 w != m_waiting.end ();
+	 ++w) {
+      w->second.erase (std::remove (w->second.begin (), w->second.end (), aid), w->second.end ());
+    }
+
+    // Take back the connections that were not delivered.
+    std::map<aid_t, std::deque<connection_val> >::iterator pos = m_acquired.find (aid);
+    if (pos != m_acquired.end ()) {
+      std::deque<connection_val> undelivered;
+      undelivered.swap (pos->second);
+      m_acquired.erase (pos);
+      for (std::deque<connection_val>::const_iterator c = undelivered.begin ();
+	   c != undelivered.end ();
+	   ++c) {
+	std::map<aid_t, size_t>::const_iterator k = m_keys.find (c->connection);
+	if (k != m_keys.end ()) {
+	  pool (k->second);
+	}
+      }
+    }
+
+    // Destroy the connections that were delivered.
+    std::vector<size_t> leased;
+    for (std::map<size_t, entry>::const_iterator c = m_connections.begin ();
+	 c != m_connections.end ();
+	 ++c) {
+      if (c->second.state == LEASED && c->second.client == aid) {
+	leased.push_back (c->first);
+      }
+    }
+    for (std::vector<size_t>::const_iterator k = leased.begin ();
+	 k != leased.end ();
+	 ++k) {
+      remove (*k);
+    }
+
+    m_errors.erase (aid);
+  }
+
+  void tcp_connection_pool_automaton::connect (const inet_address& address) {
+    const size_t key = m_next_key++;
+    automaton_manager<tcp_connector_automaton>* connector =
+      make_automaton_manager (this, make_allocator<tcp_connector_automaton> (address, m_timeout, m_retries, m_backoff));
+    make_binding_manager (this,
+			  connector, &tcp_connector_automaton::connected,
+			  &m_self, &tcp_connection_pool_automaton::connected, key);
+    make_binding_manager (this,
+			  connector, &tcp_connector_automaton::error,
+			  &m_self, &tcp_connection_pool_automaton::connect_error, key);
+    m_connectors.insert (std::make_pair (key, std::make_pair (address, connector)));
+    ++m_connecting[address];
+  }
+
+  void tcp_connection_pool_automaton::lease (const size_t key,
+					     const aid_t aid) {
+    entry& e = m_connections.find (key)->second;
+    e.state = LEASED;
+    e.client = aid;
+    m_acquired[aid].push_back (connection_val (e.address, e.manager->get_handle ()));
+  }
+
+  void tcp_connection_pool_automaton::pool (const size_t key) {
+    entry& e = m_connections.find (key)->second;
+    std::deque<aid_t>& waiting = m_waiting[e.address];
+    std::deque<size_t>& idle = m_idle[e.address];
+    if (!waiting.empty ()) {
+      // Go straight to the next client.
+      const aid_t aid = waiting.front ();
+      waiting.pop_front ();
+      lease (key, aid);
+    }
+    else if (idle.size () < m_max_idle) {
+      e.state = IDLE;
+      e.client = -1;
+      idle.push_back (key);
+    }
+    else {
+      remove (key);
+    }
+  }
+
+  void tcp_connection_pool_automaton::remove (const size_t key) {
+    std::map<size_t, entry>::iterator pos = m_connections.find (key);
+    entry& e = pos->second;
+    if (e.state == IDLE) {
+      std::deque<size_t>& idle = m_idle[e.address];
+      idle.erase (std::find (idle.begin (), idle.end (), key));
+    }
+    m_keys.erase (e.manager->get_handle ());
+    e.manager->destroy ();
+    m_connections.erase (pos);
+  }
+
+  void tcp_connection_pool_automaton::forget (const size_t key) {
+    // The manager deletes itself so the connection is dropped without destroying it.
+    std::map<size_t, entry>::iterator pos = m_connections.find (key);
+    entry& e = pos->second;
+    if (e.state == CREATING) {
+      fail (e.address, ECONNABORTED);
+    }
+    else if (e.state == IDLE) {
+      std::deque<size_t>& idle = m_idle[e.address];
+      idle.erase (std::find (idle.begin (), idle.end (), key));
+    }
+    for (std::map<aid_t, size_t>::iterator k = m_keys.begin (); k != m_keys.end (); ++k) {
+      if (k->second == key) {
+	m_keys.erase (k);
+	break;
+      }
+    }
+    m_connections.erase (pos);
+  }
+
+  void tcp_connection_pool_automaton::fail (const inet_address& address,
+					    const int error) {
+    --m_connecting[address];
+
+    std::deque<aid_t>& waiting = m_waiting[address];
+    if (!waiting.empty ()) {
+      m_errors[waiting.front ()].push_back (error_val (address, error));
+      waiting.pop_front ();
+    }
+  }
+
+  void tcp_connection_pool_automaton::acquire_effect (const inet_address& address,
+						      aid_t aid) {
+    std::deque<size_t>& idle = m_idle[address];
+    if (!idle.empty ()) {
+      // The most recently used connection is the least likely to have been closed by the peer.
+      const size_t key = idle.back ();
+      idle.pop_back ();
+      lease (key, aid);
+      return;
+    }
+
+    std::deque<aid_t>& waiting = m_waiting[address];
+    waiting.push_back (aid);
+    if (waiting.size () > m_connecting[address]) {
+      connect (address);
+    }
+  }
+
+  void tcp_connection_pool_automaton::acquire_schedule (aid_t) const {
+    schedule ();
+  }
+
+  bool tcp_connection_pool_automaton::acquired_precondition (aid_t aid) const {
+    std::map<aid_t, std::deque<connection_val> >::const_iterator pos = m_acquired.find (aid);
+    return pos != m_acquired.end () && !pos->second.empty () && binding_count (&tcp_connection_pool_automaton::acquired, aid) != 0;
+  }
+
+  tcp_connection_pool_automaton::connection_val tcp_connection_pool_automaton::acquired_effect (aid_t aid) {
+    std::map<aid_t, std::deque<connection_val> >::iterator pos = m_acquired.find (aid);
+    const connection_val retval = pos->second.front ();
+    pos->second.pop_front ();
+    if (pos->second.empty ()) {
+      m_acquired.erase (pos);
+    }
+    return retval;
+  }
+
+  void tcp_connection_pool_automaton::acquired_schedule (aid_t) const {
+    schedule ();
+  }
+
+  void tcp_connection_pool_automaton::release_effect (const automaton_handle<tcp_connection_automaton>& connection,
+						      aid_t aid) {
+    std::map<aid_t, size_t>::const_iterator pos = m_keys.find (connection);
+    if (pos != m_keys.end ()) {
+      const entry& e = m_connections.find (pos->second)->second;
+      // Only the client holding the connection can give it back.
+      if (e.state == LEASED && e.client == aid) {
+	pool (pos->second);
+      }
+    }
+  }
+
+  void tcp_connection_pool_automaton::release_schedule (aid_t) const {
+    schedule ();
+  }
+
+  bool tcp_connection_pool_automaton::error_precondition (aid_t aid) const {
+    std::map<aid_t, std::deque<error_val> >::const_iterator pos = m_errors.find (aid);
+    return pos != m_errors.end () && !pos->second.empty () && binding_count (&tcp_connection_pool_automaton::error, aid) != 0;
+  }
+
+  tcp_connection_pool_automaton::error_val tcp_connection_pool_automaton::error_effect (aid_t aid) {
+    std::map<aid_t, std::deque<error_val> >::iterator pos = m_errors.find (aid);
+    const error_val retval = pos->second.front ();
+    pos->second.pop_front ();
+    if (pos->second.empty ()) {
+      m_errors.erase (pos);
+    }
+    return retval;
+  }
+
+  void tcp_connection_pool_automaton::error_schedule (aid_t) const {
+    schedule ();
+  }
+
+  void tcp_connection_pool_automaton::connected_effect (const fd_transfer& fd,
+							size_t key) {
+    std::map<size_t, std::pair<inet_address, automaton_manager<tcp_connector_automaton>*> >::iterator pos = m_connectors.find (key);
+    if (pos == m_connectors.end ()) {
+      return;
+    }
+
+    const inet_address address = pos->second.first;
+    pos->second.second->destroy ();
+    m_connectors.erase (pos);
+
+    automaton_manager<tcp_connection_automaton>* connection =
+      make_automaton_manager (this, make_allocator<tcp_connection_automaton> (fd));
+    // Handed out once it has been created.
+    add_observable (connection);
+    m_connections.insert (std::make_pair (key, entry (address, connection)));
+  }
+
+  void tcp_connection_pool_automaton::connected_schedule (size_t) const {
+    schedule ();
+  }
+
+  void tcp_connection_pool_automaton::connect_error_effect (const int& error,
+							    size_t key) {
+    std::map<size_t, std::pair<inet_address, automaton_manager<tcp_connector_automaton>*> >::iterator pos = m_connectors.find (key);
+    if (pos == m_connectors.end ()) {
+      return;
+    }
+
+    const inet_address address = pos->second.first;
+    pos->second.second->destroy ();
+    m_connectors.erase (pos);
+    fail (address, error);
+  }
+
+  void tcp_connection_pool_automaton::connect_error_schedule (size_t) const {
+    schedule ();
+  }
+
+  void tcp_connection_pool_automaton::connection_error_effect (const int&,
+							       size_t key) {
+    if (m_connections.find (key) != m_connections.end ()) {
+      remove (key);
+    }
+  }
+
+  void tcp_connection_pool_automaton::connection_error_schedule (size_t) const {
+    schedule ();
+  }
+
+}
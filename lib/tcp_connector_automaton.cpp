@@ -24,62 +24,128 @@ namespace ioa {
     if (error_precondition ()) {
       ioa::schedule (&tcp_connector_automaton::error);
     }
+    if (connected_precondition ()) {
+      ioa::schedule (&tcp_connector_automaton::connected);
+    }
+    if (init_precondition ()) {
+      ioa::schedule (&tcp_connector_automaton::init);
+    }
+  }
+
+  void tcp_connector_automaton::observe (observable*) {
+    schedule ();
   }
 
   tcp_connector_automaton::tcp_connector_automaton (const inet_address& address,
-						    const automaton_handle<tcp_connection_automaton>& connection) :
+						    const automaton_handle<tcp_connection_automaton>& connection,
+						    const time& timeout,
+						    const size_t retries,
+						    const time& backoff) :
     m_self (get_aid ()),
     m_connection (connection),
+    m_address (address),
+    m_timeout (timeout),
+    m_retries (retries),
+    m_backoff (backoff),
+    m_fd (-1),
+    m_connected (false),
+    m_retry_wait (false),
     m_errno (0),
     m_error_reported (false) {
+    add_observable (&init);
+    // Hand the socket directly to the connection instead of going through a helper automaton.
+    make_binding_manager (this,
+			  &m_self, &tcp_connector_automaton::init,
+			  &m_connection, &tcp_connection_automaton::init);
+    attempt ();
+    schedule ();
+  }
 
-    try {
-      // Open a socket.
-      m_fd = socket (AF_INET, SOCK_STREAM, 0);
-      if (m_fd == -1) {
-	m_errno = errno;
-	throw std::exception ();
-      }
+  tcp_connector_automaton::tcp_connector_automaton (const inet_address& address,
+						    const time& timeout,
+						    const size_t retries,
+						    const time& backoff) :
+    m_self (get_aid ()),
+    m_address (address),
+    m_timeout (timeout),
+    m_retries (retries),
+    m_backoff (backoff),
+    m_fd (-1),
+    m_connected (false),
+    m_retry_wait (false),
+    m_errno (0),
+    m_error_reported (false) {
+    add_observable (&connected);
+    attempt ();
+    schedule ();
+  }
+
+  void tcp_connector_automaton::attempt () {
+    if (m_address.get_errno () != 0) {
+      // Retrying will not help.
+      m_errno = m_address.get_errno ();
+      return;
+    }
+
+    // Open a socket.
+    m_fd = socket (m_address.get_sockaddr ()->sa_family, SOCK_STREAM, 0);
+    if (m_fd == -1) {
+      fail (errno);
+      return;
+    }
       
-      // Get the flags.
-      int flags = fcntl (m_fd, F_GETFL, 0);
-      if (flags < 0) {
-	m_errno = errno;
-	throw std::exception ();
-      }
+    // Get the flags.
+    int flags = fcntl (m_fd, F_GETFL, 0);
+    if (flags < 0) {
+      fail (errno);
+      return;
+    }
       
-      // Set non-blocking.
-      flags |= O_NONBLOCK;
-      if (fcntl (m_fd, F_SETFL, flags) == -1) {
-	m_errno = errno;
-	throw std::exception ();
-      }
+    // Set non-blocking.
+    flags |= O_NONBLOCK;
+    if (fcntl (m_fd, F_SETFL, flags) == -1) {
+      fail (errno);
+      return;
+    }
       
-      if (::connect (m_fd, address.get_sockaddr (), address.get_socklen ()) != -1) {
-	automaton_manager<connection_init_automaton>* init = make_automaton_manager (this, make_allocator<connection_init_automaton> (m_connection, m_fd));
-	make_binding_manager (this,
-			      init, &connection_init_automaton::done,
-			      &m_self, &tcp_connector_automaton::done);
-	throw std::exception ();
-      }
-      else {
-	if (errno == EINPROGRESS) {
-	  // Asynchronous connect.
-	  ioa::schedule_write_ready (&ioa::tcp_connector_automaton::write_ready, m_fd);
-	}
-	else {
-	  m_errno = errno;
-	  throw std::exception ();
-	}
+    if (::connect (m_fd, m_address.get_sockaddr (), m_address.get_socklen ()) != -1) {
+      m_connected = true;
+    }
+    else if (errno == EINPROGRESS) {
+      // Asynchronous connect.
+      ioa::schedule_write_ready (&tcp_connector_automaton::write_ready, m_fd);
+      if (m_timeout > time ()) {
+	m_deadline = time::now () + m_timeout;
+	ioa::schedule_after (&tcp_connector_automaton::timeout, m_timeout);
       }
-    } catch (...) { }
+    }
+    else {
+      fail (errno);
+    }
+  }
 
-    schedule ();
+  void tcp_connector_automaton::fail (const int error) {
+    if (m_fd != -1) {
+      // Also drops the write_ready registration.
+      ioa::close (m_fd);
+      m_fd = -1;
+      ioa::cancel_timer (&tcp_connector_automaton::timeout);
+    }
+
+    if (m_retries != 0) {
+      --m_retries;
+      m_retry_wait = true;
+      ioa::schedule_after (&tcp_connector_automaton::retry, m_backoff);
+      m_backoff += m_backoff;
+    }
+    else {
+      m_errno = error;
+    }
   }
 
   tcp_connector_automaton::~tcp_connector_automaton () {
     if (m_fd != -1) {
-      close (m_fd);
+      ioa::close (m_fd);
     }
   }
 
@@ -96,8 +162,23 @@ namespace ioa {
     schedule ();
   }
 
+  bool tcp_connector_automaton::connected_precondition () const {
+    return m_connected && binding_count (&tcp_connector_automaton::connected) != 0;
+  }
+
+  fd_transfer tcp_connector_automaton::connected_effect () {
+    fd_transfer retval (m_fd);
+    m_fd = -1;
+    m_connected = false;
+    return retval;
+  }
+
+  void tcp_connector_automaton::connected_schedule () const {
+    schedule ();
+  }
+
   bool tcp_connector_automaton::write_ready_precondition () const {
-    return true;
+    return m_fd != -1 && !m_connected;
   }
 
   void tcp_connector_automaton::write_ready_effect () {
@@ -105,20 +186,17 @@ namespace ioa {
     int val;
     socklen_t sz = sizeof (val);
     if (getsockopt (m_fd, SOL_SOCKET, SO_ERROR, &val, &sz) == -1) {
-      m_errno = errno;
+      fail (errno);
       return;
     }
 
     if (val == 0) {
       // Success.
-      automaton_manager<connection_init_automaton>* init = make_automaton_manager (this, make_allocator<connection_init_automaton> (m_connection, m_fd));
-      make_binding_manager (this,
-			    init, &connection_init_automaton::done,
-			    &m_self, &tcp_connector_automaton::done);
-      
+      m_connected = true;
+      ioa::cancel_timer (&tcp_connector_automaton::timeout);
     }
     else {
-      m_errno = val;
+      fail (val);
     }
   }
 
@@ -126,13 +204,51 @@ namespace ioa {
     schedule ();
   }
 
-  void tcp_connector_automaton::done_effect (const int& fd) {
-    if (fd != -1) {
-      close (fd);
+  bool tcp_connector_automaton::timeout_precondition () const {
+    // The timeout is cancelled when its attempt ends but may already be queued.
+    return m_fd != -1 && !m_connected && m_timeout > time ();
+  }
+
+  void tcp_connector_automaton::timeout_effect () {
+    const time now = time::now ();
+    if (now >= m_deadline) {
+      fail (ETIMEDOUT);
     }
+    else {
+      // The timer belonged to an earlier attempt.
+      ioa::schedule_after (&tcp_connector_automaton::timeout, m_deadline - now);
+    }
+  }
+
+  void tcp_connector_automaton::timeout_schedule () const {
+    schedule ();
+  }
+
+  bool tcp_connector_automaton::retry_precondition () const {
+    return m_retry_wait;
+  }
+
+  void tcp_connector_automaton::retry_effect () {
+    m_retry_wait = false;
+    attempt ();
+  }
+
+  void tcp_connector_automaton::retry_schedule () const {
+    schedule ();
+  }
+
+  bool tcp_connector_automaton::init_precondition () const {
+    return m_connected && binding_count (&tcp_connector_automaton::init) != 0;
+  }
+
+  int tcp_connector_automaton::init_effect () {
+    const int fd = m_fd;
+    m_fd = -1;
+    m_connected = false;
+    return fd;
   }
 
-  void tcp_connector_automaton::done_schedule () const {
+  void tcp_connector_automaton::init_schedule () const {
     schedule ();
   }
 
@@ -0,0 +1,421 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <ioa/tcp_mux_automaton.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+namespace ioa {
+
+#ifdef MSG_NOSIGNAL
+  static const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+  static const int SEND_FLAGS = 0;
+#endif
+
+  tcp_mux_automaton::tcp_mux_automaton (const size_t max_events,
+					const size_t buffer_size,
+					const size_t high_watermark,
+					const size_t low_watermark) :
+    m_state (SCHEDULE_READ_READY),
+    m_epoll (-1),
+    m_errno (0),
+    m_error_reported (false),
+    m_next_id (1),
+    m_buffer (std::max (buffer_size, static_cast<size_t> (1))),
+    m_high_watermark (high_watermark),
+    m_low_watermark (std::min (low_watermark, high_watermark))
+  {
+#ifdef __linux__
+    m_events.resize (std::max (max_events, static_cast<size_t> (1)) * sizeof (struct epoll_event));
+    m_epoll = epoll_create1 (EPOLL_CLOEXEC);
+    if (m_epoll == -1) {
+      m_errno = errno;
+    }
+#else
+    m_errno = ENOSYS;
+#endif
+
+    schedule ();
+  }
+
+  tcp_mux_automaton::~tcp_mux_automaton () {
+    for (std::map<connection_id, connection>::const_iterator pos = m_connections.begin ();
+	 pos != m_connections.end ();
+	 ++pos) {
+      ::close (pos->second.fd);
+    }
+    if (m_epoll != -1) {
+      ioa::close (m_epoll);
+    }
+  }
+
+  void tcp_mux_automaton::schedule () const {
+    if (opened_precondition ()) {
+      ioa::schedule (&tcp_mux_automaton::opened);
+    }
+    if (receive_precondition ()) {
+      ioa::schedule (&tcp_mux_automaton::receive);
+    }
+    if (closed_precondition ()) {
+      ioa::schedule (&tcp_mux_automaton::closed);
+    }
+    if (backpressure_precondition ()) {
+      ioa::schedule (&tcp_mux_automaton::backpressure);
+    }
+    if (error_precondition ()) {
+      ioa::schedule (&tcp_mux_automaton::error);
+    }
+    if (schedule_read_ready_precondition ()) {
+      ioa::schedule (&tcp_mux_automaton::schedule_read_ready);
+    }
+  }
+
+  void tcp_mux_automaton::watch (const connection_id id,
+				 connection& c,
+				 const bool writing) {
+#ifdef __linux__
+    struct epoll_event event;
+    memset (&event, 0, sizeof (event));
+    event.events = (c.eof ? 0 : EPOLLIN) | (writing ? EPOLLOUT : 0);
+    event.data.u64 = id;
+    if (epoll_ctl (m_epoll, EPOLL_CTL_MOD, c.fd, &event) == -1) {
+      remove (id, errno);
+      return;
+    }
+#endif
+    c.writing = writing;
+  }
+
+  void tcp_mux_automaton::remove (const connection_id id,
+				  const int error) {
+    std::map<connection_id, connection>::iterator pos = m_connections.find (id);
+    // Closing the socket removes it from the epoll set.
+    ::close (pos->second.fd);
+    m_connections.erase (pos);
+    if (error != 0 && binding_count (&tcp_mux_automaton::error) != 0) {
+      m_error_queue.push_back (error_val (id, error));
+    }
+  }
+
+  void tcp_mux_automaton::read_socket (const connection_id id,
+				       connection& c) {
+    const ssize_t bytes_read = ::read (c.fd, &m_buffer[0], m_buffer.size ());
+    if (bytes_read > 0) {
+      m_receive_queue.push_back (message (id, std::string (&m_buffer[0], bytes_read)));
+    }
+    else if (bytes_read == 0) {
+      // The peer finished sending but may still be reading.
+      c.eof = true;
+      if (binding_count (&tcp_mux_automaton::closed) != 0) {
+	m_closed.push_back (id);
+	// Stop watching for input.
+	watch (id, c, c.writing);
+      }
+      else if (c.offset == c.send_buffer.size ()) {
+	remove (id, 0);
+      }
+      else {
+	c.closing = true;
+	watch (id, c, c.writing);
+      }
+    }
+    else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+      remove (id, errno);
+    }
+  }
+
+  void tcp_mux_automaton::write_socket (const connection_id id,
+					connection& c) {
+    while (c.offset != c.send_buffer.size ()) {
+      const ssize_t bytes_written = ::send (c.fd, c.send_buffer.data () + c.offset, c.send_buffer.size () - c.offset, SEND_FLAGS);
+      if (bytes_written >= 0) {
+	c.offset += bytes_written;
+      }
+      else if (errno == EINTR) {
+	continue;
+      }
+      else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+	break;
+      }
+      else {
+	remove (id, errno);
+	return;
+      }
+    }
+
+    update_congestion (id, c);
+
+    if (c.offset == c.send_buffer.size ()) {
+      c.send_buffer.clear ();
+      c.offset = 0;
+      if (c.closing) {
+	remove (id, 0);
+      }
+      else if (c.writing) {
+	watch (id, c, false);
+      }
+    }
+    else if (!c.writing) {
+      // Wait for the socket to drain.
+      watch (id, c, true);
+    }
+  }
+
+  void tcp_mux_automaton::update_congestion (const connection_id id,
+					     connection& c) {
+    const size_t queued = c.send_buffer.size () - c.offset;
+    if (c.congested ? queued <= m_low_watermark : queued >= m_high_watermark) {
+      c.congested = !c.congested;
+      if (binding_count (&tcp_mux_automaton::backpressure) != 0) {
+	m_backpressure_queue.push_back (backpressure_val (id, c.congested));
+      }
+    }
+  }
+
+  void tcp_mux_automaton::add_effect (const fd_transfer& fd) {
+    const int f = fd.take ();
+    if (f == -1) {
+      return;
+    }
+
+    if (m_errno != 0) {
+      ::close (f);
+      return;
+    }
+
+    const connection_id id = m_next_id++;
+    int flags = fcntl (f, F_GETFL, 0);
+    if (flags == -1 || fcntl (f, F_SETFL, flags | O_NONBLOCK) == -1) {
+      ::close (f);
+      if (binding_count (&tcp_mux_automaton::error) != 0) {
+	m_error_queue.push_back (error_val (id, errno));
+      }
+      return;
+    }
+
+#ifdef __linux__
+    struct epoll_event event;
+    memset (&event, 0, sizeof (event));
+    event.events = EPOLLIN;
+    event.data.u64 = id;
+    if (epoll_ctl (m_epoll, EPOLL_CTL_ADD, f, &event) == -1) {
+      ::close (f);
+      if (binding_count (&tcp_mux_automaton::error) != 0) {
+	m_error_queue.push_back (error_val (id, errno));
+      }
+      return;
+    }
+#endif
+
+    m_connections.insert (std::make_pair (id, connection (f)));
+    if (binding_count (&tcp_mux_automaton::opened) != 0) {
+      m_opened.push_back (id);
+    }
+  }
+
+  void tcp_mux_automaton::add_schedule () const {
+    schedule ();
+  }
+
+  bool tcp_mux_automaton::opened_precondition () const {
+    return !m_opened.empty () && binding_count (&tcp_mux_automaton::opened) != 0;
+  }
+
+  tcp_mux_automaton::connection_id tcp_mux_automaton::opened_effect () {
+    const connection_id id = m_opened.front ();
+    m_opened.pop_front ();
+    return id;
+  }
+
+  void tcp_mux_automaton::opened_schedule () const {
+    schedule ();
+  }
+
+  void tcp_mux_automaton::send_effect (const message& m) {
+    std::map<connection_id, connection>::iterator pos = m_connections.find (m.id);
+    if (pos == m_connections.end () || pos->second.closing) {
+      // The connection is gone.
+      return;
+    }
+
+    connection& c = pos->second;
+    if (c.offset != 0 && c.offset >= c.send_buffer.size () / 2) {
+      // Drop the bytes that have been written.
+      c.send_buffer.erase (0, c.offset);
+      c.offset = 0;
+    }
+    c.send_buffer.append (m.data);
+
+    if (!c.writing) {
+      // Write immediately.
+      // Most sends fit in the socket buffer so this saves waiting for the socket to become writable.
+      write_socket (m.id, c);
+    }
+    else {
+      update_congestion (m.id, c);
+    }
+  }
+
+  void tcp_mux_automaton::send_schedule () const {
+    schedule ();
+  }
+
+  void tcp_mux_automaton::disconnect_effect (const connection_id& id) {
+    std::map<connection_id, connection>::iterator pos = m_connections.find (id);
+    if (pos == m_connections.end ()) {
+      return;
+    }
+
+    if (pos->second.offset == pos->second.send_buffer.size ()) {
+      remove (id, 0);
+    }
+    else {
+      // Close after the queued bytes are written.
+      pos->second.closing = true;
+    }
+  }
+
+  void tcp_mux_automaton::disconnect_schedule () const {
+    schedule ();
+  }
+
+  bool tcp_mux_automaton::receive_precondition () const {
+    return !m_receive_queue.empty () && binding_count (&tcp_mux_automaton::receive) != 0;
+  }
+
+  tcp_mux_automaton::message tcp_mux_automaton::receive_effect () {
+    message m = m_receive_queue.front ();
+    m_receive_queue.pop_front ();
+    return m;
+  }
+
+  void tcp_mux_automaton::receive_schedule () const {
+    schedule ();
+  }
+
+  bool tcp_mux_automaton::closed_precondition () const {
+    return !m_closed.empty () && binding_count (&tcp_mux_automaton::closed) != 0;
+  }
+
+  tcp_mux_automaton::connection_id tcp_mux_automaton::closed_effect () {
+    const connection_id id = m_closed.front ();
+    m_closed.pop_front ();
+    return id;
+  }
+
+  void tcp_mux_automaton::closed_schedule () const {
+    schedule ();
+  }
+
+  bool tcp_mux_automaton::backpressure_precondition () const {
+    return !m_backpressure_queue.empty () && binding_count (&tcp_mux_automaton::backpressure) != 0;
+  }
+
+  tcp_mux_automaton::backpressure_val tcp_mux_automaton::backpressure_effect () {
+    const backpressure_val b = m_backpressure_queue.front ();
+    m_backpressure_queue.pop_front ();
+    return b;
+  }
+
+  void tcp_mux_automaton::backpressure_schedule () const {
+    schedule ();
+  }
+
+  bool tcp_mux_automaton::error_precondition () const {
+    return ((m_errno != 0 && !m_error_reported) || !m_error_queue.empty ()) && binding_count (&tcp_mux_automaton::error) != 0;
+  }
+
+  tcp_mux_automaton::error_val tcp_mux_automaton::error_effect () {
+    if (m_errno != 0 && !m_error_reported) {
+      m_error_reported = true;
+      return error_val (0, m_errno);
+    }
+    error_val e = m_error_queue.front ();
+    m_error_queue.pop_front ();
+    return e;
+  }
+
+  void tcp_mux_automaton::error_schedule () const {
+    schedule ();
+  }
+
+  bool tcp_mux_automaton::schedule_read_ready_precondition () const {
+    // Without sockets, waiting would keep the scheduler running.
+    return m_state == SCHEDULE_READ_READY && m_errno == 0 && !m_connections.empty () && m_receive_queue.empty ();
+  }
+
+  void tcp_mux_automaton::schedule_read_ready_effect () {
+    ioa::schedule_read_ready (&tcp_mux_automaton::read_ready, m_epoll);
+    m_state = READ_READY_WAIT;
+  }
+
+  void tcp_mux_automaton::schedule_read_ready_schedule () const {
+    schedule ();
+  }
+
+  bool tcp_mux_automaton::read_ready_precondition () const {
+    return m_state == READ_READY_WAIT && m_errno == 0;
+  }
+
+  void tcp_mux_automaton::read_ready_effect () {
+    m_state = SCHEDULE_READ_READY;
+
+#ifdef __linux__
+    struct epoll_event* events = reinterpret_cast<struct epoll_event*> (&m_events[0]);
+    const int count = epoll_wait (m_epoll, events, m_events.size () / sizeof (struct epoll_event), 0);
+    if (count == -1) {
+      if (errno != EINTR) {
+	m_errno = errno;
+      }
+      return;
+    }
+
+    for (int i = 0; i < count; ++i) {
+      const connection_id id = events[i].data.u64;
+
+      // An earlier event may have removed the connection.
+      std::map<connection_id, connection>::iterator pos = m_connections.find (id);
+      if (pos != m_connections.end () && (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) != 0) {
+	if (!pos->second.eof) {
+	  read_socket (id, pos->second);
+	}
+	else if (!pos->second.writing) {
+	  // The peer hung up and nothing is waiting to be written.
+	  remove (id, 0);
+	}
+	pos = m_connections.find (id);
+      }
+      if (pos != m_connections.end () && (events[i].events & EPOLLOUT) != 0) {
+	write_socket (id, pos->second);
+      }
+    }
+#endif
+  }
+
+  void tcp_mux_automaton::read_ready_schedule () const {
+    schedule ();
+  }
+
+}
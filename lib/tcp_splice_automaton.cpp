@@ -0,0 +1,278 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <ioa/tcp_splice_automaton.hpp>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+
+namespace ioa {
+
+  void tcp_splice_automaton::schedule () const {
+    for (int d = 0; d < DIRECTION_COUNT; ++d) {
+      if (pump_precondition (d)) {
+	ioa::schedule (&tcp_splice_automaton::pump, d);
+      }
+    }
+    if (bytes_precondition ()) {
+      ioa::schedule (&tcp_splice_automaton::bytes);
+    }
+    if (closed_precondition ()) {
+      ioa::schedule (&tcp_splice_automaton::closed);
+    }
+    if (error_precondition ()) {
+      ioa::schedule (&tcp_splice_automaton::error);
+    }
+  }
+
+  void tcp_splice_automaton::observe (observable*) {
+    // A new binding might enable an output.
+    schedule ();
+  }
+
+  static ssize_t splice_some (const int in,
+			      const int out,
+			      const size_t length) {
+#ifdef __linux__
+    return splice (in, 0, out, 0, length, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+  }
+
+  void tcp_splice_automaton::prepare (const int d,
+				      const size_t pipe_size) {
+    direction& dir = m_direction[d];
+    dir.source = m_fd[d];
+    dir.destination = m_fd[1 - d];
+    dir.pipe[0] = -1;
+    dir.pipe[1] = -1;
+    dir.capacity = 0;
+    dir.buffered = 0;
+    dir.pipe_full = false;
+    dir.read_wait = false;
+    dir.write_wait = false;
+    dir.eof = false;
+    dir.shutdown = false;
+
+    if (m_errno != 0) {
+      return;
+    }
+
+#ifdef __linux__
+    if (pipe2 (dir.pipe, O_NONBLOCK | O_CLOEXEC) == -1) {
+      m_errno = errno;
+      return;
+    }
+
+    // The kernel rounds the size up to a whole number of pages.
+    const int size = fcntl (dir.pipe[1], F_SETPIPE_SZ, static_cast<int> (pipe_size));
+    if (size != -1) {
+      dir.capacity = size;
+    }
+    else {
+      const int actual = fcntl (dir.pipe[1], F_GETPIPE_SZ);
+      dir.capacity = actual != -1 ? actual : 65536;
+    }
+#else
+    // splice is Linux-only.
+    m_errno = ENOSYS;
+#endif
+  }
+
+  tcp_splice_automaton::tcp_splice_automaton (const fd_transfer& a,
+					      const fd_transfer& b,
+					      const size_t pipe_size) :
+    m_closed_reported (false),
+    m_errno (0),
+    m_error_reported (false)
+  {
+    add_observable (&bytes);
+    add_observable (&closed);
+    add_observable (&error);
+
+    m_fd[0] = a.take ();
+    m_fd[1] = b.take ();
+    if (m_fd[0] == -1 || m_fd[1] == -1) {
+      m_errno = EBADF;
+    }
+    for (int i = 0; i < 2 && m_errno == 0; ++i) {
+      // splice only honors SPLICE_F_NONBLOCK for the pipe.
+      const int flags = fcntl (m_fd[i], F_GETFL, 0);
+      if (flags == -1 || fcntl (m_fd[i], F_SETFL, flags | O_NONBLOCK) == -1) {
+	m_errno = errno;
+      }
+    }
+    for (int d = 0; d < DIRECTION_COUNT; ++d) {
+      prepare (d, pipe_size);
+    }
+    schedule ();
+  }
+
+  tcp_splice_automaton::~tcp_splice_automaton () {
+    for (int d = 0; d < DIRECTION_COUNT; ++d) {
+      if (m_direction[d].pipe[0] != -1) {
+	::close (m_direction[d].pipe[0]);
+	::close (m_direction[d].pipe[1]);
+      }
+      if (m_fd[d] != -1) {
+	ioa::close (m_fd[d]);
+      }
+    }
+  }
+
+  bool tcp_splice_automaton::pump_precondition (int d) const {
+    const direction& dir = m_direction[d];
+    return m_errno == 0 &&
+      ((!dir.eof && !dir.read_wait && !dir.pipe_full && dir.buffered < dir.capacity) ||
+       (dir.buffered != 0 && !dir.write_wait) ||
+       (dir.eof && dir.buffered == 0 && !dir.shutdown));
+  }
+
+  void tcp_splice_automaton::pump_effect (int d) {
+    direction& dir = m_direction[d];
+
+    // Fill the pipe.
+    if (!dir.eof && !dir.read_wait && !dir.pipe_full && dir.buffered < dir.capacity) {
+      const ssize_t n = splice_some (dir.source, dir.pipe[1], dir.capacity - dir.buffered);
+      if (n > 0) {
+	dir.buffered += n;
+      }
+      else if (n == 0) {
+	dir.eof = true;
+      }
+      else if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+	int available = 0;
+	if (dir.buffered != 0 && ioctl (dir.source, FIONREAD, &available) == 0 && available > 0) {
+	  // The pipe ran out of pages before bytes.  Waiting for the socket would spin.
+	  dir.pipe_full = true;
+	}
+	else {
+	  dir.read_wait = true;
+	  ioa::schedule_read_ready (&tcp_splice_automaton::read_ready, d, dir.source);
+	}
+      }
+      else {
+	m_errno = errno;
+	return;
+      }
+    }
+
+    // Drain the pipe.
+    if (dir.buffered != 0 && !dir.write_wait) {
+      const ssize_t n = splice_some (dir.pipe[0], dir.destination, dir.buffered);
+      if (n > 0) {
+	dir.buffered -= n;
+	dir.pipe_full = false;
+	if (d == FORWARD) {
+	  m_bytes.forward += n;
+	}
+	else {
+	  m_bytes.backward += n;
+	}
+      }
+      else if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+	dir.write_wait = true;
+	ioa::schedule_write_ready (&tcp_splice_automaton::write_ready, d, dir.destination);
+      }
+      else if (n == -1) {
+	m_errno = errno;
+	return;
+      }
+    }
+
+    if (dir.eof && dir.buffered == 0 && !dir.shutdown) {
+      // Forward the half-close.
+      dir.shutdown = true;
+      if (::shutdown (dir.destination, SHUT_WR) == -1 && errno != ENOTCONN) {
+	m_errno = errno;
+      }
+    }
+  }
+
+  void tcp_splice_automaton::pump_schedule (int) const {
+    schedule ();
+  }
+
+  bool tcp_splice_automaton::read_ready_precondition (int d) const {
+    return m_direction[d].read_wait;
+  }
+
+  void tcp_splice_automaton::read_ready_effect (int d) {
+    m_direction[d].read_wait = false;
+  }
+
+  void tcp_splice_automaton::read_ready_schedule (int) const {
+    schedule ();
+  }
+
+  bool tcp_splice_automaton::write_ready_precondition (int d) const {
+    return m_direction[d].write_wait;
+  }
+
+  void tcp_splice_automaton::write_ready_effect (int d) {
+    m_direction[d].write_wait = false;
+  }
+
+  void tcp_splice_automaton::write_ready_schedule (int) const {
+    schedule ();
+  }
+
+  bool tcp_splice_automaton::bytes_precondition () const {
+    return m_bytes != m_bytes_reported && binding_count (&tcp_splice_automaton::bytes) != 0;
+  }
+
+  tcp_splice_automaton::bytes_val tcp_splice_automaton::bytes_effect () {
+    m_bytes_reported = m_bytes;
+    return m_bytes;
+  }
+
+  void tcp_splice_automaton::bytes_schedule () const {
+    schedule ();
+  }
+
+  bool tcp_splice_automaton::closed_precondition () const {
+    return !m_closed_reported &&
+      m_direction[FORWARD].shutdown &&
+      m_direction[BACKWARD].shutdown &&
+      binding_count (&tcp_splice_automaton::closed) != 0;
+  }
+
+  void tcp_splice_automaton::closed_effect () {
+    m_closed_reported = true;
+  }
+
+  void tcp_splice_automaton::closed_schedule () const {
+    schedule ();
+  }
+
+  bool tcp_splice_automaton::error_precondition () const {
+    return m_errno != 0 && !m_error_reported && binding_count (&tcp_splice_automaton::error) != 0;
+  }
+
+  int tcp_splice_automaton::error_effect () {
+    m_error_reported = true;
+    return m_errno;
+  }
+
+  void tcp_splice_automaton::error_schedule () const {
+    schedule ();
+  }
+
+}
@@ -17,147 +17,263 @@
 #include <ioa/time.hpp>
 #include <cassert>
 
-#define MILLION 1000000
+#if defined (__x86_64__)
+#include <cpuid.h>
+#endif
+
+#define THOUSAND 1000LL
+#define MILLION 1000000LL
+#define BILLION 1000000000LL
 
 namespace ioa {
 
-  void time::check () {
-    assert ((m_sec <= 0 && m_usec <= 0 && m_usec > -MILLION) ||
-	    (m_sec >= 0 && m_usec >= 0 && m_usec < MILLION));
+  time::clock_source time::m_source = time::MONOTONIC_CLOCK;
+  volatile int64_t time::m_coarse = 0;
+
+  static int64_t monotonic_nsec () {
+    struct timespec ts;
+    int result = clock_gettime (CLOCK_MONOTONIC, &ts);
+    assert (result == 0);
+    return static_cast<int64_t> (ts.tv_sec) * BILLION + ts.tv_nsec;
   }
-  
-  void time::normalize () {
-    if (m_usec <= -MILLION || m_usec >= MILLION) {
-      m_sec += m_usec / MILLION;
-      m_usec = m_usec % MILLION;
+
+#if defined (__x86_64__)
+  /*
+    The counter is converted with a fixed-point multiplier:  nsec = base_nsec + ((tsc - base_tsc) * mult) >> 32.
+    The product is computed in 128 bits so the counter can run for years without overflow.
+
+    Calibration is lazy so selecting the counter does not block.
+    Until TSC_CALIBRATION has passed since the first sample, now reads the monotonic clock and the first call after that computes the multiplier.
+    Samples are published with a compare-and-swap and never freed so readers need no lock.
+  */
+  struct tsc_sample
+  {
+    uint64_t tsc;
+    int64_t nsec;
+    uint64_t mult;
+
+    tsc_sample (uint64_t t,
+		int64_t n,
+		uint64_t m) :
+      tsc (t),
+      nsec (n),
+      mult (m)
+    { }
+  };
+
+  static const int64_t TSC_CALIBRATION = 10 * MILLION;
+  static tsc_sample* volatile tsc_first = 0;
+  static tsc_sample* volatile tsc_base = 0;
+
+  static inline uint64_t rdtsc () {
+    uint32_t lo;
+    uint32_t hi;
+    __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+    return (static_cast<uint64_t> (hi) << 32) | lo;
+  }
+
+  static bool invariant_tsc () {
+    unsigned int eax, ebx, ecx, edx;
+    if (__get_cpuid (0x80000000, &eax, &ebx, &ecx, &edx) == 0 || eax < 0x80000007) {
+      return false;
     }
-    
-    if (m_sec > 0 && m_usec < 0) {
-      m_sec -= 1;
-      m_usec += MILLION;
+    __get_cpuid (0x80000007, &eax, &ebx, &ecx, &edx);
+    // The counter runs at a constant rate in all power states.
+    return (edx & (1 << 8)) != 0;
+  }
+
+  static int64_t calibrate_tsc () {
+    const int64_t nsec = monotonic_nsec ();
+    const uint64_t tsc = rdtsc ();
+
+    tsc_sample* first = tsc_first;
+    if (first == 0) {
+      first = new tsc_sample (tsc, nsec, 0);
+      if (!__sync_bool_compare_and_swap (&tsc_first, 0, first)) {
+	delete first;
+      }
     }
-    else if (m_sec < 0 && m_usec > 0) {
-      m_sec += 1;
-      m_usec -= MILLION;
+    else if (nsec - first->nsec >= TSC_CALIBRATION && tsc > first->tsc) {
+      const unsigned __int128 elapsed = nsec - first->nsec;
+      const uint64_t mult = static_cast<uint64_t> ((elapsed << 32) / (tsc - first->tsc));
+      if (mult != 0) {
+	tsc_sample* base = new tsc_sample (tsc, nsec, mult);
+	if (!__sync_bool_compare_and_swap (&tsc_base, 0, base)) {
+	  delete base;
+	}
+      }
     }
-    check ();
+
+    return nsec;
   }
 
-  long long time::compare (const time& o) const {
-    return ((long long)(m_sec) * (long long)(MILLION) + (long long)(m_usec)) -
-      ((long long)(o.m_sec) * (long long)(MILLION) + (long long)(o.m_usec));
+  static int64_t tsc_nsec () {
+    const tsc_sample* base = tsc_base;
+    if (base == 0) {
+      return calibrate_tsc ();
+    }
+    const unsigned __int128 delta = rdtsc () - base->tsc;
+    return base->nsec + static_cast<int64_t> ((delta * base->mult) >> 32);
+  }
+#else
+  static bool invariant_tsc () {
+    return false;
   }
 
+  static int64_t tsc_nsec () {
+    return monotonic_nsec ();
+  }
+#endif
+
   time::time () :
-    m_sec (0),
-    m_usec (0)
+    m_nsec (0)
   { }
   
   time::time (long sec,
 	      long usec) :
-    m_sec (sec),
-    m_usec (usec)
-  {
-    normalize ();
-  }
+    m_nsec (static_cast<int64_t> (sec) * BILLION + static_cast<int64_t> (usec) * THOUSAND)
+  { }
   
-  time::time (const time& o) {
-    m_sec = o.m_sec;
-    m_usec = o.m_usec;
-  }
+  time::time (const time& o) :
+    m_nsec (o.m_nsec)
+  { }
   
   time::time (const struct timeval& t) :
-    m_sec (t.tv_sec),
-    m_usec (t.tv_usec)
+    m_nsec (static_cast<int64_t> (t.tv_sec) * BILLION + static_cast<int64_t> (t.tv_usec) * THOUSAND)
   {
-    check ();
+    assert ((t.tv_sec <= 0 && t.tv_usec <= 0 && t.tv_usec > -MILLION) ||
+	    (t.tv_sec >= 0 && t.tv_usec >= 0 && t.tv_usec < MILLION));
+  }
+  
+  time::time (const struct timespec& t) :
+    m_nsec (static_cast<int64_t> (t.tv_sec) * BILLION + t.tv_nsec)
+  { }
+
+  time time::from_nsec (int64_t nsec) {
+    time result;
+    result.m_nsec = nsec;
+    return result;
   }
   
   long time::sec () const {
-    return m_sec;
+    // Division truncates toward zero so sec and usec have the same sign.
+    return m_nsec / BILLION;
   }
-
   
   long time::usec () const {
-    return m_usec;
+    return (m_nsec % BILLION) / THOUSAND;
+  }
+
+  int64_t time::nsec () const {
+    return m_nsec;
   }
 
   time& time::operator= (const time& o) {
-    if (this != &o) {
-      m_sec = o.m_sec;
-      m_usec = o.m_usec;
-      check ();
-    }
+    m_nsec = o.m_nsec;
     return *this;
   }
 
   time time::operator+ (const time& o) const {
-    time result;
-    result.m_sec = m_sec + o.m_sec;
-    result.m_usec = m_usec + o.m_usec;
-    result.normalize ();
-    return result;
+    return from_nsec (m_nsec + o.m_nsec);
   }
   
   time time::operator- (const time& o) const {
-    time result;
-    result.m_sec = m_sec - o.m_sec;
-    result.m_usec = m_usec - o.m_usec;
-    result.normalize ();
-    return result;
+    return from_nsec (m_nsec - o.m_nsec);
   }
 
   time& time::operator+= (const time& o) {
-    m_sec += o.m_sec;
-    m_usec += o.m_usec;
-    normalize ();
+    m_nsec += o.m_nsec;
     return *this;
   }
 
   time& time::operator-= (const time& o) {
-    m_sec -= o.m_sec;
-    m_usec -= o.m_usec;
-    normalize ();
+    m_nsec -= o.m_nsec;
     return *this;
   }
 
   bool time::operator== (const time& o) const {
-    return compare (o) == 0;
+    return m_nsec == o.m_nsec;
   }
 
   bool time::operator!= (const time& o) const {
-    return compare (o) != 0;
+    return m_nsec != o.m_nsec;
   }
 
   bool time::operator> (const time& o) const {
-    return compare (o) > 0;
+    return m_nsec > o.m_nsec;
   }
 
   bool time::operator< (const time& o) const {
-    return compare (o) < 0;
+    return m_nsec < o.m_nsec;
   }
 
   bool time::operator>= (const time& o) const {
-    return compare (o) >= 0;
+    return m_nsec >= o.m_nsec;
   }
 
   bool time::operator<= (const time& o) const {
-    return compare (o) <= 0;
+    return m_nsec <= o.m_nsec;
   }
     
   time::operator struct timeval () const {
-    assert (m_sec >= 0 && m_usec >= 0);
+    assert (m_nsec >= 0);
     struct timeval retval;
-    retval.tv_sec = m_sec;
-    retval.tv_usec = m_usec;
+    retval.tv_sec = m_nsec / BILLION;
+    retval.tv_usec = (m_nsec % BILLION) / THOUSAND;
+    return retval;
+  }
+
+  time::operator struct timespec () const {
+    assert (m_nsec >= 0);
+    struct timespec retval;
+    retval.tv_sec = m_nsec / BILLION;
+    retval.tv_nsec = m_nsec % BILLION;
     return retval;
   }
 
   time time::now () {
-    timeval tv;
-    int result = gettimeofday (&tv, 0);
-    assert (result == 0);
-    return time (tv);
+    if (m_source == TSC_CLOCK) {
+      return from_nsec (tsc_nsec ());
+    }
+    else {
+      return from_nsec (monotonic_nsec ());
+    }
+  }
+
+  time time::coarse () {
+    // Read without a locked instruction so coarse stays cheap; refresh publishes with a full barrier.
+    const int64_t nsec = m_coarse;
+    if (nsec == 0) {
+      return refresh ();
+    }
+    return from_nsec (nsec);
+  }
+
+  time time::refresh () {
+    // Threads race to refresh so only move forward.
+    const int64_t nsec = now ().m_nsec;
+    int64_t old = m_coarse;
+    while (old < nsec) {
+      const int64_t prev = __sync_val_compare_and_swap (&m_coarse, old, nsec);
+      if (prev == old) {
+	return from_nsec (nsec);
+      }
+      old = prev;
+    }
+    return from_nsec (old);
+  }
+
+  bool time::set_clock_source (clock_source source) {
+    if (source == TSC_CLOCK && !invariant_tsc ()) {
+      return false;
+    }
+    m_source = source;
+    __sync_lock_test_and_set (&m_coarse, 0);
+    return true;
+  }
+
+  time::clock_source time::get_clock_source () {
+    return m_source;
   }
 
 }
@@ -0,0 +1,135 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "timer_set.hpp"
+#include "model.hpp"
+
+#include <cassert>
+
+namespace ioa {
+
+  timer_set::~timer_set () {
+    while (!m_action_to_timer.empty ()) {
+      erase (m_action_to_timer.begin ());
+    }
+  }
+
+  void timer_set::insert (action_runnable_interface* r,
+			  const timer& t) {
+    m_time_to_action.insert (std::make_pair (t.deadline, r));
+    m_action_to_timer.insert (std::make_pair (r, t));
+  }
+
+  void timer_set::erase (action_map::iterator pos) {
+    time_map::iterator pos2;
+    for (pos2 = m_time_to_action.find (pos->second.deadline);
+	 pos2 != m_time_to_action.end () && pos2->second != pos->first;
+	 ++pos2) ;;
+    assert (pos2 != m_time_to_action.end ());
+    m_time_to_action.erase (pos2);
+    if (pos->second.periodic != 0) {
+      pos->second.periodic->release ();
+    }
+    else {
+      delete pos->first;
+    }
+    m_action_to_timer.erase (pos);
+  }
+
+  void timer_set::apply (const timer_request& request) {
+    action_map::iterator pos = m_action_to_timer.find (request.runnable);
+
+    switch (request.kind) {
+    case timer_request::AFTER:
+      if (pos == m_action_to_timer.end ()) {
+	// Insert new action.
+	insert (request.runnable, timer (request.deadline, time (), 0));
+      }
+      else if (pos->second.periodic != 0 || request.deadline < pos->second.deadline) {
+	// Action is periodic or already has a time but new time is earlier.
+	erase (pos);
+	insert (request.runnable, timer (request.deadline, time (), 0));
+      }
+      else {
+	// Action will execute at or before the new time.
+	delete request.runnable;
+      }
+      break;
+    case timer_request::EVERY:
+      assert (request.period > time ());
+      if (pos != m_action_to_timer.end ()) {
+	erase (pos);
+      }
+      insert (request.runnable, timer (request.deadline, request.period, new periodic_timer (request.runnable)));
+      break;
+    case timer_request::CANCEL:
+      if (pos != m_action_to_timer.end ()) {
+	erase (pos);
+      }
+      delete request.runnable;
+      break;
+    }
+  }
+
+  bool timer_set::empty () const {
+    return m_time_to_action.empty ();
+  }
+
+  const time& timer_set::next () const {
+    assert (!m_time_to_action.empty ());
+    return m_time_to_action.begin ()->first;
+  }
+
+  action_runnable_interface* timer_set::expire (const time& now,
+						model& model) {
+    while (!m_time_to_action.empty () && m_time_to_action.begin ()->first < now) {
+      action_runnable_interface* r = m_time_to_action.begin ()->second;
+      action_map::iterator pos = m_action_to_timer.find (r);
+      assert (pos != m_action_to_timer.end ());
+
+      if (pos->second.periodic == 0) {
+	// One-shot timers hand over their runnable.
+	m_time_to_action.erase (m_time_to_action.begin ());
+	m_action_to_timer.erase (pos);
+	return r;
+      }
+
+      if (!model.exists (r->get_action ().get_aid ())) {
+	// The automaton is gone so the timer can never be cancelled.
+	erase (pos);
+	continue;
+      }
+
+      // Advance by whole periods past now.
+      time deadline = pos->second.deadline + pos->second.period;
+      if (deadline <= now) {
+	const int64_t period = pos->second.period.nsec ();
+	deadline += time::from_nsec (((now - deadline).nsec () / period + 1) * period);
+      }
+
+      m_time_to_action.erase (m_time_to_action.begin ());
+      m_time_to_action.insert (std::make_pair (deadline, r));
+      pos->second.deadline = deadline;
+
+      if (!pos->second.periodic->ticking ()) {
+	return new timer_tick (pos->second.periodic);
+      }
+    }
+
+    return 0;
+  }
+
+}
@@ -0,0 +1,176 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef __timer_set_hpp__
+#define __timer_set_hpp__
+
+#include <ioa/action_runnable_interface.hpp>
+#include <ioa/time.hpp>
+#include <map>
+
+namespace ioa {
+
+  class model;
+
+  /*
+    A request to the timer set.
+    Requests are queued by the automata and applied by the thread that waits for timers.
+  */
+  struct timer_request
+  {
+    enum kind_t {
+      // Execute once at the deadline.
+      AFTER,
+      // Execute at the deadline and every period thereafter.
+      EVERY,
+      // Remove the timer for the action.
+      CANCEL,
+    };
+
+    kind_t kind;
+    action_runnable_interface* runnable;
+    time deadline;
+    time period;
+
+    timer_request (const kind_t k,
+		   action_runnable_interface* r,
+		   const time& d,
+		   const time& p) :
+      kind (k),
+      runnable (r),
+      deadline (d),
+      period (p)
+    { }
+  };
+
+  // The runnable of a periodic timer is shared by the timer and the tick that is waiting to execute.
+  struct periodic_timer
+  {
+    action_runnable_interface* runnable;
+    int refs;
+
+    periodic_timer (action_runnable_interface* r) :
+      runnable (r),
+      refs (1)
+    { }
+
+    bool ticking () {
+      return __sync_add_and_fetch (&refs, 0) != 1;
+    }
+
+    void acquire () {
+      __sync_add_and_fetch (&refs, 1);
+    }
+
+    void release () {
+      if (__sync_sub_and_fetch (&refs, 1) == 0) {
+	delete runnable;
+	delete this;
+      }
+    }
+  };
+
+  // One expiration of a periodic timer.
+  class timer_tick :
+    public action_runnable_interface
+  {
+  private:
+    periodic_timer* m_timer;
+
+  public:
+    timer_tick (periodic_timer* timer) :
+      m_timer (timer)
+    {
+      m_timer->acquire ();
+    }
+
+    ~timer_tick () {
+      m_timer->release ();
+    }
+
+    void operator() (model_interface& model) {
+      (*m_timer->runnable) (model);
+    }
+
+    const action_executor_interface& get_action () const {
+      return m_timer->runnable->get_action ();
+    }
+  };
+
+  /*
+    The timers of a scheduler.
+
+    An action has at most one timer so the action itself identifies the timer.
+    A one-shot timer for an action that already has a one-shot timer keeps the earlier deadline.
+    A one-shot timer replaces a periodic timer for the action.
+    A periodic timer replaces the existing timer for the action and keeps its runnable.
+    Each expiration executes a tick that shares the runnable and the next deadline is computed from the previous deadline, not from the time of expiration, so the period does not drift.
+    Periods missed while the scheduler was busy, or while the previous tick was waiting to execute, are skipped instead of executed in a burst.
+  */
+  class timer_set
+  {
+  private:
+    struct compare_action_runnable
+    {
+      bool operator() (const action_runnable_interface* x,
+		       const action_runnable_interface* y) const {
+	return (*x) < (*y);
+      }
+    };
+
+    struct timer
+    {
+      time deadline;
+      // Zero for one-shot timers.
+      time period;
+      periodic_timer* periodic;
+
+      timer (const time& d,
+	     const time& p,
+	     periodic_timer* pt) :
+	deadline (d),
+	period (p),
+	periodic (pt)
+      { }
+    };
+
+    typedef std::multimap<time, action_runnable_interface*> time_map;
+    typedef std::map<action_runnable_interface*, timer, compare_action_runnable> action_map;
+
+    time_map m_time_to_action;
+    action_map m_action_to_timer;
+
+    timer_set (const timer_set&) { }
+    void operator= (const timer_set&) { }
+
+    void insert (action_runnable_interface* r,
+		 const timer& t);
+    void erase (action_map::iterator pos);
+
+  public:
+    timer_set () { }
+    ~timer_set ();
+    void apply (const timer_request& request);
+    bool empty () const;
+    const time& next () const;
+    // Returns the runnable to execute for the earliest timer that expired before now or 0.
+    action_runnable_interface* expire (const time& now,
+				       model& model);
+  };
+
+}
+
+#endif
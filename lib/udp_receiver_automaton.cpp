@@ -18,10 +18,12 @@
 
 #include <fcntl.h>
 #include <sys/ioctl.h>
+#include <cstring>
 
 namespace ioa {
 
-  void udp_receiver_automaton::prepare_socket (const inet_address& address) {
+  void udp_receiver_automaton::prepare_socket (const inet_address& address,
+					       const int recv_buf_size) {
     // Open a socket.
     m_fd = socket (AF_INET, SOCK_DGRAM, 0);
     if (m_fd == -1) {
@@ -61,6 +63,13 @@ namespace ioa {
     }
 #endif
 
+    if (recv_buf_size != 0) {
+      if (setsockopt (m_fd, SOL_SOCKET, SO_RCVBUF, &recv_buf_size, sizeof (recv_buf_size)) == -1) {
+	m_errno = errno;
+	return;
+      }
+    }
+
     // Bind.
     if (::bind (m_fd, address.get_sockaddr (), address.get_socklen ()) == -1) {
       m_errno = errno;
@@ -68,10 +77,35 @@ namespace ioa {
     }
   }
 
+  void udp_receiver_automaton::prepare_batch (const size_t datagram_size) {
+    m_pool = new chunk_pool (datagram_size, 2 * m_batch_size);
+    m_chunks.reserve (m_batch_size);
+    m_addresses.resize (m_batch_size);
+    m_iov.resize (m_batch_size);
+    m_msgs.resize (m_batch_size);
+
+#ifdef SO_RXQ_OVFL
+    // Ask for the drop counter with each datagram.
+    m_control.resize (m_batch_size * CMSG_SPACE (sizeof (uint32_t)));
+    if (m_fd != -1) {
+      const int val = 1;
+      if (setsockopt (m_fd, SOL_SOCKET, SO_RXQ_OVFL, &val, sizeof (val)) == -1) {
+	m_errno = errno;
+      }
+    }
+#endif
+  }
+
   void udp_receiver_automaton::schedule () const {
     if (receive_precondition ()) {
       ioa::schedule (&udp_receiver_automaton::receive);
     }
+    if (receive_batch_precondition ()) {
+      ioa::schedule (&udp_receiver_automaton::receive_batch);
+    }
+    if (drops_precondition ()) {
+      ioa::schedule (&udp_receiver_automaton::drops);
+    }
     if (error_precondition ()) {
       ioa::schedule (&udp_receiver_automaton::error);
     }
@@ -80,28 +114,48 @@ namespace ioa {
     }
   }
 
-  udp_receiver_automaton::udp_receiver_automaton (const inet_address& address) :
+  udp_receiver_automaton::udp_receiver_automaton (const inet_address& address,
+						  const size_t batch_size,
+						  const size_t datagram_size,
+						  const int recv_buf_size) :
     m_state (SCHEDULE_READ_READY),
     m_fd (-1),
     m_errno (0),
     m_buf (0),
     m_buf_size (0),
-    m_error_reported (false)
+    m_error_reported (false),
+    m_pool (0),
+    m_batch_size (batch_size),
+    m_drops (0),
+    m_drops_reported (0)
   {
-    prepare_socket (address);
+    prepare_socket (address, recv_buf_size);
+    if (m_batch_size != 0) {
+      prepare_batch (datagram_size);
+    }
     schedule ();
   }
 
   udp_receiver_automaton::udp_receiver_automaton (const inet_address& group_addr,
-						  const inet_address& local_addr) :
+						  const inet_address& local_addr,
+						  const size_t batch_size,
+						  const size_t datagram_size,
+						  const int recv_buf_size) :
     m_state (SCHEDULE_READ_READY),
     m_fd (-1),
     m_errno (0),
     m_buf (0),
     m_buf_size (0),
-    m_error_reported (false)
+    m_error_reported (false),
+    m_pool (0),
+    m_batch_size (batch_size),
+    m_drops (0),
+    m_drops_reported (0)
   {
-    prepare_socket (local_addr);
+    prepare_socket (local_addr, recv_buf_size);
+    if (m_batch_size != 0) {
+      prepare_batch (datagram_size);
+    }
 
     inet_mreq req (group_addr, local_addr);
     // Join the multicast group.
@@ -114,7 +168,18 @@ namespace ioa {
 
   udp_receiver_automaton::~udp_receiver_automaton () {
     if (m_fd != -1) {
-      close (m_fd);
+      ioa::close (m_fd);
+    }
+    delete[] m_buf;
+    // Release the chunks before the pool.
+    m_recv_batch.clear ();
+    for (std::vector<chunk_buffer*>::const_iterator pos = m_chunks.begin ();
+	 pos != m_chunks.end ();
+	 ++pos) {
+      release_chunk_buffer (*pos);
+    }
+    if (m_pool != 0) {
+      m_pool->release ();
     }
   }
 
@@ -131,6 +196,33 @@ namespace ioa {
   void udp_receiver_automaton::receive_schedule () const {
     schedule ();
   }
+
+  bool udp_receiver_automaton::receive_batch_precondition () const {
+    return !m_recv_batch.empty () && binding_count (&udp_receiver_automaton::receive_batch) != 0;
+  }
+
+  udp_receiver_automaton::receive_batch_val udp_receiver_automaton::receive_batch_effect () {
+    receive_batch_val retval;
+    retval.swap (m_recv_batch);
+    return retval;
+  }
+
+  void udp_receiver_automaton::receive_batch_schedule () const {
+    schedule ();
+  }
+
+  bool udp_receiver_automaton::drops_precondition () const {
+    return m_drops != m_drops_reported && binding_count (&udp_receiver_automaton::drops) != 0;
+  }
+
+  uint32_t udp_receiver_automaton::drops_effect () {
+    m_drops_reported = m_drops;
+    return m_drops;
+  }
+
+  void udp_receiver_automaton::drops_schedule () const {
+    schedule ();
+  }
   
   bool udp_receiver_automaton::error_precondition () const {
     return m_errno != 0 && m_error_reported == false && binding_count (&udp_receiver_automaton::error) != 0;
@@ -146,7 +238,8 @@ namespace ioa {
   }
 
   bool udp_receiver_automaton::schedule_read_ready_precondition () const {
-    return m_errno == 0 && m_state == SCHEDULE_READ_READY;
+    // In batched mode, the next batch is not read until this one is delivered.
+    return m_errno == 0 && m_state == SCHEDULE_READ_READY && m_recv_batch.empty ();
   }
 
   void udp_receiver_automaton::schedule_read_ready_effect () {
@@ -162,9 +255,74 @@ namespace ioa {
     return m_errno == 0 && m_state == READ_READY_WAIT;
   }
 
+  void udp_receiver_automaton::read_batch () {
+    // Keep m_batch_size buffers ready so one recvmmsg can fill all of them.
+    while (m_chunks.size () < m_batch_size) {
+      m_chunks.push_back (m_pool->allocate ());
+    }
+
+    const size_t control_size = m_control.size () / m_batch_size;
+    for (size_t i = 0; i < m_batch_size; ++i) {
+      m_addresses[i] = inet_address ();
+      m_iov[i].iov_base = m_chunks[i]->data;
+      m_iov[i].iov_len = m_pool->chunk_size ();
+      struct msghdr& hdr = m_msgs[i].msg_hdr;
+      memset (&hdr, 0, sizeof (hdr));
+      hdr.msg_name = m_addresses[i].get_sockaddr_ptr ();
+      hdr.msg_namelen = m_addresses[i].get_socklen ();
+      hdr.msg_iov = &m_iov[i];
+      hdr.msg_iovlen = 1;
+      if (control_size != 0) {
+	hdr.msg_control = &m_control[i * control_size];
+	hdr.msg_controllen = control_size;
+      }
+    }
+
+#ifdef __linux__
+    const int count = recvmmsg (m_fd, &m_msgs[0], m_batch_size, MSG_DONTWAIT, 0);
+#else
+    int count = 0;
+    for (; count < static_cast<int> (m_batch_size); ++count) {
+      const ssize_t n = recvmsg (m_fd, &m_msgs[count].msg_hdr, MSG_DONTWAIT);
+      if (n == -1) {
+	break;
+      }
+      m_msgs[count].msg_len = n;
+    }
+    if (count == 0) {
+      count = -1;
+    }
+#endif
+    if (count == -1) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+	m_errno = errno;
+      }
+      return;
+    }
+
+    for (int i = 0; i < count; ++i) {
+      struct msghdr& hdr = m_msgs[i].msg_hdr;
+      *m_addresses[i].get_socklen_ptr () = hdr.msg_namelen;
+      m_recv_batch.push_back (datagram (m_addresses[i], chunk (m_chunks[i], m_msgs[i].msg_len)));
+#ifdef SO_RXQ_OVFL
+      for (struct cmsghdr* cm = CMSG_FIRSTHDR (&hdr); cm != 0; cm = CMSG_NXTHDR (&hdr, cm)) {
+	if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SO_RXQ_OVFL) {
+	  memcpy (&m_drops, CMSG_DATA (cm), sizeof (uint32_t));
+	}
+      }
+#endif
+    }
+    m_chunks.erase (m_chunks.begin (), m_chunks.begin () + count);
+  }
+
   void udp_receiver_automaton::read_ready_effect () {
     m_state = SCHEDULE_READ_READY;
 
+    if (m_pool != 0) {
+      read_batch ();
+      return;
+    }
+
     int expect_bytes;
     int res = ioctl (m_fd, FIONREAD, &expect_bytes);
     if (res == -1) {
@@ -17,10 +17,41 @@
 #include <ioa/udp_sender_automaton.hpp>
 
 #include <algorithm>
+#include <cstring>
 #include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
 
 namespace ioa {
 
+  // Messages per sendmmsg, datagrams per sendmmsg, and the limits on one segmented send.
+  static const size_t MAX_MESSAGES = 64;
+  static const size_t MAX_DATAGRAMS = 256;
+  static const size_t MAX_SEGMENTS = 64;
+  static const size_t MAX_PAYLOAD = 65507;
+
+  static bool same_address (const inet_address& a,
+			    const inet_address& b) {
+    if (a.get_socklen () != b.get_socklen ()) {
+      return false;
+    }
+    switch (a.get_socklen ()) {
+    case sizeof (sockaddr_in):
+      {
+	const sockaddr_in* x = reinterpret_cast<const sockaddr_in*> (a.get_sockaddr ());
+	const sockaddr_in* y = reinterpret_cast<const sockaddr_in*> (b.get_sockaddr ());
+	return x->sin_port == y->sin_port && x->sin_addr.s_addr == y->sin_addr.s_addr;
+      }
+    case sizeof (sockaddr_in6):
+      {
+	const sockaddr_in6* x = reinterpret_cast<const sockaddr_in6*> (a.get_sockaddr ());
+	const sockaddr_in6* y = reinterpret_cast<const sockaddr_in6*> (b.get_sockaddr ());
+	return x->sin6_port == y->sin6_port && memcmp (&x->sin6_addr, &y->sin6_addr, sizeof (in6_addr)) == 0;
+      }
+    }
+    return false;
+  }
+
   void udp_sender_automaton::schedule () const {
     if (schedule_write_ready_precondition ()) {
       ioa::schedule (&udp_sender_automaton::schedule_write_ready);
@@ -44,13 +75,9 @@ namespace ioa {
   }
 
   void udp_sender_automaton::purge (const aid_t aid) {
-    if (m_send_set.count (aid) != 0) {
-      std::list<std::pair<aid_t, send_arg> >::iterator pos = std::find_if (m_send_queue.begin (),
-									   m_send_queue.end (),
-									   first_aid_equal (aid));
-      assert (pos != m_send_queue.end ());
-      m_send_queue.erase (pos);
-      m_send_set.erase (aid);
+    if (m_send_count.count (aid) != 0) {
+      m_send_queue.remove_if (first_aid_equal (aid));
+      m_send_count.erase (aid);
     }
     
     m_complete_set.erase (aid);
@@ -58,16 +85,32 @@ namespace ioa {
 
   void udp_sender_automaton::add_to_complete_set (const aid_t aid) {
     m_complete_set.insert (aid);
-    // Schedule the send complete.
-    ioa::schedule (&udp_sender_automaton::send_complete, aid);
+    // Schedule the send complete when the last datagram of aid is written.
+    if (m_send_count.count (aid) == 0) {
+      ioa::schedule (&udp_sender_automaton::send_complete, aid);
+    }
   }
 
-  udp_sender_automaton::udp_sender_automaton (const size_t send_buf_size) :
+  udp_sender_automaton::udp_sender_automaton (const size_t send_buf_size,
+					      const size_t window) :
+    m_window (std::max (window, static_cast<size_t> (1))),
     m_state (SCHEDULE_WRITE_READY),
     m_fd (-1),
     m_errno (0),
-    m_error_reported (false)
+    m_error_reported (false),
+    m_msgs (MAX_MESSAGES),
+    m_iov (MAX_DATAGRAMS),
+    m_msg_count (MAX_MESSAGES),
+#ifdef UDP_SEGMENT
+    m_gso (true)
+#else
+    m_gso (false)
+#endif
   {
+#ifdef UDP_SEGMENT
+    m_control.resize (MAX_MESSAGES * CMSG_SPACE (sizeof (uint16_t)));
+#endif
+
     add_observable (&send);
     add_observable (&send_complete);
 
@@ -115,21 +158,23 @@ namespace ioa {
 
   udp_sender_automaton::~udp_sender_automaton () {
     if (m_fd != -1) {
-      close (m_fd);
+      ioa::close (m_fd);
     }
   }
 
   void udp_sender_automaton::send_effect (const send_arg& arg,
 					  aid_t aid) {
-    // There is no error, no outstanding send, and no outstanding complete.
+    std::map<aid_t, size_t>::const_iterator count = m_send_count.find (aid);
+    // There is no error and the window is open.
+    // A window of 1 also waits for the outstanding complete.
     if (m_errno == 0 &&
-	m_send_set.count (aid) == 0 &&
-	m_complete_set.count (aid) == 0) {
+	(count == m_send_count.end () || count->second < m_window) &&
+	(m_window != 1 || m_complete_set.count (aid) == 0)) {
       // Good address and data.
       if (arg.address.get_errno () == 0) {
-	// Add to the send queue and set.
+	// Add to the send queue and count.
 	m_send_queue.push_back (std::make_pair (aid, arg));
-	m_send_set.insert (aid);
+	++m_send_count[aid];
       }
       else {
 	// Succeed immediately for a bad address or no data.
@@ -144,7 +189,8 @@ namespace ioa {
   }
 
   bool udp_sender_automaton::send_complete_precondition (aid_t aid) const {
-    return m_complete_set.count (aid) != 0 && 
+    return m_complete_set.count (aid) != 0 &&
+      m_send_count.count (aid) == 0 &&
       binding_count (&udp_sender_automaton::send_complete, aid) != 0;
   }
 
@@ -187,17 +233,102 @@ namespace ioa {
     return m_errno == 0 && m_state == WRITE_READY_WAIT;
   }
 
+  size_t udp_sender_automaton::prepare_messages () {
+    size_t msgs = 0;
+    size_t iovs = 0;
+    std::list<std::pair<aid_t, send_arg> >::const_iterator pos = m_send_queue.begin ();
+    while (pos != m_send_queue.end () && msgs != m_msgs.size () && iovs != m_iov.size ()) {
+      const send_arg& first = pos->second;
+      const size_t segment_size = first.buffer.size ();
+      const size_t begin = iovs;
+      size_t bytes = 0;
+
+      // A segmented send is a run of datagrams to one address that are all segment_size bytes except possibly the last.
+      do {
+	m_iov[iovs].iov_base = const_cast<char*> (pos->second.buffer.data ());
+	m_iov[iovs].iov_len = pos->second.buffer.size ();
+	bytes += pos->second.buffer.size ();
+	++iovs;
+	++pos;
+      } while (m_gso &&
+	       segment_size != 0 &&
+	       pos != m_send_queue.end () &&
+	       iovs != m_iov.size () &&
+	       iovs - begin != MAX_SEGMENTS &&
+	       m_iov[iovs - 1].iov_len == segment_size &&
+	       pos->second.buffer.size () != 0 &&
+	       pos->second.buffer.size () <= segment_size &&
+	       bytes + pos->second.buffer.size () <= MAX_PAYLOAD &&
+	       same_address (pos->second.address, first.address));
+
+      struct msghdr& hdr = m_msgs[msgs].msg_hdr;
+      memset (&hdr, 0, sizeof (hdr));
+      hdr.msg_name = const_cast<sockaddr*> (first.address.get_sockaddr ());
+      hdr.msg_namelen = first.address.get_socklen ();
+      hdr.msg_iov = &m_iov[begin];
+      hdr.msg_iovlen = iovs - begin;
+#ifdef UDP_SEGMENT
+      if (iovs - begin > 1) {
+	const size_t control_size = CMSG_SPACE (sizeof (uint16_t));
+	hdr.msg_control = &m_control[msgs * control_size];
+	hdr.msg_controllen = control_size;
+	struct cmsghdr* cm = CMSG_FIRSTHDR (&hdr);
+	cm->cmsg_level = IPPROTO_UDP;
+	cm->cmsg_type = UDP_SEGMENT;
+	cm->cmsg_len = CMSG_LEN (sizeof (uint16_t));
+	const uint16_t size = segment_size;
+	memcpy (CMSG_DATA (cm), &size, sizeof (uint16_t));
+      }
+#endif
+      m_msg_count[msgs] = iovs - begin;
+      ++msgs;
+    }
+
+    return msgs;
+  }
+
+  void udp_sender_automaton::complete_messages (const size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+      for (size_t j = 0; j < m_msg_count[i]; ++j) {
+	const aid_t aid = m_send_queue.front ().first;
+	m_send_queue.pop_front ();
+	std::map<aid_t, size_t>::iterator pos = m_send_count.find (aid);
+	if (--pos->second == 0) {
+	  m_send_count.erase (pos);
+	}
+	add_to_complete_set (aid);
+      }
+    }
+  }
+
   void udp_sender_automaton::write_ready_effect () {
     m_state = SCHEDULE_WRITE_READY;
 
     if (!m_send_queue.empty ()) {
-      std::pair<aid_t, send_arg> item = m_send_queue.front ();
-      m_send_queue.pop_front ();
-      m_send_set.erase (item.first);
-      
-      if (sendto (m_fd, item.second.buffer.data (), item.second.buffer.size (), 0, item.second.address.get_sockaddr (), item.second.address.get_socklen ()) != -1) {
+      const size_t msgs = prepare_messages ();
+#ifdef __linux__
+      const int sent = sendmmsg (m_fd, &m_msgs[0], msgs, 0);
+#else
+      int sent = 0;
+      for (; sent < static_cast<int> (msgs); ++sent) {
+	if (sendmsg (m_fd, &m_msgs[sent].msg_hdr, 0) == -1) {
+	  break;
+	}
+      }
+      if (sent == 0) {
+	sent = -1;
+      }
+#endif
+      if (sent != -1) {
 	// Success.
-	add_to_complete_set (item.first);
+	complete_messages (sent);
+      }
+      else if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+	// Spurious.  Wait again.
+      }
+      else if (m_gso && m_msg_count[0] > 1) {
+	// The route cannot segment.  Send the datagrams separately.
+	m_gso = false;
       }
       else {
 	// Fail.
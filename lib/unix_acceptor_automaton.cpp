@@ -0,0 +1,193 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <ioa/unix_acceptor_automaton.hpp>
+
+#include <algorithm>
+#include <fcntl.h>
+
+namespace ioa {
+
+  unix_acceptor_automaton::unix_acceptor_automaton (const unix_address& address,
+						    const int type,
+						    const int backlog,
+						    const size_t accept_batch) :
+    m_address (address),
+    m_state (SCHEDULE_READ_READY),
+    m_fd (-1),
+    m_errno (0),
+    m_error_reported (false),
+    m_bound (false),
+    m_accept_batch (std::max (accept_batch, static_cast<size_t> (1)))
+  {
+    add_observable (&accepted);
+    add_observable (&error);
+
+    try {
+      if (address.get_errno () != 0) {
+	m_errno = address.get_errno ();
+	throw std::exception ();
+      }
+
+      // Open a socket.
+      m_fd = socket (AF_UNIX, type, 0);
+      if (m_fd == -1) {
+	m_errno = errno;
+	throw std::exception ();
+      }
+      
+      // Get the flags.
+      int flags = fcntl (m_fd, F_GETFL, 0);
+      if (flags < 0) {
+	m_errno = errno;
+	throw std::exception ();
+      }
+      
+      // Set non-blocking.
+      flags |= O_NONBLOCK;
+      if (fcntl (m_fd, F_SETFL, flags) == -1) {
+	m_errno = errno;
+	throw std::exception ();
+      }
+
+      // Bind.
+      if (::bind (m_fd, address.get_sockaddr (), address.get_socklen ()) == -1) {
+	m_errno = errno;
+	throw std::exception ();
+      }
+      m_bound = true;
+
+      // Listen.
+      if (listen (m_fd, backlog) == -1) {
+	m_errno = errno;
+	throw std::exception ();
+      }
+    } catch (...) { }
+
+    schedule ();
+  }
+
+  unix_acceptor_automaton::~unix_acceptor_automaton () {
+    if (m_fd != -1) {
+      ioa::close (m_fd);
+    }
+    if (m_bound && !m_address.is_abstract ()) {
+      unlink (m_address.path ().c_str ());
+    }
+    while (!m_fd_queue.empty ()) {
+      close (m_fd_queue.front ());
+      m_fd_queue.pop ();
+    }
+  }
+
+  void unix_acceptor_automaton::schedule () const {
+    if (error_precondition ()) {
+      ioa::schedule (&unix_acceptor_automaton::error);
+    }
+    if (schedule_read_ready_precondition ()) {
+      ioa::schedule (&unix_acceptor_automaton::schedule_read_ready);
+    }
+    if (accepted_precondition ()) {
+      ioa::schedule (&unix_acceptor_automaton::accepted);
+    }
+  }
+
+  void unix_acceptor_automaton::observe (observable*) {
+    // A new consumer might let us accept.
+    schedule ();
+  }
+
+  bool unix_acceptor_automaton::accepted_precondition () const {
+    return !m_fd_queue.empty () && binding_count (&unix_acceptor_automaton::accepted) != 0;
+  }
+
+  fd_transfer unix_acceptor_automaton::accepted_effect () {
+    fd_transfer retval (m_fd_queue.front ());
+    m_fd_queue.pop ();
+    return retval;
+  }
+
+  void unix_acceptor_automaton::accepted_schedule () const {
+    schedule ();
+  }
+
+  bool unix_acceptor_automaton::error_precondition () const {
+    return m_errno != 0 && m_error_reported == false && binding_count (&unix_acceptor_automaton::error) != 0;
+  }
+
+  int unix_acceptor_automaton::error_effect () {
+    m_error_reported = true;
+    return m_errno;
+  }
+  
+  void unix_acceptor_automaton::error_schedule () const {
+    schedule ();
+  }
+
+  bool unix_acceptor_automaton::schedule_read_ready_precondition () const {
+    return m_state == SCHEDULE_READ_READY && m_errno == 0 && m_fd_queue.empty () &&
+      binding_count (&unix_acceptor_automaton::accepted) != 0;
+  }
+
+  void unix_acceptor_automaton::schedule_read_ready_effect () {
+    ioa::schedule_read_ready (&unix_acceptor_automaton::read_ready, m_fd);
+    m_state = READ_READY_WAIT;
+  }
+
+  void unix_acceptor_automaton::schedule_read_ready_schedule () const {
+    schedule ();
+  }
+
+  bool unix_acceptor_automaton::read_ready_precondition () const {
+    return m_state == READ_READY_WAIT && m_errno == 0;
+  }
+
+  void unix_acceptor_automaton::read_ready_effect () {
+    m_state = SCHEDULE_READ_READY;
+
+    // Drain the backlog.
+    for (size_t count = 0; count != m_accept_batch; ++count) {
+#ifdef SOCK_NONBLOCK
+      int connection_fd = ::accept4 (m_fd, 0, 0, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+      int connection_fd = ::accept (m_fd, 0, 0);
+      if (connection_fd != -1) {
+	fcntl (connection_fd, F_SETFL, fcntl (connection_fd, F_GETFL, 0) | O_NONBLOCK);
+	fcntl (connection_fd, F_SETFD, FD_CLOEXEC);
+      }
+#endif
+      if (connection_fd != -1) {
+	m_fd_queue.push (connection_fd);
+      }
+      else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+	// Empty.
+	break;
+      }
+      else if (errno == EINTR || errno == ECONNABORTED) {
+	continue;
+      }
+      else {
+	m_errno = errno;
+	break;
+      }
+    }
+  }
+
+  void unix_acceptor_automaton::read_ready_schedule () const {
+    schedule ();
+  }
+
+}
@@ -0,0 +1,272 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <ioa/unix_connection_automaton.hpp>
+#include "scm_rights.hpp"
+
+#include <algorithm>
+
+namespace ioa {
+
+  void unix_connection_automaton::schedule () const {
+    if (schedule_write_precondition ()) {
+      ioa::schedule (&unix_connection_automaton::schedule_write);
+    }
+    if (send_complete_precondition ()) {
+      ioa::schedule (&unix_connection_automaton::send_complete);
+    }
+    if (schedule_read_precondition ()) {
+      ioa::schedule (&unix_connection_automaton::schedule_read);
+    }
+    if (receive_precondition ()) {
+      ioa::schedule (&unix_connection_automaton::receive);
+    }
+    if (error_precondition ()) {
+      ioa::schedule (&unix_connection_automaton::error);
+    }
+  }
+
+  void unix_connection_automaton::observe (observable*) {
+    // A new binding might enable an output.
+    schedule ();
+  }
+
+  unix_connection_automaton::unix_connection_automaton (const fd_transfer& fd,
+							const size_t buffer_size,
+							const size_t max_fds) :
+    m_fd (fd.take ()),
+    m_errno (0),
+    m_error_reported (false),
+    m_send_state (SEND_WAIT),
+    m_send_offset (0),
+    m_send_complete (false),
+    m_receive_state (SCHEDULE_READ_READY),
+    m_buffer (std::max (buffer_size, static_cast<size_t> (1))),
+    m_max_fds (max_fds)
+  {
+    add_observable (&send_complete);
+    add_observable (&receive);
+    add_observable (&error);
+    if (m_fd == -1) {
+      m_errno = EBADF;
+    }
+    schedule ();
+  }
+
+  unix_connection_automaton::~unix_connection_automaton () {
+    close_queued_fds ();
+    if (m_fd != -1) {
+      ioa::close (m_fd);
+    }
+  }
+
+  void unix_connection_automaton::close_queued_fds () {
+    for (std::deque<send_item>::const_iterator pos = m_send_queue.begin ();
+	 pos != m_send_queue.end ();
+	 ++pos) {
+      for (std::vector<int>::const_iterator f = pos->fds.begin ();
+	   f != pos->fds.end ();
+	   ++f) {
+	::close (*f);
+      }
+    }
+    m_send_queue.clear ();
+  }
+
+  void unix_connection_automaton::send_effect (const unix_message& message) {
+    if (m_errno != 0 || (message.data.empty () && message.fds.empty ())) {
+      return;
+    }
+
+    m_send_queue.push_back (send_item ());
+    send_item& item = m_send_queue.back ();
+    item.data = message.data;
+    // Take the descriptors now so the sender cannot give them to anybody else.
+    for (std::vector<fd_transfer>::const_iterator pos = message.fds.begin ();
+	 pos != message.fds.end ();
+	 ++pos) {
+      const int f = pos->take ();
+      if (f != -1) {
+	item.fds.push_back (f);
+      }
+    }
+
+    if (item.data.empty ()) {
+      if (item.fds.empty ()) {
+	m_send_queue.pop_back ();
+	return;
+      }
+      // A stream socket sends nothing for an empty write and drops the descriptors with it.
+      item.data.assign (1, '\0');
+    }
+
+    m_send_complete = false;
+    if (m_send_state == SEND_WAIT) {
+      m_send_state = SCHEDULE_WRITE_READY;
+    }
+  }
+
+  void unix_connection_automaton::send_schedule () const {
+    schedule ();
+  }
+
+  bool unix_connection_automaton::schedule_write_precondition () const {
+    return m_fd != -1 && m_errno == 0 && m_send_state == SCHEDULE_WRITE_READY;
+  }
+
+  void unix_connection_automaton::schedule_write_effect () {
+    m_send_state = WRITE_READY_WAIT;
+    ioa::schedule_write_ready (&unix_connection_automaton::write_ready, m_fd);
+  }
+
+  void unix_connection_automaton::schedule_write_schedule () const {
+    schedule ();
+  }
+
+  bool unix_connection_automaton::write_ready_precondition () const {
+    return m_fd != -1 && m_errno == 0 && m_send_state == WRITE_READY_WAIT;
+  }
+
+  void unix_connection_automaton::write_ready_effect () {
+    // Write until the socket is full.
+    while (!m_send_queue.empty ()) {
+      send_item& item = m_send_queue.front ();
+      // The descriptors go with the first byte.
+      static const std::vector<int> no_fds;
+      const ssize_t bytes_written = send_with_fds (m_fd, 0, 0,
+						   item.data.data () + m_send_offset,
+						   item.data.size () - m_send_offset,
+						   m_send_offset == 0 ? item.fds : no_fds);
+      if (bytes_written == -1) {
+	if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+	  // Wait again.
+	  m_send_state = SCHEDULE_WRITE_READY;
+	}
+	else {
+	  m_errno = errno;
+	}
+	return;
+      }
+
+      if (m_send_offset == 0) {
+	// The kernel holds its own references now.
+	for (std::vector<int>::const_iterator pos = item.fds.begin ();
+	     pos != item.fds.end ();
+	     ++pos) {
+	  ::close (*pos);
+	}
+	item.fds.clear ();
+      }
+
+      m_send_offset += bytes_written;
+      if (m_send_offset >= item.data.size ()) {
+	m_send_queue.pop_front ();
+	m_send_offset = 0;
+      }
+    }
+
+    m_send_state = SEND_WAIT;
+    m_send_complete = true;
+  }
+
+  void unix_connection_automaton::write_ready_schedule () const {
+    schedule ();
+  }
+
+  bool unix_connection_automaton::send_complete_precondition () const {
+    return m_send_complete && binding_count (&unix_connection_automaton::send_complete) != 0;
+  }
+
+  void unix_connection_automaton::send_complete_effect () {
+    m_send_complete = false;
+  }
+
+  void unix_connection_automaton::send_complete_schedule () const {
+    schedule ();
+  }
+
+  bool unix_connection_automaton::schedule_read_precondition () const {
+    return m_fd != -1 && m_errno == 0 && m_receive_state == SCHEDULE_READ_READY;
+  }
+
+  void unix_connection_automaton::schedule_read_effect () {
+    m_receive_state = READ_READY_WAIT;
+    ioa::schedule_read_ready (&unix_connection_automaton::read_ready, m_fd);
+  }
+
+  void unix_connection_automaton::schedule_read_schedule () const {
+    schedule ();
+  }
+
+  bool unix_connection_automaton::read_ready_precondition () const {
+    return m_fd != -1 && m_errno == 0 && m_receive_state == READ_READY_WAIT;
+  }
+
+  void unix_connection_automaton::read_ready_effect () {
+    m_receive_message = unix_message ();
+    const ssize_t bytes_read = receive_with_fds (m_fd, 0, 0, &m_buffer[0], m_buffer.size (), m_max_fds, m_receive_message.fds);
+    if (bytes_read == -1) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+	// Spurious.  Wait again.
+	m_receive_state = SCHEDULE_READ_READY;
+      }
+      else {
+	m_errno = errno;
+      }
+      return;
+    }
+    else if (bytes_read == 0 && m_receive_message.fds.empty ()) {
+      m_errno = ECONNRESET;
+      return;
+    }
+
+    m_receive_message.data.assign (&m_buffer[0], bytes_read);
+    m_receive_state = RECEIVE_READY;
+  }
+
+  void unix_connection_automaton::read_ready_schedule () const {
+    schedule ();
+  }
+
+  bool unix_connection_automaton::receive_precondition () const {
+    return m_receive_state == RECEIVE_READY && binding_count (&unix_connection_automaton::receive) != 0;
+  }
+
+  unix_message unix_connection_automaton::receive_effect () {
+    unix_message retval;
+    std::swap (retval, m_receive_message);
+    m_receive_state = SCHEDULE_READ_READY;
+    return retval;
+  }
+
+  void unix_connection_automaton::receive_schedule () const {
+    schedule ();
+  }
+
+  bool unix_connection_automaton::error_precondition () const {
+    return m_errno != 0 && !m_error_reported && binding_count (&unix_connection_automaton::error) != 0;
+  }
+
+  int unix_connection_automaton::error_effect () {
+    m_error_reported = true;
+    return m_errno;
+  }
+
+  void unix_connection_automaton::error_schedule () const {
+    schedule ();
+  }
+
+}
@@ -0,0 +1,186 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <ioa/unix_connector_automaton.hpp>
+
+#include <fcntl.h>
+
+namespace ioa {
+
+  void unix_connector_automaton::schedule () const {
+    if (error_precondition ()) {
+      ioa::schedule (&unix_connector_automaton::error);
+    }
+    if (connected_precondition ()) {
+      ioa::schedule (&unix_connector_automaton::connected);
+    }
+  }
+
+  void unix_connector_automaton::observe (observable*) {
+    schedule ();
+  }
+
+  unix_connector_automaton::unix_connector_automaton (const unix_address& address,
+						      const int type,
+						      const size_t retries,
+						      const time& backoff) :
+    m_address (address),
+    m_type (type),
+    m_retries (retries),
+    m_backoff (backoff),
+    m_fd (-1),
+    m_connected (false),
+    m_retry_wait (false),
+    m_errno (0),
+    m_error_reported (false) {
+    add_observable (&connected);
+    add_observable (&error);
+    attempt ();
+    schedule ();
+  }
+
+  void unix_connector_automaton::attempt () {
+    if (m_address.get_errno () != 0) {
+      // Retrying will not help.
+      m_errno = m_address.get_errno ();
+      return;
+    }
+
+    // Open a socket.
+    m_fd = socket (AF_UNIX, m_type, 0);
+    if (m_fd == -1) {
+      fail (errno);
+      return;
+    }
+      
+    // Get the flags.
+    int flags = fcntl (m_fd, F_GETFL, 0);
+    if (flags < 0) {
+      fail (errno);
+      return;
+    }
+      
+    // Set non-blocking.
+    flags |= O_NONBLOCK;
+    if (fcntl (m_fd, F_SETFL, flags) == -1) {
+      fail (errno);
+      return;
+    }
+      
+    if (::connect (m_fd, m_address.get_sockaddr (), m_address.get_socklen ()) != -1) {
+      m_connected = true;
+    }
+    else if (errno == EINPROGRESS) {
+      // Asynchronous connect.
+      ioa::schedule_write_ready (&unix_connector_automaton::write_ready, m_fd);
+    }
+    else {
+      // Linux reports a full backlog with EAGAIN instead of completing later.
+      fail (errno);
+    }
+  }
+
+  void unix_connector_automaton::fail (const int error) {
+    if (m_fd != -1) {
+      // Also drops the write_ready registration.
+      ioa::close (m_fd);
+      m_fd = -1;
+    }
+
+    if (m_retries != 0) {
+      --m_retries;
+      m_retry_wait = true;
+      ioa::schedule_after (&unix_connector_automaton::retry, m_backoff);
+      m_backoff += m_backoff;
+    }
+    else {
+      m_errno = error;
+    }
+  }
+
+  unix_connector_automaton::~unix_connector_automaton () {
+    if (m_fd != -1) {
+      ioa::close (m_fd);
+    }
+  }
+
+  bool unix_connector_automaton::error_precondition () const {
+    return m_errno != 0 && m_error_reported == false && binding_count (&unix_connector_automaton::error) != 0;
+  }
+
+  int unix_connector_automaton::error_effect () {
+    m_error_reported = true;
+    return m_errno;
+  }
+  
+  void unix_connector_automaton::error_schedule () const {
+    schedule ();
+  }
+
+  bool unix_connector_automaton::connected_precondition () const {
+    return m_connected && binding_count (&unix_connector_automaton::connected) != 0;
+  }
+
+  fd_transfer unix_connector_automaton::connected_effect () {
+    fd_transfer retval (m_fd);
+    m_fd = -1;
+    m_connected = false;
+    return retval;
+  }
+
+  void unix_connector_automaton::connected_schedule () const {
+    schedule ();
+  }
+
+  bool unix_connector_automaton::write_ready_precondition () const {
+    return m_fd != -1 && !m_connected;
+  }
+
+  void unix_connector_automaton::write_ready_effect () {
+    // See if the connection succeeded.
+    int val;
+    socklen_t sz = sizeof (val);
+    if (getsockopt (m_fd, SOL_SOCKET, SO_ERROR, &val, &sz) == -1) {
+      fail (errno);
+      return;
+    }
+
+    if (val == 0) {
+      m_connected = true;
+    }
+    else {
+      fail (val);
+    }
+  }
+
+  void unix_connector_automaton::write_ready_schedule () const {
+    schedule ();
+  }
+
+  bool unix_connector_automaton::retry_precondition () const {
+    return m_retry_wait;
+  }
+
+  void unix_connector_automaton::retry_effect () {
+    m_retry_wait = false;
+    attempt ();
+  }
+
+  void unix_connector_automaton::retry_schedule () const {
+    schedule ();
+  }
+
+}
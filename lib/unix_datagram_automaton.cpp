@@ -0,0 +1,287 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <ioa/unix_datagram_automaton.hpp>
+#include "scm_rights.hpp"
+
+#include <algorithm>
+#include <fcntl.h>
+
+namespace ioa {
+
+  void unix_datagram_automaton::schedule () const {
+    if (receive_precondition ()) {
+      ioa::schedule (&unix_datagram_automaton::receive);
+    }
+    if (send_complete_precondition ()) {
+      ioa::schedule (&unix_datagram_automaton::send_complete);
+    }
+    if (error_precondition ()) {
+      ioa::schedule (&unix_datagram_automaton::error);
+    }
+    if (schedule_write_ready_precondition ()) {
+      ioa::schedule (&unix_datagram_automaton::schedule_write_ready);
+    }
+    if (schedule_read_ready_precondition ()) {
+      ioa::schedule (&unix_datagram_automaton::schedule_read_ready);
+    }
+  }
+
+  void unix_datagram_automaton::observe (observable*) {
+    // A new binding might enable an output.
+    schedule ();
+  }
+
+  unix_datagram_automaton::unix_datagram_automaton (const unix_address& address,
+						    const size_t buffer_size,
+						    const size_t max_fds) :
+    m_address (address),
+    m_fd (-1),
+    m_errno (0),
+    m_error_reported (false),
+    m_bound (false),
+    m_send_state (SEND_WAIT),
+    m_send_complete (false),
+    m_receive_state (SCHEDULE_READ_READY),
+    m_buffer (std::max (buffer_size, static_cast<size_t> (1))),
+    m_max_fds (max_fds)
+  {
+    add_observable (&send_complete);
+    add_observable (&receive);
+    add_observable (&error);
+
+    try {
+      if (address.get_errno () != 0) {
+	m_errno = address.get_errno ();
+	throw std::exception ();
+      }
+
+      // Open a socket.
+      m_fd = socket (AF_UNIX, SOCK_DGRAM, 0);
+      if (m_fd == -1) {
+	m_errno = errno;
+	throw std::exception ();
+      }
+
+      // Get the flags.
+      int flags = fcntl (m_fd, F_GETFL, 0);
+      if (flags < 0) {
+	m_errno = errno;
+	throw std::exception ();
+      }
+
+      // Set non-blocking.
+      flags |= O_NONBLOCK;
+      if (fcntl (m_fd, F_SETFL, flags) == -1) {
+	m_errno = errno;
+	throw std::exception ();
+      }
+
+      if (!address.path ().empty ()) {
+	// Bind.
+	if (::bind (m_fd, address.get_sockaddr (), address.get_socklen ()) == -1) {
+	  m_errno = errno;
+	  throw std::exception ();
+	}
+	m_bound = true;
+      }
+    } catch (...) { }
+
+    schedule ();
+  }
+
+  unix_datagram_automaton::~unix_datagram_automaton () {
+    for (std::deque<send_item>::const_iterator pos = m_send_queue.begin ();
+	 pos != m_send_queue.end ();
+	 ++pos) {
+      for (std::vector<int>::const_iterator f = pos->fds.begin ();
+	   f != pos->fds.end ();
+	   ++f) {
+	::close (*f);
+      }
+    }
+    if (m_fd != -1) {
+      ioa::close (m_fd);
+    }
+    if (m_bound && !m_address.is_abstract ()) {
+      unlink (m_address.path ().c_str ());
+    }
+  }
+
+  void unix_datagram_automaton::send_effect (const send_arg& arg) {
+    if (m_errno != 0) {
+      return;
+    }
+
+    m_send_queue.push_back (send_item ());
+    send_item& item = m_send_queue.back ();
+    item.address = arg.address;
+    item.data = arg.message.data;
+    // Take the descriptors now so the sender cannot give them to anybody else.
+    for (std::vector<fd_transfer>::const_iterator pos = arg.message.fds.begin ();
+	 pos != arg.message.fds.end ();
+	 ++pos) {
+      const int f = pos->take ();
+      if (f != -1) {
+	item.fds.push_back (f);
+      }
+    }
+
+    m_send_complete = false;
+    if (m_send_state == SEND_WAIT) {
+      m_send_state = SCHEDULE_WRITE_READY;
+    }
+  }
+
+  void unix_datagram_automaton::send_schedule () const {
+    schedule ();
+  }
+
+  bool unix_datagram_automaton::send_complete_precondition () const {
+    return m_send_complete && binding_count (&unix_datagram_automaton::send_complete) != 0;
+  }
+
+  void unix_datagram_automaton::send_complete_effect () {
+    m_send_complete = false;
+  }
+
+  void unix_datagram_automaton::send_complete_schedule () const {
+    schedule ();
+  }
+
+  bool unix_datagram_automaton::receive_precondition () const {
+    return m_receive_state == RECEIVE_READY && binding_count (&unix_datagram_automaton::receive) != 0;
+  }
+
+  unix_datagram_automaton::receive_val unix_datagram_automaton::receive_effect () {
+    receive_val retval;
+    std::swap (retval, m_receive_val);
+    m_receive_state = SCHEDULE_READ_READY;
+    return retval;
+  }
+
+  void unix_datagram_automaton::receive_schedule () const {
+    schedule ();
+  }
+
+  bool unix_datagram_automaton::error_precondition () const {
+    return m_errno != 0 && !m_error_reported && binding_count (&unix_datagram_automaton::error) != 0;
+  }
+
+  int unix_datagram_automaton::error_effect () {
+    m_error_reported = true;
+    return m_errno;
+  }
+
+  void unix_datagram_automaton::error_schedule () const {
+    schedule ();
+  }
+
+  bool unix_datagram_automaton::schedule_write_ready_precondition () const {
+    return m_fd != -1 && m_errno == 0 && m_send_state == SCHEDULE_WRITE_READY;
+  }
+
+  void unix_datagram_automaton::schedule_write_ready_effect () {
+    m_send_state = WRITE_READY_WAIT;
+    ioa::schedule_write_ready (&unix_datagram_automaton::write_ready, m_fd);
+  }
+
+  void unix_datagram_automaton::schedule_write_ready_schedule () const {
+    schedule ();
+  }
+
+  bool unix_datagram_automaton::write_ready_precondition () const {
+    return m_fd != -1 && m_errno == 0 && m_send_state == WRITE_READY_WAIT;
+  }
+
+  void unix_datagram_automaton::write_ready_effect () {
+    // Write until the socket is full.
+    while (!m_send_queue.empty ()) {
+      send_item& item = m_send_queue.front ();
+      const ssize_t r = send_with_fds (m_fd, item.address.get_sockaddr (), item.address.get_socklen (),
+				       item.data.data (), item.data.size (), item.fds);
+      if (r == -1) {
+	if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+	  // Wait for the receiver to drain.
+	  m_send_state = SCHEDULE_WRITE_READY;
+	  return;
+	}
+	else if (errno != ENOENT && errno != ECONNREFUSED && errno != EMSGSIZE) {
+	  m_errno = errno;
+	  return;
+	}
+	// The datagram cannot be delivered.
+      }
+
+      // Sent or dropped.
+      for (std::vector<int>::const_iterator pos = item.fds.begin ();
+	   pos != item.fds.end ();
+	   ++pos) {
+	::close (*pos);
+      }
+      m_send_queue.pop_front ();
+    }
+
+    m_send_state = SEND_WAIT;
+    m_send_complete = true;
+  }
+
+  void unix_datagram_automaton::write_ready_schedule () const {
+    schedule ();
+  }
+
+  bool unix_datagram_automaton::schedule_read_ready_precondition () const {
+    return m_bound && m_errno == 0 && m_receive_state == SCHEDULE_READ_READY;
+  }
+
+  void unix_datagram_automaton::schedule_read_ready_effect () {
+    m_receive_state = READ_READY_WAIT;
+    ioa::schedule_read_ready (&unix_datagram_automaton::read_ready, m_fd);
+  }
+
+  void unix_datagram_automaton::schedule_read_ready_schedule () const {
+    schedule ();
+  }
+
+  bool unix_datagram_automaton::read_ready_precondition () const {
+    return m_errno == 0 && m_receive_state == READ_READY_WAIT;
+  }
+
+  void unix_datagram_automaton::read_ready_effect () {
+    m_receive_val = receive_val ();
+    const ssize_t r = receive_with_fds (m_fd,
+					m_receive_val.address.get_sockaddr_ptr (), m_receive_val.address.get_socklen_ptr (),
+					&m_buffer[0], m_buffer.size (), m_max_fds, m_receive_val.message.fds);
+    if (r == -1) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+	// Spurious.  Wait again.
+	m_receive_state = SCHEDULE_READ_READY;
+      }
+      else {
+	m_errno = errno;
+      }
+      return;
+    }
+
+    m_receive_val.message.data.assign (&m_buffer[0], r);
+    m_receive_state = RECEIVE_READY;
+  }
+
+  void unix_datagram_automaton::read_ready_schedule () const {
+    schedule ();
+  }
+
+}
@@ -0,0 +1,287 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "uring.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <errno.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+namespace ioa {
+
+#ifdef __linux__
+
+  static int io_uring_setup (const unsigned entries,
+			     struct io_uring_params* p) {
+    return syscall (__NR_io_uring_setup, entries, p);
+  }
+
+  static int io_uring_enter (const int fd,
+			     const unsigned to_submit,
+			     const unsigned min_complete,
+			     const unsigned flags) {
+    return syscall (__NR_io_uring_enter, fd, to_submit, min_complete, flags, 0, 0);
+  }
+
+  uring::uring (const unsigned entries) :
+    m_fd (-1),
+    m_sq_ptr (MAP_FAILED),
+    m_sq_size (0),
+    m_cq_ptr (MAP_FAILED),
+    m_cq_size (0),
+    m_sqes (0),
+    m_sqes_size (0),
+    m_queued (0)
+  {
+    struct io_uring_params p;
+    memset (&p, 0, sizeof (p));
+    p.flags = IORING_SETUP_CLAMP;
+    const int fd = io_uring_setup (entries, &p);
+    if (fd == -1) {
+      return;
+    }
+
+    m_sq_size = p.sq_off.array + p.sq_entries * sizeof (unsigned);
+    m_cq_size = p.cq_off.cqes + p.cq_entries * sizeof (struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+      m_sq_size = m_cq_size = std::max (m_sq_size, m_cq_size);
+    }
+    m_sq_ptr = mmap (0, m_sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (m_sq_ptr == MAP_FAILED) {
+      ::close (fd);
+      return;
+    }
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+      m_cq_ptr = m_sq_ptr;
+    }
+    else {
+      m_cq_ptr = mmap (0, m_cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    }
+    m_sqes_size = p.sq_entries * sizeof (struct io_uring_sqe);
+    void* sqes = mmap (0, m_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (m_cq_ptr == MAP_FAILED || sqes == MAP_FAILED) {
+      if (sqes != MAP_FAILED) {
+	munmap (sqes, m_sqes_size);
+      }
+      if (m_cq_ptr != MAP_FAILED && m_cq_ptr != m_sq_ptr) {
+	munmap (m_cq_ptr, m_cq_size);
+      }
+      munmap (m_sq_ptr, m_sq_size);
+      m_sq_ptr = m_cq_ptr = MAP_FAILED;
+      ::close (fd);
+      return;
+    }
+
+    char* sq = static_cast<char*> (m_sq_ptr);
+    m_sq_head = reinterpret_cast<unsigned*> (sq + p.sq_off.head);
+    m_sq_tail = reinterpret_cast<unsigned*> (sq + p.sq_off.tail);
+    m_sq_mask = *reinterpret_cast<unsigned*> (sq + p.sq_off.ring_mask);
+    m_sq_array = reinterpret_cast<unsigned*> (sq + p.sq_off.array);
+    char* cq = static_cast<char*> (m_cq_ptr);
+    m_cq_head = reinterpret_cast<unsigned*> (cq + p.cq_off.head);
+    m_cq_tail = reinterpret_cast<unsigned*> (cq + p.cq_off.tail);
+    m_cq_mask = *reinterpret_cast<unsigned*> (cq + p.cq_off.ring_mask);
+    m_cqes = reinterpret_cast<struct io_uring_cqe*> (cq + p.cq_off.cqes);
+    m_sqes = static_cast<struct io_uring_sqe*> (sqes);
+    m_timespecs.resize (2 * p.sq_entries);
+    m_fd = fd;
+  }
+
+  uring::~uring () {
+    if (m_fd != -1) {
+      munmap (m_sqes, m_sqes_size);
+      if (m_cq_ptr != m_sq_ptr) {
+	munmap (m_cq_ptr, m_cq_size);
+      }
+      munmap (m_sq_ptr, m_sq_size);
+      ::close (m_fd);
+    }
+  }
+
+  bool uring::valid () const {
+    return m_fd != -1;
+  }
+
+  io_uring_sqe* uring::get_sqe () {
+    if (m_queued == m_sq_mask + 1) {
+      // Full.
+      submit (0);
+      if (m_queued == m_sq_mask + 1) {
+	return 0;
+      }
+    }
+
+    // The entry at the tail is not visible to the kernel until push advances the tail.
+    struct io_uring_sqe* sqe = &m_sqes[*m_sq_tail & m_sq_mask];
+    memset (sqe, 0, sizeof (*sqe));
+    return sqe;
+  }
+
+  void uring::push () {
+    // Only this thread writes the tail.
+    const unsigned tail = *m_sq_tail;
+    const unsigned index = tail & m_sq_mask;
+    m_sq_array[index] = index;
+    // The opcode and fields of the entry must be visible before the tail that publishes it.
+    __sync_synchronize ();
+    *m_sq_tail = tail + 1;
+    ++m_queued;
+  }
+
+  int uring::submit (const unsigned wait) {
+    int r;
+    do {
+      r = io_uring_enter (m_fd, m_queued, wait, wait != 0 ? IORING_ENTER_GETEVENTS : 0);
+    } while (r == -1 && errno == EINTR);
+    if (r >= 0) {
+      m_queued -= std::min (m_queued, static_cast<unsigned> (r));
+    }
+    return r;
+  }
+
+  bool uring::poll_add (const int fd,
+			const unsigned events,
+			const uint64_t data) {
+    struct io_uring_sqe* sqe = get_sqe ();
+    if (sqe == 0) {
+      return false;
+    }
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = events;
+    sqe->user_data = data;
+    push ();
+    return true;
+  }
+
+  bool uring::poll_remove (const uint64_t target) {
+    struct io_uring_sqe* sqe = get_sqe ();
+    if (sqe == 0) {
+      return false;
+    }
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = target;
+    // The completion of a removal is ignored.
+    sqe->user_data = 0;
+    push ();
+    return true;
+  }
+
+  bool uring::timeout (const time& offset,
+		       const uint64_t data) {
+    struct io_uring_sqe* sqe = get_sqe ();
+    if (sqe == 0) {
+      return false;
+    }
+    const size_t slot = 2 * (sqe - m_sqes);
+    m_timespecs[slot] = offset.nsec () / 1000000000;
+    m_timespecs[slot + 1] = offset.nsec () % 1000000000;
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = reinterpret_cast<uint64_t> (&m_timespecs[slot]);
+    sqe->len = 1;
+    sqe->user_data = data;
+    push ();
+    return true;
+  }
+
+  bool uring::timeout_remove (const uint64_t target) {
+    struct io_uring_sqe* sqe = get_sqe ();
+    if (sqe == 0) {
+      return false;
+    }
+    sqe->opcode = IORING_OP_TIMEOUT_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = target;
+    sqe->user_data = 0;
+    push ();
+    return true;
+  }
+
+  int uring::enter (const bool wait) {
+    if (submit (wait ? 1 : 0) == -1) {
+      // EBUSY and EAGAIN mean the completion queue must be read before more entries are taken.
+      return (errno == EINTR || errno == EBUSY || errno == EAGAIN) ? 0 : -1;
+    }
+    return 0;
+  }
+
+  bool uring::next (uint64_t& data,
+		    int& result) {
+    const unsigned head = *m_cq_head;
+    // Read the tail before the entry.
+    const unsigned tail = *m_cq_tail;
+    __sync_synchronize ();
+    if (head == tail) {
+      return false;
+    }
+    const struct io_uring_cqe& cqe = m_cqes[head & m_cq_mask];
+    data = cqe.user_data;
+    result = cqe.res;
+    // Finish reading the entry before giving it back.
+    __sync_synchronize ();
+    *m_cq_head = head + 1;
+    return true;
+  }
+
+#else
+
+  uring::uring (const unsigned) :
+    m_fd (-1)
+  { }
+
+  uring::~uring () { }
+
+  bool uring::valid () const {
+    return false;
+  }
+
+  bool uring::poll_add (const int, const unsigned, const uint64_t) {
+    return false;
+  }
+
+  bool uring::poll_remove (const uint64_t) {
+    return false;
+  }
+
+  bool uring::timeout (const time&, const uint64_t) {
+    return false;
+  }
+
+  bool uring::timeout_remove (const uint64_t) {
+    return false;
+  }
+
+  int uring::enter (const bool) {
+    errno = ENOSYS;
+    return -1;
+  }
+
+  bool uring::next (uint64_t&, int&) {
+    return false;
+  }
+
+#endif
+
+}
@@ -0,0 +1,95 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef __uring_hpp__
+#define __uring_hpp__
+
+#include <ioa/time.hpp>
+#include <cstddef>
+#include <vector>
+#include <stdint.h>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace ioa {
+
+  /*
+    A minimal io_uring built on the raw system calls so the library does not depend on liburing.
+    Requests are queued by the add functions and submitted together by enter.
+    The add functions return false if the submission queue is full and the kernel will not take the queued entries until completions are read.
+    Completions are read with next after enter returns.
+    valid () is false if the kernel does not support io_uring.
+  */
+  class uring
+  {
+  private:
+    int m_fd;
+    void* m_sq_ptr;
+    size_t m_sq_size;
+    void* m_cq_ptr;
+    size_t m_cq_size;
+    io_uring_sqe* m_sqes;
+    size_t m_sqes_size;
+    unsigned* m_sq_head;
+    unsigned* m_sq_tail;
+    unsigned m_sq_mask;
+    unsigned* m_sq_array;
+    unsigned* m_cq_head;
+    unsigned* m_cq_tail;
+    unsigned m_cq_mask;
+    io_uring_cqe* m_cqes;
+    // Entries queued since the last enter.
+    unsigned m_queued;
+    // The kernel reads a timeout when it is submitted so each entry has a slot.
+    std::vector<int64_t> m_timespecs;
+
+    uring (const uring&) { }
+    void operator= (const uring&) { }
+
+    // Returns the cleared entry at the tail or 0 if the queue is full.
+    io_uring_sqe* get_sqe ();
+    // Publishes the entry returned by get_sqe once it is filled in.
+    void push ();
+    int submit (const unsigned wait);
+
+  public:
+    uring (const unsigned entries);
+    ~uring ();
+    bool valid () const;
+
+    bool poll_add (const int fd,
+		   const unsigned events,
+		   const uint64_t data);
+    bool poll_remove (const uint64_t target);
+    bool timeout (const time& offset,
+		  const uint64_t data);
+    bool timeout_remove (const uint64_t target);
+
+    /*
+      Submits the queued entries and, if wait is true, waits for at least one completion.
+      Returns 0 if the wait was interrupted or the kernel is busy until completions are read; entries it did not take are submitted by the next enter.
+      Returns -1 and sets errno for other errors.
+    */
+    int enter (const bool wait);
+    // Returns false when no completion is left.
+    bool next (uint64_t& data,
+	       int& result);
+  };
+
+}
+
+#endif
@@ -62,11 +62,22 @@ struct test_model :
   int execute_input_bound (ioa::input_executor_interface& exec) { return -1; }
   int execute_output_unbound (ioa::output_executor_interface& exec) { return -1; }
   int execute_input_unbound (ioa::input_executor_interface& exec) { return -1; }
+
+  // Delivering the values of a buffered binding.
+  int execute_deliver (ioa::input_executor_interface& exec) { return -1; }
 };
 
 struct test_system_scheduler :
   public ioa::system_scheduler_interface
 {
+  size_t m_deliver_count;
+  size_t m_drained_count;
+
+  test_system_scheduler () :
+    m_deliver_count (0),
+    m_drained_count (0)
+  { }
+
   void set_current_aid (const ioa::aid_t aid) { }
   void clear_current_aid () { }
     
@@ -116,6 +127,16 @@ struct test_system_scheduler :
   void destroyed (const ioa::aid_t automaton,
 		  const ioa::destroyed_t,
 		  void* const key) { }
+
+  void deliver (const ioa::input_executor_interface& in) {
+    std::auto_ptr<ioa::input_executor_interface> ptr = in.clone ();
+    ++m_deliver_count;
+  }
+
+  void drained (const ioa::output_executor_interface& out) {
+    std::auto_ptr<ioa::output_executor_interface> ptr = out.clone ();
+    ++m_drained_count;
+  }
 };
 
 static const char*
@@ -347,7 +368,7 @@ unvalued_unparameterized_output_action ()
   // Always set parameter before binding.
   action.set_parameter (input1_handle);
   input1.set_parameter (h);
-  action.bind (tss, tm, input1, binder_handle, &input1);
+  action.bind (tss, tm, input1, binder_handle, &input1, 0);
   mu_assert (!action.empty ());
   mu_assert (action.size () == 1);
   mu_assert (action.involves_input (input1));
@@ -357,7 +378,7 @@ unvalued_unparameterized_output_action ()
 
   action.set_parameter (input2_handle);
   input2.set_parameter (h);
-  action.bind (tss, tm, input2, binder_handle, &input2);
+  action.bind (tss, tm, input2, binder_handle, &input2, 0);
   mu_assert (!action.empty ());
   mu_assert (action.size () == 2);
   mu_assert (action.involves_input (input2));
@@ -367,7 +388,7 @@ unvalued_unparameterized_output_action ()
 
   action.set_parameter (input3_handle);
   input3.set_parameter (h);
-  action.bind (tss, tm, input3, binder_handle, &input3);
+  action.bind (tss, tm, input3, binder_handle, &input3, 0);
   mu_assert (!action.empty ());
   mu_assert (action.size () == 3);
   mu_assert (action.involves_input (input3));
@@ -413,13 +434,13 @@ unvalued_unparameterized_output_action ()
 
   action.set_parameter (input1_handle);
   input1.set_parameter (h);
-  action.bind (tss, tm, input1, binder_handle, &input1);
+  action.bind (tss, tm, input1, binder_handle, &input1, 0);
   action.set_parameter (input2_handle);
   input2.set_parameter (h);
-  action.bind (tss, tm, input2, binder_handle, &input2);
+  action.bind (tss, tm, input2, binder_handle, &input2, 0);
   action.set_parameter (input3_handle);
   input3.set_parameter (h);
-  action.bind (tss, tm, input3, binder_handle, &input3);
+  action.bind (tss, tm, input3, binder_handle, &input3, 0);
   mu_assert (!action.empty ());
   mu_assert (action.size () == 3);
 
@@ -479,7 +500,7 @@ unvalued_parameterized_output_action ()
 
   action.set_parameter (input1_handle);
   input1.set_parameter (h);
-  action.bind (tss, tm, input1, binder_handle, &input1);
+  action.bind (tss, tm, input1, binder_handle, &input1, 0);
   mu_assert (!action.empty ());
   mu_assert (action.size () == 1);
   mu_assert (action.involves_input (input1));
@@ -489,7 +510,7 @@ unvalued_parameterized_output_action ()
 
   action.set_parameter (input2_handle);
   input2.set_parameter (h);
-  action.bind (tss, tm, input2, binder_handle, &input2);
+  action.bind (tss, tm, input2, binder_handle, &input2, 0);
   mu_assert (!action.empty ());
   mu_assert (action.size () == 2);
   mu_assert (action.involves_input (input2));
@@ -499,7 +520,7 @@ unvalued_parameterized_output_action ()
 
   action.set_parameter (input3_handle);
   input3.set_parameter (h);
-  action.bind (tss, tm, input3, binder_handle, &input3);
+  action.bind (tss, tm, input3, binder_handle, &input3, 0);
   mu_assert (!action.empty ());
   mu_assert (action.size () == 3);
   mu_assert (action.involves_input (input3));
@@ -548,13 +569,13 @@ unvalued_parameterized_output_action ()
 
   action.set_parameter (input1_handle);
   input1.set_parameter (h);
-  action.bind (tss, tm, input1, binder_handle, &input1);
+  action.bind (tss, tm, input1, binder_handle, &input1, 0);
   action.set_parameter (input2_handle);
   input2.set_parameter (h);
-  action.bind (tss, tm, input2, binder_handle, &input2);
+  action.bind (tss, tm, input2, binder_handle, &input2, 0);
   action.set_parameter (input3_handle);
   input3.set_parameter (h);
-  action.bind (tss, tm, input3, binder_handle, &input3);
+  action.bind (tss, tm, input3, binder_handle, &input3, 0);
   mu_assert (!action.empty ());
   mu_assert (action.size () == 3);
 
@@ -607,7 +628,7 @@ unvalued_auto_parameterized_output_action ()
 
   action.set_parameter (input1_handle);
   input1.set_parameter (h);
-  action.bind (tss, tm, input1, binder_handle, &input1);
+  action.bind (tss, tm, input1, binder_handle, &input1, 0);
   mu_assert (!action.empty ());
   mu_assert (action.size () == 1);
   mu_assert (action.involves_input (input1));
@@ -678,7 +699,7 @@ valued_unparameterized_output_action ()
   // Always set parameter before binding.
   action.set_parameter (input1_handle);
   input1.set_parameter (h);
-  action.bind (tss, tm, input1, binder_handle, &input1);
+  action.bind (tss, tm, input1, binder_handle, &input1, 0);
   mu_assert (!action.empty ());
   mu_assert (action.size () == 1);
   mu_assert (action.involves_input (input1));
@@ -688,7 +709,7 @@ valued_unparameterized_output_action ()
 
   action.set_parameter (input2_handle);
   input2.set_parameter (h);
-  action.bind (tss, tm, input2, binder_handle, &input2);
+  action.bind (tss, tm, input2, binder_handle, &input2, 0);
   mu_assert (!action.empty ());
   mu_assert (action.size () == 2);
   mu_assert (action.involves_input (input2));
@@ -698,7 +719,7 @@ valued_unparameterized_output_action ()
 
   action.set_parameter (input3_handle);
   input3.set_parameter (h);
-  action.bind (tss, tm, input3, binder_handle, &input3);
+  action.bind (tss, tm, input3, binder_handle, &input3, 0);
   mu_assert (!action.empty ());
   mu_assert (action.size () == 3);
   mu_assert (action.involves_input (input3));
@@ -744,13 +765,13 @@ valued_unparameterized_output_action ()
 
   action.set_parameter (input1_handle);
   input1.set_parameter (h);
-  action.bind (tss, tm, input1, binder_handle, &input1);
+  action.bind (tss, tm, input1, binder_handle, &input1, 0);
   action.set_parameter (input2_handle);
   input2.set_parameter (h);
-  action.bind (tss, tm, input2, binder_handle, &input2);
+  action.bind (tss, tm, input2, binder_handle, &input2, 0);
   action.set_parameter (input3_handle);
   input3.set_parameter (h);
-  action.bind (tss, tm, input3, binder_handle, &input3);
+  action.bind (tss, tm, input3, binder_handle, &input3, 0);
   mu_assert (!action.empty ());
   mu_assert (action.size () == 3);
 
@@ -810,7 +831,7 @@ valued_parameterized_output_action ()
 
   action.set_parameter (input1_handle);
   input1.set_parameter (h);
-  action.bind (tss, tm, input1, binder_handle, &input1);
+  action.bind (tss, tm, input1, binder_handle, &input1, 0);
   mu_assert (!action.empty ());
   mu_assert (action.size () == 1);
   mu_assert (action.involves_input (input1));
@@ -820,7 +841,7 @@ valued_parameterized_output_action ()
 
   action.set_parameter (input2_handle);
   input2.set_parameter (h);
-  action.bind (tss, tm, input2, binder_handle, &input2);
+  action.bind (tss, tm, input2, binder_handle, &input2, 0);
   mu_assert (!action.empty ());
   mu_assert (action.size () == 2);
   mu_assert (action.involves_input (input2));
@@ -830,7 +851,7 @@ valued_parameterized_output_action ()
 
   action.set_parameter (input3_handle);
   input3.set_parameter (h);
-  action.bind (tss, tm, input3, binder_handle, &input3);
+  action.bind (tss, tm, input3, binder_handle, &input3, 0);
   mu_assert (!action.empty ());
   mu_assert (action.size () == 3);
   mu_assert (action.involves_input (input3));
@@ -879,13 +900,13 @@ valued_parameterized_output_action ()
 
   action.set_parameter (input1_handle);
   input1.set_parameter (h);
-  action.bind (tss, tm, input1, binder_handle, &input1);
+  action.bind (tss, tm, input1, binder_handle, &input1, 0);
   action.set_parameter (input2_handle);
   input2.set_parameter (h);
-  action.bind (tss, tm, input2, binder_handle, &input2);
+  action.bind (tss, tm, input2, binder_handle, &input2, 0);
   action.set_parameter (input3_handle);
   input3.set_parameter (h);
-  action.bind (tss, tm, input3, binder_handle, &input3);
+  action.bind (tss, tm, input3, binder_handle, &input3, 0);
   mu_assert (!action.empty ());
   mu_assert (action.size () == 3);
 
@@ -938,7 +959,7 @@ valued_auto_parameterized_output_action ()
 
   action.set_parameter (input1_handle);
   input1.set_parameter (h);
-  action.bind (tss, tm, input1, binder_handle, &input1);
+  action.bind (tss, tm, input1, binder_handle, &input1, 0);
   mu_assert (!action.empty ());
   mu_assert (action.size () == 1);
   mu_assert (action.involves_input (input1));
@@ -968,6 +989,62 @@ valued_auto_parameterized_output_action ()
   return 0;
 }
 
+static const char*
+buffered_output_action ()
+{
+  std::cout << __func__ << std::endl;
+
+  // Must exist whole time.
+  test_model tm;
+  test_system_scheduler tss;
+
+  ioa::automaton_handle<automaton1> h (1);
+  ioa::action_executor<automaton1, automaton1::v_up_output_action> action (h, &automaton1::v_up_output);
+
+  ioa::automaton_handle<automaton1> input1_handle (2);
+  ioa::automaton_handle<automaton1> binder_handle (5);
+
+  ioa::action_executor<automaton1, automaton1::v_up_input_action> input1 (input1_handle, &automaton1::v_up_input);
+  mu_assert (input1.fetch_instance (tm));
+
+  ioa::fifo f (2);
+  action.set_parameter (input1_handle);
+  input1.set_parameter (h);
+  action.bind (tss, tm, input1, binder_handle, &input1, &f);
+  mu_assert (action.size () == 1);
+
+  // The value is buffered and a delivery is scheduled once.
+  mu_assert (action.fetch_instance (tm));
+  action (tm, tss);
+  mu_assert (tm.instance.v_up_output.state);
+  mu_assert (tm.instance.v_up_input.value == 0);
+  mu_assert (tss.m_deliver_count == 1);
+  mu_assert (action.size () == 1);
+
+  // A full buffer does not count as a binding.
+  action (tm, tss);
+  mu_assert (tss.m_deliver_count == 1);
+  mu_assert (action.size () == 0);
+
+  // The output is withheld while the buffer is full.
+  tm.instance.v_up_output.state = false;
+  action (tm, tss);
+  mu_assert (!tm.instance.v_up_output.state);
+
+  // Delivering drains the buffer and wakes the output.
+  action.deliver (tm, tss, input1);
+  mu_assert (tm.instance.v_up_input.value == 9845);
+  mu_assert (tss.m_drained_count == 1);
+  mu_assert (action.size () == 1);
+  action (tm, tss);
+  mu_assert (tm.instance.v_up_output.state);
+
+  action.unbind_automaton (binder_handle);
+  mu_assert (action.empty ());
+
+  return 0;
+}
+
 static const char*
 unparameterized_internal_action ()
 {
@@ -1027,6 +1104,7 @@ all_tests ()
   mu_run_test (valued_unparameterized_output_action);
   mu_run_test (valued_parameterized_output_action);
   mu_run_test (valued_auto_parameterized_output_action);
+  mu_run_test (buffered_output_action);
   mu_run_test (unparameterized_internal_action);
   mu_run_test (parameterized_internal_action);
 
@@ -0,0 +1,269 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+#include "minunit.h"
+
+#include <ioa/channel.hpp>
+#include <ioa/global_fifo_scheduler.hpp>
+#include <string>
+#include <iostream>
+
+static bool goal_reached;
+
+static const char*
+ring_buffer ()
+{
+  std::cout << __func__ << std::endl;
+
+  ioa::ring_buffer<std::string> rb (3);
+  mu_assert (rb.capacity () == 3);
+  mu_assert (rb.empty ());
+
+  // Wrap around several times.
+  for (int round = 0; round != 5; ++round) {
+    rb.push ("a");
+    std::string b ("b");
+    rb.push_swap (b);
+    mu_assert (b.empty ());
+    rb.push ("c");
+    mu_assert (rb.full ());
+    mu_assert (rb.size () == 3);
+
+    mu_assert (rb.front () == "a");
+    rb.pop ();
+    std::string s;
+    rb.pop_swap (s);
+    mu_assert (s == "b");
+    rb.pop_swap (s);
+    mu_assert (s == "c");
+    mu_assert (rb.empty ());
+  }
+
+  return 0;
+}
+
+static const int COUNT = 1000;
+
+class producer :
+  public ioa::automaton
+{
+private:
+  int m_count;
+  bool m_paused;
+
+  void schedule () const {
+    if (produce_precondition ()) {
+      ioa::schedule (&producer::produce);
+    }
+  }
+
+  bool produce_precondition () const {
+    return m_count != COUNT && !m_paused &&
+      ioa::binding_count (&producer::produce) != 0;
+  }
+
+  int produce_effect () {
+    return m_count++;
+  }
+
+  void produce_schedule () const {
+    schedule ();
+  }
+
+  void pause_effect (const bool& p) {
+    m_paused = p;
+  }
+
+  void pause_schedule () const {
+    schedule ();
+  }
+
+public:
+  // Don't produce until the channel reports.
+  producer () :
+    m_count (0),
+    m_paused (true)
+  { }
+
+  V_UP_OUTPUT (producer, produce, int);
+  V_UP_INPUT (producer, pause, bool);
+};
+
+class consumer :
+  public ioa::automaton
+{
+private:
+  int m_expected;
+
+  void consume (const int value) {
+    // Nothing is lost or reordered.
+    assert (value == m_expected);
+    ++m_expected;
+    if (m_expected == COUNT) {
+      goal_reached = true;
+    }
+  }
+
+  void consume_one_effect (const int& value) {
+    consume (value);
+  }
+
+  void consume_one_schedule () const { }
+
+  void consume_batch_effect (const std::vector<int>& values) {
+    assert (!values.empty () && values.size () <= 5);
+    for (std::vector<int>::const_iterator pos = values.begin ();
+	 pos != values.end ();
+	 ++pos) {
+      consume (*pos);
+    }
+  }
+
+  void consume_batch_schedule () const { }
+
+public:
+  consumer () :
+    m_expected (0)
+  { }
+
+  V_UP_INPUT (consumer, consume_one, int);
+  V_UP_INPUT (consumer, consume_batch, std::vector<int>);
+};
+
+template <bool BATCH>
+class pipeline :
+  public ioa::automaton
+{
+public:
+  pipeline () {
+    ioa::automaton_manager<producer>* p = new ioa::automaton_manager<producer> (this, ioa::make_allocator<producer> ());
+    // Small capacity to exercise backpressure.
+    ioa::automaton_manager<ioa::channel<int> >* c = new ioa::automaton_manager<ioa::channel<int> > (this, ioa::make_allocator<ioa::channel<int> > (16, 12, 4, 5));
+    ioa::automaton_manager<consumer>* q = new ioa::automaton_manager<consumer> (this, ioa::make_allocator<consumer> ());
+
+    ioa::make_binding_manager (this, p, &producer::produce, c, &ioa::channel<int>::send);
+    ioa::make_binding_manager (this, c, &ioa::channel<int>::backpressure, p, &producer::pause);
+    if (BATCH) {
+      ioa::make_binding_manager (this, c, &ioa::channel<int>::receive_batch, q, &consumer::consume_batch);
+    }
+    else {
+      ioa::make_binding_manager (this, c, &ioa::channel<int>::receive, q, &consumer::consume_one);
+    }
+  }
+};
+
+static size_t total_dropped;
+
+// Sends COUNT values without waiting for backpressure.
+class flooder :
+  public ioa::automaton,
+  private ioa::observer
+{
+private:
+  int m_count;
+
+  void observe (ioa::observable*) {
+    produce_schedule ();
+  }
+
+  bool produce_precondition () const {
+    return m_count != COUNT && ioa::binding_count (&flooder::produce) != 0;
+  }
+
+  int produce_effect () {
+    return m_count++;
+  }
+
+  void produce_schedule () const {
+    if (produce_precondition ()) {
+      ioa::schedule (&flooder::produce);
+    }
+  }
+
+  void dropped_effect (const size_t& count) {
+    total_dropped += count;
+  }
+
+  void dropped_schedule () const { }
+
+public:
+  flooder () :
+    m_count (0)
+  {
+    add_observable (&produce);
+  }
+
+  V_UP_OUTPUT (flooder, produce, int);
+  V_UP_INPUT (flooder, dropped, size_t);
+};
+
+class overflow :
+  public ioa::automaton
+{
+public:
+  overflow () {
+    ioa::automaton_manager<flooder>* f = new ioa::automaton_manager<flooder> (this, ioa::make_allocator<flooder> ());
+    // Nothing receives so everything past the capacity is dropped.
+    ioa::automaton_manager<ioa::channel<int> >* c = new ioa::automaton_manager<ioa::channel<int> > (this, ioa::make_allocator<ioa::channel<int> > (16, 12, 4, 5));
+    ioa::make_binding_manager (this, f, &flooder::produce, c, &ioa::channel<int>::send);
+    ioa::make_binding_manager (this, c, &ioa::channel<int>::dropped, f, &flooder::dropped);
+  }
+};
+
+static const char*
+receive ()
+{
+  std::cout << __func__ << std::endl;
+  goal_reached = false;
+  ioa::global_fifo_scheduler ss;
+  ioa::run (ss, ioa::make_allocator<pipeline<false> > ());
+  mu_assert (goal_reached);
+  return 0;
+}
+
+static const char*
+receive_batch ()
+{
+  std::cout << __func__ << std::endl;
+  goal_reached = false;
+  ioa::global_fifo_scheduler ss;
+  ioa::run (ss, ioa::make_allocator<pipeline<true> > ());
+  mu_assert (goal_reached);
+  return 0;
+}
+
+static const char*
+dropped ()
+{
+  std::cout << __func__ << std::endl;
+  total_dropped = 0;
+  ioa::global_fifo_scheduler ss;
+  ioa::run (ss, ioa::make_allocator<overflow> ());
+  mu_assert (total_dropped == COUNT - 16);
+  return 0;
+}
+
+const char*
+all_tests ()
+{
+  mu_run_test (ring_buffer);
+  mu_run_test (receive);
+  mu_run_test (receive_batch);
+  mu_run_test (dropped);
+
+  return 0;
+}
@@ -0,0 +1,185 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "minunit.h"
+
+#include <ioa/tcp_connection_automaton.hpp>
+#include <ioa/global_fifo_scheduler.hpp>
+#include <sys/socket.h>
+#include <iostream>
+
+static bool goal_reached;
+
+static const char*
+chunk_pool ()
+{
+  std::cout << __func__ << std::endl;
+
+  ioa::chunk_pool* pool = new ioa::chunk_pool (4, 1);
+  mu_assert (pool->chunk_size () == 4);
+
+  ioa::chunk_buffer* b1 = pool->allocate ();
+  memcpy (b1->data, "abcd", 4);
+  ioa::chunk c1 (b1, 3);
+  mu_assert (c1.str () == "abc");
+
+  {
+    // Copies share the buffer.
+    ioa::chunk c2 (c1);
+    mu_assert (c2.data () == c1.data ());
+    mu_assert (c1.substr (1, 10).str () == "bc");
+    mu_assert (c1.substr (5, 1).empty ());
+  }
+
+  // The pool outlives its creator while chunks are outstanding.
+  pool->release ();
+  mu_assert (c1.str () == "abc");
+
+  c1 = ioa::chunk ();
+  mu_assert (c1.empty ());
+
+  // Buffers are recycled.
+  pool = new ioa::chunk_pool (4, 1);
+  ioa::chunk_buffer* b2 = pool->allocate ();
+  ioa::release_chunk_buffer (b2);
+  ioa::chunk_buffer* b3 = pool->allocate ();
+  mu_assert (b3 == b2);
+  ioa::release_chunk_buffer (b3);
+  pool->release ();
+
+  return 0;
+}
+
+static const size_t SIZE = 50000;
+
+class chunk_reader :
+  public ioa::automaton,
+  private ioa::observer
+{
+private:
+  ioa::handle_manager<chunk_reader> m_self;
+  int m_fd[2];
+  ioa::automaton_manager<ioa::tcp_connection_automaton>* m_connection;
+  bool m_initialized;
+  std::string m_received;
+
+  void schedule () const {
+    if (init_precondition ()) {
+      ioa::schedule (&chunk_reader::init);
+    }
+  }
+
+  void observe (ioa::observable*) {
+    schedule ();
+  }
+
+  static char value (const size_t i) {
+    return 'a' + (i % 26);
+  }
+
+public:
+  chunk_reader () :
+    m_self (ioa::get_aid ()),
+    m_initialized (false)
+  {
+    int r = socketpair (AF_UNIX, SOCK_STREAM, 0, m_fd);
+    assert (r == 0);
+
+    // Small chunks so reads span several of them.
+    m_connection = new ioa::automaton_manager<ioa::tcp_connection_automaton> (this, ioa::make_allocator<ioa::tcp_connection_automaton> (1000, 4));
+    add_observable (m_connection);
+    ioa::make_binding_manager (this, m_connection, &ioa::tcp_connection_automaton::receive_chunks, &m_self, &chunk_reader::receive);
+    ioa::make_binding_manager (this, m_connection, &ioa::tcp_connection_automaton::error, &m_self, &chunk_reader::error);
+
+    // Everything is written before the connection reads so the end of the stream ends the test.
+    std::string data;
+    for (size_t i = 0; i < SIZE; ++i) {
+      data.push_back (value (i));
+    }
+    size_t written = 0;
+    while (written != SIZE) {
+      ssize_t n = write (m_fd[1], data.data () + written, SIZE - written);
+      assert (n > 0);
+      written += n;
+    }
+    close (m_fd[1]);
+  }
+
+private:
+  bool init_precondition () const {
+    return !m_initialized && m_connection->get_state () == ioa::automaton_manager_interface::CREATED;
+  }
+
+  void init_effect () {
+    m_initialized = true;
+    new ioa::automaton_manager<ioa::connection_init_automaton> (this, ioa::make_allocator<ioa::connection_init_automaton> (m_connection->get_handle (), m_fd[0]));
+  }
+
+  void init_schedule () const {
+    schedule ();
+  }
+
+  UP_INTERNAL (chunk_reader, init);
+
+  void receive_effect (const ioa::chunk_list& chunks) {
+    assert (!chunks.empty () && chunks.size () <= 4);
+    for (ioa::chunk_list::const_iterator pos = chunks.begin ();
+	 pos != chunks.end ();
+	 ++pos) {
+      assert (pos->size () <= 1000);
+      m_received.append (pos->data (), pos->size ());
+    }
+  }
+
+  void receive_schedule () const { }
+
+  V_UP_INPUT (chunk_reader, receive, ioa::chunk_list);
+
+  void error_effect (const int& err) {
+    if (err == ECONNRESET && m_received.size () == SIZE) {
+      goal_reached = true;
+      for (size_t i = 0; i < SIZE; ++i) {
+	if (m_received[i] != value (i)) {
+	  goal_reached = false;
+	}
+      }
+    }
+  }
+
+  void error_schedule () const { }
+
+  V_UP_INPUT (chunk_reader, error, int);
+};
+
+static const char*
+receive_chunks ()
+{
+  std::cout << __func__ << std::endl;
+  goal_reached = false;
+  ioa::global_fifo_scheduler ss;
+  ioa::run (ss, ioa::make_allocator<chunk_reader> ());
+  mu_assert (goal_reached);
+  return 0;
+}
+
+const char*
+all_tests ()
+{
+  mu_run_test (chunk_pool);
+  mu_run_test (receive_chunks);
+
+  return 0;
+}
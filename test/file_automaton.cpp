@@ -0,0 +1,338 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "minunit.h"
+
+#include <ioa/file_automaton.hpp>
+#include <ioa/global_fifo_scheduler.hpp>
+#include <cassert>
+#include <cstdlib>
+#include <errno.h>
+#include <iostream>
+#include <unistd.h>
+
+static bool goal_reached;
+
+static const size_t FILE_SIZE = 300000;
+static const size_t CHUNK_SIZE = 4096;
+
+/*
+  Streams a file, reads part of it at an offset, and then appends to it and reads the appended bytes back after an fsync.
+*/
+class file_user :
+  public ioa::automaton,
+  private ioa::observer
+{
+private:
+  enum state_t {
+    STREAM,
+    READ,
+    READ_WAIT,
+    WRITE,
+    WRITE_WAIT,
+    FSYNC,
+    FSYNC_WAIT,
+    READ_BACK,
+    READ_BACK_WAIT,
+    STOP,
+    DONE,
+  };
+
+  ioa::handle_manager<file_user> m_self;
+  std::string m_path;
+  std::string m_contents;
+  ioa::automaton_manager<ioa::file_automaton>* m_file;
+  state_t m_state;
+  std::string m_streamed;
+  bool m_ok;
+
+  void schedule () const {
+    if (read_precondition ()) {
+      ioa::schedule (&file_user::read);
+    }
+    if (write_precondition ()) {
+      ioa::schedule (&file_user::write);
+    }
+    if (fsync_precondition ()) {
+      ioa::schedule (&file_user::fsync);
+    }
+    if (stop_precondition ()) {
+      ioa::schedule (&file_user::stop);
+    }
+  }
+
+  void observe (ioa::observable*) {
+    schedule ();
+  }
+
+  static std::string to_string (const ioa::chunk_list& data) {
+    std::string retval;
+    for (ioa::chunk_list::const_iterator pos = data.begin (); pos != data.end (); ++pos) {
+      retval.append (pos->data (), pos->size ());
+    }
+    return retval;
+  }
+
+public:
+  file_user () :
+    m_self (ioa::get_aid ()),
+    m_state (STREAM),
+    m_ok (true)
+  {
+    add_observable (&read);
+    add_observable (&write);
+    add_observable (&fsync);
+
+    char path[] = "/tmp/ioa_file_automatonXXXXXX";
+    const int fd = mkstemp (path);
+    assert (fd != -1);
+    m_path = path;
+    for (size_t i = 0; i < FILE_SIZE; ++i) {
+      m_contents.push_back (static_cast<char> (i * 13));
+    }
+    const ssize_t r = ::write (fd, m_contents.data (), m_contents.size ());
+    assert (r == static_cast<ssize_t> (m_contents.size ()));
+    close (fd);
+
+    m_file = new ioa::automaton_manager<ioa::file_automaton> (this, ioa::make_allocator<ioa::file_automaton> (m_path, O_RDWR, 0666, 2, CHUNK_SIZE, 4));
+    ioa::make_binding_manager (this, m_file, &ioa::file_automaton::stream, &m_self, &file_user::stream);
+    ioa::make_binding_manager (this, &m_self, &file_user::read, m_file, &ioa::file_automaton::read);
+    ioa::make_binding_manager (this, m_file, &ioa::file_automaton::read_complete, &m_self, &file_user::read_complete);
+    ioa::make_binding_manager (this, &m_self, &file_user::write, m_file, &ioa::file_automaton::write);
+    ioa::make_binding_manager (this, m_file, &ioa::file_automaton::write_complete, &m_self, &file_user::write_complete);
+    ioa::make_binding_manager (this, &m_self, &file_user::fsync, m_file, &ioa::file_automaton::fsync);
+    ioa::make_binding_manager (this, m_file, &ioa::file_automaton::fsync_complete, &m_self, &file_user::fsync_complete);
+  }
+
+  ~file_user () {
+    unlink (m_path.c_str ());
+  }
+
+private:
+  void stream_effect (const ioa::chunk& c) {
+    if (m_state != STREAM) {
+      m_ok = false;
+    }
+    else if (c.empty ()) {
+      m_ok = m_ok && m_streamed == m_contents;
+      m_state = READ;
+    }
+    else {
+      m_streamed.append (c.data (), c.size ());
+    }
+  }
+
+  void stream_schedule () const {
+    schedule ();
+  }
+
+  V_UP_INPUT (file_user, stream, ioa::chunk);
+
+  bool read_precondition () const {
+    return (m_state == READ || m_state == READ_BACK) &&
+      ioa::binding_count (&file_user::read) != 0 &&
+      ioa::binding_count (&file_user::read_complete) != 0;
+  }
+
+  ioa::file_automaton::read_arg read_effect () {
+    if (m_state == READ) {
+      m_state = READ_WAIT;
+      // Spans several chunks.
+      return ioa::file_automaton::read_arg (1000, 10000);
+    }
+    else {
+      m_state = READ_BACK_WAIT;
+      // Asks for more than is there.
+      return ioa::file_automaton::read_arg (FILE_SIZE, 100);
+    }
+  }
+
+  void read_schedule () const {
+    schedule ();
+  }
+
+  V_UP_OUTPUT (file_user, read, ioa::file_automaton::read_arg);
+
+  void read_complete_effect (const ioa::file_automaton::read_val& v) {
+    m_ok = m_ok && v.error == 0;
+    if (m_state == READ_WAIT) {
+      m_ok = m_ok && v.offset == 1000 && to_string (v.data) == m_contents.substr (1000, 10000);
+      m_state = WRITE;
+    }
+    else if (m_state == READ_BACK_WAIT) {
+      m_ok = m_ok && v.offset == static_cast<off_t> (FILE_SIZE) && to_string (v.data) == "appended";
+      m_state = STOP;
+    }
+  }
+
+  void read_complete_schedule () const {
+    schedule ();
+  }
+
+  V_UP_INPUT (file_user, read_complete, ioa::file_automaton::read_val);
+
+  bool write_precondition () const {
+    return m_state == WRITE &&
+      ioa::binding_count (&file_user::write) != 0 &&
+      ioa::binding_count (&file_user::write_complete) != 0;
+  }
+
+  ioa::file_automaton::write_arg write_effect () {
+    m_state = WRITE_WAIT;
+    return ioa::file_automaton::write_arg (FILE_SIZE, "appended");
+  }
+
+  void write_schedule () const {
+    schedule ();
+  }
+
+  V_UP_OUTPUT (file_user, write, ioa::file_automaton::write_arg);
+
+  void write_complete_effect (const ioa::file_automaton::write_val& v) {
+    m_ok = m_ok && v.error == 0 && v.length == 8;
+    m_state = FSYNC;
+  }
+
+  void write_complete_schedule () const {
+    schedule ();
+  }
+
+  V_UP_INPUT (file_user, write_complete, ioa::file_automaton::write_val);
+
+  bool fsync_precondition () const {
+    return m_state == FSYNC &&
+      ioa::binding_count (&file_user::fsync) != 0 &&
+      ioa::binding_count (&file_user::fsync_complete) != 0;
+  }
+
+  void fsync_effect () {
+    m_state = FSYNC_WAIT;
+  }
+
+  void fsync_schedule () const {
+    schedule ();
+  }
+
+  UV_UP_OUTPUT (file_user, fsync);
+
+  void fsync_complete_effect (const int& error) {
+    m_ok = m_ok && error == 0;
+    m_state = READ_BACK;
+  }
+
+  void fsync_complete_schedule () const {
+    schedule ();
+  }
+
+  V_UP_INPUT (file_user, fsync_complete, int);
+
+  bool stop_precondition () const {
+    return m_state == STOP;
+  }
+
+  void stop_effect () {
+    m_state = DONE;
+    goal_reached = m_ok;
+    m_file->destroy ();
+  }
+
+  void stop_schedule () const {
+    schedule ();
+  }
+
+  UP_INTERNAL (file_user, stop);
+};
+
+static const char*
+stream_read_write_fsync ()
+{
+  std::cout << __func__ << std::endl;
+  goal_reached = false;
+  ioa::global_fifo_scheduler ss;
+  ioa::run (ss, ioa::make_allocator<file_user> ());
+  mu_assert (goal_reached);
+  return 0;
+}
+
+/*
+  A file that cannot be opened reports the error and answers requests with it.
+*/
+class missing_file :
+  public ioa::automaton
+{
+private:
+  ioa::handle_manager<missing_file> m_self;
+  ioa::automaton_manager<ioa::file_automaton>* m_file;
+  int m_error;
+  bool m_end;
+
+public:
+  missing_file () :
+    m_self (ioa::get_aid ()),
+    m_error (0),
+    m_end (false)
+  {
+    m_file = new ioa::automaton_manager<ioa::file_automaton> (this, ioa::make_allocator<ioa::file_automaton> (std::string ("/nonexistent/ioa_file_automaton")));
+    ioa::make_binding_manager (this, m_file, &ioa::file_automaton::error, &m_self, &missing_file::error);
+    ioa::make_binding_manager (this, m_file, &ioa::file_automaton::stream, &m_self, &missing_file::stream);
+  }
+
+private:
+  void check () {
+    if (m_error != 0 && m_end) {
+      goal_reached = m_error == ENOENT;
+      m_file->destroy ();
+    }
+  }
+
+  void error_effect (const int& error) {
+    m_error = error;
+    check ();
+  }
+
+  void error_schedule () const { }
+
+  V_UP_INPUT (missing_file, error, int);
+
+  void stream_effect (const ioa::chunk& c) {
+    m_end = c.empty ();
+    check ();
+  }
+
+  void stream_schedule () const { }
+
+  V_UP_INPUT (missing_file, stream, ioa::chunk);
+};
+
+static const char*
+open_error ()
+{
+  std::cout << __func__ << std::endl;
+  goal_reached = false;
+  ioa::global_fifo_scheduler ss;
+  ioa::run (ss, ioa::make_allocator<missing_file> ());
+  mu_assert (goal_reached);
+  return 0;
+}
+
+const char*
+all_tests ()
+{
+  mu_run_test (stream_read_write_fsync);
+  mu_run_test (open_error);
+
+  return 0;
+}
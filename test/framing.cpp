@@ -0,0 +1,169 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "minunit.h"
+
+#include <ioa/framing_automaton.hpp>
+#include <ioa/tcp_connection_automaton.hpp>
+#include <ioa/global_fifo_scheduler.hpp>
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <iostream>
+
+static bool goal_reached;
+
+/*
+  Sends messages of several sizes through framing automata on both ends of a socket pair.
+  The receiving connection delivers chunks for length-prefixed frames and strings for delimited frames so both inputs are used.
+*/
+class frame_pair :
+  public ioa::automaton,
+  private ioa::observer
+{
+private:
+  ioa::handle_manager<frame_pair> m_self;
+  ioa::automaton_manager<ioa::tcp_connection_automaton>* m_connection[2];
+  ioa::automaton_manager<ioa::framing_automaton>* m_framing[2];
+  std::deque<std::string> m_send_queue;
+  std::deque<std::string> m_expected;
+  bool m_mismatch;
+
+  void schedule () const {
+    if (send_message_precondition ()) {
+      ioa::schedule (&frame_pair::send_message);
+    }
+  }
+
+  void observe (ioa::observable*) {
+    schedule ();
+  }
+
+public:
+  frame_pair (const bool delimited) :
+    m_self (ioa::get_aid ()),
+    m_mismatch (false)
+  {
+    add_observable (&send_message);
+
+    int fd[2];
+    int r = socketpair (AF_UNIX, SOCK_STREAM, 0, fd);
+    assert (r == 0);
+    for (int i = 0; i < 2; ++i) {
+      fcntl (fd[i], F_SETFL, O_NONBLOCK);
+      m_connection[i] = new ioa::automaton_manager<ioa::tcp_connection_automaton> (this, ioa::make_allocator<ioa::tcp_connection_automaton> (ioa::fd_transfer (fd[i]), i == 1 && !delimited ? 4096 : 0));
+      if (delimited) {
+	m_framing[i] = new ioa::automaton_manager<ioa::framing_automaton> (this, ioa::make_allocator<ioa::framing_automaton> (std::string ("\r\n")));
+      }
+      else {
+	m_framing[i] = new ioa::automaton_manager<ioa::framing_automaton> (this, ioa::make_allocator<ioa::framing_automaton> (1 << 24));
+      }
+      ioa::make_binding_manager (this, m_framing[i], &ioa::framing_automaton::send, m_connection[i], &ioa::tcp_connection_automaton::send);
+    }
+    if (delimited) {
+      ioa::make_binding_manager (this, m_connection[1], &ioa::tcp_connection_automaton::receive, m_framing[1], &ioa::framing_automaton::receive);
+    }
+    else {
+      ioa::make_binding_manager (this, m_connection[1], &ioa::tcp_connection_automaton::receive_chunks, m_framing[1], &ioa::framing_automaton::receive_chunks);
+    }
+    ioa::make_binding_manager (this, &m_self, &frame_pair::send_message, m_framing[0], &ioa::framing_automaton::send_message);
+    ioa::make_binding_manager (this, m_framing[1], &ioa::framing_automaton::message, &m_self, &frame_pair::message);
+
+    m_send_queue.push_back ("hello");
+    m_send_queue.push_back ("");
+    // A partial delimiter just before the delimiter.
+    m_send_queue.push_back ("world\r");
+    m_send_queue.push_back (std::string (100000, 'x'));
+    std::string large;
+    for (size_t k = 0; k < (1 << 20); ++k) {
+      large.push_back (static_cast<char> ('a' + k % 26));
+    }
+    m_send_queue.push_back (large);
+    m_send_queue.push_back ("bye");
+    m_expected = m_send_queue;
+  }
+
+private:
+  bool send_message_precondition () const {
+    return !m_send_queue.empty () && ioa::binding_count (&frame_pair::send_message) != 0;
+  }
+
+  std::string send_message_effect () {
+    std::string retval;
+    retval.swap (m_send_queue.front ());
+    m_send_queue.pop_front ();
+    return retval;
+  }
+
+  void send_message_schedule () const {
+    schedule ();
+  }
+
+  V_UP_OUTPUT (frame_pair, send_message, std::string);
+
+  void message_effect (const ioa::chunk_list& m) {
+    if (m_expected.empty () || ioa::framing_automaton::str (m) != m_expected.front ()) {
+      m_mismatch = true;
+    }
+    else {
+      m_expected.pop_front ();
+    }
+
+    if (m_mismatch || m_expected.empty ()) {
+      goal_reached = !m_mismatch;
+      for (int i = 0; i < 2; ++i) {
+	m_framing[i]->destroy ();
+	m_connection[i]->destroy ();
+      }
+    }
+  }
+
+  void message_schedule () const {
+    schedule ();
+  }
+
+  V_UP_INPUT (frame_pair, message, ioa::chunk_list);
+};
+
+static const char*
+length_prefixed ()
+{
+  std::cout << __func__ << std::endl;
+  goal_reached = false;
+  ioa::global_fifo_scheduler ss;
+  ioa::run (ss, ioa::make_allocator<frame_pair> (false));
+  mu_assert (goal_reached);
+  return 0;
+}
+
+static const char*
+delimited ()
+{
+  std::cout << __func__ << std::endl;
+  goal_reached = false;
+  ioa::global_fifo_scheduler ss;
+  ioa::run (ss, ioa::make_allocator<frame_pair> (true));
+  mu_assert (goal_reached);
+  return 0;
+}
+
+const char*
+all_tests ()
+{
+  mu_run_test (length_prefixed);
+  mu_run_test (delimited);
+
+  return 0;
+}
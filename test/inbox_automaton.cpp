@@ -0,0 +1,157 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "minunit.h"
+
+#include <ioa/inbox_automaton.hpp>
+#include <ioa/global_fifo_scheduler.hpp>
+#include <pthread.h>
+#include <iostream>
+
+static bool goal_reached;
+
+static const int THREAD_COUNT = 4;
+static const int POST_COUNT = 20000;
+
+typedef std::pair<int, int> post_val;
+
+static ioa::inbox<post_val>* the_inbox;
+
+static void* poster (void* arg) {
+  const int thread = *static_cast<int*> (arg);
+  for (int k = 0; k < POST_COUNT; ++k) {
+    the_inbox->post (post_val (thread, k));
+  }
+  return 0;
+}
+
+/*
+  Receives the values posted by several threads and checks that none are lost and each thread's values arrive in order.
+*/
+class inbox_reader :
+  public ioa::automaton
+{
+private:
+  ioa::handle_manager<inbox_reader> m_self;
+  ioa::automaton_manager<ioa::inbox_automaton<post_val> >* m_inbox;
+  int m_next[THREAD_COUNT];
+  int m_received;
+  bool m_in_order;
+  const bool m_batch;
+  int m_batches;
+
+  void check (const post_val& v) {
+    if (m_next[v.first] != v.second) {
+      m_in_order = false;
+    }
+    m_next[v.first] = v.second + 1;
+    ++m_received;
+    if (m_received == THREAD_COUNT * POST_COUNT) {
+      // Waking up once per value would take as many batches as values.
+      goal_reached = m_in_order && (!m_batch || m_batches < m_received);
+      m_inbox->destroy ();
+    }
+  }
+
+public:
+  inbox_reader (const bool batch) :
+    m_self (ioa::get_aid ()),
+    m_received (0),
+    m_in_order (true),
+    m_batch (batch),
+    m_batches (0)
+  {
+    for (int i = 0; i < THREAD_COUNT; ++i) {
+      m_next[i] = 0;
+    }
+    m_inbox = new ioa::automaton_manager<ioa::inbox_automaton<post_val> > (this, ioa::make_allocator<ioa::inbox_automaton<post_val> > (the_inbox));
+    if (batch) {
+      ioa::make_binding_manager (this, m_inbox, &ioa::inbox_automaton<post_val>::receive_batch, &m_self, &inbox_reader::receive_batch);
+    }
+    else {
+      ioa::make_binding_manager (this, m_inbox, &ioa::inbox_automaton<post_val>::receive, &m_self, &inbox_reader::receive);
+    }
+  }
+
+private:
+  void receive_effect (const post_val& v) {
+    check (v);
+  }
+
+  void receive_schedule () const { }
+
+  V_UP_INPUT (inbox_reader, receive, post_val);
+
+  void receive_batch_effect (const std::vector<post_val>& values) {
+    ++m_batches;
+    for (std::vector<post_val>::const_iterator pos = values.begin (); pos != values.end (); ++pos) {
+      check (*pos);
+    }
+  }
+
+  void receive_batch_schedule () const { }
+
+  V_UP_INPUT (inbox_reader, receive_batch, std::vector<post_val>);
+};
+
+static bool
+run_posters (const bool batch)
+{
+  goal_reached = false;
+  ioa::inbox<post_val> i;
+  the_inbox = &i;
+
+  pthread_t threads[THREAD_COUNT];
+  int ids[THREAD_COUNT];
+  for (int t = 0; t < THREAD_COUNT; ++t) {
+    ids[t] = t;
+    pthread_create (&threads[t], 0, poster, &ids[t]);
+  }
+
+  ioa::global_fifo_scheduler ss;
+  ioa::run (ss, ioa::make_allocator<inbox_reader> (batch));
+
+  for (int t = 0; t < THREAD_COUNT; ++t) {
+    pthread_join (threads[t], 0);
+  }
+  the_inbox = 0;
+  return goal_reached;
+}
+
+static const char*
+receive_batches ()
+{
+  std::cout << __func__ << std::endl;
+  mu_assert (run_posters (true));
+  return 0;
+}
+
+static const char*
+receive_one_at_a_time ()
+{
+  std::cout << __func__ << std::endl;
+  mu_assert (run_posters (false));
+  return 0;
+}
+
+const char*
+all_tests ()
+{
+  mu_run_test (receive_batches);
+  mu_run_test (receive_one_at_a_time);
+
+  return 0;
+}
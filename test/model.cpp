@@ -23,6 +23,7 @@
 
 #include "instance_holder.hpp"
 #include <iostream>
+#include <vector>
 
 struct unbound_t {
   const ioa::aid_t aid;
@@ -226,6 +227,10 @@ struct test_system_scheduler :
 		  void* const key) {
     m_automaton_destroyed.insert (destroyed_t (automaton, type, key));
   }
+
+  void deliver (const ioa::input_executor_interface&) { }
+
+  void drained (const ioa::output_executor_interface&) { }
 };
 
 ioa::aid_t create (ioa::model& model,
@@ -811,19 +816,157 @@ automaton_destroyed ()
 
   tss.reset ();
   mu_assert (model.destroy (beta) == 0);
+  // Only the automata that survive are notified.
   mu_assert (tss.m_automaton_destroyed.count (destroyed_t (alpha, ioa::AUTOMATON_DESTROYED_RESULT, &beta_key)) == 1);
-  mu_assert (tss.m_automaton_destroyed.count (destroyed_t (beta, ioa::AUTOMATON_DESTROYED_RESULT, &gamma_key)) == 1);
+  mu_assert (tss.m_automaton_destroyed.count (destroyed_t (beta, ioa::AUTOMATON_DESTROYED_RESULT, &gamma_key)) == 0);
   mu_assert (tss.m_unbound.count (unbound_t (alpha, ioa::UNBOUND_RESULT, &bind1)) == 1);
-  mu_assert (tss.m_unbound.count (unbound_t (beta, ioa::UNBOUND_RESULT, &bind2)) == 1);
-  mu_assert (tss.m_unbound.count (unbound_t (beta, ioa::UNBOUND_RESULT, &bind3)) == 1);
+  mu_assert (tss.m_unbound.count (unbound_t (beta, ioa::UNBOUND_RESULT, &bind2)) == 0);
+  mu_assert (tss.m_unbound.count (unbound_t (beta, ioa::UNBOUND_RESULT, &bind3)) == 0);
   
   mu_assert (tss.m_output_unbound.count (outrec1) == 1);
-  mu_assert (tss.m_output_unbound.count (outrec2) == 1);
-  mu_assert (tss.m_output_unbound.count (outrec3) == 1);
+  mu_assert (tss.m_output_unbound.count (outrec2) == 0);
+  mu_assert (tss.m_output_unbound.count (outrec3) == 0);
+
+  mu_assert (tss.m_input_unbound.count (inrec1) == 0);
+  mu_assert (tss.m_input_unbound.count (inrec2) == 0);
+  mu_assert (tss.m_input_unbound.count (inrec3) == 0);
 
-  mu_assert (tss.m_input_unbound.count (inrec1) == 1);
-  mu_assert (tss.m_input_unbound.count (inrec2) == 1);
-  mu_assert (tss.m_input_unbound.count (inrec3) == 1);
+  return 0;
+}
+
+static const char*
+subtree_destroyed ()
+{
+  std::cout << __func__ << std::endl;
+  test_system_scheduler tss;
+  ioa::model model (tss);
+
+  const int COUNT = 1000;
+
+  ioa::automaton_handle<automaton1> alpha = create (model, tss, std::auto_ptr<ioa::allocator_interface> (ioa::make_allocator<automaton1> ()));
+
+  int beta_key;
+  ioa::automaton_handle<automaton1> beta = create (model, tss, alpha, std::auto_ptr<ioa::allocator_interface> (ioa::make_allocator<automaton1> ()), &beta_key);
+
+  // A chain of children bound together by their parent.
+  std::vector<ioa::automaton_handle<automaton1> > children;
+  std::vector<int> keys (2 * COUNT);
+  for (int i = 0; i != COUNT; ++i) {
+    children.push_back (create (model, tss, beta, std::auto_ptr<ioa::allocator_interface> (ioa::make_allocator<automaton1> ()), &keys[i]));
+    if (i != 0) {
+      bind (model, tss, beta,
+	    ioa::make_bind_executor (children[i - 1], &automaton1::uv_up_output,
+				     children[i], &automaton1::uv_up_input),
+	    &keys[COUNT + i]);
+    }
+  }
+
+  // A binding from the survivor into the subtree.
+  int alpha_bind_key;
+  std::auto_ptr<ioa::bind_executor_interface> exec = ioa::make_bind_executor (alpha, &automaton1::uv_up_output,
+									     children[0], &automaton1::uv_up_input);
+  unbound_record outrec (exec->get_output ());
+  bind (model, tss, alpha, exec, &alpha_bind_key);
+
+  tss.reset ();
+  mu_assert (model.destroy (beta) == 0);
+  mu_assert (tss.m_automaton_destroyed.size () == 1);
+  mu_assert (tss.m_automaton_destroyed.count (destroyed_t (alpha, ioa::AUTOMATON_DESTROYED_RESULT, &beta_key)) == 1);
+  mu_assert (tss.m_unbound.size () == 1);
+  mu_assert (tss.m_unbound.count (unbound_t (alpha, ioa::UNBOUND_RESULT, &alpha_bind_key)) == 1);
+  mu_assert (tss.m_output_unbound.size () == 1);
+  mu_assert (tss.m_output_unbound.count (outrec) == 1);
+  mu_assert (tss.m_input_unbound.empty ());
+
+  for (int i = 0; i != COUNT; ++i) {
+    mu_assert (model.destroy (children[i]) == -1);
+  }
+
+  // The survivor can bind again.
+  tss.reset ();
+  ioa::automaton_handle<automaton1> gamma = create (model, tss, alpha, std::auto_ptr<ioa::allocator_interface> (ioa::make_allocator<automaton1> ()), &beta_key);
+  bind (model, tss, alpha,
+	ioa::make_bind_executor (alpha, &automaton1::uv_up_output,
+				 gamma, &automaton1::uv_up_input),
+	&alpha_bind_key);
+
+  return 0;
+}
+
+static const char*
+fan_out_destroyed ()
+{
+  std::cout << __func__ << std::endl;
+  test_system_scheduler tss;
+  ioa::model model (tss);
+
+  const int COUNT = 1000;
+
+  ioa::automaton_handle<automaton1> alpha = create (model, tss, std::auto_ptr<ioa::allocator_interface> (ioa::make_allocator<automaton1> ()));
+
+  int beta_key;
+  ioa::automaton_handle<automaton1> beta = create (model, tss, alpha, std::auto_ptr<ioa::allocator_interface> (ioa::make_allocator<automaton1> ()), &beta_key);
+
+  int gamma_key;
+  ioa::automaton_handle<automaton1> gamma = create (model, tss, alpha, std::auto_ptr<ioa::allocator_interface> (ioa::make_allocator<automaton1> ()), &gamma_key);
+
+  int delta_key;
+  ioa::automaton_handle<automaton1> delta = create (model, tss, alpha, std::auto_ptr<ioa::allocator_interface> (ioa::make_allocator<automaton1> ()), &delta_key);
+
+  // The survivor fans out to every child of the dying automaton.
+  std::vector<ioa::automaton_handle<automaton1> > children;
+  std::vector<int> keys (2 * COUNT);
+  for (int i = 0; i != COUNT; ++i) {
+    children.push_back (create (model, tss, beta, std::auto_ptr<ioa::allocator_interface> (ioa::make_allocator<automaton1> ()), &keys[i]));
+    bind (model, tss, alpha,
+	  ioa::make_bind_executor (alpha, &automaton1::uv_up_output,
+				   children[i], &automaton1::uv_up_input),
+	  &keys[COUNT + i]);
+  }
+
+  // A binding between survivors that outlives the destroy.
+  int gamma_bind_key;
+  bind (model, tss, alpha,
+	ioa::make_bind_executor (alpha, &automaton1::uv_up_output,
+				 gamma, &automaton1::uv_up_input),
+	&gamma_bind_key);
+
+  // A binding between survivors whose binder dies.
+  int delta_bind_key;
+  std::auto_ptr<ioa::bind_executor_interface> exec = ioa::make_bind_executor (alpha, &automaton1::uv_up_output,
+									     delta, &automaton1::uv_up_input);
+  unbound_record outrec (exec->get_output ());
+  unbound_record inrec (exec->get_input ());
+  bind (model, tss, beta, exec, &delta_bind_key);
+
+  tss.reset ();
+  mu_assert (model.destroy (beta) == 0);
+  mu_assert (tss.m_automaton_destroyed.size () == 1);
+  mu_assert (tss.m_automaton_destroyed.count (destroyed_t (alpha, ioa::AUTOMATON_DESTROYED_RESULT, &beta_key)) == 1);
+  mu_assert (tss.m_unbound.size () == static_cast<size_t> (COUNT));
+  for (int i = 0; i != COUNT; ++i) {
+    mu_assert (tss.m_unbound.count (unbound_t (alpha, ioa::UNBOUND_RESULT, &keys[COUNT + i])) == 1);
+  }
+  mu_assert (tss.m_unbound.count (unbound_t (alpha, ioa::UNBOUND_RESULT, &gamma_bind_key)) == 0);
+  mu_assert (tss.m_output_unbound.size () == 1);
+  mu_assert (tss.m_output_unbound.count (outrec) == 1);
+  mu_assert (tss.m_input_unbound.size () == 1);
+  mu_assert (tss.m_input_unbound.count (inrec) == 1);
+
+  // The binding between survivors is intact.
+  tss.reset ();
+  int key;
+  mu_assert (model.bind (alpha,
+			 ioa::make_bind_executor (alpha, &automaton1::uv_up_output,
+						  gamma, &automaton1::uv_up_input),
+			 &key) == -1);
+  mu_assert (tss.m_bound_type == ioa::BINDING_EXISTS_RESULT);
+
+  // The input whose binder died can be bound again.
+  bind (model, tss, alpha,
+	ioa::make_bind_executor (alpha, &automaton1::uv_up_output,
+				 delta, &automaton1::uv_up_input),
+	&delta_bind_key);
 
   return 0;
 }
@@ -953,6 +1096,8 @@ all_tests ()
   mu_run_test (destroyer_dne);
   mu_run_test (create_key_dne);
   mu_run_test (automaton_destroyed);
+  mu_run_test (subtree_destroyed);
+  mu_run_test (fan_out_destroyed);
   mu_run_test (execute_automaton_dne);
   mu_run_test (execute_output);
   mu_run_test (execute_internal);
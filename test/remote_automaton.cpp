@@ -0,0 +1,231 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "minunit.h"
+
+#include <ioa/remote_automaton.hpp>
+#include <ioa/global_fifo_scheduler.hpp>
+#include <sys/socket.h>
+#include <sstream>
+#include <iostream>
+
+static bool goal_reached;
+
+static const char*
+serialization ()
+{
+  std::cout << __func__ << std::endl;
+
+  typedef std::vector<std::pair<int, std::string> > value_type;
+  value_type v;
+  v.push_back (std::make_pair (1, std::string ("one")));
+  v.push_back (std::make_pair (-2, std::string ()));
+  v.push_back (std::make_pair (3, std::string ("three", 5)));
+
+  std::string out;
+  ioa::serialization<value_type>::write (out, v);
+
+  const char* pos = out.data ();
+  value_type w;
+  mu_assert (ioa::serialization<value_type>::read (pos, out.data () + out.size (), w));
+  mu_assert (pos == out.data () + out.size ());
+  mu_assert (w == v);
+
+  // Truncated input is rejected.
+  pos = out.data ();
+  mu_assert (!ioa::serialization<value_type>::read (pos, out.data () + out.size () - 1, w));
+
+  return 0;
+}
+
+static const char*
+frames ()
+{
+  std::cout << __func__ << std::endl;
+
+  std::string out;
+  ioa::write_frame (out, std::string ("hello"));
+  ioa::write_frame (out, 42);
+
+  const char* pos = out.data ();
+  const char* end = out.data () + out.size ();
+
+  // A partial frame is incomplete.
+  mu_assert (ioa::frame_size (pos, pos + 3) == 0);
+  mu_assert (ioa::frame_size (pos, pos + 8) == 0);
+
+  std::string s;
+  mu_assert (ioa::frame_size (pos, end) != 0);
+  mu_assert (ioa::read_frame (pos, end, s));
+  mu_assert (s == "hello");
+
+  // Reading a frame as the wrong type fails but skips the frame.
+  mu_assert (ioa::frame_size (pos, end) != 0);
+  mu_assert (!ioa::read_frame (pos, end, s));
+  mu_assert (pos == end);
+
+  return 0;
+}
+
+static const int COUNT = 1000;
+
+/*
+  Connects a producer and consumer through a socket pair as though they were in different processes.
+*/
+class remote_pipeline :
+  public ioa::automaton,
+  private ioa::observer
+{
+private:
+  ioa::handle_manager<remote_pipeline> m_self;
+  int m_fd[2];
+  ioa::automaton_manager<ioa::tcp_connection_automaton>* m_connection[2];
+  bool m_proxies_created;
+  int m_produced;
+  int m_consumed;
+  bool m_stopped;
+
+  void schedule () const {
+    if (create_proxies_precondition ()) {
+      ioa::schedule (&remote_pipeline::create_proxies);
+    }
+    if (produce_precondition ()) {
+      ioa::schedule (&remote_pipeline::produce);
+    }
+    if (stop_precondition ()) {
+      ioa::schedule (&remote_pipeline::stop);
+    }
+  }
+
+  void observe (ioa::observable*) {
+    schedule ();
+  }
+
+  static std::string value (const int i) {
+    std::stringstream s;
+    s << std::string (i % 64, 'x') << i;
+    return s.str ();
+  }
+
+public:
+  remote_pipeline () :
+    m_self (ioa::get_aid ()),
+    m_proxies_created (false),
+    m_produced (0),
+    m_consumed (0),
+    m_stopped (false)
+  {
+    int r = socketpair (AF_UNIX, SOCK_STREAM, 0, m_fd);
+    assert (r == 0);
+    for (int i = 0; i < 2; ++i) {
+      m_connection[i] = new ioa::automaton_manager<ioa::tcp_connection_automaton> (this, ioa::make_allocator<ioa::tcp_connection_automaton> ());
+      add_observable (m_connection[i]);
+    }
+  }
+
+private:
+  bool create_proxies_precondition () const {
+    return !m_proxies_created &&
+      m_connection[0]->get_state () == ioa::automaton_manager_interface::CREATED &&
+      m_connection[1]->get_state () == ioa::automaton_manager_interface::CREATED;
+  }
+
+  void create_proxies_effect () {
+    m_proxies_created = true;
+    for (int i = 0; i < 2; ++i) {
+      new ioa::automaton_manager<ioa::connection_init_automaton> (this, ioa::make_allocator<ioa::connection_init_automaton> (m_connection[i]->get_handle (), m_fd[i]));
+    }
+
+    ioa::automaton_manager<ioa::remote_sender_automaton<std::string> >* sender = new ioa::automaton_manager<ioa::remote_sender_automaton<std::string> > (this, ioa::make_allocator<ioa::remote_sender_automaton<std::string> > (m_connection[0]->get_handle ()));
+    ioa::automaton_manager<ioa::remote_receiver_automaton<std::string> >* receiver = new ioa::automaton_manager<ioa::remote_receiver_automaton<std::string> > (this, ioa::make_allocator<ioa::remote_receiver_automaton<std::string> > (m_connection[1]->get_handle ()));
+
+    ioa::make_binding_manager (this, &m_self, &remote_pipeline::produce, sender, &ioa::remote_sender_automaton<std::string>::send);
+    ioa::make_binding_manager (this, receiver, &ioa::remote_receiver_automaton<std::string>::receive, &m_self, &remote_pipeline::consume);
+  }
+
+  void create_proxies_schedule () const {
+    schedule ();
+  }
+
+  UP_INTERNAL (remote_pipeline, create_proxies);
+
+  bool produce_precondition () const {
+    return m_produced != COUNT && ioa::binding_count (&remote_pipeline::produce) != 0;
+  }
+
+  std::string produce_effect () {
+    return value (m_produced++);
+  }
+
+  void produce_schedule () const {
+    schedule ();
+  }
+
+  V_UP_OUTPUT (remote_pipeline, produce, std::string);
+
+  void consume_effect (const std::string& v) {
+    // Nothing is lost or reordered.
+    assert (v == value (m_consumed));
+    ++m_consumed;
+    if (m_consumed == COUNT) {
+      goal_reached = true;
+    }
+  }
+
+  void consume_schedule () const {
+    schedule ();
+  }
+
+  V_UP_INPUT (remote_pipeline, consume, std::string);
+
+  bool stop_precondition () const {
+    return m_consumed == COUNT && !m_stopped;
+  }
+
+  void stop_effect () {
+    // Closing the connections lets the scheduler run out of work.
+    m_stopped = true;
+    m_connection[0]->destroy ();
+    m_connection[1]->destroy ();
+  }
+
+  void stop_schedule () const {
+    schedule ();
+  }
+
+  UP_INTERNAL (remote_pipeline, stop);
+};
+
+static const char*
+remote_binding ()
+{
+  std::cout << __func__ << std::endl;
+  goal_reached = false;
+  ioa::global_fifo_scheduler ss;
+  ioa::run (ss, ioa::make_allocator<remote_pipeline> ());
+  mu_assert (goal_reached);
+  return 0;
+}
+
+const char*
+all_tests ()
+{
+  mu_run_test (serialization);
+  mu_run_test (frames);
+  mu_run_test (remote_binding);
+
+  return 0;
+}
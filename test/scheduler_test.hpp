@@ -21,6 +21,7 @@
 #include "automaton2.hpp"
 #include "instance_holder.hpp"
 #include <ioa/automaton_manager.hpp>
+#include <ioa/binding_manager.hpp>
 
 #include <iostream>
 #include <fcntl.h>
@@ -1533,6 +1534,186 @@ schedule_afterp ()
   return 0;
 }
 
+class schedule_every_automaton :
+  public ioa::automaton {
+private:
+  enum {
+    TICKS = 10,
+  };
+  int m_ticks;
+  ioa::time m_start;
+  ioa::time m_period;
+
+  void schedule () const { }
+
+  bool tick_precondition () const {
+    return m_ticks < TICKS;
+  }
+
+  void tick_effect () {
+    ++m_ticks;
+    if (m_ticks == TICKS) {
+      // Neither timer fires again so the run ends.
+      ioa::cancel_timer (&schedule_every_automaton::tick);
+      ioa::cancel_timer (&schedule_every_automaton::never);
+      goal_reached = ioa::time::now () - m_start >= ioa::time (0, (TICKS - 1) * m_period.usec ());
+    }
+  }
+
+  void tick_schedule () const {
+    schedule ();
+  }
+
+  UV_UP_OUTPUT (schedule_every_automaton, tick);
+
+  bool never_precondition () const {
+    return true;
+  }
+
+  void never_effect () {
+    goal_reached = false;
+  }
+
+  void never_schedule () const {
+    schedule ();
+  }
+
+  UV_UP_OUTPUT (schedule_every_automaton, never);
+
+public:
+  schedule_every_automaton () :
+    m_ticks (0),
+    m_start (ioa::time::now ()),
+    m_period (0, 20000)
+  {
+    ioa::schedule_every (&schedule_every_automaton::tick, m_period);
+    ioa::schedule_after (&schedule_every_automaton::never, ioa::time (60, 0));
+  }
+  
+};
+
+static const char*
+schedule_every ()
+{
+  std::cout << __func__ << std::endl;
+  goal_reached = false;
+  SCHEDULER_TYPE ss;
+  ioa::run (ss, ioa::make_allocator<schedule_every_automaton> ());
+  mu_assert (goal_reached);
+  return 0;
+}
+
+class schedule_every_after_automaton :
+  public ioa::automaton {
+private:
+  int m_ticks;
+  ioa::time m_start;
+
+  void schedule () const { }
+
+  bool tick_precondition () const {
+    return true;
+  }
+
+  void tick_effect () {
+    ++m_ticks;
+    // The one-shot deadline replaced the period.
+    goal_reached = m_ticks == 1 && ioa::time::now () - m_start >= ioa::time (0, 50000);
+  }
+
+  void tick_schedule () const {
+    schedule ();
+  }
+
+  UV_UP_OUTPUT (schedule_every_after_automaton, tick);
+
+  bool done_precondition () const {
+    return true;
+  }
+
+  void done_effect () {
+    goal_reached = goal_reached && m_ticks == 1;
+  }
+
+  void done_schedule () const {
+    schedule ();
+  }
+
+  UV_UP_OUTPUT (schedule_every_after_automaton, done);
+
+public:
+  schedule_every_after_automaton () :
+    m_ticks (0),
+    m_start (ioa::time::now ())
+  {
+    ioa::schedule_every (&schedule_every_after_automaton::tick, ioa::time (0, 10000));
+    ioa::schedule_after (&schedule_every_after_automaton::tick, ioa::time (0, 50000));
+    ioa::schedule_after (&schedule_every_after_automaton::done, ioa::time (0, 200000));
+  }
+  
+};
+
+static const char*
+schedule_every_after ()
+{
+  std::cout << __func__ << std::endl;
+  goal_reached = false;
+  SCHEDULER_TYPE ss;
+  ioa::run (ss, ioa::make_allocator<schedule_every_after_automaton> ());
+  mu_assert (goal_reached);
+  return 0;
+}
+
+class schedule_everyp_automaton :
+  public ioa::automaton {
+private:
+  enum {
+    TICKS = 10,
+  };
+  int m_ticks;
+
+  void schedule () const { }
+
+  bool tick_precondition (int param) const {
+    assert (param == 512);
+    return m_ticks < TICKS;
+  }
+
+  void tick_effect (int param) {
+    assert (param == 512);
+    ++m_ticks;
+    if (m_ticks == TICKS) {
+      ioa::cancel_timer (&schedule_everyp_automaton::tick, 512);
+      goal_reached = true;
+    }
+  }
+
+  void tick_schedule (int) const {
+    schedule ();
+  }
+
+  UV_P_OUTPUT (schedule_everyp_automaton, tick, int);
+
+public:
+  schedule_everyp_automaton () :
+    m_ticks (0)
+  {
+    ioa::schedule_every (&schedule_everyp_automaton::tick, 512, ioa::time (0, 10000));
+  }
+  
+};
+
+static const char*
+schedule_everyp ()
+{
+  std::cout << __func__ << std::endl;
+  goal_reached = false;
+  SCHEDULER_TYPE ss;
+  ioa::run (ss, ioa::make_allocator<schedule_everyp_automaton> ());
+  mu_assert (goal_reached);
+  return 0;
+}
+
 class schedule_read_ready_automaton :
   public ioa::automaton {
 private:
@@ -1736,9 +1917,94 @@ schedule_write_readyp ()
   return 0;
 }
 
+static const int BUFFERED_COUNT = 100;
+
+class buffered_producer :
+  public ioa::automaton
+{
+private:
+  int m_count;
+
+  void schedule () const {
+    if (produce_precondition ()) {
+      ioa::schedule (&buffered_producer::produce);
+    }
+  }
+
+  bool produce_precondition () const {
+    return m_count != BUFFERED_COUNT && ioa::binding_count (&buffered_producer::produce) != 0;
+  }
+
+  int produce_effect () {
+    return m_count++;
+  }
+
+  void produce_schedule () const {
+    schedule ();
+  }
+
+public:
+  V_UP_OUTPUT (buffered_producer, produce, int);
+
+  buffered_producer () :
+    m_count (0)
+  { }
+};
+
+class buffered_consumer :
+  public ioa::automaton
+{
+private:
+  int m_expected;
+
+  void consume_effect (const int& value) {
+    // Values must arrive in order.
+    assert (value == m_expected);
+    ++m_expected;
+    if (m_expected == BUFFERED_COUNT) {
+      goal_reached = true;
+    }
+  }
+
+  void consume_schedule () const { }
+
+public:
+  V_UP_INPUT (buffered_consumer, consume, int);
+
+  buffered_consumer () :
+    m_expected (0)
+  { }
+};
+
+class buffered_binding_automaton :
+  public ioa::automaton
+{
+public:
+  buffered_binding_automaton () {
+    ioa::automaton_manager<buffered_producer>* producer = new ioa::automaton_manager<buffered_producer> (this, ioa::make_allocator<buffered_producer> ());
+    ioa::automaton_manager<buffered_consumer>* consumer = new ioa::automaton_manager<buffered_consumer> (this, ioa::make_allocator<buffered_consumer> ());
+    // A small capacity forces the producer to wait for the consumer.
+    ioa::make_binding_manager (this, producer, &buffered_producer::produce, consumer, &buffered_consumer::consume, ioa::fifo (4));
+  }
+};
+
+static const char*
+buffered_binding ()
+{
+  std::cout << __func__ << std::endl;
+  goal_reached = false;
+  SCHEDULER_TYPE ss;
+  ioa::run (ss, ioa::make_allocator<buffered_binding_automaton> ());
+  mu_assert (goal_reached);
+  return 0;
+}
+
 const char*
 all_tests ()
 {
+#ifdef SCHEDULER_CHECK
+  mu_run_test (SCHEDULER_CHECK);
+#endif
   mu_run_test (instance_exists);
   mu_run_test (automaton_created);
   mu_run_test (output_automaton_dne);
@@ -1755,10 +2021,14 @@ all_tests ()
   mu_run_test (schedulep);
   mu_run_test (schedule_after);
   mu_run_test (schedule_afterp);
+  mu_run_test (schedule_every);
+  mu_run_test (schedule_every_after);
+  mu_run_test (schedule_everyp);
   mu_run_test (schedule_read_ready);
   mu_run_test (schedule_read_readyp);
   mu_run_test (schedule_write_ready);
   mu_run_test (schedule_write_readyp);
+  mu_run_test (buffered_binding);
 
   return 0;
 }
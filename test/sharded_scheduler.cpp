@@ -0,0 +1,34 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "minunit.h"
+
+#include <ioa/simple_scheduler.hpp>
+#include <ioa/sharded_scheduler.hpp>
+
+// Use more shards than automata in most tests so bindings cross shards.
+class sharded_scheduler :
+  public ioa::sharded_scheduler
+{
+public:
+  sharded_scheduler () :
+    ioa::sharded_scheduler (4)
+  { }
+};
+
+#define SCHEDULER_TYPE sharded_scheduler
+
+#include "scheduler_test.hpp"
@@ -0,0 +1,232 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "minunit.h"
+
+#include <ioa/shm_automaton.hpp>
+#include <ioa/global_fifo_scheduler.hpp>
+#include <sstream>
+#include <iostream>
+#include <errno.h>
+#include <sys/mman.h>
+
+static bool goal_reached;
+
+static const char*
+ring ()
+{
+  std::cout << __func__ << std::endl;
+
+  ioa::shm_ring_descriptor d1;
+  mu_assert (ioa::shm_ring::create (8, d1) == 0);
+  ioa::shm_ring_descriptor d2;
+  mu_assert (ioa::shm_ring::duplicate (d1, d2) == 0);
+
+  ioa::shm_ring writer;
+  mu_assert (writer.attach (d1.memory_fd) == 0);
+  ioa::shm_ring reader;
+  mu_assert (reader.attach (d2.memory_fd) == 0);
+  mu_assert (writer.capacity () == 8);
+
+  // Wrap around several times.
+  for (int round = 0; round != 5; ++round) {
+    mu_assert (writer.write ("abcde", 5) == 5);
+    mu_assert (writer.write ("fghij", 5) == 3);
+    mu_assert (writer.wait_for_space ());
+    std::string s;
+    mu_assert (reader.read (s) == 8);
+    mu_assert (s == "abcdefgh");
+    mu_assert (reader.writer_waiting ());
+    mu_assert (!reader.writer_waiting ());
+    mu_assert (reader.wait_for_data ());
+    mu_assert (writer.write ("x", 1) == 1);
+    mu_assert (writer.reader_waiting ());
+    s.clear ();
+    mu_assert (reader.read (s) == 1);
+    mu_assert (s == "x");
+  }
+
+  close (d1.memory_fd);
+  close (d1.data_fd);
+  close (d1.space_fd);
+  close (d2.memory_fd);
+  close (d2.data_fd);
+  close (d2.space_fd);
+
+  return 0;
+}
+
+static const char*
+corrupt_header ()
+{
+  std::cout << __func__ << std::endl;
+
+  ioa::shm_ring_descriptor d1;
+  mu_assert (ioa::shm_ring::create (8, d1) == 0);
+  ioa::shm_ring_descriptor d2;
+  mu_assert (ioa::shm_ring::duplicate (d1, d2) == 0);
+
+  ioa::shm_ring writer;
+  mu_assert (writer.attach (d1.memory_fd) == 0);
+  ioa::shm_ring reader;
+  mu_assert (reader.attach (d2.memory_fd) == 0);
+
+  // Play a hostile writer: the tail is the first field of the third cache line of the header.
+  const size_t size = lseek (d1.memory_fd, 0, SEEK_END);
+  char* ptr = static_cast<char*> (mmap (0, size, PROT_READ | PROT_WRITE, MAP_SHARED, d1.memory_fd, 0));
+  mu_assert (ptr != MAP_FAILED);
+  *reinterpret_cast<volatile uint64_t*> (ptr + 128) = 1 << 20;
+
+  std::string s;
+  mu_assert (reader.read (s) == -1);
+  mu_assert (errno == EPROTO);
+  mu_assert (s.empty ());
+  mu_assert (!reader.attached ());
+
+  // The writer sees more bytes in the ring than it can hold.
+  mu_assert (writer.write ("x", 1) == -1);
+  mu_assert (errno == EPROTO);
+  mu_assert (!writer.attached ());
+
+  munmap (ptr, size);
+  close (d1.memory_fd);
+  close (d1.data_fd);
+  close (d1.space_fd);
+  close (d2.memory_fd);
+  close (d2.data_fd);
+  close (d2.space_fd);
+
+  return 0;
+}
+
+static const int COUNT = 1000;
+
+class shm_pipeline :
+  public ioa::automaton
+{
+private:
+  ioa::handle_manager<shm_pipeline> m_self;
+  ioa::automaton_manager<ioa::shm_sender_automaton<std::string> >* m_sender;
+  ioa::automaton_manager<ioa::shm_receiver_automaton<std::string> >* m_receiver;
+  int m_produced;
+  int m_consumed;
+  bool m_stopped;
+
+  void schedule () const {
+    if (produce_precondition ()) {
+      ioa::schedule (&shm_pipeline::produce);
+    }
+    if (stop_precondition ()) {
+      ioa::schedule (&shm_pipeline::stop);
+    }
+  }
+
+  static std::string value (const int i) {
+    std::stringstream s;
+    s << std::string (i % 64, 'x') << i;
+    return s.str ();
+  }
+
+public:
+  shm_pipeline () :
+    m_self (ioa::get_aid ()),
+    m_produced (0),
+    m_consumed (0),
+    m_stopped (false)
+  {
+    // Small enough that the sender must wait for space.
+    ioa::shm_ring_descriptor d1;
+    int r = ioa::shm_ring::create (256, d1);
+    assert (r == 0);
+    ioa::shm_ring_descriptor d2;
+    r = ioa::shm_ring::duplicate (d1, d2);
+    assert (r == 0);
+
+    m_sender = new ioa::automaton_manager<ioa::shm_sender_automaton<std::string> > (this, ioa::make_allocator<ioa::shm_sender_automaton<std::string> > (d1));
+    m_receiver = new ioa::automaton_manager<ioa::shm_receiver_automaton<std::string> > (this, ioa::make_allocator<ioa::shm_receiver_automaton<std::string> > (d2));
+
+    ioa::make_binding_manager (this, &m_self, &shm_pipeline::produce, m_sender, &ioa::shm_sender_automaton<std::string>::send);
+    ioa::make_binding_manager (this, m_receiver, &ioa::shm_receiver_automaton<std::string>::receive, &m_self, &shm_pipeline::consume);
+  }
+
+private:
+  bool produce_precondition () const {
+    return m_produced != COUNT && ioa::binding_count (&shm_pipeline::produce) != 0;
+  }
+
+  std::string produce_effect () {
+    return value (m_produced++);
+  }
+
+  void produce_schedule () const {
+    schedule ();
+  }
+
+  V_UP_OUTPUT (shm_pipeline, produce, std::string);
+
+  void consume_effect (const std::string& v) {
+    // Nothing is lost or reordered.
+    assert (v == value (m_consumed));
+    ++m_consumed;
+    if (m_consumed == COUNT) {
+      goal_reached = true;
+    }
+  }
+
+  void consume_schedule () const {
+    schedule ();
+  }
+
+  V_UP_INPUT (shm_pipeline, consume, std::string);
+
+  bool stop_precondition () const {
+    return m_consumed == COUNT && !m_stopped;
+  }
+
+  void stop_effect () {
+    // Closing the eventfds lets the scheduler run out of work.
+    m_stopped = true;
+    m_sender->destroy ();
+    m_receiver->destroy ();
+  }
+
+  void stop_schedule () const {
+    schedule ();
+  }
+
+  UP_INTERNAL (shm_pipeline, stop);
+};
+
+static const char*
+shm_binding ()
+{
+  std::cout << __func__ << std::endl;
+  goal_reached = false;
+  ioa::global_fifo_scheduler ss;
+  ioa::run (ss, ioa::make_allocator<shm_pipeline> ());
+  mu_assert (goal_reached);
+  return 0;
+}
+
+const char*
+all_tests ()
+{
+  mu_run_test (ring);
+  mu_run_test (corrupt_header);
+  mu_run_test (shm_binding);
+
+  return 0;
+}
@@ -0,0 +1,1414 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "minunit.h"
+
+#include <ioa/tcp_acceptor_automaton.hpp>
+#include <ioa/tcp_connector_automaton.hpp>
+#include <ioa/tcp_connection_pool_automaton.hpp>
+#include <ioa/global_fifo_scheduler.hpp>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+static bool goal_reached;
+
+static const int COUNT = 2000;
+static const size_t MESSAGE_SIZE = 100;
+
+/*
+  Sends many small buffers without waiting for send_complete and uses backpressure to bound the send queue.
+*/
+class send_queue :
+  public ioa::automaton,
+  private ioa::observer
+{
+private:
+  ioa::handle_manager<send_queue> m_self;
+  int m_fd[2];
+  ioa::automaton_manager<ioa::tcp_connection_automaton>* m_connection[2];
+  bool m_initialized[2];
+  int m_sent;
+  bool m_paused;
+  bool m_congested;
+  bool m_complete;
+  std::string m_received;
+  bool m_stopped;
+
+  void schedule () const {
+    if (init_precondition ()) {
+      ioa::schedule (&send_queue::init);
+    }
+    if (send_precondition ()) {
+      ioa::schedule (&send_queue::send);
+    }
+    if (stop_precondition ()) {
+      ioa::schedule (&send_queue::stop);
+    }
+  }
+
+  void observe (ioa::observable*) {
+    schedule ();
+  }
+
+  static std::string message (const int i) {
+    char buf[MESSAGE_SIZE + 1];
+    snprintf (buf, sizeof (buf), "%0*d", static_cast<int> (MESSAGE_SIZE), i);
+    return std::string (buf, MESSAGE_SIZE);
+  }
+
+public:
+  send_queue () :
+    m_self (ioa::get_aid ()),
+    m_sent (0),
+    m_paused (true),
+    m_congested (false),
+    m_complete (false),
+    m_stopped (false)
+  {
+    m_initialized[0] = false;
+    m_initialized[1] = false;
+    int r = socketpair (AF_UNIX, SOCK_STREAM, 0, m_fd);
+    assert (r == 0);
+    // A small socket buffer so writes stall until the reader starts.
+    const int size = 4096;
+    r = setsockopt (m_fd[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof (size));
+    assert (r == 0);
+
+    // Small watermarks so the queue fills.
+    m_connection[0] = new ioa::automaton_manager<ioa::tcp_connection_automaton> (this, ioa::make_allocator<ioa::tcp_connection_automaton> (0, 8, 4096, 1024));
+    m_connection[1] = new ioa::automaton_manager<ioa::tcp_connection_automaton> (this, ioa::make_allocator<ioa::tcp_connection_automaton> ());
+    add_observable (m_connection[0]);
+    add_observable (m_connection[1]);
+
+    ioa::make_binding_manager (this, &m_self, &send_queue::send, m_connection[0], &ioa::tcp_connection_automaton::send);
+    ioa::make_binding_manager (this, m_connection[0], &ioa::tcp_connection_automaton::backpressure, &m_self, &send_queue::pause);
+    ioa::make_binding_manager (this, m_connection[0], &ioa::tcp_connection_automaton::send_complete, &m_self, &send_queue::send_complete);
+    ioa::make_binding_manager (this, m_connection[1], &ioa::tcp_connection_automaton::receive, &m_self, &send_queue::receive);
+  }
+
+private:
+  bool init_precondition () const {
+    // The reader starts after the writer is congested.
+    return (!m_initialized[0] && m_connection[0]->get_state () == ioa::automaton_manager_interface::CREATED) ||
+      (!m_initialized[1] && m_congested && m_connection[1]->get_state () == ioa::automaton_manager_interface::CREATED);
+  }
+
+  void init_effect () {
+    const int i = m_initialized[0] ? 1 : 0;
+    m_initialized[i] = true;
+    new ioa::automaton_manager<ioa::connection_init_automaton> (this, ioa::make_allocator<ioa::connection_init_automaton> (m_connection[i]->get_handle (), m_fd[i]));
+  }
+
+  void init_schedule () const {
+    schedule ();
+  }
+
+  UP_INTERNAL (send_queue, init);
+
+  bool send_precondition () const {
+    return m_sent != COUNT && !m_paused && ioa::binding_count (&send_queue::send) != 0;
+  }
+
+  std::string send_effect () {
+    return message (m_sent++);
+  }
+
+  void send_schedule () const {
+    schedule ();
+  }
+
+  V_UP_OUTPUT (send_queue, send, std::string);
+
+  void pause_effect (const bool& p) {
+    m_paused = p;
+    m_congested = m_congested || p;
+  }
+
+  void pause_schedule () const {
+    schedule ();
+  }
+
+  V_UP_INPUT (send_queue, pause, bool);
+
+  void send_complete_effect () {
+    if (m_sent == COUNT) {
+      m_complete = true;
+    }
+  }
+
+  void send_complete_schedule () const {
+    schedule ();
+  }
+
+  UV_UP_INPUT (send_queue, send_complete);
+
+  void receive_effect (const std::string& buf) {
+    m_received.append (buf);
+  }
+
+  void receive_schedule () const {
+    schedule ();
+  }
+
+  V_UP_INPUT (send_queue, receive, std::string);
+
+  bool stop_precondition () const {
+    return !m_stopped && m_complete && m_received.size () == COUNT * MESSAGE_SIZE;
+  }
+
+  void stop_effect () {
+    m_stopped = true;
+
+    // Nothing is lost or reordered and the queue filled at least once.
+    goal_reached = m_congested;
+    for (int i = 0; i < COUNT; ++i) {
+      if (m_received.compare (i * MESSAGE_SIZE, MESSAGE_SIZE, message (i)) != 0) {
+	goal_reached = false;
+      }
+    }
+
+    m_connection[0]->destroy ();
+    m_connection[1]->destroy ();
+  }
+
+  void stop_schedule () const {
+    schedule ();
+  }
+
+  UP_INTERNAL (send_queue, stop);
+};
+
+static const char*
+send_queue_backpressure ()
+{
+  std::cout << __func__ << std::endl;
+  goal_reached = false;
+  ioa::global_fifo_scheduler ss;
+  ioa::run (ss, ioa::make_allocator<send_queue> ());
+  mu_assert (goal_reached);
+  return 0;
+}
+
+static const size_t PAYLOAD_SIZE = 4 << 20;
+static const size_t FILE_SIZE = 1 << 20;
+
+/*
+  Sends a large buffer with send_zerocopy and a file with send_file over TCP loopback.
+*/
+class large_send :
+  public ioa::automaton,
+  private ioa::observer
+{
+private:
+  ioa::handle_manager<large_send> m_self;
+  int m_fd[2];
+  int m_file;
+  std::string m_payload;
+  std::string m_contents;
+  ioa::automaton_manager<ioa::tcp_connection_automaton>* m_connection[2];
+  int m_initialized;
+  int m_sent;
+  bool m_complete;
+  std::string m_received;
+  bool m_stopped;
+
+  void schedule () const {
+    if (init_precondition ()) {
+      ioa::schedule (&large_send::init);
+    }
+    if (send_zerocopy_precondition ()) {
+      ioa::schedule (&large_send::send_zerocopy);
+    }
+    if (send_file_precondition ()) {
+      ioa::schedule (&large_send::send_file);
+    }
+    if (stop_precondition ()) {
+      ioa::schedule (&large_send::stop);
+    }
+  }
+
+  void observe (ioa::observable*) {
+    schedule ();
+  }
+
+public:
+  large_send () :
+    m_self (ioa::get_aid ()),
+    m_initialized (0),
+    m_sent (0),
+    m_complete (false),
+    m_stopped (false)
+  {
+    // A connected pair over loopback.
+    int listener = socket (AF_INET, SOCK_STREAM, 0);
+    assert (listener != -1);
+    struct sockaddr_in addr;
+    memset (&addr, 0, sizeof (addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    int r = ::bind (listener, reinterpret_cast<struct sockaddr*> (&addr), sizeof (addr));
+    assert (r == 0);
+    r = listen (listener, 1);
+    assert (r == 0);
+    socklen_t len = sizeof (addr);
+    r = getsockname (listener, reinterpret_cast<struct sockaddr*> (&addr), &len);
+    assert (r == 0);
+    m_fd[0] = socket (AF_INET, SOCK_STREAM, 0);
+    assert (m_fd[0] != -1);
+    r = connect (m_fd[0], reinterpret_cast<struct sockaddr*> (&addr), sizeof (addr));
+    assert (r == 0);
+    m_fd[1] = ::accept (listener, 0, 0);
+    assert (m_fd[1] != -1);
+    close (listener);
+    for (int i = 0; i < 2; ++i) {
+      r = fcntl (m_fd[i], F_SETFL, O_NONBLOCK);
+      assert (r == 0);
+    }
+
+    for (size_t i = 0; i < PAYLOAD_SIZE; ++i) {
+      m_payload.push_back (static_cast<char> (i * 7));
+    }
+    for (size_t i = 0; i < FILE_SIZE; ++i) {
+      m_contents.push_back (static_cast<char> (i * 13));
+    }
+    char name[] = "/tmp/ioa_tcp_connectionXXXXXX";
+    m_file = mkstemp (name);
+    assert (m_file != -1);
+    unlink (name);
+    r = write (m_file, m_contents.data (), m_contents.size ());
+    assert (r == static_cast<int> (FILE_SIZE));
+
+    m_connection[0] = new ioa::automaton_manager<ioa::tcp_connection_automaton> (this, ioa::make_allocator<ioa::tcp_connection_automaton> ());
+    m_connection[1] = new ioa::automaton_manager<ioa::tcp_connection_automaton> (this, ioa::make_allocator<ioa::tcp_connection_automaton> ());
+    add_observable (m_connection[0]);
+    add_observable (m_connection[1]);
+
+    ioa::make_binding_manager (this, &m_self, &large_send::send_zerocopy, m_connection[0], &ioa::tcp_connection_automaton::send_zerocopy);
+    ioa::make_binding_manager (this, &m_self, &large_send::send_file, m_connection[0], &ioa::tcp_connection_automaton::send_file);
+    ioa::make_binding_manager (this, m_connection[0], &ioa::tcp_connection_automaton::send_complete, &m_self, &large_send::send_complete);
+    ioa::make_binding_manager (this, m_connection[1], &ioa::tcp_connection_automaton::receive, &m_self, &large_send::receive);
+  }
+
+  ~large_send () {
+    close (m_file);
+  }
+
+private:
+  bool init_precondition () const {
+    return m_initialized != 2 && m_connection[m_initialized]->get_state () == ioa::automaton_manager_interface::CREATED;
+  }
+
+  void init_effect () {
+    new ioa::automaton_manager<ioa::connection_init_automaton> (this, ioa::make_allocator<ioa::connection_init_automaton> (m_connection[m_initialized]->get_handle (), m_fd[m_initialized]));
+    ++m_initialized;
+  }
+
+  void init_schedule () const {
+    schedule ();
+  }
+
+  UP_INTERNAL (large_send, init);
+
+  bool send_zerocopy_precondition () const {
+    return m_initialized == 2 && m_sent == 0 && ioa::binding_count (&large_send::send_zerocopy) != 0;
+  }
+
+  std::string send_zerocopy_effect () {
+    ++m_sent;
+    return m_payload;
+  }
+
+  void send_zerocopy_schedule () const {
+    schedule ();
+  }
+
+  V_UP_OUTPUT (large_send, send_zerocopy, std::string);
+
+  bool send_file_precondition () const {
+    return m_sent == 1 && ioa::binding_count (&large_send::send_file) != 0;
+  }
+
+  ioa::file_region send_file_effect () {
+    ++m_sent;
+    return ioa::file_region (m_file, 0, FILE_SIZE);
+  }
+
+  void send_file_schedule () const {
+    schedule ();
+  }
+
+  V_UP_OUTPUT (large_send, send_file, ioa::file_region);
+
+  void send_complete_effect () {
+    if (m_sent == 2) {
+      m_complete = true;
+    }
+  }
+
+  void send_complete_schedule () const {
+    schedule ();
+  }
+
+  UV_UP_INPUT (large_send, send_complete);
+
+  void receive_effect (const std::string& buf) {
+    m_received.append (buf);
+  }
+
+  void receive_schedule () const {
+    schedule ();
+  }
+
+  V_UP_INPUT (large_send, receive, std::string);
+
+  bool stop_precondition () const {
+    return !m_stopped && m_complete && m_received.size () == PAYLOAD_SIZE + FILE_SIZE;
+  }
+
+  void stop_effect () {
+    m_stopped = true;
+    goal_reached = m_received == m_payload + m_contents;
+    m_connection[0]->destroy ();
+    m_connection[1]->destroy ();
+  }
+
+  void stop_schedule () const {
+    schedule ();
+  }
+
+  UP_INTERNAL (large_send, stop);
+};
+
+static const char*
+send_zerocopy_and_file ()
+{
+  std::cout << __func__ << std::endl;
+  goal_reached = false;
+  ioa::global_fifo_scheduler ss;
+  ioa::run (ss, ioa::make_allocator<large_send> ());
+  mu_assert (goal_reached);
+  return 0;
+}
+
+static const size_t HELD_SIZE = 128 << 10;
+
+/*
+  Sends a buffer with send_zerocopy to a peer whose receive window is nearly closed.
+  The buffer fits in the send buffer so the queue empties at once, but the kernel holds its pages until the peer reads.
+  send_complete must wait for the kernel's completion.
+  With abandon, the connection is destroyed while the kernel holds the buffer.
+  The destroy must not wait for the peer and the peer must still receive the buffer intact followed by the end of the stream.
+*/
+class zerocopy_hold :
+  public ioa::automaton,
+  private ioa::observer
+{
+private:
+  ioa::handle_manager<zerocopy_hold> m_self;
+  int m_fd;
+  std::string m_payload;
+  ioa::automaton_manager<ioa::tcp_connection_automaton>* m_connection;
+  bool m_sent;
+  bool m_complete;
+  bool m_early;
+  bool m_read_wait;
+  std::string m_received;
+  bool m_stopped;
+  const bool m_abandon;
+  ioa::time m_destroy_start;
+  bool m_destroy_fast;
+  bool m_eof;
+
+  void schedule () const {
+    if (send_zerocopy_precondition ()) {
+      ioa::schedule (&zerocopy_hold::send_zerocopy);
+    }
+    if (stop_precondition ()) {
+      ioa::schedule (&zerocopy_hold::stop);
+    }
+  }
+
+  void observe (ioa::observable*) {
+    if (m_abandon && !m_read_wait && m_received.empty () &&
+	m_connection->get_state () == ioa::automaton_manager_interface::DESTROYED) {
+      m_destroy_fast = ioa::time::now () - m_destroy_start < ioa::time (0, 50000);
+      m_read_wait = true;
+      ioa::schedule_read_ready (&zerocopy_hold::read_ready, m_fd);
+    }
+    schedule ();
+  }
+
+public:
+  zerocopy_hold (const bool abandon) :
+    m_self (ioa::get_aid ()),
+    m_sent (false),
+    m_complete (false),
+    m_early (false),
+    m_read_wait (false),
+    m_stopped (false),
+    m_abandon (abandon),
+    m_destroy_fast (false),
+    m_eof (false)
+  {
+    int listener = socket (AF_INET, SOCK_STREAM, 0);
+    assert (listener != -1);
+    // The accepted socket inherits the small receive buffer and advertises a small window.
+    const int rcvbuf = 4096;
+    int r = setsockopt (listener, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof (rcvbuf));
+    assert (r == 0);
+    struct sockaddr_in addr;
+    memset (&addr, 0, sizeof (addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    r = ::bind (listener, reinterpret_cast<struct sockaddr*> (&addr), sizeof (addr));
+    assert (r == 0);
+    r = listen (listener, 1);
+    assert (r == 0);
+    socklen_t len = sizeof (addr);
+    r = getsockname (listener, reinterpret_cast<struct sockaddr*> (&addr), &len);
+    assert (r == 0);
+    const int sender = socket (AF_INET, SOCK_STREAM, 0);
+    assert (sender != -1);
+    const int sndbuf = 4 * HELD_SIZE;
+    r = setsockopt (sender, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof (sndbuf));
+    assert (r == 0);
+    r = connect (sender, reinterpret_cast<struct sockaddr*> (&addr), sizeof (addr));
+    assert (r == 0);
+    m_fd = ::accept (listener, 0, 0);
+    assert (m_fd != -1);
+    close (listener);
+    r = fcntl (m_fd, F_SETFL, O_NONBLOCK);
+    assert (r == 0);
+    r = fcntl (sender, F_SETFL, O_NONBLOCK);
+    assert (r == 0);
+
+    for (size_t i = 0; i < HELD_SIZE; ++i) {
+      m_payload.push_back (static_cast<char> (i * 11));
+    }
+
+    m_connection = new ioa::automaton_manager<ioa::tcp_connection_automaton> (this, ioa::make_allocator<ioa::tcp_connection_automaton> (ioa::fd_transfer (sender)));
+    add_observable (m_connection);
+
+    ioa::make_binding_manager (this, &m_self, &zerocopy_hold::send_zerocopy, m_connection, &ioa::tcp_connection_automaton::send_zerocopy);
+    ioa::make_binding_manager (this, m_connection, &ioa::tcp_connection_automaton::send_complete, &m_self, &zerocopy_hold::send_complete);
+  }
+
+private:
+  bool send_zerocopy_precondition () const {
+    return !m_sent && ioa::binding_count (&zerocopy_hold::send_zerocopy) != 0;
+  }
+
+  std::string send_zerocopy_effect () {
+    m_sent = true;
+    // Give a premature send_complete time to arrive before the peer reads.
+    ioa::schedule_after (&zerocopy_hold::drain, ioa::time (0, 200000));
+    return m_payload;
+  }
+
+  void send_zerocopy_schedule () const {
+    schedule ();
+  }
+
+  V_UP_OUTPUT (zerocopy_hold, send_zerocopy, std::string);
+
+  void send_complete_effect () {
+    m_complete = true;
+  }
+
+  void send_complete_schedule () const {
+    schedule ();
+  }
+
+  UV_UP_INPUT (zerocopy_hold, send_complete);
+
+  // Only scheduled by the timer.
+  bool drain_precondition () const {
+    return m_sent && !m_read_wait && m_received.empty () && m_destroy_start == ioa::time ();
+  }
+
+  void drain_effect () {
+    m_early = m_complete;
+    if (m_abandon) {
+      // Read once the destroy is done.
+      m_destroy_start = ioa::time::now ();
+      m_connection->destroy ();
+      return;
+    }
+    m_read_wait = true;
+    ioa::schedule_read_ready (&zerocopy_hold::read_ready, m_fd);
+  }
+
+  void drain_schedule () const {
+    schedule ();
+  }
+
+  UP_INTERNAL (zerocopy_hold, drain);
+
+  bool read_ready_precondition () const {
+    return m_read_wait;
+  }
+
+  void read_ready_effect () {
+    char buf[16384];
+    ssize_t n;
+    while ((n = read (m_fd, buf, sizeof (buf))) > 0) {
+      m_received.append (buf, n);
+    }
+    m_eof = n == 0;
+    if (m_received.size () < HELD_SIZE || (m_abandon && !m_eof)) {
+      ioa::schedule_read_ready (&zerocopy_hold::read_ready, m_fd);
+    }
+    else {
+      m_read_wait = false;
+    }
+  }
+
+  void read_ready_schedule () const {
+    schedule ();
+  }
+
+  UP_INTERNAL (zerocopy_hold, read_ready);
+
+  bool stop_precondition () const {
+    if (m_abandon) {
+      return !m_stopped && m_eof;
+    }
+    return !m_stopped && m_complete && m_received.size () == HELD_SIZE;
+  }
+
+  void stop_effect () {
+    m_stopped = true;
+    goal_reached = !m_early && m_received == m_payload && (!m_abandon || m_destroy_fast);
+    ioa::close (m_fd);
+    if (!m_abandon) {
+      m_connection->destroy ();
+    }
+  }
+
+  void stop_schedule () const {
+    schedule ();
+  }
+
+  UP_INTERNAL (zerocopy_hold, stop);
+};
+
+static const char*
+zerocopy_completion ()
+{
+  std::cout << __func__ << std::endl;
+#ifdef MSG_ZEROCOPY
+  const int probe = socket (AF_INET, SOCK_STREAM, 0);
+  const int set = 1;
+  const bool supported = setsockopt (probe, SOL_SOCKET, SO_ZEROCOPY, &set, sizeof (set)) == 0;
+  close (probe);
+#else
+  const bool supported = false;
+#endif
+  if (!supported) {
+    std::cout << "  skipped: MSG_ZEROCOPY is not supported" << std::endl;
+    return 0;
+  }
+  goal_reached = false;
+  {
+    ioa::global_fifo_scheduler ss;
+    ioa::run (ss, ioa::make_allocator<zerocopy_hold> (false));
+  }
+  mu_assert (goal_reached);
+  std::cout << "  abandon" << std::endl;
+  goal_reached = false;
+  {
+    ioa::global_fifo_scheduler ss;
+    ioa::run (ss, ioa::make_allocator<zerocopy_hold> (true));
+  }
+  mu_assert (goal_reached);
+  return 0;
+}
+
+/*
+  Sets up two connections over loopback.
+  The first is handed to automata given to an acceptor and a connector through init.
+  The second is created from the fds that an acceptor and a connector output.
+*/
+class handoff :
+  public ioa::automaton,
+  private ioa::observer
+{
+private:
+  enum {
+    // Connection handed out by the acceptor through init.
+    SERVER_INIT,
+    // Connection handed out by the connector through init.
+    CLIENT_INIT,
+    SERVER_TRANSFER,
+    CLIENT_TRANSFER,
+    CONNECTION_COUNT
+  };
+
+  ioa::handle_manager<handoff> m_self;
+  ioa::inet_address m_address[2];
+  ioa::automaton_manager<ioa::tcp_acceptor_automaton>* m_acceptor[2];
+  ioa::automaton_manager<ioa::tcp_connection_automaton>* m_connection[CONNECTION_COUNT];
+  bool m_accept_sent;
+  bool m_connectors_created;
+  bool m_sent[CONNECTION_COUNT];
+  std::string m_received[CONNECTION_COUNT];
+  bool m_stopped;
+
+  void schedule () const {
+    if (accept_precondition ()) {
+      ioa::schedule (&handoff::accept);
+    }
+    if (create_connectors_precondition ()) {
+      ioa::schedule (&handoff::create_connectors);
+    }
+    if (send_precondition (CLIENT_INIT)) {
+      ioa::schedule (&handoff::send, static_cast<int> (CLIENT_INIT));
+    }
+    if (send_precondition (CLIENT_TRANSFER)) {
+      ioa::schedule (&handoff::send, static_cast<int> (CLIENT_TRANSFER));
+    }
+    if (stop_precondition ()) {
+      ioa::schedule (&handoff::stop);
+    }
+  }
+
+  void observe (ioa::observable*) {
+    schedule ();
+  }
+
+  void create_connection (const int i,
+			  ioa::automaton_manager<ioa::tcp_connection_automaton>* connection) {
+    m_connection[i] = connection;
+    add_observable (connection);
+    ioa::make_binding_manager (this, &m_self, &handoff::send, i, connection, &ioa::tcp_connection_automaton::send);
+    ioa::make_binding_manager (this, connection, &ioa::tcp_connection_automaton::receive, &m_self, &handoff::receive, i);
+  }
+
+public:
+  handoff () :
+    m_self (ioa::get_aid ()),
+    m_accept_sent (false),
+    m_connectors_created (false),
+    m_stopped (false)
+  {
+    add_observable (&send);
+
+    // Below the usual ephemeral range.
+    const unsigned short port = 20000 + getpid () % 10000;
+    for (int i = 0; i < 2; ++i) {
+      m_address[i] = ioa::inet_address ("127.0.0.1", port + i);
+      m_acceptor[i] = new ioa::automaton_manager<ioa::tcp_acceptor_automaton> (this, ioa::make_allocator<ioa::tcp_acceptor_automaton> (m_address[i]));
+      add_observable (m_acceptor[i]);
+    }
+    for (int i = 0; i < CONNECTION_COUNT; ++i) {
+      m_connection[i] = 0;
+      m_sent[i] = false;
+    }
+
+    ioa::make_binding_manager (this, &m_self, &handoff::accept, m_acceptor[0], &ioa::tcp_acceptor_automaton::accept);
+    ioa::make_binding_manager (this, m_acceptor[1], &ioa::tcp_acceptor_automaton::accepted, &m_self, &handoff::transferred, static_cast<int> (SERVER_TRANSFER));
+    create_connection (SERVER_INIT, new ioa::automaton_manager<ioa::tcp_connection_automaton> (this, ioa::make_allocator<ioa::tcp_connection_automaton> ()));
+    create_connection (CLIENT_INIT, new ioa::automaton_manager<ioa::tcp_connection_automaton> (this, ioa::make_allocator<ioa::tcp_connection_automaton> ()));
+  }
+
+private:
+  bool accept_precondition () const {
+    return !m_accept_sent &&
+      m_connection[SERVER_INIT]->get_state () == ioa::automaton_manager_interface::CREATED &&
+      ioa::binding_count (&handoff::accept) != 0;
+  }
+
+  ioa::automaton_handle<ioa::tcp_connection_automaton> accept_effect () {
+    m_accept_sent = true;
+    return m_connection[SERVER_INIT]->get_handle ();
+  }
+
+  void accept_schedule () const {
+    schedule ();
+  }
+
+  V_UP_OUTPUT (handoff, accept, ioa::automaton_handle<ioa::tcp_connection_automaton>);
+
+  bool create_connectors_precondition () const {
+    // Connect once both acceptors are listening.
+    return !m_connectors_created &&
+      m_acceptor[0]->get_state () == ioa::automaton_manager_interface::CREATED &&
+      m_acceptor[1]->get_state () == ioa::automaton_manager_interface::CREATED &&
+      m_connection[CLIENT_INIT]->get_state () == ioa::automaton_manager_interface::CREATED;
+  }
+
+  void create_connectors_effect () {
+    m_connectors_created = true;
+    ioa::make_automaton_manager (this, ioa::make_allocator<ioa::tcp_connector_automaton> (m_address[0], m_connection[CLIENT_INIT]->get_handle ()));
+    ioa::automaton_manager<ioa::tcp_connector_automaton>* connector = ioa::make_automaton_manager (this, ioa::make_allocator<ioa::tcp_connector_automaton> (m_address[1]));
+    ioa::make_binding_manager (this, connector, &ioa::tcp_connector_automaton::connected, &m_self, &handoff::transferred, static_cast<int> (CLIENT_TRANSFER));
+  }
+
+  void create_connectors_schedule () const {
+    schedule ();
+  }
+
+  UP_INTERNAL (handoff, create_connectors);
+
+  void transferred_effect (const ioa::fd_transfer& fd,
+			   int i) {
+    create_connection (i, new ioa::automaton_manager<ioa::tcp_connection_automaton> (this, ioa::make_allocator<ioa::tcp_connection_automaton> (fd)));
+  }
+
+  void transferred_schedule (int) const {
+    schedule ();
+  }
+
+  V_P_INPUT (handoff, transferred, ioa::fd_transfer, int);
+
+  bool send_precondition (int i) const {
+    return !m_sent[i] && ioa::binding_count (&handoff::send, i) != 0;
+  }
+
+  std::string send_effect (int i) {
+    m_sent[i] = true;
+    return i == CLIENT_INIT ? "init" : "transfer";
+  }
+
+  void send_schedule (int) const {
+    schedule ();
+  }
+
+  V_P_OUTPUT (handoff, send, std::string, int);
+
+  void receive_effect (const std::string& buf,
+		       int i) {
+    m_received[i].append (buf);
+  }
+
+  void receive_schedule (int) const {
+    schedule ();
+  }
+
+  V_P_INPUT (handoff, receive, std::string, int);
+
+  bool stop_precondition () const {
+    return !m_stopped && m_received[SERVER_INIT] == "init" && m_received[SERVER_TRANSFER] == "transfer";
+  }
+
+  void stop_effect () {
+    m_stopped = true;
+    goal_reached = true;
+    for (int i = 0; i < CONNECTION_COUNT; ++i) {
+      m_connection[i]->destroy ();
+    }
+    m_acceptor[0]->destroy ();
+    m_acceptor[1]->destroy ();
+  }
+
+  void stop_schedule () const {
+    schedule ();
+  }
+
+  UP_INTERNAL (handoff, stop);
+};
+
+static const char*
+acceptor_and_connector_handoff ()
+{
+  std::cout << __func__ << std::endl;
+  goal_reached = false;
+  ioa::global_fifo_scheduler ss;
+  ioa::run (ss, ioa::make_allocator<handoff> ());
+  mu_assert (goal_reached);
+  return 0;
+}
+
+/*
+  Connects to a port that nobody listens on and checks that the connector backs off between retries before reporting the error.
+*/
+class refused :
+  public ioa::automaton
+{
+private:
+  ioa::handle_manager<refused> m_self;
+  ioa::automaton_manager<ioa::tcp_connector_automaton>* m_connector;
+  ioa::time m_start;
+
+public:
+  refused () :
+    m_self (ioa::get_aid ()),
+    m_start (ioa::time::now ())
+  {
+    // Below the usual ephemeral range.
+    const unsigned short port = 20000 + getpid () % 10000 + 2;
+    m_connector = new ioa::automaton_manager<ioa::tcp_connector_automaton> (this, ioa::make_allocator<ioa::tcp_connector_automaton> (ioa::inet_address ("127.0.0.1", port), ioa::time (), 2, ioa::time (0, 20000)));
+    ioa::make_binding_manager (this, m_connector, &ioa::tcp_connector_automaton::error, &m_self, &refused::error);
+  }
+
+private:
+  void error_effect (const int& error) {
+    // Retries after 20ms and 40ms.
+    goal_reached = error == ECONNREFUSED && ioa::time::now () - m_start >= ioa::time (0, 60000);
+    m_connector->destroy ();
+  }
+
+  void error_schedule () const { }
+
+  V_UP_INPUT (refused, error, int);
+};
+
+static const char*
+connector_retries ()
+{
+  std::cout << __func__ << std::endl;
+  goal_reached = false;
+  ioa::global_fifo_scheduler ss;
+  ioa::run (ss, ioa::make_allocator<refused> ());
+  mu_assert (goal_reached);
+  return 0;
+}
+
+/*
+  Connects to a listener whose accept queue is full so its SYNs are dropped and checks that the connector gives up with ETIMEDOUT after its timeout.
+*/
+class blackholed :
+  public ioa::automaton
+{
+private:
+  ioa::handle_manager<blackholed> m_self;
+  int m_listener;
+  int m_filler;
+  ioa::automaton_manager<ioa::tcp_connector_automaton>* m_connector;
+  ioa::time m_start;
+
+public:
+  blackholed () :
+    m_self (ioa::get_aid ()),
+    m_start (ioa::time::now ())
+  {
+    m_listener = socket (AF_INET, SOCK_STREAM, 0);
+    assert (m_listener != -1);
+    struct sockaddr_in addr;
+    memset (&addr, 0, sizeof (addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    int r = ::bind (m_listener, reinterpret_cast<struct sockaddr*> (&addr), sizeof (addr));
+    assert (r == 0);
+    r = listen (m_listener, 0);
+    assert (r == 0);
+    socklen_t len = sizeof (addr);
+    r = getsockname (m_listener, reinterpret_cast<struct sockaddr*> (&addr), &len);
+    assert (r == 0);
+    // Fill the accept queue.  The listener never accepts.
+    m_filler = socket (AF_INET, SOCK_STREAM, 0);
+    assert (m_filler != -1);
+    r = connect (m_filler, reinterpret_cast<struct sockaddr*> (&addr), sizeof (addr));
+    assert (r == 0);
+
+    m_connector = new ioa::automaton_manager<ioa::tcp_connector_automaton> (this, ioa::make_allocator<ioa::tcp_connector_automaton> (ioa::inet_address ("127.0.0.1", ntohs (addr.sin_port)), ioa::time (0, 100000), 0));
+    ioa::make_binding_manager (this, m_connector, &ioa::tcp_connector_automaton::error, &m_self, &blackholed::error);
+  }
+
+  ~blackholed () {
+    close (m_filler);
+    close (m_listener);
+  }
+
+private:
+  void error_effect (const int& error) {
+    goal_reached = error == ETIMEDOUT && ioa::time::now () - m_start >= ioa::time (0, 100000);
+    m_connector->destroy ();
+  }
+
+  void error_schedule () const { }
+
+  V_UP_INPUT (blackholed, error, int);
+};
+
+static const char*
+connect_timeout ()
+{
+  std::cout << __func__ << std::endl;
+  goal_reached = false;
+  ioa::global_fifo_scheduler ss;
+  ioa::run (ss, ioa::make_allocator<blackholed> ());
+  mu_assert (goal_reached);
+  return 0;
+}
+
+/*
+  Makes several requests through a connection pool to an echo server and checks that they share one connection.
+*/
+class pooled_client :
+  public ioa::automaton,
+  private ioa::observer
+{
+private:
+  enum state_t {
+    ACQUIRE,
+    ACQUIRE_WAIT,
+    REQUEST,
+    RESPONSE_WAIT,
+    UNBIND_WAIT,
+    RELEASE,
+    DONE,
+  };
+
+  static const int ROUNDS = 3;
+
+  ioa::handle_manager<pooled_client> m_self;
+  ioa::inet_address m_address;
+  ioa::automaton_manager<ioa::tcp_acceptor_automaton>* m_acceptor;
+  ioa::automaton_manager<ioa::tcp_connection_pool_automaton>* m_pool;
+  ioa::automaton_manager<ioa::tcp_connection_automaton>* m_server;
+  int m_accepted;
+  std::string m_echo;
+  state_t m_state;
+  int m_round;
+  ioa::handle_manager<ioa::tcp_connection_automaton> m_connection;
+  ioa::automaton_handle<ioa::tcp_connection_automaton> m_first_connection;
+  bool m_reused;
+  ioa::binding_manager_interface* m_request_binding;
+  ioa::binding_manager_interface* m_response_binding;
+  std::string m_response;
+
+  void schedule () const {
+    if (acquire_precondition ()) {
+      ioa::schedule (&pooled_client::acquire);
+    }
+    if (request_precondition ()) {
+      ioa::schedule (&pooled_client::request);
+    }
+    if (release_precondition ()) {
+      ioa::schedule (&pooled_client::release);
+    }
+    if (echo_precondition ()) {
+      ioa::schedule (&pooled_client::echo);
+    }
+    if (stop_precondition ()) {
+      ioa::schedule (&pooled_client::stop);
+    }
+  }
+
+  void observe (ioa::observable*) {
+    if (m_state == UNBIND_WAIT &&
+	ioa::binding_count (&pooled_client::request) == 0 &&
+	ioa::binding_count (&pooled_client::response) == 0) {
+      m_state = RELEASE;
+    }
+    schedule ();
+  }
+
+public:
+  pooled_client () :
+    m_self (ioa::get_aid ()),
+    m_server (0),
+    m_accepted (0),
+    m_state (ACQUIRE),
+    m_round (0),
+    m_reused (true),
+    m_request_binding (0),
+    m_response_binding (0)
+  {
+    add_observable (&acquire);
+    add_observable (&request);
+    add_observable (&response);
+
+    // Below the usual ephemeral range.
+    const unsigned short port = 20000 + getpid () % 10000 + 3;
+    m_address = ioa::inet_address ("127.0.0.1", port);
+    m_acceptor = new ioa::automaton_manager<ioa::tcp_acceptor_automaton> (this, ioa::make_allocator<ioa::tcp_acceptor_automaton> (m_address));
+    add_observable (m_acceptor);
+    ioa::make_binding_manager (this, m_acceptor, &ioa::tcp_acceptor_automaton::accepted, &m_self, &pooled_client::accepted);
+
+    m_pool = new ioa::automaton_manager<ioa::tcp_connection_pool_automaton> (this, ioa::make_allocator<ioa::tcp_connection_pool_automaton> (1, ioa::time (0, 500000)));
+    ioa::make_binding_manager (this, &m_self, &pooled_client::acquire, m_pool, &ioa::tcp_connection_pool_automaton::acquire);
+    ioa::make_binding_manager (this, m_pool, &ioa::tcp_connection_pool_automaton::acquired, &m_self, &pooled_client::acquired);
+    ioa::make_binding_manager (this, &m_self, &pooled_client::release, m_pool, &ioa::tcp_connection_pool_automaton::release);
+  }
+
+private:
+  void accepted_effect (const ioa::fd_transfer& fd) {
+    ++m_accepted;
+    if (m_server == 0) {
+      m_server = new ioa::automaton_manager<ioa::tcp_connection_automaton> (this, ioa::make_allocator<ioa::tcp_connection_automaton> (fd));
+      ioa::make_binding_manager (this, m_server, &ioa::tcp_connection_automaton::receive, &m_self, &pooled_client::server_receive);
+      ioa::make_binding_manager (this, &m_self, &pooled_client::echo, m_server, &ioa::tcp_connection_automaton::send);
+    }
+  }
+
+  void accepted_schedule () const {
+    schedule ();
+  }
+
+  V_UP_INPUT (pooled_client, accepted, ioa::fd_transfer);
+
+  void server_receive_effect (const std::string& buf) {
+    m_echo.append (buf);
+  }
+
+  void server_receive_schedule () const {
+    schedule ();
+  }
+
+  V_UP_INPUT (pooled_client, server_receive, std::string);
+
+  bool echo_precondition () const {
+    return !m_echo.empty () && ioa::binding_count (&pooled_client::echo) != 0;
+  }
+
+  std::string echo_effect () {
+    std::string retval;
+    retval.swap (m_echo);
+    return retval;
+  }
+
+  void echo_schedule () const {
+    schedule ();
+  }
+
+  V_UP_OUTPUT (pooled_client, echo, std::string);
+
+  bool acquire_precondition () const {
+    return m_state == ACQUIRE &&
+      m_acceptor->get_state () == ioa::automaton_manager_interface::CREATED &&
+      ioa::binding_count (&pooled_client::acquire) != 0;
+  }
+
+  ioa::inet_address acquire_effect () {
+    m_state = ACQUIRE_WAIT;
+    return m_address;
+  }
+
+  void acquire_schedule () const {
+    schedule ();
+  }
+
+  V_UP_OUTPUT (pooled_client, acquire, ioa::inet_address);
+
+  void acquired_effect (const ioa::tcp_connection_pool_automaton::connection_val& c) {
+    m_connection = ioa::handle_manager<ioa::tcp_connection_automaton> (c.connection);
+    if (m_round == 0) {
+      m_first_connection = c.connection;
+    }
+    else if (c.connection != m_first_connection) {
+      m_reused = false;
+    }
+    m_state = REQUEST;
+    m_request_binding = ioa::make_binding_manager (this, &m_self, &pooled_client::request, &m_connection, &ioa::tcp_connection_automaton::send);
+    m_response_binding = ioa::make_binding_manager (this, &m_connection, &ioa::tcp_connection_automaton::receive, &m_self, &pooled_client::response);
+  }
+
+  void acquired_schedule () const {
+    schedule ();
+  }
+
+  V_UP_INPUT (pooled_client, acquired, ioa::tcp_connection_pool_automaton::connection_val);
+
+  bool request_precondition () const {
+    return m_state == REQUEST &&
+      ioa::binding_count (&pooled_client::request) != 0 &&
+      ioa::binding_count (&pooled_client::response) != 0;
+  }
+
+  std::string request_effect () {
+    m_state = RESPONSE_WAIT;
+    m_response.clear ();
+    return "request";
+  }
+
+  void request_schedule () const {
+    schedule ();
+  }
+
+  V_UP_OUTPUT (pooled_client, request, std::string);
+
+  void response_effect (const std::string& buf) {
+    m_response.append (buf);
+    if (m_state == RESPONSE_WAIT && m_response == "request") {
+      m_state = UNBIND_WAIT;
+      m_request_binding->unbind ();
+      m_response_binding->unbind ();
+    }
+  }
+
+  void response_schedule () const {
+    schedule ();
+  }
+
+  V_UP_INPUT (pooled_client, response, std::string);
+
+  bool release_precondition () const {
+    return m_state == RELEASE && ioa::binding_count (&pooled_client::release) != 0;
+  }
+
+  ioa::automaton_handle<ioa::tcp_connection_automaton> release_effect () {
+    ++m_round;
+    m_state = m_round == ROUNDS ? DONE : ACQUIRE;
+    return m_connection.get_handle ();
+  }
+
+  void release_schedule () const {
+    schedule ();
+  }
+
+  V_UP_OUTPUT (pooled_client, release, ioa::automaton_handle<ioa::tcp_connection_automaton>);
+
+  bool stop_precondition () const {
+    return m_state == DONE;
+  }
+
+  void stop_effect () {
+    m_state = ACQUIRE_WAIT;
+    goal_reached = m_reused && m_accepted == 1;
+    m_pool->destroy ();
+    m_server->destroy ();
+    m_acceptor->destroy ();
+  }
+
+  void stop_schedule () const {
+    schedule ();
+  }
+
+  UP_INTERNAL (pooled_client, stop);
+};
+
+static const char*
+connection_pool ()
+{
+  std::cout << __func__ << std::endl;
+  goal_reached = false;
+  ioa::global_fifo_scheduler ss;
+  ioa::run (ss, ioa::make_allocator<pooled_client> ());
+  mu_assert (goal_reached);
+  return 0;
+}
+
+/*
+  Holds a connection from a pool and announces it by sending on it.
+*/
+class lease_holder :
+  public ioa::automaton
+{
+private:
+  ioa::handle_manager<lease_holder> m_self;
+  ioa::handle_manager<ioa::tcp_connection_pool_automaton> m_pool;
+  ioa::inet_address m_address;
+  bool m_acquire;
+  bool m_announce;
+  ioa::handle_manager<ioa::tcp_connection_automaton> m_connection;
+
+  void schedule () const {
+    if (acquire_precondition ()) {
+      ioa::schedule (&lease_holder::acquire);
+    }
+    if (announce_precondition ()) {
+      ioa::schedule (&lease_holder::announce);
+    }
+  }
+
+public:
+  lease_holder (const ioa::automaton_handle<ioa::tcp_connection_pool_automaton>& pool,
+		const ioa::inet_address& address) :
+    m_self (ioa::get_aid ()),
+    m_pool (pool),
+    m_address (address),
+    m_acquire (true),
+    m_announce (false)
+  {
+    ioa::make_binding_manager (this, &m_self, &lease_holder::acquire, &m_pool, &ioa::tcp_connection_pool_automaton::acquire);
+    ioa::make_binding_manager (this, &m_pool, &ioa::tcp_connection_pool_automaton::acquired, &m_self, &lease_holder::acquired);
+  }
+
+private:
+  bool acquire_precondition () const {
+    return m_acquire && ioa::binding_count (&lease_holder::acquire) != 0;
+  }
+
+  ioa::inet_address acquire_effect () {
+    m_acquire = false;
+    return m_address;
+  }
+
+  void acquire_schedule () const {
+    schedule ();
+  }
+
+  V_UP_OUTPUT (lease_holder, acquire, ioa::inet_address);
+
+  void acquired_effect (const ioa::tcp_connection_pool_automaton::connection_val& c) {
+    m_connection = ioa::handle_manager<ioa::tcp_connection_automaton> (c.connection);
+    m_announce = true;
+    ioa::make_binding_manager (this, &m_self, &lease_holder::announce, &m_connection, &ioa::tcp_connection_automaton::send);
+  }
+
+  void acquired_schedule () const {
+    schedule ();
+  }
+
+  V_UP_INPUT (lease_holder, acquired, ioa::tcp_connection_pool_automaton::connection_val);
+
+  bool announce_precondition () const {
+    return m_announce && ioa::binding_count (&lease_holder::announce) != 0;
+  }
+
+  std::string announce_effect () {
+    m_announce = false;
+    return "held";
+  }
+
+  void announce_schedule () const {
+    schedule ();
+  }
+
+  V_UP_OUTPUT (lease_holder, announce, std::string);
+};
+
+/*
+  Destroys a client while it holds a connection and checks that the pool closes the connection instead of keeping it leased forever.
+*/
+class abandoned_lease :
+  public ioa::automaton,
+  private ioa::observer
+{
+private:
+  ioa::handle_manager<abandoned_lease> m_self;
+  ioa::inet_address m_address;
+  ioa::automaton_manager<ioa::tcp_acceptor_automaton>* m_acceptor;
+  ioa::automaton_manager<ioa::tcp_connection_pool_automaton>* m_pool;
+  ioa::automaton_manager<lease_holder>* m_holder;
+  ioa::automaton_manager<ioa::tcp_connection_automaton>* m_server;
+  std::string m_received;
+  bool m_done;
+
+  void observe (ioa::observable*) {
+    if (m_holder == 0 &&
+	m_acceptor->get_state () == ioa::automaton_manager_interface::CREATED &&
+	m_pool->get_state () == ioa::automaton_manager_interface::CREATED) {
+      m_holder = new ioa::automaton_manager<lease_holder> (this, ioa::make_allocator<lease_holder> (m_pool->get_handle (), m_address));
+    }
+  }
+
+public:
+  abandoned_lease () :
+    m_self (ioa::get_aid ()),
+    m_holder (0),
+    m_server (0),
+    m_done (false)
+  {
+    const unsigned short port = 20000 + getpid () % 10000 + 4;
+    m_address = ioa::inet_address ("127.0.0.1", port);
+    m_acceptor = new ioa::automaton_manager<ioa::tcp_acceptor_automaton> (this, ioa::make_allocator<ioa::tcp_acceptor_automaton> (m_address));
+    add_observable (m_acceptor);
+    ioa::make_binding_manager (this, m_acceptor, &ioa::tcp_acceptor_automaton::accepted, &m_self, &abandoned_lease::accepted);
+
+    m_pool = new ioa::automaton_manager<ioa::tcp_connection_pool_automaton> (this, ioa::make_allocator<ioa::tcp_connection_pool_automaton> (1, ioa::time (0, 500000)));
+    add_observable (m_pool);
+
+    ioa::schedule_after (&abandoned_lease::timeout, ioa::time (5, 0));
+  }
+
+private:
+  void finish () {
+    m_done = true;
+    ioa::cancel_timer (&abandoned_lease::timeout);
+    m_pool->destroy ();
+    m_acceptor->destroy ();
+    if (m_server != 0) {
+      m_server->destroy ();
+    }
+  }
+
+  void accepted_effect (const ioa::fd_transfer& fd) {
+    if (m_server == 0) {
+      m_server = new ioa::automaton_manager<ioa::tcp_connection_automaton> (this, ioa::make_allocator<ioa::tcp_connection_automaton> (fd));
+      ioa::make_binding_manager (this, m_server, &ioa::tcp_connection_automaton::receive, &m_self, &abandoned_lease::server_receive);
+      ioa::make_binding_manager (this, m_server, &ioa::tcp_connection_automaton::error, &m_self, &abandoned_lease::server_error);
+    }
+  }
+
+  void accepted_schedule () const { }
+
+  V_UP_INPUT (abandoned_lease, accepted, ioa::fd_transfer);
+
+  void server_receive_effect (const std::string& buf) {
+    m_received.append (buf);
+    if (m_received == "held") {
+      // The holder has the connection.  Destroy it without releasing.
+      m_holder->destroy ();
+    }
+  }
+
+  void server_receive_schedule () const { }
+
+  V_UP_INPUT (abandoned_lease, server_receive, std::string);
+
+  void server_error_effect (const int& error) {
+    if (!m_done) {
+      // The pool closed the abandoned connection.
+      goal_reached = error == ECONNRESET && m_received == "held";
+      finish ();
+    }
+  }
+
+  void server_error_schedule () const { }
+
+  V_UP_INPUT (abandoned_lease, server_error, int);
+
+  bool timeout_precondition () const {
+    return !m_done;
+  }
+
+  void timeout_effect () {
+    goal_reached = false;
+    finish ();
+  }
+
+  void timeout_schedule () const { }
+
+  UP_INTERNAL (abandoned_lease, timeout);
+};
+
+static const char*
+connection_pool_abandoned ()
+{
+  std::cout << __func__ << std::endl;
+  goal_reached = false;
+  ioa::global_fifo_scheduler ss;
+  ioa::run (ss, ioa::make_allocator<abandoned_lease> ());
+  mu_assert (goal_reached);
+  return 0;
+}
+
+const char*
+all_tests ()
+{
+  mu_run_test (send_queue_backpressure);
+  mu_run_test (send_zerocopy_and_file);
+  mu_run_test (zerocopy_completion);
+  mu_run_test (acceptor_and_connector_handoff);
+  mu_run_test (connector_retries);
+  mu_run_test (connect_timeout);
+  mu_run_test (connection_pool);
+  mu_run_test (connection_pool_abandoned);
+
+  return 0;
+}
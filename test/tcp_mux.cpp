@@ -0,0 +1,541 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "minunit.h"
+
+#include <ioa/tcp_mux_automaton.hpp>
+#include <ioa/global_fifo_scheduler.hpp>
+#include <sys/socket.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cassert>
+#include <deque>
+#include <iostream>
+#include <sstream>
+
+static bool goal_reached;
+
+static const size_t PAIR_COUNT = 100;
+
+/*
+  Gives each multiplexer one end of many socket pairs.
+  The first multiplexer sends a message on each of its sockets, the second echoes them, and then the first disconnects them all so the second sees them close.
+*/
+class echo_pairs :
+  public ioa::automaton,
+  private ioa::observer
+{
+private:
+  typedef ioa::tcp_mux_automaton::connection_id connection_id;
+  typedef ioa::tcp_mux_automaton::message message;
+  typedef ioa::tcp_mux_automaton::error_val error_val;
+
+  ioa::handle_manager<echo_pairs> m_self;
+  ioa::automaton_manager<ioa::tcp_mux_automaton>* m_mux[2];
+  std::deque<int> m_fds[2];
+  std::vector<connection_id> m_ids[2];
+  std::deque<message> m_send_queue[2];
+  std::map<connection_id, std::string> m_expected;
+  std::map<connection_id, std::string> m_received;
+  size_t m_echoes;
+  std::deque<connection_id> m_disconnect_queue;
+  bool m_disconnecting;
+  size_t m_closes;
+  size_t m_other_errors;
+  bool m_stopped;
+
+  void schedule () const {
+    for (int i = 0; i < 2; ++i) {
+      if (add_precondition (i)) {
+	ioa::schedule (&echo_pairs::add, i);
+      }
+      if (send_precondition (i)) {
+	ioa::schedule (&echo_pairs::send, i);
+      }
+    }
+    if (disconnect_precondition ()) {
+      ioa::schedule (&echo_pairs::disconnect);
+    }
+    if (stop_precondition ()) {
+      ioa::schedule (&echo_pairs::stop);
+    }
+  }
+
+  void observe (ioa::observable*) {
+    schedule ();
+  }
+
+  static std::string to_string (const connection_id id) {
+    std::ostringstream out;
+    out << "message " << id;
+    return out.str ();
+  }
+
+public:
+  echo_pairs () :
+    m_self (ioa::get_aid ()),
+    m_echoes (0),
+    m_disconnecting (false),
+    m_closes (0),
+    m_other_errors (0),
+    m_stopped (false)
+  {
+    add_observable (&add);
+    add_observable (&opened);
+    add_observable (&receive);
+    add_observable (&error);
+    add_observable (&closed);
+    add_observable (&send);
+    add_observable (&disconnect);
+
+    for (size_t k = 0; k < PAIR_COUNT; ++k) {
+      int fd[2];
+      int r = socketpair (AF_UNIX, SOCK_STREAM, 0, fd);
+      assert (r == 0);
+      m_fds[0].push_back (fd[0]);
+      m_fds[1].push_back (fd[1]);
+    }
+
+    for (int i = 0; i < 2; ++i) {
+      m_mux[i] = new ioa::automaton_manager<ioa::tcp_mux_automaton> (this, ioa::make_allocator<ioa::tcp_mux_automaton> (16));
+      ioa::make_binding_manager (this, &m_self, &echo_pairs::add, i, m_mux[i], &ioa::tcp_mux_automaton::add);
+      ioa::make_binding_manager (this, m_mux[i], &ioa::tcp_mux_automaton::opened, &m_self, &echo_pairs::opened, i);
+      ioa::make_binding_manager (this, &m_self, &echo_pairs::send, i, m_mux[i], &ioa::tcp_mux_automaton::send);
+      ioa::make_binding_manager (this, m_mux[i], &ioa::tcp_mux_automaton::receive, &m_self, &echo_pairs::receive, i);
+      ioa::make_binding_manager (this, m_mux[i], &ioa::tcp_mux_automaton::error, &m_self, &echo_pairs::error, i);
+    }
+    ioa::make_binding_manager (this, &m_self, &echo_pairs::disconnect, m_mux[0], &ioa::tcp_mux_automaton::disconnect);
+    ioa::make_binding_manager (this, m_mux[1], &ioa::tcp_mux_automaton::closed, &m_self, &echo_pairs::closed);
+  }
+
+  ~echo_pairs () {
+    for (int i = 0; i < 2; ++i) {
+      for (std::deque<int>::const_iterator pos = m_fds[i].begin (); pos != m_fds[i].end (); ++pos) {
+	close (*pos);
+      }
+    }
+  }
+
+private:
+  bool add_precondition (int i) const {
+    // opened, closed, and error are only reported while they are bound.
+    return !m_fds[i].empty () &&
+      ioa::binding_count (&echo_pairs::add, i) != 0 &&
+      (i == 0 || ioa::binding_count (&echo_pairs::closed) != 0) &&
+      ioa::binding_count (&echo_pairs::opened, i) != 0 &&
+      ioa::binding_count (&echo_pairs::receive, i) != 0 &&
+      ioa::binding_count (&echo_pairs::error, i) != 0;
+  }
+
+  ioa::fd_transfer add_effect (int i) {
+    ioa::fd_transfer fd (m_fds[i].front ());
+    m_fds[i].pop_front ();
+    return fd;
+  }
+
+  void add_schedule (int) const {
+    schedule ();
+  }
+
+  V_P_OUTPUT (echo_pairs, add, ioa::fd_transfer, int);
+
+  void opened_effect (const connection_id& id,
+		      int i) {
+    m_ids[i].push_back (id);
+    if (i == 0) {
+      m_expected[id] = to_string (id);
+      m_send_queue[0].push_back (message (id, m_expected[id]));
+    }
+  }
+
+  void opened_schedule (int) const {
+    schedule ();
+  }
+
+  V_P_INPUT (echo_pairs, opened, connection_id, int);
+
+  bool send_precondition (int i) const {
+    return !m_send_queue[i].empty () && ioa::binding_count (&echo_pairs::send, i) != 0;
+  }
+
+  message send_effect (int i) {
+    message m = m_send_queue[i].front ();
+    m_send_queue[i].pop_front ();
+    return m;
+  }
+
+  void send_schedule (int) const {
+    schedule ();
+  }
+
+  V_P_OUTPUT (echo_pairs, send, message, int);
+
+  void receive_effect (const message& m,
+		       int i) {
+    if (i == 1) {
+      // Echo.
+      m_send_queue[1].push_back (m);
+    }
+    else {
+      std::string& received = m_received[m.id];
+      received.append (m.data);
+      if (received == m_expected[m.id]) {
+	++m_echoes;
+	if (m_echoes == PAIR_COUNT) {
+	  m_disconnect_queue.assign (m_ids[0].begin (), m_ids[0].end ());
+	}
+      }
+    }
+  }
+
+  void receive_schedule (int) const {
+    schedule ();
+  }
+
+  V_P_INPUT (echo_pairs, receive, message, int);
+
+  bool disconnect_precondition () const {
+    return !m_disconnect_queue.empty () && ioa::binding_count (&echo_pairs::disconnect) != 0;
+  }
+
+  connection_id disconnect_effect () {
+    const connection_id id = m_disconnect_queue.front ();
+    m_disconnect_queue.pop_front ();
+    return id;
+  }
+
+  void disconnect_schedule () const {
+    schedule ();
+  }
+
+  V_UP_OUTPUT (echo_pairs, disconnect, connection_id);
+
+  void closed_effect (const connection_id&) {
+    ++m_closes;
+  }
+
+  void closed_schedule () const {
+    schedule ();
+  }
+
+  V_UP_INPUT (echo_pairs, closed, connection_id);
+
+  void error_effect (const error_val&,
+		     int) {
+    ++m_other_errors;
+  }
+
+  void error_schedule (int) const {
+    schedule ();
+  }
+
+  V_P_INPUT (echo_pairs, error, error_val, int);
+
+  bool stop_precondition () const {
+    return !m_stopped && m_closes == PAIR_COUNT;
+  }
+
+  void stop_effect () {
+    m_stopped = true;
+    goal_reached = m_echoes == PAIR_COUNT && m_other_errors == 0 && m_ids[0].size () == PAIR_COUNT && m_ids[1].size () == PAIR_COUNT;
+    m_mux[0]->destroy ();
+    m_mux[1]->destroy ();
+  }
+
+  void stop_schedule () const {
+    schedule ();
+  }
+
+  UP_INTERNAL (echo_pairs, stop);
+};
+
+static const char*
+echo_and_disconnect ()
+{
+  std::cout << __func__ << std::endl;
+  goal_reached = false;
+  ioa::global_fifo_scheduler ss;
+  ioa::run (ss, ioa::make_allocator<echo_pairs> ());
+  mu_assert (goal_reached);
+  return 0;
+}
+
+static const size_t REPLY_SIZE = 1 << 20;
+
+/*
+  A client sends a request on a socket pair and shuts down its writing side.
+  The multiplexer reports the end of the stream with closed but still writes a large reply, reporting backpressure while the client is not reading.
+  The client only reads once backpressure is reported and the socket is disconnected after the reply is queued.
+*/
+class half_close :
+  public ioa::automaton,
+  private ioa::observer
+{
+private:
+  typedef ioa::tcp_mux_automaton::connection_id connection_id;
+  typedef ioa::tcp_mux_automaton::message message;
+  typedef ioa::tcp_mux_automaton::error_val error_val;
+  typedef ioa::tcp_mux_automaton::backpressure_val backpressure_val;
+
+  ioa::handle_manager<half_close> m_self;
+  ioa::automaton_manager<ioa::tcp_mux_automaton>* m_mux;
+  int m_client;
+  int m_server;
+  connection_id m_id;
+  std::string m_request;
+  std::string m_reply;
+  bool m_replied;
+  bool m_closed;
+  bool m_disconnected;
+  std::vector<bool> m_backpressure;
+  bool m_read_wait;
+  std::string m_received;
+  bool m_eof;
+  size_t m_errors;
+  bool m_stopped;
+
+  void schedule () const {
+    if (add_precondition ()) {
+      ioa::schedule (&half_close::add);
+    }
+    if (send_precondition ()) {
+      ioa::schedule (&half_close::send);
+    }
+    if (disconnect_precondition ()) {
+      ioa::schedule (&half_close::disconnect);
+    }
+    if (stop_precondition ()) {
+      ioa::schedule (&half_close::stop);
+    }
+  }
+
+  void observe (ioa::observable*) {
+    schedule ();
+  }
+
+public:
+  half_close () :
+    m_self (ioa::get_aid ()),
+    m_id (0),
+    m_request ("request"),
+    m_replied (false),
+    m_closed (false),
+    m_disconnected (false),
+    m_read_wait (false),
+    m_eof (false),
+    m_errors (0),
+    m_stopped (false)
+  {
+    add_observable (&add);
+    add_observable (&receive);
+    add_observable (&closed);
+    add_observable (&backpressure);
+    add_observable (&error);
+    add_observable (&send);
+    add_observable (&disconnect);
+
+    int fd[2];
+    int r = socketpair (AF_UNIX, SOCK_STREAM, 0, fd);
+    assert (r == 0);
+    m_client = fd[0];
+    m_server = fd[1];
+    r = write (m_client, m_request.data (), m_request.size ());
+    assert (r == static_cast<int> (m_request.size ()));
+    r = shutdown (m_client, SHUT_WR);
+    assert (r == 0);
+    r = fcntl (m_client, F_SETFL, O_NONBLOCK);
+    assert (r == 0);
+
+    for (size_t i = 0; i < REPLY_SIZE; ++i) {
+      m_reply.push_back (static_cast<char> (i * 3));
+    }
+
+    m_mux = new ioa::automaton_manager<ioa::tcp_mux_automaton> (this, ioa::make_allocator<ioa::tcp_mux_automaton> (16, 65536, 1 << 16, 1 << 14));
+    ioa::make_binding_manager (this, &m_self, &half_close::add, m_mux, &ioa::tcp_mux_automaton::add);
+    ioa::make_binding_manager (this, &m_self, &half_close::send, m_mux, &ioa::tcp_mux_automaton::send);
+    ioa::make_binding_manager (this, &m_self, &half_close::disconnect, m_mux, &ioa::tcp_mux_automaton::disconnect);
+    ioa::make_binding_manager (this, m_mux, &ioa::tcp_mux_automaton::receive, &m_self, &half_close::receive);
+    ioa::make_binding_manager (this, m_mux, &ioa::tcp_mux_automaton::closed, &m_self, &half_close::closed);
+    ioa::make_binding_manager (this, m_mux, &ioa::tcp_mux_automaton::backpressure, &m_self, &half_close::backpressure);
+    ioa::make_binding_manager (this, m_mux, &ioa::tcp_mux_automaton::error, &m_self, &half_close::error);
+  }
+
+  ~half_close () {
+    if (m_server != -1) {
+      close (m_server);
+    }
+  }
+
+private:
+  bool add_precondition () const {
+    // closed, backpressure, and error are only reported while they are bound.
+    return m_server != -1 &&
+      ioa::binding_count (&half_close::add) != 0 &&
+      ioa::binding_count (&half_close::receive) != 0 &&
+      ioa::binding_count (&half_close::closed) != 0 &&
+      ioa::binding_count (&half_close::backpressure) != 0 &&
+      ioa::binding_count (&half_close::error) != 0;
+  }
+
+  ioa::fd_transfer add_effect () {
+    ioa::fd_transfer fd (m_server);
+    m_server = -1;
+    return fd;
+  }
+
+  void add_schedule () const {
+    schedule ();
+  }
+
+  V_UP_OUTPUT (half_close, add, ioa::fd_transfer);
+
+  void receive_effect (const message& m) {
+    m_id = m.id;
+  }
+
+  void receive_schedule () const {
+    schedule ();
+  }
+
+  V_UP_INPUT (half_close, receive, message);
+
+  bool send_precondition () const {
+    return m_id != 0 && !m_replied && ioa::binding_count (&half_close::send) != 0;
+  }
+
+  message send_effect () {
+    m_replied = true;
+    return message (m_id, m_reply);
+  }
+
+  void send_schedule () const {
+    schedule ();
+  }
+
+  V_UP_OUTPUT (half_close, send, message);
+
+  void closed_effect (const connection_id& id) {
+    m_closed = id == m_id;
+  }
+
+  void closed_schedule () const {
+    schedule ();
+  }
+
+  V_UP_INPUT (half_close, closed, connection_id);
+
+  bool disconnect_precondition () const {
+    return m_closed && m_replied && !m_disconnected && ioa::binding_count (&half_close::disconnect) != 0;
+  }
+
+  connection_id disconnect_effect () {
+    m_disconnected = true;
+    return m_id;
+  }
+
+  void disconnect_schedule () const {
+    schedule ();
+  }
+
+  V_UP_OUTPUT (half_close, disconnect, connection_id);
+
+  void backpressure_effect (const backpressure_val& b) {
+    m_backpressure.push_back (b.congested);
+    if (b.congested && !m_read_wait && !m_eof) {
+      m_read_wait = true;
+      ioa::schedule_read_ready (&half_close::read_ready, m_client);
+    }
+  }
+
+  void backpressure_schedule () const {
+    schedule ();
+  }
+
+  V_UP_INPUT (half_close, backpressure, backpressure_val);
+
+  bool read_ready_precondition () const {
+    return m_read_wait;
+  }
+
+  void read_ready_effect () {
+    char buf[65536];
+    ssize_t n;
+    while ((n = read (m_client, buf, sizeof (buf))) > 0) {
+      m_received.append (buf, n);
+    }
+    if (n == 0) {
+      m_read_wait = false;
+      m_eof = true;
+      ioa::close (m_client);
+    }
+    else {
+      ioa::schedule_read_ready (&half_close::read_ready, m_client);
+    }
+  }
+
+  void read_ready_schedule () const {
+    schedule ();
+  }
+
+  UP_INTERNAL (half_close, read_ready);
+
+  void error_effect (const error_val&) {
+    ++m_errors;
+  }
+
+  void error_schedule () const {
+    schedule ();
+  }
+
+  V_UP_INPUT (half_close, error, error_val);
+
+  bool stop_precondition () const {
+    return !m_stopped && m_eof;
+  }
+
+  void stop_effect () {
+    m_stopped = true;
+    goal_reached = m_received == m_reply && m_errors == 0 && m_backpressure.size () == 2 && m_backpressure[0] && !m_backpressure[1];
+    m_mux->destroy ();
+  }
+
+  void stop_schedule () const {
+    schedule ();
+  }
+
+  UP_INTERNAL (half_close, stop);
+};
+
+static const char*
+half_close_and_backpressure ()
+{
+  std::cout << __func__ << std::endl;
+  goal_reached = false;
+  ioa::global_fifo_scheduler ss;
+  ioa::run (ss, ioa::make_allocator<half_close> ());
+  mu_assert (goal_reached);
+  return 0;
+}
+
+const char*
+all_tests ()
+{
+  mu_run_test (echo_and_disconnect);
+  mu_run_test (half_close_and_backpressure);
+
+  return 0;
+}
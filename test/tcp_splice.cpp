@@ -0,0 +1,204 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "minunit.h"
+
+#include <ioa/tcp_splice_automaton.hpp>
+#include <ioa/tcp_connection_automaton.hpp>
+#include <ioa/global_fifo_scheduler.hpp>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <iostream>
+
+static bool goal_reached;
+
+static const size_t PAYLOAD_SIZE = 1 << 20;
+
+// Connects two pairs of loopback sockets.  client[i] is connected to server[i].
+static void connect_pairs (int client[2],
+			   int server[2]) {
+  int listener = socket (AF_INET, SOCK_STREAM, 0);
+  assert (listener != -1);
+  sockaddr_in addr;
+  memset (&addr, 0, sizeof (addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+  addr.sin_port = 0;
+  int r = bind (listener, reinterpret_cast<sockaddr*> (&addr), sizeof (addr));
+  assert (r == 0);
+  r = listen (listener, 2);
+  assert (r == 0);
+  socklen_t len = sizeof (addr);
+  r = getsockname (listener, reinterpret_cast<sockaddr*> (&addr), &len);
+  assert (r == 0);
+
+  for (int i = 0; i < 2; ++i) {
+    client[i] = socket (AF_INET, SOCK_STREAM, 0);
+    assert (client[i] != -1);
+    r = connect (client[i], reinterpret_cast<sockaddr*> (&addr), sizeof (addr));
+    assert (r == 0);
+    // tcp_connection_automaton expects a non-blocking socket.
+    fcntl (client[i], F_SETFL, O_NONBLOCK);
+    server[i] = accept (listener, 0, 0);
+    assert (server[i] != -1);
+  }
+  close (listener);
+}
+
+/*
+  Splices two connections together, sends a large payload one way and a reply the other way, and closes both ends.
+*/
+class splice_pair :
+  public ioa::automaton,
+  private ioa::observer
+{
+private:
+  ioa::handle_manager<splice_pair> m_self;
+  ioa::automaton_manager<ioa::tcp_connection_automaton>* m_connection[2];
+  ioa::automaton_manager<ioa::tcp_splice_automaton>* m_splice;
+  std::string m_payload;
+  std::string m_send[2];
+  std::string m_received[2];
+  ioa::tcp_splice_automaton::bytes_val m_bytes;
+
+  void schedule () const {
+    for (int i = 0; i < 2; ++i) {
+      if (send_precondition (i)) {
+	ioa::schedule (&splice_pair::send, i);
+      }
+    }
+  }
+
+  void observe (ioa::observable*) {
+    schedule ();
+  }
+
+public:
+  splice_pair () :
+    m_self (ioa::get_aid ())
+  {
+    add_observable (&send);
+
+    int client[2];
+    int server[2];
+    connect_pairs (client, server);
+
+    for (size_t k = 0; k < PAYLOAD_SIZE; ++k) {
+      m_payload.push_back (static_cast<char> ('a' + k % 26));
+    }
+    m_send[0] = m_payload;
+
+    for (int i = 0; i < 2; ++i) {
+      m_connection[i] = new ioa::automaton_manager<ioa::tcp_connection_automaton> (this, ioa::make_allocator<ioa::tcp_connection_automaton> (ioa::fd_transfer (client[i])));
+      ioa::make_binding_manager (this, &m_self, &splice_pair::send, i, m_connection[i], &ioa::tcp_connection_automaton::send);
+      ioa::make_binding_manager (this, m_connection[i], &ioa::tcp_connection_automaton::receive, &m_self, &splice_pair::receive, i);
+    }
+    ioa::make_binding_manager (this, m_connection[1], &ioa::tcp_connection_automaton::error, &m_self, &splice_pair::connection_error);
+
+    m_splice = new ioa::automaton_manager<ioa::tcp_splice_automaton> (this, ioa::make_allocator<ioa::tcp_splice_automaton> (ioa::fd_transfer (server[0]), ioa::fd_transfer (server[1]), 1 << 14));
+    ioa::make_binding_manager (this, m_splice, &ioa::tcp_splice_automaton::bytes, &m_self, &splice_pair::bytes);
+    ioa::make_binding_manager (this, m_splice, &ioa::tcp_splice_automaton::closed, &m_self, &splice_pair::closed);
+  }
+
+private:
+  bool send_precondition (int i) const {
+    return !m_send[i].empty () && ioa::binding_count (&splice_pair::send, i) != 0;
+  }
+
+  std::string send_effect (int i) {
+    std::string retval;
+    retval.swap (m_send[i]);
+    return retval;
+  }
+
+  void send_schedule (int) const {
+    schedule ();
+  }
+
+  V_P_OUTPUT (splice_pair, send, std::string, int);
+
+  void receive_effect (const std::string& buf,
+		       int i) {
+    m_received[i].append (buf);
+    if (i == 1 && m_received[1].size () == PAYLOAD_SIZE) {
+      m_send[1] = "reply";
+    }
+    else if (i == 0 && m_received[0] == "reply") {
+      // The splice sees the end of the first connection and shuts down the second.
+      m_connection[0]->destroy ();
+    }
+  }
+
+  void receive_schedule (int) const {
+    schedule ();
+  }
+
+  V_P_INPUT (splice_pair, receive, std::string, int);
+
+  void connection_error_effect (const int&) {
+    // The end of the stream is reported as an error.
+    m_connection[1]->destroy ();
+  }
+
+  void connection_error_schedule () const {
+    schedule ();
+  }
+
+  V_UP_INPUT (splice_pair, connection_error, int);
+
+  void bytes_effect (const ioa::tcp_splice_automaton::bytes_val& b) {
+    m_bytes = b;
+  }
+
+  void bytes_schedule () const {
+    schedule ();
+  }
+
+  V_UP_INPUT (splice_pair, bytes, ioa::tcp_splice_automaton::bytes_val);
+
+  void closed_effect () {
+    goal_reached = m_received[1] == m_payload && m_bytes.forward == PAYLOAD_SIZE && m_bytes.backward == 5;
+    m_splice->destroy ();
+  }
+
+  void closed_schedule () const {
+    schedule ();
+  }
+
+  UV_UP_INPUT (splice_pair, closed);
+};
+
+static const char*
+splice_both_directions ()
+{
+  std::cout << __func__ << std::endl;
+  goal_reached = false;
+  ioa::global_fifo_scheduler ss;
+  ioa::run (ss, ioa::make_allocator<splice_pair> ());
+  mu_assert (goal_reached);
+  return 0;
+}
+
+const char*
+all_tests ()
+{
+  mu_run_test (splice_both_directions);
+
+  return 0;
+}
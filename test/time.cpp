@@ -18,6 +18,7 @@
 
 #include <ioa/time.hpp>
 #include <iostream>
+#include <pthread.h>
 
 static const char*
 default_ctor ()
@@ -239,6 +240,124 @@ op_minus ()
   return 0;
 }
 
+static const char*
+nsec ()
+{
+  std::cout << __func__ << std::endl;
+
+  ioa::time t1 (1, 500000);
+  mu_assert (t1.nsec () == 1500000000LL);
+
+  ioa::time t2 = ioa::time::from_nsec (-2500000999LL);
+  mu_assert (t2.sec () == -2);
+  mu_assert (t2.usec () == -500000);
+  mu_assert (t2.nsec () == -2500000999LL);
+
+  struct timespec ts;
+  ts.tv_sec = 3;
+  ts.tv_nsec = 999;
+  ioa::time t3 (ts);
+  mu_assert (t3.nsec () == 3000000999LL);
+  ts = t3;
+  mu_assert (ts.tv_sec == 3);
+  mu_assert (ts.tv_nsec == 999);
+
+  return 0;
+}
+
+static const char*
+monotonic ()
+{
+  std::cout << __func__ << std::endl;
+
+  ioa::time t1 = ioa::time::now ();
+  ioa::time t2 = ioa::time::now ();
+  mu_assert (t1 <= t2);
+
+  ioa::time c1 = ioa::time::refresh ();
+  mu_assert (ioa::time::coarse () == c1);
+  ioa::time c2 = ioa::time::refresh ();
+  mu_assert (c1 <= c2);
+  mu_assert (ioa::time::coarse () == c2);
+
+  return 0;
+}
+
+static void*
+refresh_thread (void* arg)
+{
+  bool* ok = static_cast<bool*> (arg);
+  ioa::time last = ioa::time::coarse ();
+  for (int i = 0; i < 100000; ++i) {
+    ioa::time::refresh ();
+    ioa::time c = ioa::time::coarse ();
+    if (c < last) {
+      *ok = false;
+    }
+    last = c;
+  }
+  return 0;
+}
+
+static const char*
+concurrent_refresh ()
+{
+  std::cout << __func__ << std::endl;
+
+  enum {
+    THREADS = 4,
+  };
+  pthread_t threads[THREADS];
+  bool ok[THREADS];
+  for (int i = 0; i < THREADS; ++i) {
+    ok[i] = true;
+    mu_assert (pthread_create (&threads[i], 0, refresh_thread, &ok[i]) == 0);
+  }
+  for (int i = 0; i < THREADS; ++i) {
+    pthread_join (threads[i], 0);
+    mu_assert (ok[i]);
+  }
+
+  return 0;
+}
+
+static const char*
+tsc ()
+{
+  std::cout << __func__ << std::endl;
+
+  if (ioa::time::set_clock_source (ioa::time::TSC_CLOCK)) {
+    mu_assert (ioa::time::get_clock_source () == ioa::time::TSC_CLOCK);
+    // The counter is on the same timeline as the monotonic clock.
+    struct timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    ioa::time t1 = ioa::time::now ();
+    ioa::time t2 = ioa::time::now ();
+    mu_assert (t1 <= t2);
+    mu_assert (t1 - ioa::time (ts) < ioa::time (0, 100000));
+    mu_assert (ioa::time (ts) - t1 < ioa::time (0, 100000));
+
+    // Calibrate and check again.
+    struct timespec delay = { 0, 20000000 };
+    nanosleep (&delay, 0);
+    ioa::time::now ();
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    t1 = ioa::time::now ();
+    t2 = ioa::time::now ();
+    mu_assert (t1 <= t2);
+    mu_assert (t1 - ioa::time (ts) < ioa::time (0, 100000));
+    mu_assert (ioa::time (ts) - t1 < ioa::time (0, 100000));
+  }
+  else {
+    mu_assert (ioa::time::get_clock_source () == ioa::time::MONOTONIC_CLOCK);
+  }
+
+  mu_assert (ioa::time::set_clock_source (ioa::time::MONOTONIC_CLOCK));
+  mu_assert (ioa::time::get_clock_source () == ioa::time::MONOTONIC_CLOCK);
+
+  return 0;
+}
+
 const char*
 all_tests ()
 {
@@ -250,6 +369,10 @@ all_tests ()
   mu_run_test (op_equal);
   mu_run_test (op_plus_equal);
   mu_run_test (op_minus);
+  mu_run_test (nsec);
+  mu_run_test (monotonic);
+  mu_run_test (concurrent_refresh);
+  mu_run_test (tsc);
 
   return 0;
 }
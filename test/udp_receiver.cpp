@@ -0,0 +1,188 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "minunit.h"
+
+#include <ioa/udp_receiver_automaton.hpp>
+#include <ioa/global_fifo_scheduler.hpp>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+static bool goal_reached;
+
+static const int COUNT = 1000;
+static const char* MARKER = "marker";
+
+/*
+  Floods a receiver with a small receive buffer and checks that every datagram is either delivered in order or counted as dropped.
+  A marker is sent after each batch until one arrives because drops are only reported with later datagrams.
+*/
+class batch_receive :
+  public ioa::automaton,
+  private ioa::observer
+{
+private:
+  ioa::handle_manager<batch_receive> m_self;
+  ioa::inet_address m_address;
+  int m_fd;
+  ioa::automaton_manager<ioa::udp_receiver_automaton>* m_receiver;
+  bool m_flooded;
+  int m_markers_sent;
+  bool m_marker_received;
+  int m_received;
+  bool m_in_order;
+  uint32_t m_drops;
+  bool m_stopped;
+
+  void schedule () const {
+    if (flood_precondition ()) {
+      ioa::schedule (&batch_receive::flood);
+    }
+    if (stop_precondition ()) {
+      ioa::schedule (&batch_receive::stop);
+    }
+  }
+
+  void observe (ioa::observable*) {
+    schedule ();
+  }
+
+  void send_datagram (const std::string& s) {
+    sendto (m_fd, s.data (), s.size (), 0, m_address.get_sockaddr (), m_address.get_socklen ());
+  }
+
+public:
+  batch_receive () :
+    m_self (ioa::get_aid ()),
+    m_address ("127.0.0.1", 20000 + getpid () % 20000),
+    m_fd (socket (AF_INET, SOCK_DGRAM, 0)),
+    m_flooded (false),
+    m_markers_sent (0),
+    m_marker_received (false),
+    m_received (0),
+    m_in_order (true),
+    m_drops (0),
+    m_stopped (false)
+  {
+    assert (m_fd != -1);
+    m_receiver = new ioa::automaton_manager<ioa::udp_receiver_automaton> (this, ioa::make_allocator<ioa::udp_receiver_automaton> (m_address, 16, 256, 4096));
+    add_observable (m_receiver);
+    ioa::make_binding_manager (this, m_receiver, &ioa::udp_receiver_automaton::receive_batch, &m_self, &batch_receive::receive_batch);
+    ioa::make_binding_manager (this, m_receiver, &ioa::udp_receiver_automaton::drops, &m_self, &batch_receive::drops);
+  }
+
+  ~batch_receive () {
+    close (m_fd);
+  }
+
+private:
+  bool flood_precondition () const {
+    return !m_flooded && m_receiver->get_state () == ioa::automaton_manager_interface::CREATED;
+  }
+
+  void flood_effect () {
+    m_flooded = true;
+    // The receiver cannot run until this action finishes so most of these are dropped.
+    for (int i = 0; i < COUNT; ++i) {
+      char buf[32];
+      snprintf (buf, sizeof (buf), "%d", i);
+      send_datagram (buf);
+    }
+  }
+
+  void flood_schedule () const {
+    schedule ();
+  }
+
+  UP_INTERNAL (batch_receive, flood);
+
+  void receive_batch_effect (const ioa::udp_receiver_automaton::receive_batch_val& batch) {
+    for (ioa::udp_receiver_automaton::receive_batch_val::const_iterator pos = batch.begin ();
+	 pos != batch.end ();
+	 ++pos) {
+      const std::string s = pos->buffer.str ();
+      if (s == MARKER) {
+	m_marker_received = true;
+      }
+      else {
+	if (atoi (s.c_str ()) < m_received) {
+	  m_in_order = false;
+	}
+	++m_received;
+      }
+    }
+
+    if (!m_marker_received) {
+      ++m_markers_sent;
+      send_datagram (MARKER);
+    }
+  }
+
+  void receive_batch_schedule () const {
+    schedule ();
+  }
+
+  V_UP_INPUT (batch_receive, receive_batch, ioa::udp_receiver_automaton::receive_batch_val);
+
+  void drops_effect (const uint32_t& d) {
+    m_drops = d;
+  }
+
+  void drops_schedule () const {
+    schedule ();
+  }
+
+  V_UP_INPUT (batch_receive, drops, uint32_t);
+
+  bool stop_precondition () const {
+    // The marker carries the drops of the whole flood.
+    return !m_stopped && m_marker_received && m_received + static_cast<int> (m_drops) >= COUNT;
+  }
+
+  void stop_effect () {
+    m_stopped = true;
+    // Every datagram is accounted for except markers that were dropped.
+    goal_reached = m_in_order && m_received != 0 && m_drops != 0 && m_received + static_cast<int> (m_drops) <= COUNT + m_markers_sent - 1;
+    m_receiver->destroy ();
+  }
+
+  void stop_schedule () const {
+    schedule ();
+  }
+
+  UP_INTERNAL (batch_receive, stop);
+};
+
+static const char*
+batch_receive_drops ()
+{
+  std::cout << __func__ << std::endl;
+  goal_reached = false;
+  ioa::global_fifo_scheduler ss;
+  ioa::run (ss, ioa::make_allocator<batch_receive> ());
+  mu_assert (goal_reached);
+  return 0;
+}
+
+const char*
+all_tests ()
+{
+  mu_run_test (batch_receive_drops);
+
+  return 0;
+}
@@ -0,0 +1,178 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "minunit.h"
+
+#include <ioa/udp_sender_automaton.hpp>
+#include <ioa/udp_receiver_automaton.hpp>
+#include <ioa/global_fifo_scheduler.hpp>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+static bool goal_reached;
+
+static const int COUNT = 1000;
+static const size_t WINDOW = 32;
+
+/*
+  Sends windows of datagrams and checks that they arrive intact and that send_complete acknowledges many sends at once.
+  Runs of equal-sized datagrams are cut short by smaller ones so segmented sends end with a short segment.
+  A window starts only after the previous one has been received so the receiver never drops.
+*/
+class window_send :
+  public ioa::automaton,
+  private ioa::observer
+{
+private:
+  ioa::handle_manager<window_send> m_self;
+  ioa::inet_address m_address;
+  ioa::automaton_manager<ioa::udp_sender_automaton>* m_sender;
+  ioa::automaton_manager<ioa::udp_receiver_automaton>* m_receiver;
+  int m_sent;
+  size_t m_outstanding;
+  int m_completes;
+  int m_received;
+  bool m_intact;
+  bool m_stopped;
+
+  void schedule () const {
+    if (send_precondition ()) {
+      ioa::schedule (&window_send::send);
+    }
+    if (stop_precondition ()) {
+      ioa::schedule (&window_send::stop);
+    }
+  }
+
+  void observe (ioa::observable*) {
+    schedule ();
+  }
+
+  static std::string message (const int i) {
+    char buf[32];
+    snprintf (buf, sizeof (buf), "%d:", i);
+    std::string retval (buf);
+    retval.resize (i % 7 == 6 ? 500 : 1000, static_cast<char> ('a' + i % 26));
+    return retval;
+  }
+
+public:
+  window_send () :
+    m_self (ioa::get_aid ()),
+    m_address ("127.0.0.1", 20000 + getpid () % 20000),
+    m_sent (0),
+    m_outstanding (0),
+    m_completes (0),
+    m_received (0),
+    m_intact (true),
+    m_stopped (false)
+  {
+    m_sender = new ioa::automaton_manager<ioa::udp_sender_automaton> (this, ioa::make_allocator<ioa::udp_sender_automaton> (0, WINDOW));
+    m_receiver = new ioa::automaton_manager<ioa::udp_receiver_automaton> (this, ioa::make_allocator<ioa::udp_receiver_automaton> (m_address, 16, 2048));
+    add_observable (m_sender);
+    add_observable (m_receiver);
+    ioa::make_binding_manager (this, &m_self, &window_send::send, m_sender, &ioa::udp_sender_automaton::send);
+    ioa::make_binding_manager (this, m_sender, &ioa::udp_sender_automaton::send_complete, &m_self, &window_send::send_complete);
+    ioa::make_binding_manager (this, m_receiver, &ioa::udp_receiver_automaton::receive_batch, &m_self, &window_send::receive_batch);
+  }
+
+private:
+  bool send_precondition () const {
+    return m_sent != COUNT &&
+      m_outstanding != WINDOW &&
+      (m_outstanding != 0 || m_received == m_sent) &&
+      m_receiver->get_state () == ioa::automaton_manager_interface::CREATED &&
+      ioa::binding_count (&window_send::send) != 0;
+  }
+
+  ioa::udp_sender_automaton::send_arg send_effect () {
+    ++m_outstanding;
+    return ioa::udp_sender_automaton::send_arg (m_address, message (m_sent++));
+  }
+
+  void send_schedule () const {
+    schedule ();
+  }
+
+  V_UP_OUTPUT (window_send, send, ioa::udp_sender_automaton::send_arg);
+
+  void send_complete_effect () {
+    // Everything sent so far has been written.
+    m_outstanding = 0;
+    ++m_completes;
+  }
+
+  void send_complete_schedule () const {
+    schedule ();
+  }
+
+  UV_UP_INPUT (window_send, send_complete);
+
+  void receive_batch_effect (const ioa::udp_receiver_automaton::receive_batch_val& batch) {
+    for (ioa::udp_receiver_automaton::receive_batch_val::const_iterator pos = batch.begin ();
+	 pos != batch.end ();
+	 ++pos) {
+      if (pos->buffer.str () != message (m_received)) {
+	m_intact = false;
+      }
+      ++m_received;
+    }
+  }
+
+  void receive_batch_schedule () const {
+    schedule ();
+  }
+
+  V_UP_INPUT (window_send, receive_batch, ioa::udp_receiver_automaton::receive_batch_val);
+
+  bool stop_precondition () const {
+    return !m_stopped && m_received == COUNT && m_outstanding == 0;
+  }
+
+  void stop_effect () {
+    m_stopped = true;
+    goal_reached = m_intact && m_completes < COUNT;
+    m_sender->destroy ();
+    m_receiver->destroy ();
+  }
+
+  void stop_schedule () const {
+    schedule ();
+  }
+
+  UP_INTERNAL (window_send, stop);
+};
+
+static const char*
+window_send_batches ()
+{
+  std::cout << __func__ << std::endl;
+  goal_reached = false;
+  ioa::global_fifo_scheduler ss;
+  ioa::run (ss, ioa::make_allocator<window_send> ());
+  mu_assert (goal_reached);
+  return 0;
+}
+
+const char*
+all_tests ()
+{
+  mu_run_test (window_send_batches);
+
+  return 0;
+}
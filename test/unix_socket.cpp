@@ -0,0 +1,347 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "minunit.h"
+
+#include <ioa/unix_acceptor_automaton.hpp>
+#include <ioa/unix_connector_automaton.hpp>
+#include <ioa/unix_datagram_automaton.hpp>
+#include <ioa/global_fifo_scheduler.hpp>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sstream>
+#include <iostream>
+
+static bool goal_reached;
+
+static std::string abstract_path (const std::string& name) {
+  // Abstract names leave no files behind.
+  std::ostringstream out;
+  out << '\0' << "ioa-test-" << name << "-" << getpid ();
+  return out.str ();
+}
+
+// Checks that the descriptor is the write end of the pipe whose read end is read_fd.
+static bool writes_to (const int fd,
+		       const int read_fd) {
+  char c = 'x';
+  if (write (fd, &c, 1) != 1) {
+    return false;
+  }
+  c = 0;
+  return read (read_fd, &c, 1) == 1 && c == 'x';
+}
+
+/*
+  Connects a client to a server, sends the write end of a pipe with the first message, and checks that the server can write to it.
+  On SOCK_SEQPACKET, the messages must also arrive with their boundaries.
+  If the first message has no bytes, it must arrive as one zero byte with the descriptor.
+*/
+class fd_passing :
+  public ioa::automaton,
+  private ioa::observer
+{
+private:
+  enum {
+    SERVER,
+    CLIENT,
+    CONNECTION_COUNT
+  };
+
+  const int m_type;
+  const std::string m_first;
+  ioa::handle_manager<fd_passing> m_self;
+  ioa::automaton_manager<ioa::unix_acceptor_automaton>* m_acceptor;
+  ioa::automaton_manager<ioa::unix_connection_automaton>* m_connection[CONNECTION_COUNT];
+  int m_pipe[2];
+  std::deque<ioa::unix_message> m_send_queue[CONNECTION_COUNT];
+  std::vector<std::string> m_received;
+  bool m_fd_works;
+  bool m_stopped;
+
+  void schedule () const {
+    for (int i = 0; i < CONNECTION_COUNT; ++i) {
+      if (send_precondition (i)) {
+	ioa::schedule (&fd_passing::send, i);
+      }
+    }
+    if (stop_precondition ()) {
+      ioa::schedule (&fd_passing::stop);
+    }
+  }
+
+  void observe (ioa::observable*) {
+    schedule ();
+  }
+
+  size_t expected_count () const {
+    return m_type == SOCK_SEQPACKET ? 2 : 1;
+  }
+
+public:
+  fd_passing (const int type,
+	      const bool fd_only = false) :
+    m_type (type),
+    m_first (fd_only ? "" : "ping"),
+    m_self (ioa::get_aid ()),
+    m_fd_works (false),
+    m_stopped (false)
+  {
+    add_observable (&send);
+
+    int r = pipe (m_pipe);
+    assert (r == 0);
+    fcntl (m_pipe[0], F_SETFL, O_NONBLOCK);
+    for (int i = 0; i < CONNECTION_COUNT; ++i) {
+      m_connection[i] = 0;
+    }
+
+    const ioa::unix_address address (abstract_path (type == SOCK_SEQPACKET ? "seqpacket" : (fd_only ? "fd-only" : "stream")));
+    m_acceptor = new ioa::automaton_manager<ioa::unix_acceptor_automaton> (this, ioa::make_allocator<ioa::unix_acceptor_automaton> (address, type));
+    ioa::make_binding_manager (this, m_acceptor, &ioa::unix_acceptor_automaton::accepted, &m_self, &fd_passing::transferred, static_cast<int> (SERVER));
+    // The acceptor might not be listening yet.
+    ioa::automaton_manager<ioa::unix_connector_automaton>* connector = ioa::make_automaton_manager (this, ioa::make_allocator<ioa::unix_connector_automaton> (address, type, 10, ioa::time (0, 1000)));
+    ioa::make_binding_manager (this, connector, &ioa::unix_connector_automaton::connected, &m_self, &fd_passing::transferred, static_cast<int> (CLIENT));
+
+    m_send_queue[CLIENT].push_back (ioa::unix_message (m_first, ioa::fd_transfer (m_pipe[1])));
+    if (type == SOCK_SEQPACKET) {
+      m_send_queue[CLIENT].push_back (ioa::unix_message ("pong"));
+    }
+  }
+
+  ~fd_passing () {
+    close (m_pipe[0]);
+  }
+
+private:
+  void transferred_effect (const ioa::fd_transfer& fd,
+			   int i) {
+    m_connection[i] = new ioa::automaton_manager<ioa::unix_connection_automaton> (this, ioa::make_allocator<ioa::unix_connection_automaton> (fd));
+    ioa::make_binding_manager (this, &m_self, &fd_passing::send, i, m_connection[i], &ioa::unix_connection_automaton::send);
+    ioa::make_binding_manager (this, m_connection[i], &ioa::unix_connection_automaton::receive, &m_self, &fd_passing::receive, i);
+  }
+
+  void transferred_schedule (int) const {
+    schedule ();
+  }
+
+  V_P_INPUT (fd_passing, transferred, ioa::fd_transfer, int);
+
+  bool send_precondition (int i) const {
+    return !m_send_queue[i].empty () && ioa::binding_count (&fd_passing::send, i) != 0;
+  }
+
+  ioa::unix_message send_effect (int i) {
+    ioa::unix_message m = m_send_queue[i].front ();
+    m_send_queue[i].pop_front ();
+    return m;
+  }
+
+  void send_schedule (int) const {
+    schedule ();
+  }
+
+  V_P_OUTPUT (fd_passing, send, ioa::unix_message, int);
+
+  void receive_effect (const ioa::unix_message& m,
+		       int i) {
+    if (i == SERVER) {
+      m_received.push_back (m.data);
+      if (m_received.size () == 1 && m.fds.size () == 1) {
+	const int fd = m.fds.front ().take ();
+	m_fd_works = writes_to (fd, m_pipe[0]);
+	close (fd);
+      }
+      if (m_received.size () == expected_count ()) {
+	m_send_queue[SERVER].push_back (ioa::unix_message ("done"));
+      }
+    }
+    else if (m.data == "done") {
+      goal_reached = m_fd_works && m_received[0] == (m_first.empty () ? std::string (1, '\0') : m_first) && (m_type != SOCK_SEQPACKET || m_received[1] == "pong");
+      m_stopped = true;
+    }
+  }
+
+  void receive_schedule (int) const {
+    schedule ();
+  }
+
+  V_P_INPUT (fd_passing, receive, ioa::unix_message, int);
+
+  bool stop_precondition () const {
+    return m_stopped;
+  }
+
+  void stop_effect () {
+    m_stopped = false;
+    for (int i = 0; i < CONNECTION_COUNT; ++i) {
+      m_connection[i]->destroy ();
+    }
+    m_acceptor->destroy ();
+  }
+
+  void stop_schedule () const {
+    schedule ();
+  }
+
+  UP_INTERNAL (fd_passing, stop);
+};
+
+static const char*
+stream_fd_passing ()
+{
+  std::cout << __func__ << std::endl;
+  goal_reached = false;
+  ioa::global_fifo_scheduler ss;
+  ioa::run (ss, ioa::make_allocator<fd_passing> (SOCK_STREAM));
+  mu_assert (goal_reached);
+  return 0;
+}
+
+static const char*
+stream_fd_only ()
+{
+  std::cout << __func__ << std::endl;
+  goal_reached = false;
+  ioa::global_fifo_scheduler ss;
+  ioa::run (ss, ioa::make_allocator<fd_passing> (SOCK_STREAM, true));
+  mu_assert (goal_reached);
+  return 0;
+}
+
+static const char*
+seqpacket_fd_passing ()
+{
+  std::cout << __func__ << std::endl;
+  goal_reached = false;
+  ioa::global_fifo_scheduler ss;
+  ioa::run (ss, ioa::make_allocator<fd_passing> (SOCK_SEQPACKET));
+  mu_assert (goal_reached);
+  return 0;
+}
+
+/*
+  Sends a datagram with the write end of a pipe between two bound sockets.
+*/
+class datagram_passing :
+  public ioa::automaton,
+  private ioa::observer
+{
+private:
+  ioa::handle_manager<datagram_passing> m_self;
+  ioa::unix_address m_address[2];
+  ioa::automaton_manager<ioa::unix_datagram_automaton>* m_socket[2];
+  int m_pipe[2];
+  bool m_sent;
+
+  void schedule () const {
+    if (send_precondition ()) {
+      ioa::schedule (&datagram_passing::send);
+    }
+  }
+
+  void observe (ioa::observable*) {
+    schedule ();
+  }
+
+public:
+  datagram_passing () :
+    m_self (ioa::get_aid ()),
+    m_sent (false)
+  {
+    add_observable (&send);
+
+    int r = pipe (m_pipe);
+    assert (r == 0);
+    fcntl (m_pipe[0], F_SETFL, O_NONBLOCK);
+
+    for (int i = 0; i < 2; ++i) {
+      std::ostringstream name;
+      name << "datagram-" << i;
+      m_address[i] = ioa::unix_address (abstract_path (name.str ()));
+      m_socket[i] = new ioa::automaton_manager<ioa::unix_datagram_automaton> (this, ioa::make_allocator<ioa::unix_datagram_automaton> (m_address[i]));
+      add_observable (m_socket[i]);
+    }
+    ioa::make_binding_manager (this, &m_self, &datagram_passing::send, m_socket[0], &ioa::unix_datagram_automaton::send);
+    ioa::make_binding_manager (this, m_socket[1], &ioa::unix_datagram_automaton::receive, &m_self, &datagram_passing::receive);
+  }
+
+  ~datagram_passing () {
+    if (!m_sent) {
+      close (m_pipe[1]);
+    }
+    close (m_pipe[0]);
+  }
+
+private:
+  bool send_precondition () const {
+    // The receiver must be bound or the datagram is dropped.
+    return !m_sent &&
+      m_socket[1]->get_state () == ioa::automaton_manager_interface::CREATED &&
+      ioa::binding_count (&datagram_passing::send) != 0;
+  }
+
+  ioa::unix_datagram_automaton::send_arg send_effect () {
+    m_sent = true;
+    return ioa::unix_datagram_automaton::send_arg (m_address[1], ioa::unix_message ("hello", ioa::fd_transfer (m_pipe[1])));
+  }
+
+  void send_schedule () const {
+    schedule ();
+  }
+
+  V_UP_OUTPUT (datagram_passing, send, ioa::unix_datagram_automaton::send_arg);
+
+  void receive_effect (const ioa::unix_datagram_automaton::receive_val& v) {
+    bool fd_works = false;
+    if (v.message.fds.size () == 1) {
+      const int fd = v.message.fds.front ().take ();
+      fd_works = writes_to (fd, m_pipe[0]);
+      close (fd);
+    }
+    goal_reached = fd_works && v.message.data == "hello" && v.address.path () == m_address[0].path ();
+    m_socket[0]->destroy ();
+    m_socket[1]->destroy ();
+  }
+
+  void receive_schedule () const {
+    schedule ();
+  }
+
+  V_UP_INPUT (datagram_passing, receive, ioa::unix_datagram_automaton::receive_val);
+};
+
+static const char*
+datagram_fd_passing ()
+{
+  std::cout << __func__ << std::endl;
+  goal_reached = false;
+  ioa::global_fifo_scheduler ss;
+  ioa::run (ss, ioa::make_allocator<datagram_passing> ());
+  mu_assert (goal_reached);
+  return 0;
+}
+
+const char*
+all_tests ()
+{
+  mu_run_test (stream_fd_passing);
+  mu_run_test (stream_fd_only);
+  mu_run_test (seqpacket_fd_passing);
+  mu_run_test (datagram_fd_passing);
+
+  return 0;
+}
@@ -0,0 +1,73 @@
+/*
+   Copyright 2011 Justin R. Wilson
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "minunit.h"
+
+#include <ioa/global_fifo_scheduler.hpp>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#endif
+
+class uring_scheduler :
+  public ioa::global_fifo_scheduler
+{
+public:
+  uring_scheduler () :
+    ioa::global_fifo_scheduler (ioa::global_fifo_scheduler::IO_URING_BACKEND)
+  { }
+};
+
+static bool
+uring_supported ()
+{
+#ifdef __NR_io_uring_setup
+  struct io_uring_params p;
+  memset (&p, 0, sizeof (p));
+  const int fd = syscall (__NR_io_uring_setup, 1, &p);
+  if (fd != -1) {
+    close (fd);
+    return true;
+  }
+#endif
+  return false;
+}
+
+/*
+  Runs first so the other tests do not pass on the select fall back.
+*/
+static const char*
+backend ()
+{
+  std::cout << __func__ << std::endl;
+  if (!uring_supported ()) {
+    std::cout << "  skipped: io_uring is not available" << std::endl;
+    // The test harness reports 77 as a skip.
+    exit (77);
+  }
+  uring_scheduler ss;
+  mu_assert (ss.get_backend () == ioa::global_fifo_scheduler::IO_URING_BACKEND);
+  return 0;
+}
+
+#define SCHEDULER_TYPE uring_scheduler
+#define SCHEDULER_CHECK backend
+
+#include "scheduler_test.hpp"